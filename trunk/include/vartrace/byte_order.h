@@ -0,0 +1,87 @@
+/* byte_order.h
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file byte_order.h
+
+  Reading dumps produced on machines with other byte order.
+
+  Headers and data are written in the byte order of the producing
+  machine. A dump becomes self describing if it starts with a byte
+  order mark: an ordinary top level message of type
+  kTypeIdByteOrderMark that holds the 32 bit value kByteOrderMark. The
+  mark is written by WriteByteOrderMark() before the trace is dumped
+  and is parsed like any other message. DumpInto() and DrainInto() do
+  not write the mark themselves, the caller must do it.
+
+  ToNativeByteOrder() checks the mark and, if the dump comes from a
+  machine with the other byte order, swaps timestamps, description
+  words and data of standard types in place. Arrays are swapped with
+  SSE2 when it is available, so the conversion runs close to memory
+  speed. Data of user defined types is left untouched. All fields are
+  read with memcpy, so the dump buffer needs no particular alignment.
+*/
+
+#ifndef TRUNK_INCLUDE_VARTRACE_BYTE_ORDER_H_
+#define TRUNK_INCLUDE_VARTRACE_BYTE_ORDER_H_
+
+#include <vartrace/tracetypes.h>
+#include <vartrace/type_codes.h>
+#include <vartrace/utility.h>
+
+#include <cstddef>
+#include <cstring>
+
+namespace vartrace {
+
+//! Byte order of a dump relative to the reading machine.
+enum ByteOrder {
+  kUnknownByteOrder, //!< Dump does not start with a byte order mark.
+  kNativeByteOrder, //!< Dump was written with the same byte order.
+  kSwappedByteOrder //!< Dump was written with the opposite byte order.
+};
+
+//! Value stored in the byte order mark message.
+const uint32_t kByteOrderMark = 0x01020304;
+//! Size of the byte order mark message in bytes.
+const unsigned kByteOrderMarkSize = sizeof(AlignmentType)*kHeaderLength
+    + sizeof(kByteOrderMark);
+
+//! Write byte order mark message, return its size or 0 if it does not fit.
+inline unsigned WriteByteOrderMark(void *buffer, unsigned size) {
+  if (size < kByteOrderMarkSize) {
+    return 0;
+  }
+  AlignmentType words[kHeaderLength + 1] = {0};
+  words[kHeaderLength - 1] = sizeof(kByteOrderMark)
+      + (static_cast<AlignmentType>(kTypeIdByteOrderMark) << kDataIdShift);
+  words[kHeaderLength] = kByteOrderMark;
+  std::memcpy(buffer, words, kByteOrderMarkSize);
+  return kByteOrderMarkSize;
+}
+
+//! Check the byte order mark at the beginning of a dump.
+ByteOrder DetectByteOrder(const void *dump, std::size_t size);
+
+//! Swap byte order of all headers and standard type data in place.
+void SwapByteOrder(void *dump, std::size_t size);
+
+//! Convert dump to native byte order if needed, return detected order.
+ByteOrder ToNativeByteOrder(void *dump, std::size_t size);
+}  // namespace vartrace
+
+#endif  // TRUNK_INCLUDE_VARTRACE_BYTE_ORDER_H_
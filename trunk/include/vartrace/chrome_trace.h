@@ -0,0 +1,144 @@
+/* chrome_trace.h
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file chrome_trace.h
+
+  Export of dumps as Chrome trace event JSON for timeline viewers.
+
+  ChromeTraceWriter is a TraceVisitor, so it receives messages one by
+  one from VisitMessages() or StreamParser and writes events as soon
+  as they are known. Memory use does not depend on the dump size.
+
+  Events are produced as follows:
+  - A top level subtrace becomes a complete event ("X") that starts at
+    its timestamp. Subtraces carry only the start time, the event
+    ends at the next top level message, which is logged after the
+    subtrace is closed.
+  - Top level span records of ScopedSpan become complete events named
+    by their id.
+  - Top level messages with ids configured as span begin and end
+    become begin ("B") and end ("E") events. A string logged as span
+    begin is used as the event name.
+  - Scalar values of standard numeric types become counter events
+    ("C") on a track named by the message path, e.g. "7/42".
+  - Strings become instant events ("i").
+  Nested messages have no timestamp of their own and use the time of
+  their top level subtrace. Other messages are skipped.
+
+  Timestamps are divided by the tick rate to get microseconds. The 32
+  bit timestamps are unwrapped when they decrease by more than half
+  of their range, so long captures keep increasing times.
+*/
+
+#ifndef TRUNK_INCLUDE_VARTRACE_CHROME_TRACE_H_
+#define TRUNK_INCLUDE_VARTRACE_CHROME_TRACE_H_
+
+#include <vartrace/message_view.h>
+#include <vartrace/stream_parser.h>
+#include <vartrace/text_writer.h>
+#include <vartrace/tracetypes.h>
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace vartrace {
+
+//! Layout of the exported JSON.
+enum ChromeTraceFormat {
+  kChromeArrayFormat, //!< Array of events, readable even if cut short.
+  kChromeObjectFormat //!< Object with traceEvents, preferred by Perfetto.
+};
+
+//! Settings of the export.
+struct ChromeTraceOptions {
+  //! Array format, one tick per microsecond, process and thread 1.
+  ChromeTraceOptions()
+      : ticks_per_microsecond(1), format(kChromeArrayFormat),
+        process_id(1), thread_id(1) {}
+
+  double ticks_per_microsecond; //!< Timestamp rate.
+  ChromeTraceFormat format; //!< Layout of the JSON.
+  int process_id; //!< Process of all events.
+  int thread_id; //!< Thread of all events.
+  std::string process_name; //!< Name shown for the process, if not empty.
+  std::string thread_name; //!< Name shown for the thread, if not empty.
+  //! Ids of top level messages that begin and end a span.
+  std::vector<std::pair<MessageIdType, MessageIdType> > spans;
+};
+
+//! Visitor that writes messages as Chrome trace events.
+class ChromeTraceWriter : public TraceVisitor {
+ public:
+  //! Writer of events into out, the JSON header is written at once.
+  ChromeTraceWriter(const ChromeTraceOptions &options, std::ostream *out);
+  //! Finish the JSON if Finish was not called.
+  virtual ~ChromeTraceWriter();
+
+  //! Write counter, instant or span event.
+  virtual void OnMessage(const MessageView &message);
+  //! Start a subtrace event or enter a nested subtrace.
+  virtual void OnSubtraceBegin(const MessageView &subtrace);
+  //! Leave a subtrace.
+  virtual void OnSubtraceEnd(const MessageView &subtrace);
+
+  //! Write the last subtrace and close the JSON, false on write errors.
+  bool Finish();
+  //! Number of events written so far.
+  std::size_t event_count() const {return event_count_;}
+
+ private:
+  //! Role of a message id in spans.
+  enum SpanRole {kNoSpan, kSpanBegin, kSpanEnd};
+
+  //! Writers can not be copied.
+  ChromeTraceWriter(const ChromeTraceWriter &);
+  //! Writers can not be copied.
+  ChromeTraceWriter &operator=(const ChromeTraceWriter &);
+
+  //! Unwrap timestamp of a top level message, end waiting subtrace.
+  void BeginTopLevel(const MessageView &message);
+  //! Write event of the waiting subtrace if there is one.
+  void EndSubtrace(uint64_t time);
+  //! Write separator, phase, time, process and thread of an event.
+  void BeginEvent(char phase, uint64_t time);
+  //! Write time in microseconds.
+  void WriteTime(uint64_t time);
+  //! Write message path and id as event name.
+  void WritePathName(const MessageView &message);
+  //! Write metadata event that names the process or the thread.
+  void WriteName(const char *kind, const std::string &name);
+
+  ChromeTraceOptions options_; //!< Settings.
+  TextWriter writer_; //!< Buffered output.
+  std::vector<MessageIdType> path_; //!< Ids of entered subtraces.
+  SpanRole span_roles_[0x100]; //!< Role of every message id.
+  TimestampUnwrapper unwrapper_; //!< Extends top level timestamps.
+  uint64_t time_; //!< Unwrapped timestamp of the current message.
+  bool has_subtrace_; //!< True if a subtrace waits for its end time.
+  MessageIdType subtrace_id_; //!< Id of the waiting subtrace.
+  uint64_t subtrace_time_; //!< Start of the waiting subtrace.
+  int subtrace_size_; //!< Size of the waiting subtrace in bytes.
+  std::size_t event_count_; //!< Written events.
+  bool is_finished_; //!< True after Finish.
+};
+}  // namespace vartrace
+
+#endif  // TRUNK_INCLUDE_VARTRACE_CHROME_TRACE_H_
@@ -0,0 +1,125 @@
+/* columnar.h
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file columnar.h
+
+  Export of trace values as columns.
+
+  Every combination of message path and standard numeric data type
+  becomes a column. The path consists of message ids of enclosing
+  subtraces followed by the id of the message, the column name is the
+  path joined with slashes and followed by the type name, for example
+  "4/17:double". A column holds one row per array element: the value
+  and the timestamp of the top level message that contains it. Arrays
+  are copied into columns in one block, so no per value decoding is
+  done. Messages of other types are counted but not exported.
+
+  Columns can be written as CSV with one row per value or as a binary
+  column file. The binary file starts with a header that lists the
+  columns with offsets of their timestamp and value arrays, all arrays
+  are stored in the byte order of the writer and aligned to 8 bytes so
+  they can be memory mapped directly:
+
+  \code
+  char     magic[8]         "VTCOLS01"
+  uint32_t byte_order_mark  0x01020304
+  uint32_t column_count
+  column_count times:
+    uint32_t name_size
+    char     name[name_size]
+    uint8_t  message_type_id, data_type_id, element_size, 0
+    uint64_t row_count
+    uint64_t timestamps_offset  uint32 timestamps from file start
+    uint64_t values_offset      values from file start
+  \endcode
+*/
+
+#ifndef TRUNK_INCLUDE_VARTRACE_COLUMNAR_H_
+#define TRUNK_INCLUDE_VARTRACE_COLUMNAR_H_
+
+#include <vartrace/message_view.h>
+#include <vartrace/tracetypes.h>
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vartrace {
+
+//! Values of one message path and data type.
+struct Column {
+  //! Values interpreted as array of given type.
+  template <typename T> const T *values() const {
+    return reinterpret_cast<const T *>(data.data());
+  }
+  //! Number of rows.
+  std::size_t size() const {return timestamps.size();}
+
+  std::string name; //!< Path and type name, e.g. "4/17:double".
+  std::vector<MessageIdType> path; //!< Ids from top level to the message.
+  DataIdType data_type_id; //!< Type of values.
+  std::size_t element_size; //!< Size of a value in bytes.
+  std::vector<TimestampType> timestamps; //!< Timestamp of every row.
+  std::vector<uint64_t> data; //!< Values, 8 byte aligned.
+};
+
+//! Name of a standard data type, empty for other types.
+std::string DataTypeName(int data_type_id);
+
+//! Collects columns from top level messages.
+class ColumnBuilder {
+ public:
+  //! Empty set of columns.
+  ColumnBuilder();
+
+  //! Add values of a top level message and its children.
+  void Add(const MessageView &message);
+  //! Add all messages of a dump.
+  void Add(const TraceView &view);
+
+  //! Columns in order of first appearance.
+  const std::vector<Column> &columns() const {return columns_;}
+  //! Number of messages with types that are not exported.
+  std::size_t skipped_count() const {return skipped_count_;}
+
+ private:
+  //! Add values of a message found under given path.
+  void AddMessage(const MessageView &message, TimestampType timestamp,
+                  uint32_t path_index);
+  //! Column for message under path, created if necessary.
+  Column *FindColumn(const MessageView &message, uint32_t path_index);
+  //! Index of the path of a subtrace child, created if necessary.
+  uint32_t ChildPath(const MessageView &subtrace, uint32_t path_index);
+
+  std::vector<Column> columns_; //!< Extracted columns.
+  std::vector<std::vector<MessageIdType> > paths_; //!< Known subtrace paths.
+  //! Path index, message and data id to column or child path index.
+  std::unordered_map<uint64_t, uint32_t> indices_;
+  std::size_t skipped_count_; //!< Messages that were not exported.
+};
+
+//! Write columns as CSV with columns name, timestamp and value.
+bool WriteColumnsCsv(const std::vector<Column> &columns, std::ostream *out);
+
+//! Write columns into binary column file.
+bool WriteColumnFile(const std::vector<Column> &columns, std::ostream *out);
+}  // namespace vartrace
+
+#endif  // TRUNK_INCLUDE_VARTRACE_COLUMNAR_H_
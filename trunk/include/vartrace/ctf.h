@@ -0,0 +1,177 @@
+/* ctf.h
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file ctf.h
+
+  Conversion of dumps into Common Trace Format 1.8 for Trace Compass
+  and babeltrace.
+
+  A CTF trace is a directory with a TSDL text file named metadata that
+  describes the binary layout and one or more binary stream files.
+  CtfWriter is a TraceVisitor that writes one stream directly from
+  decoded messages, values are copied without conversion to text.
+  The stream is cut into packets of about packet_size bytes, only the
+  current packet is kept in memory. Metadata() returns the matching
+  TSDL text.
+
+  Every message becomes an event, the event id is the data type id:
+  - standard types of type_codes.h produce events named after the
+    type, e.g. "int32", with the elements of the message in values;
+  - char messages produce "string" events with UTF-8 text;
+  - span records of ScopedSpan produce "span" events with the
+    duration, stamped with the end of the span so that event times
+    do not decrease;
+  - subtraces produce "subtrace_begin" and "subtrace_end" events
+    around the events of their nested messages;
+  - user types listed in the options produce events with the given
+    name and either raw bytes or elements of the given TSDL fields;
+  - other types produce "raw" events with the data type id and bytes.
+  All events carry the path of enclosing subtrace ids and the message
+  id. Nested messages use the timestamp of their top level subtrace.
+  Event times never decrease, an event older than the previous one,
+  e.g. a subtrace committed after messages of other threads, gets the
+  time of the previous event.
+
+  The event timestamps are 64 bit values of a clock with the given
+  frequency, 32 bit vartrace timestamps are unwrapped when they
+  decrease by more than half of their range. The clock offset aligns
+  the trace with other traces, e.g. LTTng kernel traces recorded with
+  the same clock. All fields are byte aligned and written in the byte
+  order of the converting machine.
+*/
+
+#ifndef TRUNK_INCLUDE_VARTRACE_CTF_H_
+#define TRUNK_INCLUDE_VARTRACE_CTF_H_
+
+#include <vartrace/message_view.h>
+#include <vartrace/stream_parser.h>
+#include <vartrace/tracetypes.h>
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace vartrace {
+
+//! Default size of stream packets in bytes.
+const std::size_t kDefaultCtfPacketSize = 0x10000;
+//! Event id of subtrace ends.
+const unsigned kCtfSubtraceEndId = 0x100;
+//! Event id of messages of types without description.
+const unsigned kCtfRawId = 0x101;
+
+//! Description of a user type, see VARTRACE_SET_TYPEID.
+struct CtfUserType {
+  //! Type without name.
+  CtfUserType() : data_type_id(0), element_size(0) {}
+  //! Type with given id, name and optional element layout.
+  CtfUserType(int type_id, const std::string &type_name,
+              std::size_t size = 0, const std::string &type_fields = "")
+      : data_type_id(type_id), name(type_name), element_size(size),
+        fields(type_fields) {}
+
+  int data_type_id; //!< Id assigned to the type.
+  std::string name; //!< Event name.
+  //! Size of one element, data is written as bytes if 0.
+  std::size_t element_size;
+  //! TSDL declarations of element fields, e.g. "float64_t x; float64_t y;".
+  /*! Fields may use byte aligned types int8_t ... uint64_t, float32_t
+    and float64_t declared in the metadata.
+   */
+  std::string fields;
+};
+
+//! Settings of the conversion.
+struct CtfOptions {
+  //! Nanosecond clock without offset, default packet size.
+  CtfOptions()
+      : clock_frequency(1000000000), clock_offset_seconds(0),
+        clock_offset(0), packet_size(kDefaultCtfPacketSize) {}
+
+  uint64_t clock_frequency; //!< Timestamp ticks per second.
+  int64_t clock_offset_seconds; //!< Seconds from epoch to timestamp 0.
+  uint64_t clock_offset; //!< Ticks added to the offset in seconds.
+  std::size_t packet_size; //!< Target size of packets in bytes.
+  std::vector<CtfUserType> user_types; //!< Known user types.
+};
+
+//! Visitor that writes messages as events of a CTF stream.
+class CtfWriter : public TraceVisitor {
+ public:
+  //! Writer of a stream into out, trace uuid is generated.
+  CtfWriter(const CtfOptions &options, std::ostream *out);
+  //! Write the last packet if Finish was not called.
+  virtual ~CtfWriter();
+
+  //! Write event of a message.
+  virtual void OnMessage(const MessageView &message);
+  //! Write subtrace begin event.
+  virtual void OnSubtraceBegin(const MessageView &subtrace);
+  //! Write subtrace end event.
+  virtual void OnSubtraceEnd(const MessageView &subtrace);
+
+  //! Write the last packet, return false on write errors.
+  bool Finish();
+  //! TSDL description of the stream.
+  std::string Metadata() const;
+  //! Number of events written so far.
+  std::size_t event_count() const {return event_count_;}
+  //! Trace uuid shared by the metadata and the packets.
+  const uint8_t *uuid() const {return uuid_;}
+
+ private:
+  //! Writers can not be copied.
+  CtfWriter(const CtfWriter &);
+  //! Writers can not be copied.
+  CtfWriter &operator=(const CtfWriter &);
+
+  //! Size of elements of events of a type, 0 if written as raw bytes.
+  std::size_t EventElementSize(int data_type_id) const;
+  //! Use time for next events unless it is older than the current one.
+  void SetTime(uint64_t time);
+  //! Write event header, subtrace path and message id.
+  void BeginEvent(unsigned event_id, const MessageView &message);
+  //! Count event, write packet if it is full.
+  void EndEvent();
+  //! Append bytes to the packet.
+  void Append(const void *data, std::size_t size);
+  //! Append a value to the packet.
+  template <typename T> void AppendValue(T value) {
+    Append(&value, sizeof(value));
+  }
+  //! Write packet header, context and events, start a new packet.
+  void FlushPacket();
+
+  CtfOptions options_; //!< Settings.
+  std::ostream *out_; //!< Stream file.
+  uint8_t uuid_[16]; //!< Trace uuid.
+  //! User type index plus one for every data type id, 0 if not known.
+  std::size_t user_types_[0x100];
+  std::vector<MessageIdType> path_; //!< Ids of entered subtraces.
+  std::vector<uint8_t> packet_; //!< Events of the current packet.
+  TimestampUnwrapper unwrapper_; //!< Extends top level timestamps.
+  uint64_t time_; //!< Time of the current event.
+  uint64_t packet_begin_; //!< Smallest timestamp of packet events.
+  uint64_t packet_end_; //!< Largest timestamp of packet events.
+  std::size_t event_count_; //!< Written events.
+  bool is_finished_; //!< True after Finish.
+};
+}  // namespace vartrace
+
+#endif  // TRUNK_INCLUDE_VARTRACE_CTF_H_
@@ -0,0 +1,112 @@
+/* flat_parsed_trace.h
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file flat_parsed_trace.h
+
+  Parsed trace stored in two flat arrays.
+
+  FlatParsedTrace owns a copy of a trace like ParsedVartrace but keeps
+  all messages in one array in pre-order, that is every subtrace is
+  followed by its descendants. A message refers to the end of its
+  subtree instead of keeping a list of children, and all payloads are
+  copied into one arena. Walking the trace is a linear scan and
+  destroying it frees two blocks of memory.
+*/
+
+#ifndef TRUNK_INCLUDE_VARTRACE_FLAT_PARSED_TRACE_H_
+#define TRUNK_INCLUDE_VARTRACE_FLAT_PARSED_TRACE_H_
+
+#include <vartrace/message_view.h>
+#include <vartrace/tracetypes.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+namespace vartrace {
+
+//! Description of a message in FlatParsedTrace, 16 bytes.
+struct FlatMessage {
+  TimestampType timestamp; //!< Timestamp, 0 for nested messages.
+  uint32_t data_index; //!< Start of data in the payload arena.
+  uint32_t subtree_end; //!< Index after the last descendant.
+  LengthType data_size; //!< Size of data or of all children in bytes.
+  MessageIdType message_type_id; //!< Message type id.
+  DataIdType data_type_id; //!< Data type id, 0 for subtraces.
+};
+
+//! Parsed trace with messages in pre-order and payloads in one arena.
+class FlatParsedTrace {
+ public:
+  //! Parse trace from byte array.
+  FlatParsedTrace(const void *byte_stream, std::size_t size);
+  //! Copy all messages of a range.
+  explicit FlatParsedTrace(const TraceView &view);
+
+  //! Total number of messages including nested ones.
+  std::size_t size() const {return messages_.size();}
+  //! Message at given pre-order position.
+  const FlatMessage &operator[](std::size_t index) const {
+    return messages_[index];
+  }
+  //! All messages in pre-order.
+  const std::vector<FlatMessage> &messages() const {return messages_;}
+  //! True if the message is a subtrace with children.
+  bool has_children(uint32_t index) const {
+    return messages_[index].subtree_end > index + 1;
+  }
+  //! Index of the next message on the same level or of the parent end.
+  uint32_t next_sibling(uint32_t index) const {
+    return messages_[index].subtree_end;
+  }
+  //! Index of the first child, equals next_sibling() if there are none.
+  uint32_t first_child(uint32_t index) const {return index + 1;}
+  //! Number of top level messages.
+  std::size_t top_level_count() const {return top_level_count_;}
+
+  //! Pointer to message data.
+  const void *data(uint32_t index) const {
+    return payload_.data() + messages_[index].data_index;
+  }
+  //! Copy data into value of given type, missing bytes are zeroed.
+  template <typename T> T value(uint32_t index) const {
+    T val;
+    std::memset(&val, 0, sizeof(val));
+    std::memcpy(&val, data(index),
+                std::min<std::size_t>(sizeof(val), messages_[index].data_size));
+    return val;
+  }
+  //! Interpret data as pointer to given type.
+  template <typename T> const T *pointer(uint32_t index) const {
+    return static_cast<const T *>(data(index));
+  }
+
+ private:
+  //! Copy all messages of a range.
+  void ParseView(const TraceView &view);
+  //! Copy message and its descendants.
+  void AppendMessage(const MessageView &message);
+
+  std::vector<FlatMessage> messages_; //!< Messages in pre-order.
+  std::vector<AlignmentType> payload_; //!< Data of all messages.
+  std::size_t top_level_count_; //!< Number of top level messages.
+};
+}  // namespace vartrace
+
+#endif  // TRUNK_INCLUDE_VARTRACE_FLAT_PARSED_TRACE_H_
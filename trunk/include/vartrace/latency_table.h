@@ -0,0 +1,79 @@
+/* latency_table.h
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file latency_table.h
+
+  Latency statistics of span records written by ScopedSpan.
+
+  A span record holds the start timestamp in the header and the
+  duration as data, so no pairing of begin and end messages is
+  needed: LatencyTable collects durations by message id from top level
+  messages and subtraces and summarizes them into one row per id.
+  Durations are in timestamp ticks.
+*/
+
+#ifndef TRUNK_INCLUDE_VARTRACE_LATENCY_TABLE_H_
+#define TRUNK_INCLUDE_VARTRACE_LATENCY_TABLE_H_
+
+#include <vartrace/message_view.h>
+#include <vartrace/tracetypes.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace vartrace {
+
+//! Latency statistics of spans with one id.
+struct LatencySummary {
+  MessageIdType span_id; //!< Message id of the spans.
+  std::size_t count; //!< Number of spans.
+  TimestampType min; //!< Shortest duration.
+  TimestampType max; //!< Longest duration.
+  double mean; //!< Average duration.
+  TimestampType p50; //!< Median duration.
+  TimestampType p90; //!< 90th percentile of durations.
+  TimestampType p99; //!< 99th percentile of durations.
+};
+
+//! Collects span durations by message id.
+class LatencyTable {
+ public:
+  //! Table without spans.
+  LatencyTable();
+
+  //! Add span or spans nested in a subtrace, other messages are ignored.
+  void Add(const MessageView &message);
+  //! Add spans of all messages of a dump.
+  void Add(const TraceView &view);
+
+  //! Durations of spans with given id in the order they were added.
+  const std::vector<TimestampType> &durations(MessageIdType span_id) const {
+    return durations_[span_id];
+  }
+  //! Rows of ids that have spans in ascending id order.
+  /*! Percentiles are nearest rank values, so every reported duration
+    was measured.
+   */
+  std::vector<LatencySummary> Summarize() const;
+
+ private:
+  std::vector<std::vector<TimestampType> > durations_; //!< Durations by id.
+};
+}  // namespace vartrace
+
+#endif  // TRUNK_INCLUDE_VARTRACE_LATENCY_TABLE_H_
@@ -0,0 +1,124 @@
+/* merge.h
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file merge.h
+
+  Timestamp ordered merge of several dumps.
+
+  Every source is a sequence of top level messages, either a dump or
+  the chunks of a trace file, that is read with a message iterator. A
+  heap holds the next message of every source, so merging N sources
+  needs memory for N positions and not for the decoded messages. Ties
+  are resolved by source order and messages of a source keep their
+  order.
+
+  Timestamps of every source are unwrapped to 64 bits, so a source
+  whose 32 bit clock wraps still sorts after its older messages.
+  Clocks of different processes or machines rarely agree, so each
+  source may have a linear correction applied to its unwrapped
+  timestamps before they are compared. A written dump keeps the low
+  32 bits of the corrected timestamps. Byte order marks of the sources are
+  skipped, a merged dump gets a single mark of its own.
+
+  When the merge is written as a dump every message may be tagged
+  with its source: it becomes the only child of a subtrace whose
+  message id is the source index and whose timestamp is the corrected
+  timestamp. Messages too large to be wrapped are written untagged.
+*/
+
+#ifndef TRUNK_INCLUDE_VARTRACE_MERGE_H_
+#define TRUNK_INCLUDE_VARTRACE_MERGE_H_
+
+#include <vartrace/message_view.h>
+#include <vartrace/tracetypes.h>
+
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace vartrace {
+
+//! Linear correction of source timestamps.
+struct ClockCorrection {
+  //! Correction that keeps timestamps.
+  ClockCorrection() : offset(0), scale(1) {}
+  //! Correction by offset ticks and drift in parts per million.
+  ClockCorrection(double offset, double drift_ppm)
+      : offset(offset), scale(1 + drift_ppm*1e-6) {}
+
+  //! Corrected unwrapped timestamp, limited to the range of uint64_t.
+  uint64_t Apply(uint64_t timestamp) const;
+
+  double offset; //!< Added after scaling.
+  double scale; //!< Multiplies source timestamps.
+};
+
+//! Top level message taken from one of the sources.
+struct MergedMessage {
+  std::size_t source; //!< Index of the source.
+  uint64_t timestamp; //!< Corrected unwrapped timestamp.
+  MessageView message; //!< Message in the source buffer.
+};
+
+//! Merges top level messages of several sources by timestamp.
+class TraceMerger {
+ public:
+  //! Merger without sources.
+  TraceMerger();
+
+  //! Add source that consists of consecutive parts, return its index.
+  std::size_t AddSource(const std::vector<TraceView> &parts,
+                        const ClockCorrection &clock = ClockCorrection());
+  //! Add dump as a source, return its index.
+  std::size_t AddSource(const TraceView &view,
+                        const ClockCorrection &clock = ClockCorrection());
+  //! Take message with the smallest timestamp, false if none is left.
+  bool Next(MergedMessage *message);
+
+ private:
+  //! Reading position in a source.
+  struct Source {
+    std::vector<TraceView> parts; //!< Parts read one after another.
+    std::size_t part; //!< Index of the current part.
+    MessageIterator position; //!< Next message of the current part.
+    ClockCorrection clock; //!< Correction of timestamps.
+    TimestampUnwrapper unwrapper; //!< Unwraps timestamps of the source.
+  };
+  //! Corrected timestamp and index of the source with that message.
+  typedef std::pair<uint64_t, std::size_t> HeapEntry;
+
+  //! Put next message of the source into the heap if there is one.
+  void Advance(std::size_t source);
+
+  std::vector<Source> sources_; //!< Added sources.
+  //! Next message of every source that is not exhausted.
+  std::priority_queue<HeapEntry, std::vector<HeapEntry>,
+                      std::greater<HeapEntry> > heap_;
+};
+
+//! Write merged messages as a native dump that starts with a mark.
+/*! If tag_sources is true messages are wrapped into subtraces with
+  source index as message id. Returns false on write errors.
+ */
+bool WriteMerged(TraceMerger *merger, bool tag_sources, std::ostream *out);
+}  // namespace vartrace
+
+#endif  // TRUNK_INCLUDE_VARTRACE_MERGE_H_
@@ -0,0 +1,260 @@
+/* message_view.h
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file message_view.h
+
+  Zero-copy access to messages of a dumped trace.
+
+  MessageView decodes a message header in place and points into the
+  dump buffer instead of copying the payload, TraceView iterates over
+  consecutive messages of a buffer or of a subtrace. Nothing is
+  allocated, so the buffer must outlive all views obtained from it.
+
+  Sizes are trusted, a view of a damaged dump can point past the end
+  of the buffer. Iteration never goes beyond the end of the range
+  though. Use ValidatingParse() from validating_parser.h for dumps
+  that may be damaged.
+*/
+
+#ifndef TRUNK_INCLUDE_VARTRACE_MESSAGE_VIEW_H_
+#define TRUNK_INCLUDE_VARTRACE_MESSAGE_VIEW_H_
+
+#include <vartrace/tracetypes.h>
+#include <vartrace/utility.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+
+namespace vartrace {
+
+class TraceView;
+
+//! Non-owning view of a message stored in a dump buffer.
+class MessageView {
+ public:
+  //! Empty view.
+  MessageView() : message_(NULL), description_(0), is_nested_(false) {}
+  //! Decode header of the message that starts at given position.
+  MessageView(const void *message, bool is_nested)
+      : message_(static_cast<const uint8_t *>(message)),
+        is_nested_(is_nested) {
+    std::memcpy(&description_, message_ + header_size() - kNestedHeaderSize,
+                sizeof(description_));
+  }
+
+  //! True if message is nested.
+  bool is_nested() const {return is_nested_;}
+  //! True if message contains other messages.
+  bool has_children() const {return data_type_id() == 0 && data_size() > 0;}
+  //! Return timestamp, nested messages have none and return 0.
+  unsigned timestamp() const {
+    TimestampType timestamp = 0;
+    if (!is_nested_) {
+      std::memcpy(&timestamp, message_, sizeof(timestamp));
+    }
+    return timestamp;
+  }
+  //! Return data type id.
+  int data_type_id() const {
+    return static_cast<DataIdType>(description_ >> kDataIdShift);
+  }
+  //! Return message type id.
+  int message_type_id() const {
+    return static_cast<MessageIdType>(description_ >> kMessageIdShift);
+  }
+  //! Return size of data in message.
+  int data_size() const {return static_cast<LengthType>(description_);}
+  //! Return size of message header.
+  int header_size() const {
+    return is_nested_ ? sizeof(AlignmentType)*kNestedHeaderLength
+        : sizeof(AlignmentType)*kHeaderLength;
+  }
+  //! Return size of message with header and padding.
+  int message_size() const {
+    return header_size() + sizeof(AlignmentType)*RoundSize(data_size());
+  }
+  //! Pointer to the first byte of the message.
+  const void *message() const {return message_;}
+  //! Pointer to message data inside the dump buffer.
+  const void *data() const {return message_ + header_size();}
+  //! Copy data into value of given type, missing bytes are zeroed.
+  template <typename T> T value() const {
+    T val;
+    if (static_cast<std::size_t>(data_size()) >= sizeof(val)) {
+      std::memcpy(&val, data(), sizeof(val));
+    } else {
+      std::memset(&val, 0, sizeof(val));
+      std::memcpy(&val, data(), data_size());
+    }
+    return val;
+  }
+  //! Interpret data as pointer to given type, no copy is done.
+  template <typename T> const T* pointer() const {
+    return static_cast<const T *>(data());
+  }
+  //! Range of nested messages, empty if message is not a subtrace.
+  inline TraceView children() const;
+
+ private:
+  const uint8_t *message_; //!< First byte of the message.
+  AlignmentType description_; //!< Size and ids word of the header.
+  bool is_nested_; //!< True if there is no timestamp.
+};
+
+//! Forward iterator over consecutive messages.
+class MessageIterator
+    : public std::iterator<std::forward_iterator_tag, MessageView> {
+ public:
+  //! Empty iterator.
+  MessageIterator() : position_(NULL), end_(NULL), is_nested_(false) {}
+  //! Iterator pointing to message at position, end limits iteration.
+  /*! A tail that is too short for a message header is skipped, so
+    such an iterator is equal to the end one.
+   */
+  MessageIterator(const uint8_t *position, const uint8_t *end,
+                  bool is_nested)
+      : position_(position), end_(end), is_nested_(is_nested) {
+    SkipPartialHeader();
+  }
+
+  //! Decode current message.
+  MessageView operator*() const {return MessageView(position_, is_nested_);}
+  //! Move to the next message, never beyond the end of the range.
+  MessageIterator &operator++() {
+    std::size_t left = end_ - position_;
+    std::size_t size = MessageView(position_, is_nested_).message_size();
+    position_ += std::min(size, left);
+    SkipPartialHeader();
+    return *this;
+  }
+  //! Postfix increment.
+  MessageIterator operator++(int) {
+    MessageIterator previous = *this;
+    ++(*this);
+    return previous;
+  }
+  //! Iterators are equal if they point to the same position.
+  bool operator==(const MessageIterator &other) const {
+    return position_ == other.position_;
+  }
+  //! Iterators are different if they point to different positions.
+  bool operator!=(const MessageIterator &other) const {
+    return position_ != other.position_;
+  }
+  //! Current position in the buffer.
+  const uint8_t *position() const {return position_;}
+
+ private:
+  //! Go to the end if the rest of the range can not hold a header.
+  void SkipPartialHeader() {
+    std::size_t header_size = sizeof(AlignmentType)
+        *(is_nested_ ? kNestedHeaderLength : kHeaderLength);
+    if (static_cast<std::size_t>(end_ - position_) < header_size) {
+      position_ = end_;
+    }
+  }
+
+  const uint8_t *position_; //!< Start of the current message.
+  const uint8_t *end_; //!< End of the iterated range.
+  bool is_nested_; //!< Type of iterated messages.
+};
+
+//! Non-owning range of consecutive messages.
+class TraceView {
+ public:
+  //! Iterator type.
+  typedef MessageIterator const_iterator;
+
+  //! Empty range.
+  TraceView() : begin_(NULL), end_(NULL), is_nested_(false) {}
+  //! Top level messages of a dump or nested messages of a subtrace.
+  TraceView(const void *buffer, std::size_t size, bool is_nested = false)
+      : begin_(static_cast<const uint8_t *>(buffer)),
+        end_(static_cast<const uint8_t *>(buffer) + size),
+        is_nested_(is_nested) {}
+
+  //! First message.
+  MessageIterator begin() const {
+    return MessageIterator(begin_, end_, is_nested_);
+  }
+  //! Position after the last message.
+  MessageIterator end() const {return MessageIterator(end_, end_, is_nested_);}
+  //! True if range contains no messages.
+  bool empty() const {return begin() == end();}
+  //! First byte of the range, even if it is too short for a message.
+  const void *data() const {return begin_;}
+  //! Size of the range in bytes.
+  std::size_t size() const {return end_ - begin_;}
+  //! True if the range contains nested messages.
+  bool is_nested() const {return is_nested_;}
+
+ private:
+  const uint8_t *begin_; //!< First byte of the range.
+  const uint8_t *end_; //!< Byte after the range.
+  bool is_nested_; //!< Type of messages.
+};
+
+//! Extends 32 bit timestamps of consecutive top level messages.
+/*! A timestamp that is smaller than the previous one by more than half
+  of the timestamp range is taken as a wrap around. A timestamp that
+  is larger by more than half of the range is a late record written
+  before the last wrap, e.g. a subtrace or a span committed after
+  newer messages, it is unwrapped into the previous epoch and does
+  not move the current time.
+ */
+class TimestampUnwrapper {
+ public:
+  //! Unwrapper that starts at 0.
+  TimestampUnwrapper() : time_(0), has_time_(false) {}
+  //! Unwrapped value of the next timestamp.
+  uint64_t Unwrap(TimestampType timestamp) {
+    const TimestampType kWrapThreshold = 0x80000000;
+    const uint64_t kEpochMask = ~static_cast<uint64_t>(0xffffffff);
+    const uint64_t kEpochSize = static_cast<uint64_t>(1) << 32;
+    TimestampType previous = static_cast<TimestampType>(time_);
+    if (has_time_ && timestamp > previous
+        && timestamp - previous > kWrapThreshold && time_ >= kEpochSize) {
+      return (time_ & kEpochMask) - kEpochSize + timestamp;
+    }
+    if (has_time_ && timestamp < previous
+        && previous - timestamp > kWrapThreshold) {
+      time_ += kEpochSize;
+    }
+    time_ = (time_ & kEpochMask) + timestamp;
+    has_time_ = true;
+    return time_;
+  }
+  //! Last unwrapped timestamp.
+  uint64_t time() const {return time_;}
+
+ private:
+  uint64_t time_; //!< Last unwrapped timestamp.
+  bool has_time_; //!< False before the first timestamp.
+};
+
+TraceView MessageView::children() const {
+  if (!has_children()) {
+    return TraceView(data(), 0, true);
+  }
+  return TraceView(data(), data_size(), true);
+}
+}  // namespace vartrace
+
+#endif  // TRUNK_INCLUDE_VARTRACE_MESSAGE_VIEW_H_
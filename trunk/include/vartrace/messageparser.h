@@ -17,6 +17,19 @@
 
 /*! \file messageparser.h 
   Extracts fields from binary data stream. 
+
+  Messages parsed here own copies of their data and children. See
+  message_view.h for access without copying.
+
+  In lazy mode only headers are decoded during parsing. Data is copied
+  and subtraces are parsed when value(), pointer() or children() is
+  first called, so the parsed buffer must stay unchanged while messages
+  are used. Lazily parsed messages must not be accessed from several
+  threads at once.
+
+  ParsedVartrace trusts all sizes unless it is given a vector for
+  skipped ranges, then damaged parts of the dump are detected and
+  skipped, see validating_parser.h.
  */
 
 #ifndef TRUNK_INCLUDE_VARTRACE_MESSAGEPARSER_H_
@@ -27,11 +40,18 @@
 
 #include <vartrace/tracetypes.h>
 #include <vartrace/utility.h>
+#include <vartrace/validating_parser.h>
 #include <cstddef>
 #include <vector>
 
 namespace vartrace {
 
+//! How much of a message is decoded when it is parsed.
+enum ParseMode {
+  kEagerParse, //!< Copy data and parse children immediately.
+  kLazyParse //!< Decode header, the rest on first access.
+};
+
 //! Class for parsing and storing VarTrace messages.
 class Message {
  public:
@@ -39,12 +59,16 @@ class Message {
   typedef boost::shared_ptr<Message> Pointer;
 
   //! Read message from buffer and return pointer to it.
-  static Pointer Parse(void *byte_stream, bool is_nested = false);
+  static Pointer Parse(void *byte_stream, bool is_nested = false,
+                       ParseMode mode = kEagerParse);
 
   //! Default constructor.
   Message();
   //! Construct message from stream.
-  Message(void *byte_stream, bool is_nested = false);
+  Message(void *byte_stream, bool is_nested = false,
+          ParseMode mode = kEagerParse);
+  //! Construct message from decoded header.
+  explicit Message(const MessageView &view, ParseMode mode = kEagerParse);
   //! Empty destructor.
   ~Message() {}
 
@@ -67,11 +91,20 @@ class Message {
   //! Interpret data as pointer to given type.
   template <typename T> T* pointer() const;
   //! Return vector of pointers to children.
-  const std::vector<Pointer>& children() const {return children_;}
+  const std::vector<Pointer>& children() const {
+    if (unparsed_) {
+      Expand(kLazyParse);
+    }
+    return children_;
+  }
 
  private:
   //! Function that does actual stream parsing.
-  void ParseStream(void *byte_stream, bool is_nested = false);
+  void ParseStream(void *byte_stream, bool is_nested, ParseMode mode);
+  //! Copy fields of a decoded message, data too unless mode is lazy.
+  void ParseView(const MessageView &view, ParseMode mode);
+  //! Copy data or parse children in given mode.
+  void Expand(ParseMode mode) const;
 
   bool is_nested_; //!< True if message is nested.
   bool has_children_; //!< True if message contains other messages.
@@ -80,11 +113,15 @@ class Message {
   MessageIdType message_type_id_; //!< Message type id
   LengthType data_size_; //!< Size of data.
   int message_length_; //!< Total message length, data and header.
-  boost::scoped_array<AlignmentType> data_; //!< Message data.
-  std::vector<Pointer> children_; //!< Pointers to children.
+  mutable const void *unparsed_; //!< Data in stream, NULL when expanded.
+  mutable boost::scoped_array<AlignmentType> data_; //!< Message data.
+  mutable std::vector<Pointer> children_; //!< Pointers to children.
 };
 
 template <typename T> T Message::value() const {
+  if (unparsed_) {
+    Expand(kLazyParse);
+  }
   T val;
   memset(&val, 0, sizeof(val));
   memcpy(&val, data_.get(), data_size_);
@@ -92,6 +129,9 @@ template <typename T> T Message::value() const {
 }
 
 template <typename T> T* Message::pointer() const {
+  if (unparsed_) {
+    Expand(kLazyParse);
+  }
   T *ptr = reinterpret_cast<T *>(data_.get());
   return ptr;
 }
@@ -102,7 +142,12 @@ class ParsedVartrace {
   //! Convenience typedef for pointer to a vartrace.
   typedef boost::shared_ptr<ParsedVartrace> Pointer;
   //! Parse trace from byte array.
-  ParsedVartrace(void *byte_stream, std::size_t size);
+  ParsedVartrace(void *byte_stream, std::size_t size,
+                 ParseMode mode = kEagerParse);
+  //! Parse valid messages, report damaged parts of the byte array.
+  ParsedVartrace(void *byte_stream, std::size_t size,
+                 std::vector<SkippedRange> *skipped_ranges,
+                 ParseMode mode = kEagerParse);
   //! Empty destructor.
   ~ParsedVartrace() {}
   //! Access top level message.
@@ -113,7 +158,7 @@ class ParsedVartrace {
   const std::vector<Message::Pointer>& messages() const {return messages_;}
  private:
   //! Actual byte array parser.
-  void ParseStream(void *byte_stream, std::size_t size);
+  void ParseStream(void *byte_stream, std::size_t size, ParseMode mode);
 
   std::vector<Message::Pointer> messages_; //!< Top level messages.
 };
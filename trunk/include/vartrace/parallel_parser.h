@@ -0,0 +1,66 @@
+/* parallel_parser.h
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file parallel_parser.h
+
+  Decoding of large dumps on several threads.
+
+  A dump has no record index, so the buffer is split into equal chunks
+  and every chunk is walked from a guessed message boundary: the first
+  position from which a few consecutive plausible headers can be
+  decoded. Chunks are then stitched in order. The walk of the previous
+  chunk tells where the current chunk really starts, if the guess was
+  wrong the chunk is walked again from there until it meets one of the
+  speculatively found boundaries. The result is therefore always the
+  same as that of a sequential walk, a bad guess only costs time.
+*/
+
+#ifndef TRUNK_INCLUDE_VARTRACE_PARALLEL_PARSER_H_
+#define TRUNK_INCLUDE_VARTRACE_PARALLEL_PARSER_H_
+
+#include <vartrace/message_view.h>
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace vartrace {
+
+//! Function that processes one part of a dump.
+typedef std::function<void (unsigned part_index, const TraceView &part)>
+    PartFunction;
+
+//! Call task for every index below task_count using several threads.
+/*! The calling thread runs tasks too, returns when all are done.
+ */
+void ParallelFor(unsigned task_count, unsigned thread_count,
+                 const std::function<void (unsigned)> &task);
+
+//! Decode top level messages of a dump using several threads.
+std::vector<MessageView> ParallelParse(const TraceView &view,
+                                       unsigned thread_count);
+
+//! Call function concurrently for consecutive parts of a dump.
+/*! Every part contains whole top level messages, parts are numbered
+  in dump order. Number of parts is a few times the thread count.
+ */
+void ParallelForEach(const TraceView &view, unsigned thread_count,
+                     const PartFunction &function);
+}  // namespace vartrace
+
+#endif  // TRUNK_INCLUDE_VARTRACE_PARALLEL_PARSER_H_
@@ -23,13 +23,42 @@
   Classes defined here are used to customize trace object at compile
   time. They allow to specify behavior in multithreaded
   environment. The default policy is to do nothing that is no locking
-  is done on trace access.
+  is done on trace access. MultiThreaded policy serializes writes into
+  the circular buffer with a mutex. Subtraces are assembled in a
+  per-thread arena, so the lock is held only while a finished
+  subtrace is copied into a trace.
+
+  RealTime policy is meant for threads that must not allocate memory
+  or block. It does no locking, touches all trace memory in the
+  constructor and forbids logging of std::string and std::vector,
+  which are usually passed as freshly allocated temporaries.
+
+  Overflow policy selects at run time what happens when the circular
+  buffer is full. By default the oldest messages are overwritten. The
+  other policies treat the trace as a queue: messages stay in the
+  buffer until DrainInto() copies them out, new messages are either
+  rejected or wait for free space.
 */
 
 #ifndef TRUNK_INCLUDE_VARTRACE_POLICIES_H_
 #define TRUNK_INCLUDE_VARTRACE_POLICIES_H_
 
+#include <vartrace/subtrace_arena.h>
+
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+
 namespace vartrace {
+//! Handling of a message that does not fit into free trace space.
+enum OverflowPolicy {
+  kOverwrite, //!< Overwrite the oldest messages.
+  kDropNew, //!< Reject the message and count it.
+  kBlock //!< Wait until a drainer frees space, drop on timeout.
+};
+//! Block timeout that makes a writer wait as long as necessary.
+const unsigned kWaitForever = ~0u;
+
 //! No locking policy.
 template <class T> struct SingleThreaded {
  public:
@@ -40,9 +69,85 @@ template <class T> struct SingleThreaded {
     Lock() {}
     //! Lock for particular object, empty.
     explicit Lock(const T &obj) {}
+    //! Release the lock while waiting, empty.
+    void unlock() {}
+    //! Take the lock again, empty.
+    void lock() {}
   };
+  //! Containers can be logged.
+  enum { kIsRealTime = 0 };
+  //! Writers are not serialized, nobody else can run while one waits.
+  enum { kIsLocking = 0 };
  protected:
   ~SingleThreaded() {}
+  //! Prepare allocated trace memory, nothing to do.
+  static void PrepareStorage(void *storage, std::size_t size) {}
+};
+
+//! Policy that locks a mutex on every trace modification.
+template <class T> struct MultiThreaded {
+ public:
+  //! Scoped lock of trace mutex.
+  class Lock {
+   public:
+    //! Lock mutex of the given object.
+    explicit Lock(const T &obj)
+        : mutex_(static_cast<const MultiThreaded &>(obj).mutex_) {
+      mutex_.lock();
+    }
+    //! Unlock mutex.
+    ~Lock() {
+      mutex_.unlock();
+    }
+    //! Release the mutex while waiting, lock() must follow.
+    void unlock() {
+      mutex_.unlock();
+    }
+    //! Take the mutex again.
+    void lock() {
+      mutex_.lock();
+    }
+   private:
+    //! Disabled copy constructor.
+    Lock(const Lock &);
+    //! Disabled assignment.
+    Lock operator=(const Lock &);
+
+    std::mutex &mutex_; //!< Locked mutex.
+  };
+  //! Containers can be logged.
+  enum { kIsRealTime = 0 };
+  //! Writers are serialized by the mutex.
+  enum { kIsLocking = 1 };
+ protected:
+  ~MultiThreaded() {}
+  //! Prepare allocated trace memory, nothing to do.
+  static void PrepareStorage(void *storage, std::size_t size) {}
+ private:
+  mutable std::mutex mutex_; //!< Mutex that guards a trace.
+};
+
+//! No locking and no memory allocation after construction.
+/*! Subtrace arenas of other threads are not touched by the
+  constructor, a real-time thread should call
+  SubtraceArena::Prefault() on ThreadSubtraceArena() before entering
+  time critical code.
+ */
+template <class T> struct RealTime {
+ public:
+  //! Lock that does nothing.
+  typedef typename SingleThreaded<T>::Lock Lock;
+  //! Containers can not be logged.
+  enum { kIsRealTime = 1 };
+  //! Writers are not serialized.
+  enum { kIsLocking = 0 };
+ protected:
+  ~RealTime() {}
+  //! Touch trace memory and arena of the calling thread to map pages.
+  static void PrepareStorage(void *storage, std::size_t size) {
+    std::memset(storage, 0, size);
+    ThreadSubtraceArena()->Prefault();
+  }
 };
 }  // namespace vartrace
 
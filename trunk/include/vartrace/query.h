@@ -0,0 +1,133 @@
+/* query.h
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file query.h
+
+  Filtering of trace messages.
+
+  A query selects messages by message id, data type, timestamp range,
+  subtrace path and a comparison of payload values. Conditions are
+  checked from the cheapest: the timestamp of a top level message is
+  tested before its children are visited, only subtraces on the
+  requested path are descended into and values are compared only for
+  messages whose id and type already match. Messages of a dump or of
+  trace file chunks are split between threads, results are returned
+  in dump order.
+
+  The path lists ids of enclosing subtraces starting from the top
+  level, a message matches if its path starts with the query path.
+  Subtraces themselves are returned only if the query asks for data
+  type 0. A value condition holds if any element of an array of a
+  standard numeric type satisfies it, values are compared as double.
+*/
+
+#ifndef TRUNK_INCLUDE_VARTRACE_QUERY_H_
+#define TRUNK_INCLUDE_VARTRACE_QUERY_H_
+
+#include <vartrace/message_view.h>
+#include <vartrace/trace_file.h>
+#include <vartrace/tracetypes.h>
+
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <vector>
+
+namespace vartrace {
+
+//! Comparison of payload values with the query value.
+enum CompareOperator {
+  kAnyValue, //!< Values are not checked.
+  kLess,
+  kLessEqual,
+  kEqual,
+  kNotEqual,
+  kGreaterEqual,
+  kGreater
+};
+
+//! Conditions that selected messages satisfy.
+struct QueryFilter {
+  //! Filter that accepts all data messages.
+  QueryFilter()
+      : message_type_id(-1), data_type_id(-1), first_timestamp(0),
+        last_timestamp(std::numeric_limits<TimestampType>::max()),
+        value_operator(kAnyValue), value(0) {}
+
+  int message_type_id; //!< Required message id, any if negative.
+  int data_type_id; //!< Required data type, any except 0 if negative.
+  TimestampType first_timestamp; //!< Smallest top level timestamp.
+  TimestampType last_timestamp; //!< Largest top level timestamp.
+  std::vector<MessageIdType> path; //!< Ids of enclosing subtraces.
+  CompareOperator value_operator; //!< Comparison of values.
+  double value; //!< Value to compare with.
+};
+
+//! Message selected by a query.
+struct QueryMatch {
+  TimestampType timestamp; //!< Timestamp of the top level message.
+  std::vector<MessageIdType> path; //!< Ids of enclosing subtraces.
+  MessageView message; //!< Selected message.
+};
+
+//! Function called for a selected message with its top level timestamp.
+typedef std::function<void (TimestampType timestamp,
+                            const std::vector<MessageIdType> &path,
+                            const MessageView &message)> MatchFunction;
+
+//! True if header of the message passes id and type conditions.
+inline bool MatchesHeader(const MessageView &message,
+                          const QueryFilter &filter) {
+  return (filter.message_type_id < 0
+          || message.message_type_id() == filter.message_type_id)
+      && (filter.data_type_id < 0
+          ? message.data_type_id() != 0
+          : message.data_type_id() == filter.data_type_id);
+}
+
+//! True if a value of the message satisfies the value condition.
+bool MatchesValue(const MessageView &message, const QueryFilter &filter);
+
+//! Call function for selected messages in dump order on this thread.
+void ForEachMatch(const MessageView *messages, std::size_t count,
+                  const QueryFilter &filter, const MatchFunction &function);
+
+//! Call function for selected messages in dump order on this thread.
+inline void ForEachMatch(const std::vector<MessageView> &messages,
+                         const QueryFilter &filter,
+                         const MatchFunction &function) {
+  ForEachMatch(messages.data(), messages.size(), filter, function);
+}
+
+//! Select messages from top level messages using several threads.
+std::vector<QueryMatch> RunQuery(const std::vector<MessageView> &messages,
+                                 const QueryFilter &filter,
+                                 unsigned thread_count);
+
+//! Select messages of a dump using several threads.
+std::vector<QueryMatch> RunQuery(const TraceView &view,
+                                 const QueryFilter &filter,
+                                 unsigned thread_count);
+
+//! Select messages of a trace file, chunks are skipped using the index.
+std::vector<QueryMatch> RunQuery(const TraceFile &file,
+                                 const QueryFilter &filter,
+                                 unsigned thread_count);
+}  // namespace vartrace
+
+#endif  // TRUNK_INCLUDE_VARTRACE_QUERY_H_
@@ -0,0 +1,104 @@
+/* stream_parser.h
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file stream_parser.h
+
+  Event based parsing of a trace that arrives in chunks.
+
+  StreamParser accepts a dump piece by piece, for example as it is
+  read from a file or a socket, and reports every message to a
+  TraceVisitor as soon as the message is complete. Nothing is
+  accumulated: the only state kept between chunks is one incomplete
+  top level message, which can not be longer than kMaxMessageSize.
+  Subtraces are walked recursively, so stack use grows with nesting
+  depth only.
+
+  Views passed to a visitor point either into the chunk being parsed
+  or into the parser, they are valid only during the callback.
+*/
+
+#ifndef TRUNK_INCLUDE_VARTRACE_STREAM_PARSER_H_
+#define TRUNK_INCLUDE_VARTRACE_STREAM_PARSER_H_
+
+#include <vartrace/message_view.h>
+#include <vartrace/tracetypes.h>
+#include <vartrace/utility.h>
+
+#include <cstddef>
+
+namespace vartrace {
+
+//! Largest possible top level message in bytes.
+const unsigned kMaxMessageSize = sizeof(AlignmentType)*(kHeaderLength
+    + CEIL_DIV(kMaxDataSize, sizeof(AlignmentType)));
+
+//! Interface of StreamParser event receivers, all callbacks are empty.
+class TraceVisitor {
+ public:
+  //! Empty destructor.
+  virtual ~TraceVisitor() {}
+  //! Called for every message that is not a subtrace.
+  virtual void OnMessage(const MessageView &message) {}
+  //! Called for a subtrace before its children.
+  virtual void OnSubtraceBegin(const MessageView &subtrace) {}
+  //! Called for a subtrace after its children.
+  virtual void OnSubtraceEnd(const MessageView &subtrace) {}
+};
+
+//! Report all messages of a complete range to a visitor.
+void VisitMessages(const TraceView &view, TraceVisitor *visitor);
+
+//! Parser that reports messages of a dump fed in arbitrary chunks.
+class StreamParser {
+ public:
+  //! Create parser that reports to the given visitor.
+  explicit StreamParser(TraceVisitor *visitor);
+
+  //! Parse next part of a dump.
+  /*! An incomplete message at the end of the chunk is kept and
+    finished by the next call.
+   */
+  void Feed(const void *chunk, std::size_t size);
+  //! True if all fed data was reported, that is the dump was complete.
+  bool is_complete() const {return pending_size_ == 0;}
+  //! Number of bytes of the incomplete message kept from previous chunks.
+  std::size_t pending_size() const {return pending_size_;}
+  //! Forget incomplete message.
+  void Reset() {pending_size_ = 0;}
+
+ private:
+  //! Disabled copy constructor.
+  StreamParser(const StreamParser &);
+  //! Disabled assignment.
+  StreamParser operator=(const StreamParser &);
+
+  //! Add chunk data to the pending message, return number of used bytes.
+  std::size_t CompletePending(const uint8_t *chunk, std::size_t size);
+  //! Size of a top level message whose header starts at position.
+  static std::size_t MessageSize(const void *position) {
+    return MessageView(position, false).message_size();
+  }
+
+  TraceVisitor *visitor_; //!< Receiver of messages.
+  std::size_t pending_size_; //!< Bytes of incomplete message in pending_.
+  //! Beginning of a message split between chunks.
+  AlignmentType pending_[kMaxMessageSize/sizeof(AlignmentType)];
+};
+}  // namespace vartrace
+
+#endif  // TRUNK_INCLUDE_VARTRACE_STREAM_PARSER_H_
@@ -0,0 +1,149 @@
+/* subtrace_arena.h
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file subtrace_arena.h
+
+  Scratch space in which subtraces are assembled.
+
+  Messages logged inside a subtrace are not written into the circular
+  buffer directly. They are appended to an arena owned by the calling
+  thread and the complete subtrace is copied into the trace when the
+  outermost subtrace is closed. Thus the circular buffer only ever
+  contains finished messages and can be dumped at any time.
+
+  The arena has fixed size: data size of a message is stored in
+  LengthType field, so a subtrace can not be longer than kMaxDataSize
+  bytes anyway. Subtraces that do not fit
+  or are nested deeper than internal::kMaxSubtraceDepth are dropped
+  when they are closed.
+*/
+
+#ifndef TRUNK_INCLUDE_VARTRACE_SUBTRACE_ARENA_H_
+#define TRUNK_INCLUDE_VARTRACE_SUBTRACE_ARENA_H_
+
+#include <vartrace/tracetypes.h>
+#include <vartrace/utility.h>
+
+#include <cstring>
+
+namespace vartrace {
+
+namespace internal {
+//! Arena length in AlignmentType units, the largest subtrace and its header.
+const unsigned kSubtraceArenaLength = kNestedHeaderLength
+    + CEIL_DIV(kMaxDataSize, sizeof(AlignmentType));
+//! Maximum number of simultaneously open subtraces in a thread.
+const unsigned kMaxSubtraceDepth = 64;
+}  // namespace internal
+
+//! Stack of open subtraces and storage for their messages.
+/*! Each frame of the stack remembers the trace that opened it. A
+  sequence of frames that belong to the same trace forms one
+  transaction which is committed or discarded as a whole. Subtraces
+  of different traces can be nested as long as they are closed in
+  reverse order.
+*/
+class SubtraceArena {
+ public:
+  //! Description of an open subtrace.
+  struct Frame {
+    const void *owner; //!< Trace that opened the subtrace.
+    uint_fast32_t header_index; //!< Position of the subtrace header.
+    uint_fast32_t outermost; //!< Index of the first frame of the transaction.
+    TimestampType timestamp; //!< Timestamp of the outermost subtrace.
+    bool is_overflowed; //!< Transaction lost some data and must be dropped.
+  };
+
+  //! Create empty arena.
+  SubtraceArena() : cursor_(0), depth_(0), excess_depth_(0) {}
+
+  //! True if the innermost open subtrace belongs to the given trace.
+  bool is_owned_by(const void *owner) const {
+    return depth_ != 0 && frames_[depth_ - 1].owner == owner;
+  }
+  //! Number of open subtraces, including the ones that did not fit.
+  unsigned depth() const { return depth_ + excess_depth_; }
+  //! Next free arena position.
+  uint_fast32_t cursor() const { return cursor_; }
+  //! Pointer to arena data at given position.
+  const AlignmentType *data(uint_fast32_t index) const {
+    return &(data_[index]);
+  }
+
+  //! Open a subtrace, timestamp is used only if it starts a transaction.
+  void Push(const void *owner, MessageIdType subtrace_id,
+            TimestampType timestamp);
+  //! Close innermost subtrace, return true if transaction is finished.
+  /*! If keep_data is false then the subtrace content is discarded. The
+    description of the closed subtrace is copied into closed_frame.
+   */
+  bool Pop(bool keep_data, Frame *closed_frame);
+  //! Forget everything written after the given position.
+  void Rewind(uint_fast32_t index) { cursor_ = index; }
+  //! Touch arena memory so that first subtraces do not cause page faults.
+  void Prefault() { std::memset(data_, 0, sizeof(data_)); }
+
+  //! Reserve space for a nested message, return NULL if arena is full.
+  inline AlignmentType *Reserve(unsigned length) {
+    if (internal::kSubtraceArenaLength - cursor_ < length || excess_depth_) {
+      MarkOverflow();
+      return NULL;
+    }
+    AlignmentType *position = &(data_[cursor_]);
+    cursor_ += length;
+    return position;
+  }
+  //! Append nested message to the innermost subtrace.
+  inline void Append(MessageIdType message_id, DataIdType data_id,
+                     const void *value, unsigned object_size) {
+    // larger data can not be described by the header
+    if (object_size > kMaxDataSize) {
+      MarkOverflow();
+      return;
+    }
+    AlignmentType *message = Reserve(kNestedHeaderLength
+                                     + RoundSize(object_size));
+    if (!message) {
+      return;
+    }
+    message[0] = object_size + (message_id << kMessageIdShift)
+        + (static_cast<AlignmentType>(data_id) << kDataIdShift);
+    std::memcpy(message + kNestedHeaderLength, value, object_size);
+  }
+
+ private:
+  //! Disabled copy constructor.
+  SubtraceArena(const SubtraceArena &);
+  //! Disabled assignment.
+  SubtraceArena operator=(const SubtraceArena &);
+
+  //! Mark current transaction as incomplete.
+  void MarkOverflow();
+
+  uint_fast32_t cursor_; //!< Next free position in data_.
+  uint_fast32_t depth_; //!< Number of frames in use.
+  uint_fast32_t excess_depth_; //!< Subtraces opened above kMaxSubtraceDepth.
+  Frame frames_[internal::kMaxSubtraceDepth]; //!< Open subtraces.
+  AlignmentType data_[internal::kSubtraceArenaLength]; //!< Messages.
+};
+
+//! Return arena of the calling thread.
+SubtraceArena *ThreadSubtraceArena();
+}  // namespace vartrace
+
+#endif  // TRUNK_INCLUDE_VARTRACE_SUBTRACE_ARENA_H_
@@ -0,0 +1,169 @@
+/* subtrace_writer.h
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file subtrace_writer.h
+
+  Lightweight handle for logging into an open subtrace.
+
+  vartrace::VarTrace::BeginSubtrace() returns a SubtraceWriter. Its
+  Log functions have the same signatures as the trace ones but they
+  append messages to the subtrace arena directly without checking
+  whether the calling thread is inside a subtrace. Self logging
+  classes and custom log functions that are templates receive a
+  writer pointer instead of a trace pointer.
+
+  A writer is valid only in the thread that created it and only until
+  the subtrace it was obtained for is closed.
+*/
+
+#ifndef TRUNK_INCLUDE_VARTRACE_SUBTRACE_WRITER_H_
+#define TRUNK_INCLUDE_VARTRACE_SUBTRACE_WRITER_H_
+
+#include <vartrace/copytraits.h>
+#include <vartrace/datatypeid.h>
+#include <vartrace/log_level.h>
+#include <vartrace/subtrace_arena.h>
+#include <vartrace/tracetypes.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace vartrace {
+
+namespace internal {
+//! Pass writer to LogItself if the member function accepts it.
+template <typename V, class W, class T>
+auto CallLogItself(const V &object, W *writer, T *trace, int)
+    -> decltype(object.LogItself(writer), void()) {
+  object.LogItself(writer);
+}
+
+//! Pass trace to LogItself that does not accept writer.
+template <typename V, class W, class T>
+void CallLogItself(const V &object, W *writer, T *trace, long) {
+  object.LogItself(trace);
+}
+
+//! Pass writer to LogObject if the function accepts it.
+template <typename V, class W, class T>
+auto CallLogObject(const V &object, W *writer, T *trace, int)
+    -> decltype(LogObject(object, writer), void()) {
+  LogObject(object, writer);
+}
+
+//! Pass trace to LogObject that does not accept writer.
+template <typename V, class W, class T>
+void CallLogObject(const V &object, W *writer, T *trace, long) {
+  LogObject(object, trace);
+}
+}  // namespace internal
+
+//! Logger that writes into the innermost open subtrace of a trace.
+template <class T> class SubtraceWriter {
+ public:
+  //! Log level threshold of the trace.
+  typedef typename T::LogLevel LL;
+
+  //! Create writer for a trace that has an open subtrace in the arena.
+  SubtraceWriter(T *trace, SubtraceArena *arena)
+      : trace_(trace), arena_(arena) {}
+
+  //! Trace that receives the subtrace.
+  T *trace() const { return trace_; }
+
+  //! Empty Log overload used for messages below log level.
+  template <typename V>
+  void Log(HiddenLogLevel log_level, MessageIdType message_id,
+           const V &value) {}
+  //! Logging function used for objects, PODs and arrays.
+  template <typename V>
+  void Log(LL log_level, MessageIdType message_id, const V &value) {
+    DoLog(message_id, &value, typename CopyTraits<V>::CopyCategory(), 1);
+  }
+  //! Empty array Log overload for suppressed log levels.
+  template <typename V>
+  void Log(HiddenLogLevel log_level, MessageIdType message_id,
+           const V *value, unsigned length) {}
+  //! Array logging function.
+  template <typename V>
+  void Log(LL log_level, MessageIdType message_id, const V *value,
+           unsigned length) {
+    DoLog(message_id, value, typename CopyTraits<V>::CopyCategory(), length);
+  }
+  //! Log overload for vector.
+  template <typename V>
+  void Log(LL log_level, MessageIdType message_id,
+           const std::vector<V> &value) {
+    static_assert(!T::kIsRealTime,
+                  "log vector data through pointer and length");
+    DoLog(message_id, &value[0], typename CopyTraits<V>::CopyCategory(),
+          value.size());
+  }
+  //! Log overload for std::string.
+  void Log(LL log_level, MessageIdType message_id, const std::string &value) {
+    static_assert(!T::kIsRealTime,
+                  "log string data through pointer and length");
+    DoLog(message_id, value.c_str(), SizeofCopyTag(), value.size());
+  }
+
+  //! Open nested subtrace, returned writer is the same as this one.
+  SubtraceWriter BeginSubtrace(MessageIdType subtrace_id) {
+    arena_->Push(trace_, subtrace_id, 0);
+    trace_->CountSubtraceDepth(arena_->depth());
+    return *this;
+  }
+  //! Close innermost subtrace.
+  void EndSubtrace() { trace_->EndSubtrace(arena_); }
+  //! Close innermost subtrace and discard its content.
+  void AbortSubtrace() { trace_->AbortSubtrace(arena_); }
+
+ private:
+  //! Store data by copying, assignment copy types end up here too.
+  template <typename V> void DoLog(
+      MessageIdType message_id, const V *value, const SizeofCopyTag &copy_tag,
+      unsigned length) {
+    arena_->Append(message_id, DataType2Int<V>::id, value, length*sizeof(V));
+  }
+  //! Store objects that have logging member function.
+  template <typename V> void DoLog(
+      MessageIdType message_id, const V *value, const SelfCopyTag &copy_tag,
+      unsigned length) {
+    BeginSubtrace(message_id);
+    for (std::size_t i = 0; i < length; ++i) {
+      internal::CallLogItself(value[i], this, trace_, 0);
+    }
+    EndSubtrace();
+  }
+  //! Store objects that have custom logging function.
+  template <typename V> void DoLog(
+      MessageIdType message_id, const V *value, const CustomCopyTag &copy_tag,
+      unsigned length) {
+    BeginSubtrace(message_id);
+    for (std::size_t i = 0; i < length; ++i) {
+      internal::CallLogObject(value[i], this, trace_, 0);
+    }
+    EndSubtrace();
+  }
+
+  T *trace_; //!< Trace that receives the subtrace.
+  SubtraceArena *arena_; //!< Arena of the thread that opened the subtrace.
+};
+}  // namespace vartrace
+
+#endif  // TRUNK_INCLUDE_VARTRACE_SUBTRACE_WRITER_H_
@@ -0,0 +1,113 @@
+/* text_writer.h
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file text_writer.h
+
+  Buffered text output for trace printers.
+
+  Printing millions of values through iostream formatting costs more
+  than decoding them, so TextWriter formats numbers itself into a
+  large buffer that is passed to the stream in big blocks. Integers
+  are converted digit by digit. Floating point values are printed
+  with the Grisu2 algorithm: the shortest digits that read back as
+  the same value are found with 64 bit integer arithmetic, so no
+  call to printf is made.
+*/
+
+#ifndef TRUNK_INCLUDE_VARTRACE_TEXT_WRITER_H_
+#define TRUNK_INCLUDE_VARTRACE_TEXT_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace vartrace {
+
+//! Default size of the output buffer.
+const std::size_t kTextBufferSize = 0x10000;
+
+//! Formats text into a buffer that is flushed to a stream.
+class TextWriter {
+ public:
+  //! Writer that passes text to out in blocks of buffer_size bytes.
+  explicit TextWriter(std::ostream *out,
+                      std::size_t buffer_size = kTextBufferSize);
+  //! Flush remaining text.
+  ~TextWriter();
+
+  //! Append a character.
+  void Write(char c) {
+    if (size_ == buffer_.size()) {
+      Flush();
+    }
+    buffer_[size_++] = c;
+  }
+  //! Append characters.
+  void Write(const char *text, std::size_t size) {
+    if (size_ + size > buffer_.size()) {
+      Flush();
+      if (size > buffer_.size()) {
+        out_->write(text, size);
+        return;
+      }
+    }
+    std::memcpy(&buffer_[size_], text, size);
+    size_ += size;
+  }
+  //! Append a zero terminated string.
+  void Write(const char *text) {Write(text, std::strlen(text));}
+  //! Append a string.
+  void Write(const std::string &text) {Write(text.data(), text.size());}
+  //! Append decimal digits of an unsigned number.
+  void WriteUnsigned(uint64_t value);
+  //! Append a signed number.
+  void WriteSigned(int64_t value);
+  //! Append shortest text that reads back as the same double.
+  void WriteDouble(double value);
+  //! Append shortest text that reads back as the same float.
+  void WriteFloat(float value);
+  //! Append characters as a quoted JSON string.
+  void WriteJsonString(const char *text, std::size_t size);
+
+  //! Pass buffered text to the stream, return false on errors.
+  bool Flush();
+
+ private:
+  //! Writers can not be copied.
+  TextWriter(const TextWriter &);
+  //! Writers can not be copied.
+  TextWriter &operator=(const TextWriter &);
+
+  //! Make room for size bytes and return pointer to them.
+  char *Reserve(std::size_t size) {
+    if (size_ + size > buffer_.size()) {
+      Flush();
+    }
+    return &buffer_[size_];
+  }
+
+  std::ostream *out_; //!< Destination of the text.
+  std::vector<char> buffer_; //!< Formatted text.
+  std::size_t size_; //!< Used part of the buffer.
+};
+}  // namespace vartrace
+
+#endif  // TRUNK_INCLUDE_VARTRACE_TEXT_WRITER_H_
@@ -0,0 +1,146 @@
+/* trace_counters.h
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file trace_counters.h
+
+  Counting policies that let a trace instrument itself.
+
+  A counting policy is the third template argument of VarTrace. The
+  default NoCounting policy has empty hooks and costs nothing.
+  RelaxedCounting keeps counts of written records and bytes, of wraps
+  of the circular buffer, of data that DumpInto() skipped at the slot
+  boundary and of the deepest subtrace. Records and dumps are counted
+  while the trace lock is held, so the counters use relaxed loads and
+  stores instead of read-modify-write instructions. VarTrace::Stats()
+  returns a snapshot, VarTrace::LogCounters() stores it in the trace
+  as a record of type kTypeIdCounters.
+*/
+
+#ifndef TRUNK_INCLUDE_VARTRACE_TRACE_COUNTERS_H_
+#define TRUNK_INCLUDE_VARTRACE_TRACE_COUNTERS_H_
+
+#include <vartrace/tracetypes.h>
+
+#include <atomic>
+#include <cstdint>
+
+namespace vartrace {
+
+//! Snapshot of trace counters, layout of kTypeIdCounters records.
+/*! Counters that are not compiled in are zero.
+ */
+struct TraceCounters {
+  uint64_t is_counting; //!< 1 if a counting policy is compiled in.
+  uint64_t record_count; //!< Top level records written.
+  uint64_t byte_count; //!< Bytes of top level records written.
+  uint64_t lap_count; //!< Wraps of the circular buffer.
+  uint64_t dump_count; //!< Calls of DumpInto() with kOverwrite policy.
+  //! Bytes between the write position and the first dumped message.
+  uint64_t dump_skipped_bytes;
+  uint64_t max_subtrace_depth; //!< Deepest subtrace opened.
+  uint64_t dropped_subtrace_count; //!< Subtraces that did not fit.
+  //! Messages rejected by queue policies or too large for a header.
+  uint64_t dropped_message_count;
+};
+
+//! Counting policy that compiles to nothing.
+class NoCounting {
+ public:
+  //! Counters are not available.
+  enum { kIsCounting = 0 };
+  //! Number of buffer wraps, always zero.
+  uint64_t lap_count() const { return 0; }
+  //! Count a written top level record.
+  void AddRecord(unsigned length, bool is_lap) {}
+  //! Count a dump that skipped given number of words.
+  void AddDump(unsigned skipped_length) {}
+  //! Remember subtrace depth.
+  void UpdateDepth(unsigned depth) {}
+  //! Leave counters untouched.
+  void Read(TraceCounters *counters) const {}
+};
+
+//! Counting policy with relaxed atomic counters.
+/*! Record and dump counters are updated under the trace lock, depth
+  is updated by subtrace owners with compare and swap only when it
+  grows.
+ */
+class RelaxedCounting {
+ public:
+  //! Counters are available.
+  enum { kIsCounting = 1 };
+  //! All counters start at zero.
+  RelaxedCounting()
+      : record_count_(0), length_(0), lap_count_(0), dump_count_(0),
+        dump_skipped_length_(0), max_depth_(0) {}
+
+  //! Number of buffer wraps.
+  uint64_t lap_count() const {
+    return lap_count_.load(std::memory_order_relaxed);
+  }
+  //! Count a written top level record of given length in words.
+  void AddRecord(unsigned length, bool is_lap) {
+    Increment(&record_count_, 1);
+    Increment(&length_, length);
+    if (is_lap) {
+      Increment(&lap_count_, 1);
+    }
+  }
+  //! Count a dump that skipped given number of words.
+  void AddDump(unsigned skipped_length) {
+    Increment(&dump_count_, 1);
+    Increment(&dump_skipped_length_, skipped_length);
+  }
+  //! Remember subtrace depth if it is the largest so far.
+  void UpdateDepth(unsigned depth) {
+    uint64_t max_depth = max_depth_.load(std::memory_order_relaxed);
+    while (depth > max_depth
+           && !max_depth_.compare_exchange_weak(max_depth, depth,
+                                                std::memory_order_relaxed)) {
+    }
+  }
+  //! Copy counters into a snapshot, lengths are given in bytes.
+  void Read(TraceCounters *counters) const {
+    counters->is_counting = 1;
+    counters->record_count = record_count_.load(std::memory_order_relaxed);
+    counters->byte_count = sizeof(AlignmentType)
+        *length_.load(std::memory_order_relaxed);
+    counters->lap_count = lap_count_.load(std::memory_order_relaxed);
+    counters->dump_count = dump_count_.load(std::memory_order_relaxed);
+    counters->dump_skipped_bytes = sizeof(AlignmentType)
+        *dump_skipped_length_.load(std::memory_order_relaxed);
+    counters->max_subtrace_depth = max_depth_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  //! Add to a counter that has a single writer at a time.
+  static void Increment(std::atomic<uint64_t> *counter, uint64_t value) {
+    counter->store(counter->load(std::memory_order_relaxed) + value,
+                   std::memory_order_relaxed);
+  }
+
+  std::atomic<uint64_t> record_count_; //!< Top level records.
+  std::atomic<uint64_t> length_; //!< Words of top level records.
+  std::atomic<uint64_t> lap_count_; //!< Wraps of the circular buffer.
+  std::atomic<uint64_t> dump_count_; //!< Dumps of overwrite traces.
+  std::atomic<uint64_t> dump_skipped_length_; //!< Words skipped by dumps.
+  std::atomic<uint64_t> max_depth_; //!< Deepest subtrace.
+};
+}  // namespace vartrace
+
+#endif  // TRUNK_INCLUDE_VARTRACE_TRACE_COUNTERS_H_
@@ -0,0 +1,162 @@
+/* trace_file.h
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file trace_file.h
+
+  Indexed container for large captures.
+
+  A trace file stores top level messages in chunks of about equal size
+  and ends with an index that describes every chunk: its position, the
+  smallest and the largest timestamp and a bitmap of message ids that
+  occur in it. Index timestamps are unwrapped to 64 bits, so a capture
+  longer than one period of the 32 bit clock can still be searched. A reader maps the file into memory, binary searches the
+  index for chunks of a time range and skips chunks without requested
+  message ids, so a query reads only the chunks it needs.
+
+  \code
+  char     magic[8]         "VTFILE02"
+  uint32_t byte_order_mark  0x01020304
+  uint32_t reserved
+  chunks of whole top level messages
+  ChunkIndexEntry index[chunk_count]
+  uint64_t index_offset
+  uint64_t chunk_count
+  char     magic[8]         "VTINDEX2"
+  \endcode
+
+  Files are written in the byte order of the writer. Time range
+  queries assume that unwrapped timestamps do not decrease, which holds
+  for messages written in the order they were logged, and that a chunk
+  spans less than one period of the 32 bit clock.
+*/
+
+#ifndef TRUNK_INCLUDE_VARTRACE_TRACE_FILE_H_
+#define TRUNK_INCLUDE_VARTRACE_TRACE_FILE_H_
+
+#include <vartrace/message_view.h>
+#include <vartrace/tracetypes.h>
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace vartrace {
+
+//! Default size of a chunk in bytes.
+const std::size_t kDefaultChunkSize = 0x100000;
+
+//! Description of a chunk stored in the file index.
+struct ChunkIndexEntry {
+  //! True if messages with given id are stored in the chunk.
+  bool has_message_id(int message_type_id) const {
+    return (message_ids[message_type_id >> 6] >> (message_type_id & 63)) & 1;
+  }
+
+  uint64_t offset; //!< Position of the chunk in the file.
+  uint32_t size; //!< Size of the chunk in bytes.
+  uint32_t message_count; //!< Number of top level messages.
+  uint64_t first_timestamp; //!< Smallest unwrapped timestamp.
+  uint64_t last_timestamp; //!< Largest unwrapped timestamp.
+  uint64_t message_ids[4]; //!< Bitmap of top level message ids.
+};
+
+//! Writes top level messages into an indexed trace file.
+class TraceFileWriter {
+ public:
+  //! Writer that starts a new chunk after chunk_size bytes.
+  explicit TraceFileWriter(std::size_t chunk_size = kDefaultChunkSize);
+  //! Close the file if it is still open.
+  ~TraceFileWriter();
+
+  //! Create file and write its header.
+  bool Open(const std::string &path);
+  //! Append a top level message.
+  bool Append(const MessageView &message);
+  //! Append all messages of a dump.
+  bool Append(const TraceView &view);
+  //! Write the last chunk and the index, return false on write errors.
+  bool Close();
+
+ private:
+  //! Write collected messages as a chunk.
+  void FlushChunk();
+
+  std::size_t chunk_size_; //!< Target size of chunks.
+  std::ofstream file_; //!< Output file.
+  uint64_t file_size_; //!< Bytes written so far.
+  std::vector<uint8_t> chunk_; //!< Messages of the current chunk.
+  ChunkIndexEntry entry_; //!< Index entry of the current chunk.
+  TimestampUnwrapper unwrapper_; //!< Unwraps timestamps of messages.
+  std::vector<ChunkIndexEntry> index_; //!< Entries of written chunks.
+};
+
+//! Memory mapped trace file.
+class TraceFile {
+ public:
+  //! Closed file.
+  TraceFile();
+  //! Unmap the file.
+  ~TraceFile();
+
+  //! Map file and check its index, return false if it is not valid.
+  bool Open(const std::string &path);
+  //! Unmap the file.
+  void Close();
+
+  //! Number of chunks.
+  std::size_t chunk_count() const {return chunk_count_;}
+  //! Index entry of a chunk.
+  const ChunkIndexEntry &chunk(std::size_t index) const {
+    return index_[index];
+  }
+  //! Messages of a chunk.
+  TraceView chunk_view(std::size_t index) const {
+    return TraceView(data_ + index_[index].offset, index_[index].size);
+  }
+  //! Range of chunks that may hold unwrapped timestamps from first to last.
+  std::pair<std::size_t, std::size_t> FindChunks(uint64_t first,
+                                                 uint64_t last) const;
+  //! Unwrapped timestamp of a message stored in given chunk.
+  uint64_t UnwrapTimestamp(std::size_t index,
+                           const MessageView &message) const {
+    uint64_t first = index_[index].first_timestamp;
+    return first + static_cast<TimestampType>(
+        message.timestamp() - static_cast<TimestampType>(first));
+  }
+  //! Messages with unwrapped timestamps from first to last inclusive.
+  /*! Only messages with given id are returned if message_type_id is
+    not negative.
+   */
+  std::vector<MessageView> Query(uint64_t first, uint64_t last,
+                                 int message_type_id = -1) const;
+
+ private:
+  //! Files can not be copied.
+  TraceFile(const TraceFile &);
+  //! Files can not be copied.
+  TraceFile &operator=(const TraceFile &);
+
+  const uint8_t *data_; //!< Mapped file.
+  std::size_t size_; //!< Size of the file.
+  const ChunkIndexEntry *index_; //!< Index inside the mapped file.
+  std::size_t chunk_count_; //!< Number of chunks.
+};
+}  // namespace vartrace
+
+#endif  // TRUNK_INCLUDE_VARTRACE_TRACE_FILE_H_
@@ -0,0 +1,184 @@
+/* trace_stats.h
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file trace_stats.h
+
+  Streaming statistics of message paths and folded stacks.
+
+  TraceStats is a TraceVisitor that keeps a row for every path of
+  subtrace ids and message id, e.g. "3/42" for message 42 logged in
+  subtrace 3. A row counts messages, keeps times of the first and the
+  last one, a histogram of intervals between consecutive messages and
+  a histogram of durations of span records (see ScopedSpan). Rows of
+  subtraces are kept apart from rows of messages with the same path.
+  Nested messages have no timestamp and use the time of their top
+  level subtrace. Memory use depends only on the number of paths.
+
+  Histogram is a log-linear histogram in the style of HdrHistogram:
+  values below 2^bits are counted exactly, larger values fall into
+  2^(bits - 1) buckets per power of two, so reported values differ
+  from measured ones by less than 2^(1 - bits) of their size.
+
+  Folded stacks for flamegraph.pl have one line per path, frames are
+  ids of enclosing subtraces followed by the message id, the weight is
+  the total span duration, the number of messages or their size.
+*/
+
+#ifndef TRUNK_INCLUDE_VARTRACE_TRACE_STATS_H_
+#define TRUNK_INCLUDE_VARTRACE_TRACE_STATS_H_
+
+#include <vartrace/message_view.h>
+#include <vartrace/stream_parser.h>
+#include <vartrace/tracetypes.h>
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vartrace {
+
+//! Default number of histogram sub bucket bits, error is below 1%.
+const int kDefaultHistogramBits = 8;
+
+//! Log-linear histogram of unsigned values.
+class Histogram {
+ public:
+  //! Empty histogram with given precision.
+  explicit Histogram(int sub_bucket_bits = kDefaultHistogramBits);
+
+  //! Count a value.
+  void Record(uint64_t value) {
+    std::size_t index = BucketIndex(value);
+    if (index >= counts_.size()) {
+      counts_.resize(index + 1);
+    }
+    ++counts_[index];
+    if (!count_ || value < min_) {
+      min_ = value;
+    }
+    if (value > max_) {
+      max_ = value;
+    }
+    ++count_;
+    sum_ += value;
+  }
+  //! Number of recorded values.
+  uint64_t count() const {return count_;}
+  //! Smallest value, 0 if histogram is empty.
+  uint64_t min() const {return min_;}
+  //! Largest value, 0 if histogram is empty.
+  uint64_t max() const {return max_;}
+  //! Sum of values.
+  uint64_t sum() const {return sum_;}
+  //! Average value, 0 if histogram is empty.
+  double mean() const {
+    return count_ ? static_cast<double>(sum_)/count_ : 0;
+  }
+  //! Value below or equal to given fraction of recorded values.
+  /*! The largest value of the bucket that holds the nearest rank, but
+    not more than max(), 0 if histogram is empty.
+   */
+  uint64_t Percentile(double fraction) const;
+  //! Add counts of another histogram, false if precisions differ.
+  bool Add(const Histogram &other);
+
+ private:
+  //! Bucket of a value.
+  std::size_t BucketIndex(uint64_t value) const {
+    if (value < sub_bucket_count_) {
+      return value;
+    }
+    int shift = 64 - __builtin_clzll(value) - sub_bucket_bits_;
+    return shift*(sub_bucket_count_ >> 1) + (value >> shift);
+  }
+  //! Largest value of a bucket.
+  uint64_t BucketMax(std::size_t index) const;
+
+  int sub_bucket_bits_; //!< Precision.
+  uint64_t sub_bucket_count_; //!< Number of exactly counted values.
+  std::vector<uint64_t> counts_; //!< Counts of buckets used so far.
+  uint64_t count_; //!< Number of values.
+  uint64_t min_; //!< Smallest value.
+  uint64_t max_; //!< Largest value.
+  uint64_t sum_; //!< Sum of values.
+};
+
+//! Statistics of messages with one path.
+struct PathStats {
+  //! Empty statistics.
+  PathStats() : is_subtrace(false), count(0), first_time(0), last_time(0),
+                size(0) {}
+
+  std::vector<MessageIdType> path; //!< Subtrace ids and message id.
+  bool is_subtrace; //!< True for subtraces.
+  uint64_t count; //!< Number of messages.
+  uint64_t first_time; //!< Unwrapped time of the first message.
+  uint64_t last_time; //!< Unwrapped time of the last message.
+  uint64_t size; //!< Total size of messages in bytes.
+  Histogram intervals; //!< Times between consecutive messages.
+  Histogram durations; //!< Durations of span records.
+};
+
+//! Weight of folded stacks.
+enum FoldedWeight {
+  kFoldedTime, //!< Total duration of span records.
+  kFoldedCount, //!< Number of messages other than subtraces.
+  kFoldedBytes //!< Size of messages other than subtraces.
+};
+
+//! Visitor that collects statistics of every message path.
+class TraceStats : public TraceVisitor {
+ public:
+  //! Empty statistics.
+  TraceStats();
+
+  //! Count a message.
+  virtual void OnMessage(const MessageView &message);
+  //! Count a subtrace and enter it.
+  virtual void OnSubtraceBegin(const MessageView &subtrace);
+  //! Leave a subtrace.
+  virtual void OnSubtraceEnd(const MessageView &subtrace);
+
+  //! Statistics of paths in the order of their first messages.
+  const std::vector<PathStats> &paths() const {return paths_;}
+  //! Number of visited messages.
+  uint64_t message_count() const {return message_count_;}
+  //! Unwrapped time of the first top level message.
+  uint64_t first_time() const {return first_time_;}
+  //! Unwrapped time of the last top level message.
+  uint64_t last_time() const {return unwrapper_.time();}
+  //! Write folded stacks of paths with non zero weight.
+  bool WriteFolded(FoldedWeight weight, std::ostream *out) const;
+
+ private:
+  //! Update row of a message or of a subtrace.
+  void Count(const MessageView &message, bool is_subtrace);
+
+  TimestampUnwrapper unwrapper_; //!< Extends top level timestamps.
+  uint64_t time_; //!< Time of the current top level message.
+  uint64_t first_time_; //!< Time of the first top level message.
+  uint64_t message_count_; //!< Visited messages.
+  std::string key_; //!< Ids of entered subtraces used as row key prefix.
+  std::unordered_map<std::string, std::size_t> indices_; //!< Rows by key.
+  std::vector<PathStats> paths_; //!< Rows.
+};
+}  // namespace vartrace
+
+#endif  // TRUNK_INCLUDE_VARTRACE_TRACE_STATS_H_
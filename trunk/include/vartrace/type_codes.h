@@ -42,6 +42,9 @@ enum StandardTypeIds {
   kTypeIdFloat = 0xf,
   kTypeIdDouble = 0xd,
   kTypeIdChar = 0xc,
+  kTypeIdCounters = 0xfc, //!< Reserved, see trace_counters.h.
+  kTypeIdSpan = 0xfd, //!< Reserved, see ScopedSpan in vartrace.h.
+  kTypeIdByteOrderMark = 0xfe, //!< Reserved, see byte_order.h.
   kTypeIdUnknown = 0xff
 };
 }  // namespace vartrace
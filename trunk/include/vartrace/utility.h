@@ -33,6 +33,13 @@ namespace vartrace {
 //! Divide 2 ints and round up the result.
 #define CEIL_DIV(num, div) ((num) + (div) - 1)/(div)
 
+//! Keep rarely executed function out of the caller, compiler specific.
+#if defined(__GNUC__)
+#define VARTRACE_NOINLINE __attribute__((noinline))
+#else
+#define VARTRACE_NOINLINE
+#endif
+
 //! Size of a header without a timestamp.
 const unsigned kNestedHeaderSize = sizeof(LengthType) + sizeof(MessageIdType)
     + sizeof(DataIdType);
@@ -43,6 +50,8 @@ const unsigned kNestedHeaderLength = CEIL_DIV(kNestedHeaderSize,
                                          sizeof(AlignmentType));
 //! Length of a header with a timestamp.
 const unsigned kHeaderLength = CEIL_DIV(kHeaderSize, sizeof(AlignmentType));
+//! Largest data size that fits into the size field of a header.
+const unsigned kMaxDataSize = static_cast<LengthType>(~0);
 
 //! Constant to get rid of magic numbers.
 const unsigned kBitsPerByte = 8;
@@ -53,6 +62,9 @@ const unsigned kDataIdShift = kBitsPerByte*(sizeof(MessageIdType)
                                             + sizeof(LengthType));
 
 //! Default timestamp function that returns consecutive integers.
+/*! Counter is shared by all traces and threads and safe to call
+  without a lock.
+ */
 TimestampType IncrementalTimestamp();
 //! Function used for subtrace timestamp, returns 0.
 TimestampType ZeroTimestamp();
@@ -0,0 +1,84 @@
+/* validating_parser.h
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file validating_parser.h
+
+  Decoding of damaged dumps.
+
+  Dumps written during a crash may contain torn records and subtraces
+  that were never closed. The validating parser checks every header
+  before it is used: the message must fit into the remaining buffer,
+  its size must agree with its data type and the children of a
+  subtrace must fill it exactly. When a message fails the check the
+  parser scans forward for a position from which several valid
+  messages can be decoded and continues from there. A zero description
+  word never starts a resynchronized message since cleared memory is
+  a common kind of damage, in sequence it is accepted as an empty
+  subtrace with id 0. Skipped bytes are reported instead of being
+  misparsed.
+
+  The scan for candidate headers tests four words at a time with SSE2
+  when it is available.
+*/
+
+#ifndef TRUNK_INCLUDE_VARTRACE_VALIDATING_PARSER_H_
+#define TRUNK_INCLUDE_VARTRACE_VALIDATING_PARSER_H_
+
+#include <vartrace/message_view.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace vartrace {
+
+//! Part of a dump that was not parsed.
+struct SkippedRange {
+  std::size_t offset; //!< Offset of the first skipped byte.
+  std::size_t size; //!< Number of skipped bytes.
+};
+
+//! Rules used to decide whether a header is plausible.
+struct ValidationOptions {
+  //! Accept all types and ids, resync after 8 valid messages.
+  ValidationOptions()
+      : known_types_only(false), ordered_timestamps(false),
+        max_message_type_id(0xff), chain_length(8) {}
+
+  bool known_types_only; //!< Reject type ids not listed in type_codes.h.
+  bool ordered_timestamps; //!< Reject timestamps older than previous one.
+  int max_message_type_id; //!< Reject larger message type ids.
+  unsigned chain_length; //!< Valid messages required after resync.
+};
+
+//! Size of one element of a standard type, 1 for other types.
+std::size_t ElementSize(int data_type_id);
+
+//! True if message at position and all its children are plausible.
+bool IsValidMessage(const void *position, const void *end, bool is_nested,
+                    const ValidationOptions &options = ValidationOptions());
+
+//! Decode valid top level messages and report skipped ranges.
+/*! Offsets of skipped ranges are counted from the beginning of the
+  view, skipped_ranges may be NULL.
+ */
+std::vector<MessageView> ValidatingParse(
+    const TraceView &view, std::vector<SkippedRange> *skipped_ranges,
+    const ValidationOptions &options = ValidationOptions());
+}  // namespace vartrace
+
+#endif  // TRUNK_INCLUDE_VARTRACE_VALIDATING_PARSER_H_
@@ -26,70 +26,73 @@
 #include <cstddef>
 #include <cstring>
 #include <algorithm>
+#include <chrono>
+#include <thread>
 #include <vector>
 #include <string>
 #include <utility>
 
 namespace vartrace {
 
-namespace internal {
-//! The initially reserved space for nested subtrace headers indices.
-const unsigned kInitialSubtraceDepth = 8;
-}  // namespace internal
-
 //! Macros to simplify member function definition.
-#define VAR_TRACE_TEMPLATE template <class LL, template <class> class LP>
+#define VAR_TRACE_TEMPLATE                                              \
+  template <class LL, template <class> class LP, class CP>
 
 //! Macros to simplify Log function definition.
 #define VAR_TRACE_TEMPLATE_T                                            \
-  template <class LL, template <class> class LP> template <typename T>
+  template <class LL, template <class> class LP, class CP>              \
+  template <typename T>
 
 VAR_TRACE_TEMPLATE
-VarTrace<LL, LP>::VarTrace(std::size_t trace_size, std::size_t block_count,
-                           void *storage)
-    : is_initialized_(false), is_top_level_(1),
-      is_memory_managed_(storage == NULL), current_index_(0),
-      get_timestamp_(IncrementalTimestamp), real_timestamp_(get_timestamp_) {
+VarTrace<LL, LP, CP>::VarTrace(std::size_t trace_size, std::size_t block_count,
+                               void *storage)
+    : is_initialized_(false), is_memory_managed_(storage == NULL),
+      open_subtrace_count_(0), dropped_subtrace_count_(0),
+      dropped_message_count_(0), write_position_(0), read_position_(0),
+      overflow_policy_(kOverwrite), block_timeout_us_(kWaitForever),
+      current_index_(0),
+      get_timestamp_(IncrementalTimestamp) {
   std::pair<AlignmentType *, std::size_t> aligned = AlignPointer(storage);
   data_ = aligned.first;
   trace_size -= aligned.second;
   block_count_ = FloorPower2(block_count);
   block_length_ = FloorPower2(trace_size/sizeof(AlignmentType)/block_count_);
-  log2_block_length_ = CeilLog2(block_length_);
   trace_length_ = block_count_*block_length_;
+  // every block contains at least one start index slot
+  log2_start_spacing_ = CeilLog2(std::min<uint_fast32_t>(
+      block_length_, internal::kStartIndexSpacing/sizeof(AlignmentType)));
+  slot_mask_ = (trace_length_ >> log2_start_spacing_) - 1;
   // check parameters and allocate memory
   Initialize();
 }
 
 VAR_TRACE_TEMPLATE
-void VarTrace<LL, LP>::Initialize() {
+void VarTrace<LL, LP, CP>::Initialize() {
   Lock guard(*this);
   // check for double initialization
   if (is_initialized_) {return;}
   // check block count size
   if (block_count_ < internal::kMinBlockCount) {return;}
   // try to allocate storage
-  subtrace_header_positions_.reserve(internal::kInitialSubtraceDepth);
-  message_end_indices_ = new int[block_count_];
+  message_start_indices_ = new int[slot_mask_ + 1];
   if (is_memory_managed_) {
     data_ = new AlignmentType[trace_length_];
   }
-  if (subtrace_header_positions_.capacity() > 0 && message_end_indices_
-      && data_) {
+  if (message_start_indices_ && data_) {
     is_initialized_ = true;
-    // init blocks description variables
+    LP<VarTrace>::PrepareStorage(data_, trace_length_*sizeof(AlignmentType));
     index_mask_ = (trace_length_) - 1;
-    message_end_indices_[0] = 0; // start position of the cursor
-    for (unsigned i = 1; i != block_count_; ++i) {
-      message_end_indices_[i] = -1;
+    message_start_indices_[0] = 0; // first message starts at the cursor
+    for (unsigned i = 1; i != slot_mask_ + 1; ++i) {
+      message_start_indices_[i] = internal::kUnusedSlot;
     }
   }
 }
 
 VAR_TRACE_TEMPLATE
-VarTrace<LL, LP>::~VarTrace() {
+VarTrace<LL, LP, CP>::~VarTrace() {
   if (is_initialized_) {
-    delete[] message_end_indices_;
+    delete[] message_start_indices_;
     if (is_memory_managed_) {
       delete[] data_;
     }
@@ -97,172 +100,299 @@ VarTrace<LL, LP>::~VarTrace() {
 }
 
 VAR_TRACE_TEMPLATE
-void VarTrace<LL, LP>::IncrementCurrentIndex() {
+void VarTrace<LL, LP, CP>::IncrementCurrentIndex() {
   current_index_ = (current_index_ + 1) & index_mask_;
 }
 
 VAR_TRACE_TEMPLATE
-uint_fast32_t VarTrace<LL, LP>::NextIndex(uint_fast32_t index) {
+uint_fast32_t VarTrace<LL, LP, CP>::NextIndex(uint_fast32_t index) {
   return (index + 1) & index_mask_;
 }
 
 VAR_TRACE_TEMPLATE
-uint_fast32_t VarTrace<LL, LP>::NextBlock(uint_fast32_t  block_index) {
-  return (block_index + 1) % block_count_;
+uint_fast32_t VarTrace<LL, LP, CP>::NextSlot(uint_fast32_t slot) {
+  return (slot + 1) & slot_mask_;
+}
+
+VAR_TRACE_TEMPLATE
+void VarTrace<LL, LP, CP>::MarkStartSlots(uint_fast32_t message_start) {
+  uint_fast32_t next_start_slot = current_index_ >> log2_start_spacing_;
+  for (uint_fast32_t slot = NextSlot(message_start >> log2_start_spacing_);
+       slot != next_start_slot; slot = NextSlot(slot)) {
+    message_start_indices_[slot] = internal::kCoveredSlot;
+  }
+  message_start_indices_[next_start_slot] = current_index_;
 }
 
 VAR_TRACE_TEMPLATE
-void VarTrace<LL, LP>::CreateHeader(MessageIdType message_id,
-                                    DataIdType data_id,
-                                    unsigned object_size) {
-  // if not top level then timestamp will be overwritten
-  data_[current_index_] = (get_timestamp_)();
-  current_index_ = (current_index_ + is_top_level_) & index_mask_;
+void VarTrace<LL, LP, CP>::CreateHeader(MessageIdType message_id,
+                                        DataIdType data_id,
+                                        unsigned object_size) {
+  data_[current_index_] = timestamp();
+  IncrementCurrentIndex();
   FormDescription(message_id, data_id, object_size, current_index_);
   IncrementCurrentIndex();
 }
 
+VAR_TRACE_TEMPLATE
+void VarTrace<LL, LP, CP>::CopyData(const void *value, unsigned object_size) {
+  // check if data fits in space left in trace
+  if ((trace_length_ - current_index_)
+      *sizeof(AlignmentType) > object_size) {
+    // copy using one function call
+    std::memcpy(&(data_[current_index_]), value, object_size);
+    // increment index
+    current_index_ += RoundSize(object_size);
+    current_index_ = current_index_ & index_mask_;
+  } else {
+    int copied_size = 0;
+    // copy till the end of the trace
+    int size_to_copy =
+        (trace_length_ - current_index_)
+        *sizeof(AlignmentType);
+    std::memcpy(&(data_[current_index_]), value, size_to_copy);
+    copied_size = size_to_copy;
+    // copy rest of data to the begging of the trace buffer
+    size_to_copy = object_size - copied_size;
+    std::memcpy(&(data_[0]), static_cast<const uint8_t *>(value)
+                + copied_size, size_to_copy);
+    current_index_ = RoundSize(size_to_copy);
+  }
+}
+
 VAR_TRACE_TEMPLATE_T
-void VarTrace<LL, LP>::Log(HiddenLogLevel log_level,
-                           MessageIdType message_id, const T &value) {
+void VarTrace<LL, LP, CP>::Log(HiddenLogLevel log_level,
+                               MessageIdType message_id, const T &value) {
 }
 
 VAR_TRACE_TEMPLATE_T
-void VarTrace<LL, LP>::Log(LL log_level,
-                           MessageIdType message_id, const T &value) {
+void VarTrace<LL, LP, CP>::Log(LL log_level,
+                               MessageIdType message_id, const T &value) {
   DoLog(message_id, &value, typename CopyTraits<T>::CopyCategory(), 1);
 }
 
 VAR_TRACE_TEMPLATE_T
-void VarTrace<LL, LP>::Log(HiddenLogLevel log_level,
-                           MessageIdType message_id,
-                           const T *value, unsigned length) {
+void VarTrace<LL, LP, CP>::Log(HiddenLogLevel log_level,
+                               MessageIdType message_id,
+                               const T *value, unsigned length) {
 }
 
 VAR_TRACE_TEMPLATE_T
-void VarTrace<LL, LP>::Log(LL log_level,
-                           MessageIdType message_id,
-                           const T *value, unsigned length) {
+void VarTrace<LL, LP, CP>::Log(LL log_level,
+                               MessageIdType message_id,
+                               const T *value, unsigned length) {
   DoLogArray(message_id, value, typename CopyTraits<T>::CopyCategory(), length);
 }
 
 VAR_TRACE_TEMPLATE_T
-void VarTrace<LL, LP>::Log(LL log_level, MessageIdType message_id,
-                           const std::vector<T> &value) {
+void VarTrace<LL, LP, CP>::Log(LL log_level, MessageIdType message_id,
+                               const std::vector<T> &value) {
+  static_assert(!LP<VarTrace>::kIsRealTime,
+                "log vector data through pointer and length");
   DoLogArray(message_id, &value[0], typename CopyTraits<T>::CopyCategory(),
              value.size());
 }
 
 VAR_TRACE_TEMPLATE
-void VarTrace<LL, LP>::Log(LL log_level, MessageIdType message_id,
-                           const std::string &value) {
+void VarTrace<LL, LP, CP>::Log(LL log_level, MessageIdType message_id,
+                               const std::string &value) {
+  static_assert(!LP<VarTrace>::kIsRealTime,
+                "log string data through pointer and length");
   DoLogArray(message_id, value.c_str(), SizeofCopyTag(), value.size());
 }
 
+VAR_TRACE_TEMPLATE
+void VarTrace<LL, LP, CP>::LogSpan(LL log_level, MessageIdType span_id,
+                                   TimestampType start_timestamp) {
+  TimestampType duration = timestamp() - start_timestamp;
+  if (open_subtrace_count_.load(std::memory_order_relaxed) != 0
+      && LogNested(span_id, kTypeIdSpan, &duration, sizeof(duration))) {
+    return;
+  }
+  Lock guard(*this);
+  if (!ReserveSpace(kHeaderLength + 1, &guard)) {
+    return;
+  }
+  uint_fast32_t message_start = current_index_;
+  uint_fast32_t index = message_start;
+  data_[index] = start_timestamp;
+  index = (index + 1) & index_mask_;
+  data_[index] = sizeof(duration) + (span_id << kMessageIdShift)
+      + (static_cast<AlignmentType>(kTypeIdSpan) << kDataIdShift);
+  index = (index + 1) & index_mask_;
+  data_[index] = duration;
+  current_index_ = (index + 1) & index_mask_;
+  UpdateStartIndex(message_start);
+  PublishMessage(kHeaderLength + 1);
+}
+
+VAR_TRACE_TEMPLATE
+TraceCounters VarTrace<LL, LP, CP>::Stats() const {
+  TraceCounters counters;
+  std::memset(&counters, 0, sizeof(counters));
+  counters_.Read(&counters);
+  counters.dropped_subtrace_count = dropped_subtrace_count();
+  counters.dropped_message_count = dropped_message_count();
+  return counters;
+}
+
+VAR_TRACE_TEMPLATE
+void VarTrace<LL, LP, CP>::LogCounters(LL log_level,
+                                       MessageIdType message_id) {
+  TraceCounters counters = Stats();
+  if (open_subtrace_count_.load(std::memory_order_relaxed) != 0
+      && LogNested(message_id, kTypeIdCounters, &counters,
+                   sizeof(counters))) {
+    return;
+  }
+  Lock guard(*this);
+  if (!ReserveSpace(kHeaderLength + RoundSize(sizeof(counters)), &guard)) {
+    return;
+  }
+  uint_fast32_t message_start = current_index_;
+  CreateHeader(message_id, kTypeIdCounters, sizeof(counters));
+  CopyData(&counters, sizeof(counters));
+  UpdateStartIndex(message_start);
+  PublishMessage(kHeaderLength + RoundSize(sizeof(counters)));
+}
+
 VAR_TRACE_TEMPLATE_T
-void VarTrace<LL, LP>::DoLogArray(
+void VarTrace<LL, LP, CP>::DoLogArray(
     MessageIdType message_id, const T *value, const SizeofCopyTag &copy_tag,
     unsigned length) {
   DoLog(message_id, value, copy_tag, length);
 }
 
 VAR_TRACE_TEMPLATE_T
-void VarTrace<LL, LP>::DoLogArray(
+void VarTrace<LL, LP, CP>::DoLogArray(
     MessageIdType message_id, const T *value, const SelfCopyTag &copy_tag,
     unsigned length) {
   DoLog(message_id, value, copy_tag, length);
 }
 
 VAR_TRACE_TEMPLATE_T
-void VarTrace<LL, LP>::DoLogArray(
+void VarTrace<LL, LP, CP>::DoLogArray(
     MessageIdType message_id, const T *value, const CustomCopyTag &copy_tag,
     unsigned length) {
   DoLog(message_id, value, copy_tag, length);
 }
 
+VAR_TRACE_TEMPLATE
+bool VarTrace<LL, LP, CP>::LogNested(MessageIdType message_id,
+                                     DataIdType data_id, const void *value,
+                                     unsigned object_size) {
+  SubtraceArena *arena = ThreadSubtraceArena();
+  if (!arena->is_owned_by(this)) {
+    return false;
+  }
+  arena->Append(message_id, data_id, value, object_size);
+  return true;
+}
+
 VAR_TRACE_TEMPLATE_T
-void VarTrace<LL, LP>::DoLog(MessageIdType message_id, const T *value,
-                             const AssignmentCopyTag &copy_tag,
-                             unsigned length) {
+void VarTrace<LL, LP, CP>::DoLog(MessageIdType message_id, const T *value,
+                                 const AssignmentCopyTag &copy_tag,
+                                 unsigned length) {
+  if (open_subtrace_count_.load(std::memory_order_relaxed) != 0
+      && LogNested(message_id, DataType2Int<T>::id, value, sizeof(T))) {
+    return;
+  }
   Lock guard(*this);
-  CreateHeader(message_id,  DataType2Int<T>::id, sizeof(T));
-  data_[current_index_] = *value;
-  IncrementCurrentIndex();
-  UpdateBlock();
+  if (!ReserveSpace(kHeaderLength + 1, &guard)) {
+    return;
+  }
+  // header and value are written without updating the member index
+  uint_fast32_t message_start = current_index_;
+  uint_fast32_t index = message_start;
+  data_[index] = timestamp();
+  index = (index + 1) & index_mask_;
+  data_[index] = sizeof(T) + (message_id << kMessageIdShift)
+      + (static_cast<AlignmentType>(DataType2Int<T>::id) << kDataIdShift);
+  index = (index + 1) & index_mask_;
+  // value starts the word like copied data, so that a dump converted
+  // to another byte order finds small values in the first bytes
+  AlignmentType word = 0;
+  std::memcpy(&word, value, sizeof(T));
+  data_[index] = word;
+  current_index_ = (index + 1) & index_mask_;
+  UpdateStartIndex(message_start);
+  PublishMessage(kHeaderLength + 1);
 }
 
 VAR_TRACE_TEMPLATE_T
-void VarTrace<LL, LP>::DoLog(MessageIdType message_id, const T *value,
-                             const SizeofCopyTag &copy_tag,
-                             unsigned length) {
+void VarTrace<LL, LP, CP>::DoLog(MessageIdType message_id, const T *value,
+                                 const SizeofCopyTag &copy_tag,
+                                 unsigned length) {
   assert(current_index_ < trace_length_);
-  Lock guard(*this);
   unsigned object_size = length*sizeof(T);
-  CreateHeader(message_id,  DataType2Int<T>::id, object_size);
-  // check if data fits in space left in trace
-  if ((trace_length_ - current_index_)
-      *sizeof(AlignmentType) > object_size) {
-    // copy using one function call
-    std::memcpy(&(data_[current_index_]), value, object_size);
-    // increment index
-    current_index_ += RoundSize(object_size);
-    current_index_ = current_index_ & index_mask_;
-  } else {
-    int copied_size = 0;
-    // copy till the end of the trace
-    int size_to_copy =
-        (trace_length_ - current_index_)
-        *sizeof(AlignmentType);
-    std::memcpy(&(data_[current_index_]), value, size_to_copy);
-    copied_size = size_to_copy;
-    // copy rest of data to the begging of the trace buffer
-    size_to_copy = object_size - copied_size;
-    std::memcpy(&(data_[0]), reinterpret_cast<const uint8_t *>(value)
-                + copied_size, size_to_copy);
-    current_index_ = RoundSize(size_to_copy);
+  if (open_subtrace_count_.load(std::memory_order_relaxed) != 0
+      && LogNested(message_id, DataType2Int<T>::id, value, object_size)) {
+    return;
+  }
+  // size would wrap around in the header
+  if (object_size > kMaxDataSize) {
+    dropped_message_count_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  Lock guard(*this);
+  if (!ReserveSpace(kHeaderLength + RoundSize(object_size), &guard)) {
+    return;
   }
-  UpdateBlock();
+  uint_fast32_t message_start = current_index_;
+  CreateHeader(message_id,  DataType2Int<T>::id, object_size);
+  CopyData(value, object_size);
+  UpdateStartIndex(message_start);
+  PublishMessage(kHeaderLength + RoundSize(object_size));
 }
 
 VAR_TRACE_TEMPLATE_T
-void VarTrace<LL, LP>::DoLog(MessageIdType message_id, const T *value,
-                             const SelfCopyTag &copy_tag,
-                             unsigned length) {
-  Lock guard(*this);
-  BeginSubtrace(message_id);
+void VarTrace<LL, LP, CP>::DoLog(MessageIdType message_id, const T *value,
+                                 const SelfCopyTag &copy_tag,
+                                 unsigned length) {
+  SubtraceWriter<VarTrace> writer = BeginSubtrace(message_id);
   for (std::size_t i = 0; i < length; ++i) {
-    value[i].LogItself(this);
+    internal::CallLogItself(value[i], &writer, this, 0);
   }
-  EndSubtrace();
+  writer.EndSubtrace();
 }
 
 VAR_TRACE_TEMPLATE_T
-void VarTrace<LL, LP>::DoLog(MessageIdType message_id, const T *value,
-                             const CustomCopyTag &copy_tag,
-                             unsigned length) {
-  Lock guard(*this);
-  BeginSubtrace(message_id);
+void VarTrace<LL, LP, CP>::DoLog(MessageIdType message_id, const T *value,
+                                 const CustomCopyTag &copy_tag,
+                                 unsigned length) {
+  SubtraceWriter<VarTrace> writer = BeginSubtrace(message_id);
   for (std::size_t i = 0; i < length; ++i) {
-    LogObject(value[i], this);
+    internal::CallLogObject(value[i], &writer, this, 0);
   }
-  EndSubtrace();
+  writer.EndSubtrace();
 }
 
 VAR_TRACE_TEMPLATE
-unsigned VarTrace<LL, LP>::DumpInto(void *buffer, unsigned size) {
+unsigned VarTrace<LL, LP, CP>::DumpInto(void *buffer, unsigned size) {
   Lock guard(*this);
-  if (!is_top_level_) {
-    // trace can not be parsed because subtrace size is written when
-    // subtrace is closed
-    return 0;
+  // queue policies never overwrite, the oldest message is at read position
+  if (overflow_policy_ != kOverwrite) {
+    return CopyMessages(read_position_.load(std::memory_order_acquire),
+                        write_position_.load(std::memory_order_relaxed),
+                        buffer, size);
+  }
+  // start copying from the first intact message after the current slot,
+  // slots that were not written yet are skipped until slot 0 is reached
+  uint_fast32_t current_slot = current_index_ >> log2_start_spacing_;
+  int copy_from = message_start_indices_[current_slot];
+  for (uint_fast32_t slot = NextSlot(current_slot); slot != current_slot;
+       slot = NextSlot(slot)) {
+    if (message_start_indices_[slot] >= 0) {
+      copy_from = message_start_indices_[slot];
+      break;
+    }
   }
-  // start copying from the end of the next block
-  unsigned current_block = current_index_ >> log2_block_length_;
-  int copy_from = message_end_indices_[NextBlock(current_block)];
-  // if end index of the next block is -1 then the trace was not
-  // filled even once, copy from index 0
-  if (copy_from < 0) { copy_from = 0; }
-  int copy_to = message_end_indices_[current_block];
+  if (copy_from < 0) { return 0; }
+  int copy_to = current_index_;
+  // after the first lap everything between the write position and the
+  // first intact message is old data that the dump loses
+  counters_.AddDump(counters_.lap_count() != 0
+                    ? (copy_from - copy_to) & index_mask_ : 0);
   // size of data copied in bytes
   int copied_size = 0;
   // check if block being copied wraps around
@@ -301,56 +431,175 @@ unsigned VarTrace<LL, LP>::DumpInto(void *buffer, unsigned size) {
 }  // function DumpInto
 
 VAR_TRACE_TEMPLATE
-void VarTrace<LL, LP>::SetTimestampFunction(
+unsigned VarTrace<LL, LP, CP>::DrainInto(void *buffer, unsigned size) {
+  if (overflow_policy_ == kOverwrite) {
+    return 0;
+  }
+  uint64_t read_position = read_position_.load(std::memory_order_relaxed);
+  unsigned copied_size = CopyMessages(
+      read_position, write_position_.load(std::memory_order_acquire),
+      buffer, size);
+  // writers may reuse the space as soon as the new position is visible
+  read_position_.store(read_position + copied_size/sizeof(AlignmentType),
+                       std::memory_order_release);
+  return copied_size;
+}  // function DrainInto
+
+VAR_TRACE_TEMPLATE
+unsigned VarTrace<LL, LP, CP>::CopyMessages(uint64_t from, uint64_t to,
+                                            void *buffer, unsigned size) {
+  // find the last whole message that fits in the buffer
+  uint64_t copy_to = from;
+  while (copy_to != to) {
+    LengthType object_size = static_cast<LengthType>(
+        data_[(copy_to + kHeaderLength - kNestedHeaderLength) & index_mask_]);
+    uint64_t next = copy_to + kHeaderLength + RoundSize(object_size);
+    if ((next - from)*sizeof(AlignmentType) > size) {
+      break;
+    }
+    copy_to = next;
+  }
+  // copy till the end of the trace and then from the beginning
+  uint_fast32_t length = copy_to - from;
+  uint_fast32_t first_index = from & index_mask_;
+  uint_fast32_t tail_length = std::min(length, trace_length_ - first_index);
+  std::memcpy(buffer, &(data_[first_index]),
+              tail_length*sizeof(AlignmentType));
+  std::memcpy(static_cast<AlignmentType *>(buffer) + tail_length, &(data_[0]),
+              (length - tail_length)*sizeof(AlignmentType));
+  return length*sizeof(AlignmentType);
+}  // function CopyMessages
+
+VAR_TRACE_TEMPLATE
+bool VarTrace<LL, LP, CP>::WaitForSpace(unsigned length, Lock *guard) {
+  // end of the new message must stay within one trace length of the reader
+  if (length <= trace_length_) {
+    if (write_position_.load(std::memory_order_relaxed) + length
+        <= read_position_.load(std::memory_order_acquire) + trace_length_) {
+      return true;
+    }
+    if (overflow_policy_ == kBlock) {
+      std::chrono::steady_clock::time_point deadline =
+          std::chrono::steady_clock::now()
+          + std::chrono::microseconds(block_timeout_us_);
+      do {
+        // other writers and dumps may run while this one waits, so the
+        // write position is read again after the lock is taken
+        guard->unlock();
+        std::this_thread::yield();
+        guard->lock();
+        if (write_position_.load(std::memory_order_relaxed) + length
+            <= read_position_.load(std::memory_order_acquire)
+            + trace_length_) {
+          return true;
+        }
+      } while (block_timeout_us_ == kWaitForever
+               || std::chrono::steady_clock::now() < deadline);
+    }
+  }
+  dropped_message_count_.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}  // function WaitForSpace
+
+VAR_TRACE_TEMPLATE
+void VarTrace<LL, LP, CP>::SetTimestampFunction(
     TimestampFunctionType timestamp_function) {
   assert(timestamp_function != 0);
+  get_timestamp_.store(timestamp_function, std::memory_order_relaxed);
+}
+
+VAR_TRACE_TEMPLATE
+bool VarTrace<LL, LP, CP>::SetOverflowPolicy(OverflowPolicy policy,
+                                             unsigned block_timeout_us) {
   Lock guard(*this);
-  real_timestamp_ = timestamp_function;
-  if (is_top_level_) {
-    get_timestamp_ = real_timestamp_;
+  // positions of queue policies are counted from the start of the trace
+  if (!is_initialized_ || current_index_ != 0
+      || message_start_indices_[NextSlot(0)] != internal::kUnusedSlot) {
+    return false;
+  }
+  if (policy == kBlock && block_timeout_us == kWaitForever
+      && !LP<VarTrace>::kIsLocking) {
+    return false;
   }
+  overflow_policy_ = policy;
+  block_timeout_us_ = block_timeout_us;
+  return true;
 }
 
 VAR_TRACE_TEMPLATE
-void VarTrace<LL, LP>::BeginSubtrace(MessageIdType subtrace_id) {
-  Lock guard(*this);
-  // create temporary subtrace header and store its position
-  subtrace_header_positions_.push_back(current_index_);
-  CreateHeader(subtrace_id, 0, 0);
-  // switch to subtrace state
-  is_top_level_ = 0;
-  // subtrace has no timestamp so replace by cheaper function
-  get_timestamp_ = ZeroTimestamp;
+SubtraceWriter< VarTrace<LL, LP, CP> > VarTrace<LL, LP, CP>::BeginSubtrace(
+    MessageIdType subtrace_id) {
+  SubtraceArena *arena = ThreadSubtraceArena();
+  if (arena->is_owned_by(this)) {
+    arena->Push(this, subtrace_id, 0);
+  } else {
+    // first subtrace of a transaction sets timestamp of the message
+    ++open_subtrace_count_;
+    arena->Push(this, subtrace_id, timestamp());
+  }
+  CountSubtraceDepth(arena->depth());
+  return SubtraceWriter<VarTrace>(this, arena);
 }  // function BeginSubtrace
 
-VAR_TRACE_TEMPLATE void VarTrace<LL, LP>::EndSubtrace() {
-  Lock guard(*this);
-  if (subtrace_header_positions_.empty()) {
+VAR_TRACE_TEMPLATE void VarTrace<LL, LP, CP>::EndSubtrace() {
+  EndSubtrace(ThreadSubtraceArena());
+}
+
+VAR_TRACE_TEMPLATE void VarTrace<LL, LP, CP>::AbortSubtrace() {
+  AbortSubtrace(ThreadSubtraceArena());
+}
+
+VAR_TRACE_TEMPLATE
+void VarTrace<LL, LP, CP>::EndSubtrace(SubtraceArena *arena) {
+  if (!arena->is_owned_by(this)) {
+    return;
+  }
+  SubtraceArena::Frame frame;
+  if (!arena->Pop(true, &frame)) {
     return;
   }
-  unsigned subtrace_description_index = subtrace_header_positions_.back();
-  subtrace_header_positions_.pop_back();
-  // switch state to top level if necessary
-  if (subtrace_header_positions_.empty()) {
-    is_top_level_ = 1;
-    get_timestamp_ = real_timestamp_;
-    // top level adds timestamp
-    subtrace_description_index = NextIndex(subtrace_description_index);
-  }
-  unsigned subtrace_start_index = NextIndex(subtrace_description_index);
-  unsigned written_length = 0;
-  if (current_index_ < subtrace_start_index) {
-    // trace buffer wrapped around
-    written_length = trace_length_ - subtrace_start_index
-        + current_index_;
+  // outermost subtrace is closed, move it into the trace
+  if (!frame.is_overflowed) {
+    CommitSubtrace(frame.timestamp, arena->data(frame.header_index),
+                   arena->cursor() - frame.header_index);
   } else {
-    // no wrapping happened
-    written_length = current_index_ - subtrace_start_index;
+    dropped_subtrace_count_.fetch_add(1, std::memory_order_relaxed);
   }
-  // change size field of subtrace header
-  data_[subtrace_description_index] |= written_length*sizeof(AlignmentType);
-  UpdateBlock(); // in case of empty subtrace
+  arena->Rewind(frame.header_index);
+  --open_subtrace_count_;
 }  //function EndSubtrace
+
+VAR_TRACE_TEMPLATE
+void VarTrace<LL, LP, CP>::AbortSubtrace(SubtraceArena *arena) {
+  if (!arena->is_owned_by(this)) {
+    return;
+  }
+  SubtraceArena::Frame frame;
+  if (arena->Pop(false, &frame)) {
+    --open_subtrace_count_;
+  }
+}  //function AbortSubtrace
+
+VAR_TRACE_TEMPLATE
+void VarTrace<LL, LP, CP>::CommitSubtrace(TimestampType timestamp,
+                                          const AlignmentType *message,
+                                          unsigned length) {
+  // message that does not fit would overwrite its own beginning
+  if (length + kHeaderLength - kNestedHeaderLength >= trace_length_) {
+    dropped_subtrace_count_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  Lock guard(*this);
+  if (!ReserveSpace(kHeaderLength - kNestedHeaderLength + length, &guard)) {
+    return;
+  }
+  uint_fast32_t message_start = current_index_;
+  data_[current_index_] = timestamp;
+  IncrementCurrentIndex();
+  CopyData(message, length*sizeof(AlignmentType));
+  UpdateStartIndex(message_start);
+  PublishMessage(kHeaderLength - kNestedHeaderLength + length);
+}  // function CommitSubtrace
 }  // namespace vartrace
 
 #endif  // TRUNK_INCLUDE_VARTRACE_VARTRACE_INL_H_
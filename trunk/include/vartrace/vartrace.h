@@ -29,7 +29,11 @@
 #include <vartrace/datatypeid.h>
 #include <vartrace/policies.h>
 #include <vartrace/log_level.h>
+#include <vartrace/subtrace_arena.h>
+#include <vartrace/subtrace_writer.h>
+#include <vartrace/trace_counters.h>
 
+#include <atomic>
 #include <cstring>
 #include <cassert>
 #include <string>
@@ -44,36 +48,111 @@ const unsigned kDefaultBlockCount = 8;
 const unsigned kMinBlockCount = 4;
 //! Default trace size.
 const unsigned kDefaultTraceSize = 0x1000;
+//! Distance in bytes between positions covered by message start index.
+const unsigned kStartIndexSpacing = 0x100;
+//! Start index value of a slot that was never written.
+const int kUnusedSlot = -1;
+//! Start index value of a slot covered by a message that began earlier.
+const int kCoveredSlot = -2;
 } // namespace internal
 
 //! Guard class to ensure that a subtrace is opened and closed properly.
 /*! Every call of BeginSubtrace() must be matched by a closing call to
   EndSubtrace(). This class starts a subtrace in the constructor and
-  closes it in the destructor.
+  closes it in the destructor. Calling Abort() discards the subtrace
+  instead.
 */
 template <class T> class SubtraceGuard {
  public:
   //! Begin subtrace and store trace pointer.
-  SubtraceGuard(T *trace, MessageIdType subtrace_id) : trace_(trace) {
-    trace_->BeginSubtrace(subtrace_id);
-  }
+  SubtraceGuard(T *trace, MessageIdType subtrace_id)
+      : trace_(trace), writer_(trace->BeginSubtrace(subtrace_id)) {}
   //! End subtrace.
   ~SubtraceGuard() {
-    trace_->EndSubtrace();
+    if (trace_) {
+      writer_.EndSubtrace();
+    }
+  }
+  //! Discard subtrace content, destructor does nothing afterwards.
+  void Abort() {
+    if (trace_) {
+      writer_.AbortSubtrace();
+      trace_ = NULL;
+    }
   }
+  //! Writer that logs directly into the guarded subtrace.
+  SubtraceWriter<T> *writer() { return &writer_; }
  private:
-  //! Pointer to trace in which subtrace was created.
+  //! Pointer to trace in which subtrace was created, NULL after abort.
   T *trace_;
+  //! Writer returned by BeginSubtrace.
+  SubtraceWriter<T> writer_;
+};
+
+//! Guard class that measures how long a scope takes.
+/*! The constructor reads the trace clock, the destructor reads it
+  again and stores one record: the header timestamp is the start of
+  the scope, the data is the duration of type TimestampType with data
+  type id kTypeIdSpan. The record is written when the scope ends, so
+  it follows messages logged inside the scope although its timestamp
+  is smaller. Inside a subtrace only the duration is kept, like other
+  nested messages the span has no timestamp of its own.
+
+  \code
+  {
+    ScopedSpan<VarTrace<> > span(&trace, kInfoLevel, 42);
+    DoWork();
+  }
+  \endcode
+
+  Spans below the log level of the trace read no clock and store
+  nothing. LatencyTable in latency_table.h collects durations of
+  spans by id.
+*/
+template <class T> class ScopedSpan {
+ public:
+  //! Read start time.
+  ScopedSpan(T *trace, typename T::LogLevel log_level, MessageIdType span_id)
+      : trace_(trace), log_level_(log_level), span_id_(span_id),
+        start_(trace->timestamp()) {}
+  //! Span below log level, does nothing.
+  ScopedSpan(T *trace, HiddenLogLevel log_level, MessageIdType span_id)
+      : trace_(NULL), span_id_(span_id), start_(0) {}
+  //! Store start time and duration.
+  ~ScopedSpan() {
+    if (trace_) {
+      trace_->LogSpan(log_level_, span_id_, start_);
+    }
+  }
+  //! Discard the span, destructor does nothing afterwards.
+  void Cancel() { trace_ = NULL; }
+  //! Time read by the constructor.
+  TimestampType start() const { return start_; }
+
+ private:
+  //! Spans can not be copied.
+  ScopedSpan(const ScopedSpan &);
+  //! Spans can not be copied.
+  ScopedSpan &operator=(const ScopedSpan &);
+
+  T *trace_; //!< Trace that stores the span, NULL if there is none.
+  typename T::LogLevel log_level_; //!< Level of the span.
+  MessageIdType span_id_; //!< Message id of the record.
+  TimestampType start_; //!< Start of the scope.
 };
 
 //! Class that stores values and timestamp in a circular buffer.
 template <
   class LL = User5LogLevel, // log level selection
-  template <class> class LP = SingleThreaded // locking policy
+  template <class> class LP = SingleThreaded, // locking policy
+  class CP = NoCounting // self instrumentation
   >
 class VarTrace
-    : public LP< VarTrace<LL, LP> > {
+    : public LP< VarTrace<LL, LP, CP> > {
  public:
+  //! Log level threshold of the trace.
+  typedef LL LogLevel;
+
   //! Create a new trace with the given number of blocks and block size.
   /*! Last parameter can be used to specify preallocated storage space.
    */
@@ -85,14 +164,38 @@ class VarTrace
 
   //! Returns true after memory allocation.
   bool is_initialized() const { return is_initialized_; }
-  //! Check if is in subtrace mode.
-  bool is_subtrace() const { return is_top_level_ == 0; }
+  //! Check if the calling thread has an open subtrace in this trace.
+  bool is_subtrace() const {
+    return open_subtrace_count_.load(std::memory_order_relaxed) != 0
+        && ThreadSubtraceArena()->is_owned_by(this);
+  }
   //! Number of memory blocks used to store trace.
+  /*! Blocks only limit the spacing of the message start index, a dump
+    loses at most one index slot of the oldest data.
+   */
   unsigned block_count() const { return block_count_; }
   //! Size of each block in bytes.
   unsigned block_size() const {
     return sizeof(AlignmentType)*block_length_;
   }
+  //! Number of subtraces dropped because they did not fit.
+  unsigned dropped_subtrace_count() const {
+    return dropped_subtrace_count_.load(std::memory_order_relaxed);
+  }
+  //! What happens to messages when the trace is full.
+  OverflowPolicy overflow_policy() const { return overflow_policy_; }
+  //! Number of messages rejected by kDropNew or kBlock policy or too large.
+  /*! Data of a message can not be larger than kMaxDataSize bytes,
+    larger messages inside a subtrace drop the whole subtrace.
+   */
+  unsigned dropped_message_count() const {
+    return dropped_message_count_.load(std::memory_order_relaxed);
+  }
+  //! Snapshot of trace counters, see trace_counters.h.
+  /*! Only drop counters are set unless a counting policy is compiled
+    in. The snapshot is read without the trace lock.
+   */
+  TraceCounters Stats() const;
 
   //! Empty Log overload used for messages below log level.
   template <typename T>
@@ -108,27 +211,80 @@ class VarTrace
   template <typename T>
   void Log(LL log_level, MessageIdType message_id, const T *value,
            unsigned length);
-  //! Log overload for vector.
+  //! Log overload for vector, not available for RealTime policy.
   template <typename T>
   void Log(LL log_level, MessageIdType message_id, const std::vector<T> &value);
-  //! Log overload for std::string.
+  //! Log overload for std::string, not available for RealTime policy.
   void Log(LL log_level, MessageIdType message_id, const std::string &value);
+  //! Empty span overload for suppressed log levels.
+  void LogSpan(HiddenLogLevel log_level, MessageIdType span_id,
+               TimestampType start_timestamp) {}
+  //! Store span that started at start_timestamp and ends now.
+  /*! The clock is read once, before the trace is locked. See
+    ScopedSpan.
+   */
+  void LogSpan(LL log_level, MessageIdType span_id,
+               TimestampType start_timestamp);
+  //! Empty counters overload for suppressed log levels.
+  void LogCounters(HiddenLogLevel log_level, MessageIdType message_id) {}
+  //! Store snapshot of trace counters as a kTypeIdCounters record.
+  /*! Counters are not logged automatically, the caller decides how
+    often a record is worth its space. Counts in the record do not
+    include the record itself.
+   */
+  void LogCounters(LL log_level, MessageIdType message_id);
+  //! Current value of the timestamp function.
+  TimestampType timestamp() const {
+    return get_timestamp_.load(std::memory_order_relaxed)();
+  }
 
   //! Copy trace information into a buffer.
-  /*! \note Can not be called if there is an open subtrace.
+  /*! Subtraces that are still open are not part of the trace yet so
+    they are not copied. The dump does not record its byte order, call
+    WriteByteOrderMark() from byte_order.h at the start of the buffer
+    and dump after the mark if the dump may be read on a machine with
+    other byte order.
    */
   unsigned DumpInto(void *buffer, unsigned size);
+  //! Move the oldest messages into a buffer and free their space.
+  /*! Only whole messages are copied, returns the copied size in
+    bytes. Does nothing with kOverwrite policy. The trace lock is not
+    taken so that a blocked writer can be drained, DrainInto() must
+    not be called from several threads at once.
+   */
+  unsigned DrainInto(void *buffer, unsigned size);
   //! Start subtrace.
-  void BeginSubtrace(MessageIdType subtrace_id);
-  //! End subtrace.
+  /*! Messages logged until the matching EndSubtrace() call are
+    collected in the arena of the calling thread. The returned writer
+    can be used instead of the trace to log into the subtrace without
+    per message checks.
+   */
+  SubtraceWriter<VarTrace> BeginSubtrace(MessageIdType subtrace_id);
+  //! End subtrace, the outermost subtrace is copied into the trace.
   void EndSubtrace();
+  //! Close innermost subtrace and discard its content.
+  void AbortSubtrace();
 
   //! Assign timestamp function.
+  /*! The function is called without the trace lock when a subtrace or
+    a span begins, so with a locking policy it must be safe to call
+    from all threads that log into the trace.
+   */
   void SetTimestampFunction(TimestampFunctionType timestamp_function);
+  //! Select overflow policy, returns false if something was logged.
+  /*! Block timeout is given in microseconds, messages that time out
+    are dropped. Without a locking policy kBlock needs a finite
+    timeout, otherwise a writer that waits for a drainer that never
+    comes would hang forever.
+   */
+  bool SetOverflowPolicy(OverflowPolicy policy,
+                         unsigned block_timeout_us = kWaitForever);
 
  private:
   //! Convenience typedef for locking.
-  typedef typename LP< VarTrace<LL, LP> >::Lock Lock;
+  typedef typename LP< VarTrace<LL, LP, CP> >::Lock Lock;
+  //! Writer closes subtraces through arena it already has.
+  friend class SubtraceWriter<VarTrace>;
 
   //! Disabled copy constructor.
   VarTrace(const VarTrace &);
@@ -168,41 +324,96 @@ class VarTrace
       MessageIdType message_id, const T *value, const CustomCopyTag &copy_tag,
       unsigned length);
 
-  //! Update current block number and its end using current index.
-  inline void UpdateBlock() {
-    unsigned current_block = current_index_ >> log2_block_length_;
-    message_end_indices_[current_block] = current_index_;
+  //! Update start index if the next message begins in a new slot.
+  inline void UpdateStartIndex(uint_fast32_t message_start) {
+    if ((message_start ^ current_index_) >> log2_start_spacing_) {
+      MarkStartSlots(message_start);
+    }
   }
+  //! Invalidate slots covered by the last message, record next start.
+  void MarkStartSlots(uint_fast32_t message_start);
   //! Form description word at given position.
   inline void FormDescription(MessageIdType message_id, DataIdType data_id,
                               unsigned object_size, unsigned position) {
     data_[position] = object_size + (message_id << kMessageIdShift)
-        + (data_id << kDataIdShift);
+        + (static_cast<AlignmentType>(data_id) << kDataIdShift);
   }
   //! Increment position for the next write.
   inline void IncrementCurrentIndex();
   //! Next wrapped around index.
   inline uint_fast32_t NextIndex(uint_fast32_t index);
-  //! Next block index.
-  inline uint_fast32_t  NextBlock(uint_fast32_t block_index);
+  //! Next wrapped around start index slot.
+  inline uint_fast32_t NextSlot(uint_fast32_t slot);
   //! Write message header.
   inline void CreateHeader(MessageIdType message_id, DataIdType data_id,
                            unsigned object_size);
+  //! Copy data at the current position, wrap around if necessary.
+  inline void CopyData(const void *value, unsigned object_size);
+  //! Check that a message fits, wait or drop it according to policy.
+  /*! The guard is released while a kBlock writer waits.
+   */
+  inline bool ReserveSpace(unsigned length, Lock *guard) {
+    return overflow_policy_ == kOverwrite || WaitForSpace(length, guard);
+  }
+  //! Slow path of ReserveSpace() for queue policies.
+  bool WaitForSpace(unsigned length, Lock *guard) VARTRACE_NOINLINE;
+  //! Make a written message visible to the drainer.
+  inline void PublishMessage(unsigned length) {
+    // the message ended at or past the end of the buffer
+    counters_.AddRecord(length, current_index_ < length);
+    if (overflow_policy_ != kOverwrite) {
+      write_position_.store(
+          write_position_.load(std::memory_order_relaxed) + length,
+          std::memory_order_release);
+    }
+  }
+  //! Count depth of a subtrace that was just opened.
+  inline void CountSubtraceDepth(unsigned depth) {
+    counters_.UpdateDepth(depth);
+  }
+  //! Copy whole messages between two positions, return size in bytes.
+  unsigned CopyMessages(uint64_t from, uint64_t to, void *buffer,
+                        unsigned size);
+  //! Append message to subtrace of the calling thread if there is one.
+  /*! Kept out of line so that top level logging is not burdened by
+    the subtrace code.
+   */
+  bool LogNested(MessageIdType message_id, DataIdType data_id,
+                 const void *value, unsigned object_size) VARTRACE_NOINLINE;
+  //! Close innermost subtrace of the given arena.
+  void EndSubtrace(SubtraceArena *arena);
+  //! Discard innermost subtrace of the given arena.
+  void AbortSubtrace(SubtraceArena *arena);
+  //! Copy finished subtrace from the arena into the trace.
+  void CommitSubtrace(TimestampType timestamp, const AlignmentType *message,
+                      unsigned length);
   bool is_initialized_; //!< Set to true after memory allocation.
-  uint_fast8_t is_top_level_;  //!< Set to 0 in the subtrace mode, 1 otherwise.
   bool is_memory_managed_; //!< Is memory allocated or provided.
-  //! Last header positions inside each trace block.
-  std::vector<unsigned> subtrace_header_positions_;
-  uint_fast16_t log2_block_length_; //!< Log2 of block length.
+  //! Number of threads that assemble a subtrace for this trace.
+  std::atomic<uint_fast32_t> open_subtrace_count_;
+  //! Number of subtraces that were too long or too deep.
+  std::atomic<uint_fast32_t> dropped_subtrace_count_;
+  //! Number of messages that did not fit with queue policies.
+  std::atomic<uint_fast32_t> dropped_message_count_;
+  //! Total length of messages written with queue policies.
+  std::atomic<uint64_t> write_position_;
+  //! Total length of messages drained, never passes write_position_.
+  std::atomic<uint64_t> read_position_;
+  OverflowPolicy overflow_policy_; //!< Trace overflow handling.
+  unsigned block_timeout_us_; //!< Wait limit for kBlock policy.
+  uint_fast16_t log2_start_spacing_; //!< Log2 of start index spacing.
   uint_fast16_t block_count_; //!< Total number of blocks, must be power of 2.
   uint_fast32_t block_length_; //!< Length of each block in AlignmentType units.
   uint_fast32_t trace_length_; //!< Length of the trace.
   uint_fast32_t index_mask_; //!< Restricts array index to the range 0...2^n.
   uint_fast32_t current_index_; //!< Next array element to write to.
-  int *message_end_indices_; //!< Message boundaries.
+  uint_fast32_t slot_mask_; //!< Restricts start index slot number.
+  //! First message start in every slot or one of special slot values.
+  int *message_start_indices_;
   AlignmentType *data_; //!< Data array.
-  TimestampFunctionType get_timestamp_; //!< Current timestamp function.
-  TimestampFunctionType real_timestamp_; //!< Actual temestamp function.
+  //! Current timestamp function.
+  std::atomic<TimestampFunctionType> get_timestamp_;
+  CP counters_; //!< Self instrumentation counters.
 };
 }  // vartrace
 
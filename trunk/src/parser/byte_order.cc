@@ -0,0 +1,163 @@
+/* byte_order.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file byte_order.cc
+  Conversion of foreign byte order dumps.
+*/
+
+#include <vartrace/byte_order.h>
+#include <vartrace/message_view.h>
+#include <vartrace/validating_parser.h>
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace vartrace {
+
+namespace {
+//! Size of a SSE2 register in bytes.
+const std::size_t kVectorSize = 0x10;
+
+//! Reverse bytes of one element.
+inline void SwapElement(uint8_t *element, std::size_t element_size) {
+  std::reverse(element, element + element_size);
+}
+
+//! Reverse bytes of a 32 bit word.
+inline AlignmentType SwapWord(AlignmentType word) {
+  SwapElement(reinterpret_cast<uint8_t *>(&word), sizeof(word));
+  return word;
+}
+
+//! Swap bytes of a word stored at unaligned position.
+inline void SwapWordAt(uint8_t *position) {
+  AlignmentType word;
+  std::memcpy(&word, position, sizeof(word));
+  word = SwapWord(word);
+  std::memcpy(position, &word, sizeof(word));
+}
+
+#ifdef __SSE2__
+//! Swap bytes of every 16 bit element of a register.
+inline __m128i SwapBytes16(__m128i value) {
+  return _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8));
+}
+
+//! Swap 16 byte blocks with given order of 16 bit halves, return the rest.
+template <int kShuffle>
+std::size_t SwapVectors(uint8_t *data, std::size_t size) {
+  std::size_t vector_size = size/kVectorSize*kVectorSize;
+  for (uint8_t *position = data; position != data + vector_size;
+       position += kVectorSize) {
+    __m128i *address = reinterpret_cast<__m128i *>(position);
+    __m128i value = _mm_loadu_si128(address);
+    value = _mm_shufflehi_epi16(_mm_shufflelo_epi16(value, kShuffle),
+                                kShuffle);
+    _mm_storeu_si128(address, SwapBytes16(value));
+  }
+  return vector_size;
+}
+#endif
+
+//! Swap bytes of all whole elements in data.
+void SwapElements(uint8_t *data, std::size_t size, std::size_t element_size) {
+  if (element_size == 1) {
+    return;
+  }
+  size = size/element_size*element_size;
+  std::size_t swapped = 0;
+#ifdef __SSE2__
+  // keep halves for 16 bit, swap pairs for 32 bit, reverse for 64 bit
+  switch (element_size) {
+    case 2:
+      swapped = SwapVectors<0xe4>(data, size);
+      break;
+    case 4:
+      swapped = SwapVectors<0xb1>(data, size);
+      break;
+    case 8:
+      swapped = SwapVectors<0x1b>(data, size);
+      break;
+  }
+#endif
+  for (uint8_t *position = data + swapped; position != data + size;
+       position += element_size) {
+    SwapElement(position, element_size);
+  }
+}
+
+//! Swap headers and data of consecutive messages in a range.
+void SwapMessages(uint8_t *position, uint8_t *end, bool is_nested) {
+  std::size_t header_size = sizeof(AlignmentType)
+      *(is_nested ? kNestedHeaderLength : kHeaderLength);
+  while (static_cast<std::size_t>(end - position) >= header_size) {
+    if (!is_nested) {
+      SwapWordAt(position);
+    }
+    SwapWordAt(position + header_size - sizeof(AlignmentType));
+    MessageView message(position, is_nested);
+    uint8_t *message_end = position + std::min<std::size_t>(
+        message.message_size(), end - position);
+    uint8_t *data = position + header_size;
+    uint8_t *data_end = std::min(data + message.data_size(), message_end);
+    if (message.data_type_id() == 0) {
+      SwapMessages(data, data_end, true);
+    } else {
+      SwapElements(data, data_end - data,
+                   ElementSize(message.data_type_id()));
+    }
+    position = message_end;
+  }
+}
+}  // unnamed namespace
+
+ByteOrder DetectByteOrder(const void *dump, std::size_t size) {
+  if (size < kByteOrderMarkSize) {
+    return kUnknownByteOrder;
+  }
+  AlignmentType words[kHeaderLength + 1];
+  std::memcpy(words, dump, kByteOrderMarkSize);
+  AlignmentType description = sizeof(kByteOrderMark)
+      + (static_cast<AlignmentType>(kTypeIdByteOrderMark) << kDataIdShift);
+  if (words[kHeaderLength - 1] == description
+      && words[kHeaderLength] == kByteOrderMark) {
+    return kNativeByteOrder;
+  }
+  if (words[kHeaderLength - 1] == SwapWord(description)
+      && words[kHeaderLength] == SwapWord(kByteOrderMark)) {
+    return kSwappedByteOrder;
+  }
+  return kUnknownByteOrder;
+}
+
+void SwapByteOrder(void *dump, std::size_t size) {
+  uint8_t *begin = static_cast<uint8_t *>(dump);
+  SwapMessages(begin, begin + size, false);
+}
+
+ByteOrder ToNativeByteOrder(void *dump, std::size_t size) {
+  ByteOrder order = DetectByteOrder(dump, size);
+  if (order == kSwappedByteOrder) {
+    SwapByteOrder(dump, size);
+  }
+  return order;
+}
+}  // namespace vartrace
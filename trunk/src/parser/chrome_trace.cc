@@ -0,0 +1,286 @@
+/* chrome_trace.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file chrome_trace.cc
+  Conversion of messages into Chrome trace events.
+*/
+
+#include <vartrace/chrome_trace.h>
+#include <vartrace/type_codes.h>
+#include <vartrace/validating_parser.h>
+
+#include <cmath>
+#include <cstring>
+
+namespace vartrace {
+
+namespace {
+//! Write a number, non finite values are written as null.
+inline void WriteNumber(int64_t value, TextWriter *writer) {
+  writer->WriteSigned(value);
+}
+inline void WriteNumber(uint64_t value, TextWriter *writer) {
+  writer->WriteUnsigned(value);
+}
+inline void WriteNumber(float value, TextWriter *writer) {
+  if (std::isfinite(value)) {
+    writer->WriteFloat(value);
+  } else {
+    writer->Write("null");
+  }
+}
+inline void WriteNumber(double value, TextWriter *writer) {
+  if (std::isfinite(value)) {
+    writer->WriteDouble(value);
+  } else {
+    writer->Write("null");
+  }
+}
+
+//! True if the message holds one value of a standard numeric type.
+bool IsScalar(const MessageView &message) {
+  switch (message.data_type_id()) {
+    case kTypeIdInt8:
+    case kTypeIdUint8:
+    case kTypeIdInt16:
+    case kTypeIdUint16:
+    case kTypeIdInt32:
+    case kTypeIdUint32:
+    case kTypeIdInt64:
+    case kTypeIdUint64:
+    case kTypeIdFloat:
+    case kTypeIdDouble:
+      return static_cast<std::size_t>(message.data_size())
+          == ElementSize(message.data_type_id());
+    default:
+      return false;
+  }
+}
+
+//! Write value of a scalar message.
+void WriteValue(const MessageView &message, TextWriter *writer) {
+  switch (message.data_type_id()) {
+    case kTypeIdInt8:
+      WriteNumber(static_cast<int64_t>(message.value<int8_t>()), writer);
+      break;
+    case kTypeIdUint8:
+      WriteNumber(static_cast<uint64_t>(message.value<uint8_t>()), writer);
+      break;
+    case kTypeIdInt16:
+      WriteNumber(static_cast<int64_t>(message.value<int16_t>()), writer);
+      break;
+    case kTypeIdUint16:
+      WriteNumber(static_cast<uint64_t>(message.value<uint16_t>()), writer);
+      break;
+    case kTypeIdInt32:
+      WriteNumber(static_cast<int64_t>(message.value<int32_t>()), writer);
+      break;
+    case kTypeIdUint32:
+      WriteNumber(static_cast<uint64_t>(message.value<uint32_t>()), writer);
+      break;
+    case kTypeIdInt64:
+      WriteNumber(message.value<int64_t>(), writer);
+      break;
+    case kTypeIdUint64:
+      WriteNumber(message.value<uint64_t>(), writer);
+      break;
+    case kTypeIdFloat:
+      WriteNumber(message.value<float>(), writer);
+      break;
+    case kTypeIdDouble:
+      WriteNumber(message.value<double>(), writer);
+      break;
+  }
+}
+
+//! Write string of a message as JSON, the text ends at the first zero.
+void WriteText(const MessageView &message, TextWriter *writer) {
+  const char *text = static_cast<const char *>(message.data());
+  const void *zero = std::memchr(text, 0, message.data_size());
+  writer->WriteJsonString(text, zero ? static_cast<const char *>(zero) - text
+                          : message.data_size());
+}
+}  // unnamed namespace
+
+ChromeTraceWriter::ChromeTraceWriter(const ChromeTraceOptions &options,
+                                     std::ostream *out)
+    : options_(options), writer_(out), time_(0),
+      has_subtrace_(false), subtrace_id_(0), subtrace_time_(0),
+      subtrace_size_(0), event_count_(0), is_finished_(false) {
+  for (int i = 0; i < 0x100; ++i) {
+    span_roles_[i] = kNoSpan;
+  }
+  for (std::size_t i = 0; i < options_.spans.size(); ++i) {
+    span_roles_[options_.spans[i].first] = kSpanBegin;
+    span_roles_[options_.spans[i].second] = kSpanEnd;
+  }
+  writer_.Write(options_.format == kChromeObjectFormat
+                ? "{\"traceEvents\":[\n" : "[\n");
+  if (!options_.process_name.empty()) {
+    WriteName("process_name", options_.process_name);
+  }
+  if (!options_.thread_name.empty()) {
+    WriteName("thread_name", options_.thread_name);
+  }
+}
+
+ChromeTraceWriter::~ChromeTraceWriter() {
+  if (!is_finished_) {
+    Finish();
+  }
+}
+
+void ChromeTraceWriter::OnMessage(const MessageView &message) {
+  if (!message.is_nested()) {
+    BeginTopLevel(message);
+    if (message.data_type_id() == kTypeIdByteOrderMark) {
+      return;
+    }
+    if (message.data_type_id() == kTypeIdSpan) {
+      BeginEvent('X', time_);
+      writer_.Write(",\"dur\":");
+      WriteTime(message.value<TimestampType>());
+      writer_.Write(",\"name\":");
+      WritePathName(message);
+      writer_.Write('}');
+      return;
+    }
+    SpanRole role = span_roles_[message.message_type_id()];
+    if (role != kNoSpan) {
+      BeginEvent(role == kSpanBegin ? 'B' : 'E', time_);
+      if (role == kSpanBegin) {
+        writer_.Write(",\"name\":");
+        if (message.data_type_id() == kTypeIdChar) {
+          WriteText(message, &writer_);
+        } else {
+          WritePathName(message);
+        }
+      }
+      if (IsScalar(message)) {
+        writer_.Write(",\"args\":{\"value\":");
+        WriteValue(message, &writer_);
+        writer_.Write('}');
+      }
+      writer_.Write('}');
+      return;
+    }
+  }
+  if (message.data_type_id() == kTypeIdChar) {
+    BeginEvent('i', time_);
+    writer_.Write(",\"s\":\"t\",\"name\":");
+    WriteText(message, &writer_);
+    writer_.Write(",\"args\":{\"path\":");
+    WritePathName(message);
+    writer_.Write("}}");
+  } else if (IsScalar(message)) {
+    BeginEvent('C', time_);
+    writer_.Write(",\"name\":");
+    WritePathName(message);
+    writer_.Write(",\"args\":{\"value\":");
+    WriteValue(message, &writer_);
+    writer_.Write("}}");
+  }
+}
+
+void ChromeTraceWriter::OnSubtraceBegin(const MessageView &subtrace) {
+  if (!subtrace.is_nested()) {
+    BeginTopLevel(subtrace);
+    has_subtrace_ = true;
+    subtrace_id_ = subtrace.message_type_id();
+    subtrace_time_ = time_;
+    subtrace_size_ = subtrace.data_size();
+  }
+  path_.push_back(subtrace.message_type_id());
+}
+
+void ChromeTraceWriter::OnSubtraceEnd(const MessageView &subtrace) {
+  path_.pop_back();
+}
+
+bool ChromeTraceWriter::Finish() {
+  // the last subtrace ends with the dump
+  EndSubtrace(time_);
+  writer_.Write(options_.format == kChromeObjectFormat ? "\n]}\n" : "\n]\n");
+  is_finished_ = true;
+  return writer_.Flush();
+}
+
+void ChromeTraceWriter::BeginTopLevel(const MessageView &message) {
+  time_ = unwrapper_.Unwrap(message.timestamp());
+  EndSubtrace(time_);
+}
+
+void ChromeTraceWriter::EndSubtrace(uint64_t time) {
+  if (!has_subtrace_) {
+    return;
+  }
+  has_subtrace_ = false;
+  BeginEvent('X', subtrace_time_);
+  writer_.Write(",\"dur\":");
+  // span records written after the subtrace may carry earlier times
+  WriteTime(time > subtrace_time_ ? time - subtrace_time_ : 0);
+  writer_.Write(",\"name\":\"subtrace ");
+  writer_.WriteUnsigned(subtrace_id_);
+  writer_.Write("\",\"args\":{\"size\":");
+  writer_.WriteUnsigned(subtrace_size_);
+  writer_.Write("}}");
+}
+
+void ChromeTraceWriter::BeginEvent(char phase, uint64_t time) {
+  if (event_count_++) {
+    writer_.Write(",\n");
+  }
+  writer_.Write("{\"ph\":\"");
+  writer_.Write(phase);
+  writer_.Write("\",\"ts\":");
+  WriteTime(time);
+  writer_.Write(",\"pid\":");
+  writer_.WriteSigned(options_.process_id);
+  writer_.Write(",\"tid\":");
+  writer_.WriteSigned(options_.thread_id);
+}
+
+void ChromeTraceWriter::WriteTime(uint64_t time) {
+  writer_.WriteDouble(time/options_.ticks_per_microsecond);
+}
+
+void ChromeTraceWriter::WritePathName(const MessageView &message) {
+  writer_.Write('"');
+  for (std::size_t i = 0; i < path_.size(); ++i) {
+    writer_.WriteUnsigned(path_[i]);
+    writer_.Write('/');
+  }
+  writer_.WriteUnsigned(message.message_type_id());
+  writer_.Write('"');
+}
+
+void ChromeTraceWriter::WriteName(const char *kind, const std::string &name) {
+  if (event_count_++) {
+    writer_.Write(",\n");
+  }
+  writer_.Write("{\"ph\":\"M\",\"pid\":");
+  writer_.WriteSigned(options_.process_id);
+  writer_.Write(",\"tid\":");
+  writer_.WriteSigned(options_.thread_id);
+  writer_.Write(",\"name\":\"");
+  writer_.Write(kind);
+  writer_.Write("\",\"args\":{\"name\":");
+  writer_.WriteJsonString(name.data(), name.size());
+  writer_.Write("}}");
+}
+}  // namespace vartrace
@@ -0,0 +1,282 @@
+/* columnar.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file columnar.cc
+  Extraction of columns and their serialization.
+*/
+
+#include <vartrace/columnar.h>
+#include <vartrace/byte_order.h>
+#include <vartrace/type_codes.h>
+#include <vartrace/validating_parser.h>
+
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+namespace vartrace {
+
+namespace {
+//! First bytes of a binary column file.
+const char kColumnFileMagic[] = {'V', 'T', 'C', 'O', 'L', 'S', '0', '1'};
+//! Alignment of arrays in a binary column file.
+const std::size_t kColumnFileAlignment = sizeof(uint64_t);
+
+//! Key of a column or of a subtrace path.
+inline uint64_t IndexKey(uint32_t path_index, int message_type_id,
+                         int data_type_id) {
+  return (static_cast<uint64_t>(path_index) << 16)
+      | (message_type_id << 8) | data_type_id;
+}
+
+//! True if values of the type are exported.
+bool IsExported(int data_type_id) {
+  return data_type_id != kTypeIdChar && !DataTypeName(data_type_id).empty();
+}
+
+//! Round size up to the file alignment.
+inline uint64_t AlignFileSize(uint64_t size) {
+  return CEIL_DIV(size, kColumnFileAlignment)*kColumnFileAlignment;
+}
+
+//! Write bytes of a value.
+template <typename T> void WriteRaw(const T &value, std::ostream *out) {
+  out->write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+//! Write zeros up to the file alignment.
+void WritePadding(uint64_t size, std::ostream *out) {
+  const char zeros[kColumnFileAlignment] = {0};
+  out->write(zeros, AlignFileSize(size) - size);
+}
+
+//! Print value, bytes are printed as numbers.
+template <typename T> void PrintValue(T value, std::ostream *out) {
+  *out << value;
+}
+template <> void PrintValue<int8_t>(int8_t value, std::ostream *out) {
+  *out << static_cast<int>(value);
+}
+template <> void PrintValue<uint8_t>(uint8_t value, std::ostream *out) {
+  *out << static_cast<unsigned>(value);
+}
+
+//! Print CSV rows of a column of given type.
+template <typename T>
+void PrintRows(const Column &column, std::ostream *out) {
+  out->precision(std::numeric_limits<T>::max_digits10);
+  const T *values = column.values<T>();
+  for (std::size_t i = 0; i < column.size(); ++i) {
+    *out << column.name << ',' << column.timestamps[i] << ',';
+    PrintValue(values[i], out);
+    *out << '\n';
+  }
+}
+}  // unnamed namespace
+
+std::string DataTypeName(int data_type_id) {
+  switch (data_type_id) {
+    case kTypeIdInt8:
+      return "int8";
+    case kTypeIdUint8:
+      return "uint8";
+    case kTypeIdInt16:
+      return "int16";
+    case kTypeIdUint16:
+      return "uint16";
+    case kTypeIdInt32:
+      return "int32";
+    case kTypeIdUint32:
+      return "uint32";
+    case kTypeIdInt64:
+      return "int64";
+    case kTypeIdUint64:
+      return "uint64";
+    case kTypeIdFloat:
+      return "float";
+    case kTypeIdDouble:
+      return "double";
+    case kTypeIdChar:
+      return "char";
+    case kTypeIdSpan:
+      return "span";
+    case kTypeIdCounters:
+      return "counters";
+    default:
+      return std::string();
+  }
+}
+
+ColumnBuilder::ColumnBuilder() : paths_(1), skipped_count_(0) {}
+
+void ColumnBuilder::Add(const MessageView &message) {
+  AddMessage(message, message.timestamp(), 0);
+}
+
+void ColumnBuilder::Add(const TraceView &view) {
+  for (MessageIterator pos = view.begin(); pos != view.end(); ++pos) {
+    Add(*pos);
+  }
+}
+
+void ColumnBuilder::AddMessage(const MessageView &message,
+                               TimestampType timestamp, uint32_t path_index) {
+  if (message.data_type_id() == 0) {
+    if (message.has_children()) {
+      uint32_t child_path = ChildPath(message, path_index);
+      TraceView children = message.children();
+      for (MessageIterator pos = children.begin(); pos != children.end();
+           ++pos) {
+        AddMessage(*pos, timestamp, child_path);
+      }
+    }
+    return;
+  }
+  if (!IsExported(message.data_type_id())) {
+    ++skipped_count_;
+    return;
+  }
+  Column *column = FindColumn(message, path_index);
+  std::size_t row_count = column->size();
+  std::size_t count = message.data_size()/column->element_size;
+  column->timestamps.resize(row_count + count, timestamp);
+  column->data.resize(CEIL_DIV((row_count + count)*column->element_size,
+                               sizeof(uint64_t)));
+  std::memcpy(reinterpret_cast<uint8_t *>(column->data.data())
+              + row_count*column->element_size,
+              message.data(), count*column->element_size);
+}
+
+Column *ColumnBuilder::FindColumn(const MessageView &message,
+                                  uint32_t path_index) {
+  uint64_t key = IndexKey(path_index, message.message_type_id(),
+                          message.data_type_id());
+  std::unordered_map<uint64_t, uint32_t>::const_iterator found =
+      indices_.find(key);
+  if (found != indices_.end()) {
+    return &columns_[found->second];
+  }
+  indices_[key] = columns_.size();
+  columns_.push_back(Column());
+  Column &column = columns_.back();
+  column.path = paths_[path_index];
+  column.path.push_back(message.message_type_id());
+  column.data_type_id = message.data_type_id();
+  column.element_size = ElementSize(message.data_type_id());
+  std::ostringstream name;
+  for (std::size_t i = 0; i < column.path.size(); ++i) {
+    name << (i ? "/" : "") << static_cast<int>(column.path[i]);
+  }
+  name << ':' << DataTypeName(column.data_type_id);
+  column.name = name.str();
+  return &column;
+}
+
+uint32_t ColumnBuilder::ChildPath(const MessageView &subtrace,
+                                  uint32_t path_index) {
+  uint64_t key = IndexKey(path_index, subtrace.message_type_id(), 0);
+  std::unordered_map<uint64_t, uint32_t>::const_iterator found =
+      indices_.find(key);
+  if (found != indices_.end()) {
+    return found->second;
+  }
+  std::vector<MessageIdType> path = paths_[path_index];
+  path.push_back(subtrace.message_type_id());
+  indices_[key] = paths_.size();
+  paths_.push_back(path);
+  return paths_.size() - 1;
+}
+
+bool WriteColumnsCsv(const std::vector<Column> &columns, std::ostream *out) {
+  *out << "column,timestamp,value\n";
+  for (std::size_t i = 0; i < columns.size(); ++i) {
+    switch (columns[i].data_type_id) {
+      case kTypeIdInt8:
+        PrintRows<int8_t>(columns[i], out);
+        break;
+      case kTypeIdUint8:
+        PrintRows<uint8_t>(columns[i], out);
+        break;
+      case kTypeIdInt16:
+        PrintRows<int16_t>(columns[i], out);
+        break;
+      case kTypeIdUint16:
+        PrintRows<uint16_t>(columns[i], out);
+        break;
+      case kTypeIdInt32:
+        PrintRows<int32_t>(columns[i], out);
+        break;
+      case kTypeIdUint32:
+      case kTypeIdSpan:
+        PrintRows<uint32_t>(columns[i], out);
+        break;
+      case kTypeIdInt64:
+        PrintRows<int64_t>(columns[i], out);
+        break;
+      case kTypeIdUint64:
+      case kTypeIdCounters:
+        PrintRows<uint64_t>(columns[i], out);
+        break;
+      case kTypeIdFloat:
+        PrintRows<float>(columns[i], out);
+        break;
+      case kTypeIdDouble:
+        PrintRows<double>(columns[i], out);
+        break;
+    }
+  }
+  return out->good();
+}
+
+bool WriteColumnFile(const std::vector<Column> &columns, std::ostream *out) {
+  uint64_t header_size = sizeof(kColumnFileMagic) + sizeof(kByteOrderMark)
+      + sizeof(uint32_t);
+  for (std::size_t i = 0; i < columns.size(); ++i) {
+    header_size += sizeof(uint32_t) + columns[i].name.size()
+        + sizeof(uint32_t) + 3*sizeof(uint64_t);
+  }
+  out->write(kColumnFileMagic, sizeof(kColumnFileMagic));
+  WriteRaw(kByteOrderMark, out);
+  WriteRaw(static_cast<uint32_t>(columns.size()), out);
+  uint64_t offset = AlignFileSize(header_size);
+  for (std::size_t i = 0; i < columns.size(); ++i) {
+    const Column &column = columns[i];
+    WriteRaw(static_cast<uint32_t>(column.name.size()), out);
+    out->write(column.name.data(), column.name.size());
+    uint8_t types[] = {column.path.back(), column.data_type_id,
+                       static_cast<uint8_t>(column.element_size), 0};
+    out->write(reinterpret_cast<const char *>(types), sizeof(types));
+    WriteRaw(static_cast<uint64_t>(column.size()), out);
+    WriteRaw(offset, out);
+    offset += AlignFileSize(column.size()*sizeof(TimestampType));
+    WriteRaw(offset, out);
+    offset += AlignFileSize(column.size()*column.element_size);
+  }
+  WritePadding(header_size, out);
+  for (std::size_t i = 0; i < columns.size(); ++i) {
+    const Column &column = columns[i];
+    uint64_t size = column.size()*sizeof(TimestampType);
+    out->write(reinterpret_cast<const char *>(column.timestamps.data()), size);
+    WritePadding(size, out);
+    size = column.size()*column.element_size;
+    out->write(reinterpret_cast<const char *>(column.data.data()), size);
+    WritePadding(size, out);
+  }
+  return out->good();
+}
+}  // namespace vartrace
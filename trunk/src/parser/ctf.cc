@@ -0,0 +1,333 @@
+/* ctf.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file ctf.cc
+  Conversion of messages into CTF events and TSDL metadata.
+*/
+
+#include <vartrace/ctf.h>
+#include <vartrace/type_codes.h>
+#include <vartrace/validating_parser.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <sstream>
+
+namespace vartrace {
+
+namespace {
+//! Magic number of CTF packets.
+const uint32_t kCtfMagic = 0xc1fc1fc1;
+//! Size of packet header and context in bytes.
+const std::size_t kPacketHeaderSize = 4 + 16 + 4 + 4*8;
+
+//! Event name and TSDL type of elements of a standard type.
+struct StandardEvent {
+  int data_type_id; //!< Type id of messages.
+  const char *name; //!< Event name.
+  const char *element_type; //!< TSDL type of an element.
+};
+
+//! Events of standard types.
+const StandardEvent kStandardEvents[] = {
+  {kTypeIdInt8, "int8", "int8_t"},
+  {kTypeIdUint8, "uint8", "uint8_t"},
+  {kTypeIdInt16, "int16", "int16_t"},
+  {kTypeIdUint16, "uint16", "uint16_t"},
+  {kTypeIdInt32, "int32", "int32_t"},
+  {kTypeIdUint32, "uint32", "uint32_t"},
+  {kTypeIdInt64, "int64", "int64_t"},
+  {kTypeIdUint64, "uint64", "uint64_t"},
+  {kTypeIdFloat, "float", "float32_t"},
+  {kTypeIdDouble, "double", "float64_t"},
+  {kTypeIdChar, "string", "utf8_t"},
+  {kTypeIdSpan, "span", "uint32_t"},
+  {kTypeIdCounters, "counters", "uint64_t"}
+};
+
+//! True if messages of the type are written as elements of the type.
+bool IsStandardType(int data_type_id) {
+  for (std::size_t i = 0;
+       i < sizeof(kStandardEvents)/sizeof(kStandardEvents[0]); ++i) {
+    if (kStandardEvents[i].data_type_id == data_type_id) {
+      return true;
+    }
+  }
+  return false;
+}
+
+//! Format uuid as TSDL string.
+std::string FormatUuid(const uint8_t *uuid) {
+  char text[37];
+  std::snprintf(text, sizeof(text),
+                "%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-"
+                "%02x%02x%02x%02x%02x%02x",
+                uuid[0], uuid[1], uuid[2], uuid[3], uuid[4], uuid[5],
+                uuid[6], uuid[7], uuid[8], uuid[9], uuid[10], uuid[11],
+                uuid[12], uuid[13], uuid[14], uuid[15]);
+  return text;
+}
+
+//! Write event declaration, fields follow the common path and id.
+void DeclareEvent(unsigned event_id, const std::string &name,
+                  const std::string &fields, std::ostream *out) {
+  *out << "event {\n"
+       << "\tname = \"" << name << "\";\n"
+       << "\tid = " << event_id << ";\n"
+       << "\tstream_id = 0;\n"
+       << "\tfields := struct {\n"
+       << "\t\tuint8_t depth;\n"
+       << "\t\tuint8_t path[depth];\n"
+       << "\t\tuint8_t message_id;\n"
+       << fields
+       << "\t};\n"
+       << "};\n\n";
+}
+}  // unnamed namespace
+
+CtfWriter::CtfWriter(const CtfOptions &options, std::ostream *out)
+    : options_(options), out_(out), time_(0),
+      packet_begin_(0), packet_end_(0), event_count_(0), is_finished_(false) {
+  std::random_device device;
+  for (int i = 0; i < 16; i += 4) {
+    uint32_t random = device();
+    std::memcpy(uuid_ + i, &random, sizeof(random));
+  }
+  // random uuid, version 4
+  uuid_[6] = (uuid_[6] & 0x0f) | 0x40;
+  uuid_[8] = (uuid_[8] & 0x3f) | 0x80;
+  for (int i = 0; i < 0x100; ++i) {
+    user_types_[i] = 0;
+  }
+  for (std::size_t i = 0; i < options_.user_types.size(); ++i) {
+    int data_type_id = options_.user_types[i].data_type_id;
+    if (data_type_id > 0 && data_type_id < 0x100
+        && !IsStandardType(data_type_id)) {
+      user_types_[data_type_id] = i + 1;
+    }
+  }
+  packet_.reserve(options_.packet_size + kMaxMessageSize);
+}
+
+CtfWriter::~CtfWriter() {
+  if (!is_finished_) {
+    Finish();
+  }
+}
+
+void CtfWriter::OnMessage(const MessageView &message) {
+  if (!message.is_nested()) {
+    uint64_t time = unwrapper_.Unwrap(message.timestamp());
+    if (message.data_type_id() == kTypeIdByteOrderMark) {
+      return;
+    }
+    if (message.data_type_id() == kTypeIdSpan) {
+      // stamp with the end, the record is written when the span ends
+      time += message.value<TimestampType>();
+    }
+    SetTime(time);
+  }
+  int data_type_id = message.data_type_id();
+  std::size_t element_size = EventElementSize(data_type_id);
+  std::size_t size = message.data_size();
+  if (element_size && size % element_size == 0) {
+    BeginEvent(data_type_id, message);
+    AppendValue(static_cast<uint16_t>(size/element_size));
+  } else {
+    // no description or a cut element, keep the bytes
+    BeginEvent(kCtfRawId, message);
+    AppendValue(static_cast<uint8_t>(data_type_id));
+    AppendValue(static_cast<uint16_t>(size));
+  }
+  Append(message.data(), size);
+  EndEvent();
+}
+
+void CtfWriter::OnSubtraceBegin(const MessageView &subtrace) {
+  if (!subtrace.is_nested()) {
+    SetTime(unwrapper_.Unwrap(subtrace.timestamp()));
+  }
+  BeginEvent(kTypeIdIllegal, subtrace);
+  AppendValue(static_cast<uint16_t>(subtrace.data_size()));
+  EndEvent();
+  path_.push_back(subtrace.message_type_id());
+}
+
+void CtfWriter::OnSubtraceEnd(const MessageView &subtrace) {
+  path_.pop_back();
+  BeginEvent(kCtfSubtraceEndId, subtrace);
+  EndEvent();
+}
+
+bool CtfWriter::Finish() {
+  if (!packet_.empty()) {
+    FlushPacket();
+  }
+  is_finished_ = true;
+  out_->flush();
+  return out_->good();
+}
+
+std::string CtfWriter::Metadata() const {
+  std::ostringstream out;
+  const uint16_t byte_order = 1;
+  out << "/* CTF 1.8 */\n\n"
+      << "typealias integer {size = 8; align = 8; signed = false; "
+      << "encoding = UTF8;} := utf8_t;\n";
+  for (int size = 8; size <= 64; size *= 2) {
+    out << "typealias integer {size = " << size
+        << "; align = 8; signed = true;} := int" << size << "_t;\n"
+        << "typealias integer {size = " << size
+        << "; align = 8; signed = false;} := uint" << size << "_t;\n";
+  }
+  out << "typealias floating_point {exp_dig = 8; mant_dig = 24; "
+      << "align = 8;} := float32_t;\n"
+      << "typealias floating_point {exp_dig = 11; mant_dig = 53; "
+      << "align = 8;} := float64_t;\n\n"
+      << "trace {\n"
+      << "\tmajor = 1;\n"
+      << "\tminor = 8;\n"
+      << "\tuuid = \"" << FormatUuid(uuid_) << "\";\n"
+      << "\tbyte_order = "
+      << (*reinterpret_cast<const uint8_t *>(&byte_order) ? "le" : "be")
+      << ";\n"
+      << "\tpacket.header := struct {\n"
+      << "\t\tuint32_t magic;\n"
+      << "\t\tuint8_t uuid[16];\n"
+      << "\t\tuint32_t stream_id;\n"
+      << "\t};\n"
+      << "};\n\n"
+      << "env {\n"
+      << "\ttracer_name = \"vartrace\";\n"
+      << "};\n\n"
+      << "clock {\n"
+      << "\tname = vartrace;\n"
+      << "\tfreq = " << options_.clock_frequency << ";\n"
+      << "\toffset_s = " << options_.clock_offset_seconds << ";\n"
+      << "\toffset = " << options_.clock_offset << ";\n"
+      << "};\n\n"
+      << "typealias integer {size = 64; align = 8; signed = false; "
+      << "map = clock.vartrace.value;} := vartrace_clock_t;\n\n"
+      << "stream {\n"
+      << "\tid = 0;\n"
+      << "\tevent.header := struct {\n"
+      << "\t\tuint16_t id;\n"
+      << "\t\tvartrace_clock_t timestamp;\n"
+      << "\t};\n"
+      << "\tpacket.context := struct {\n"
+      << "\t\tvartrace_clock_t timestamp_begin;\n"
+      << "\t\tvartrace_clock_t timestamp_end;\n"
+      << "\t\tuint64_t content_size;\n"
+      << "\t\tuint64_t packet_size;\n"
+      << "\t};\n"
+      << "};\n\n";
+  DeclareEvent(kTypeIdIllegal, "subtrace_begin", "\t\tuint16_t size;\n",
+               &out);
+  DeclareEvent(kCtfSubtraceEndId, "subtrace_end", "", &out);
+  for (std::size_t i = 0;
+       i < sizeof(kStandardEvents)/sizeof(kStandardEvents[0]); ++i) {
+    DeclareEvent(kStandardEvents[i].data_type_id, kStandardEvents[i].name,
+                 std::string("\t\tuint16_t length;\n\t\t")
+                 + kStandardEvents[i].element_type + " values[length];\n",
+                 &out);
+  }
+  for (int i = 0; i < 0x100; ++i) {
+    if (!user_types_[i]) {
+      continue;
+    }
+    const CtfUserType &type = options_.user_types[user_types_[i] - 1];
+    DeclareEvent(i, type.name, type.fields.empty()
+                 ? "\t\tuint16_t length;\n\t\tuint8_t values[length];\n"
+                 : "\t\tuint16_t length;\n\t\tstruct {" + type.fields
+                 + "} values[length];\n", &out);
+  }
+  DeclareEvent(kCtfRawId, "raw", "\t\tuint8_t data_type_id;\n"
+               "\t\tuint16_t length;\n\t\tuint8_t values[length];\n",
+               &out);
+  return out.str();
+}
+
+std::size_t CtfWriter::EventElementSize(int data_type_id) const {
+  if (IsStandardType(data_type_id)) {
+    return ElementSize(data_type_id);
+  }
+  if (!user_types_[data_type_id]) {
+    return 0;
+  }
+  const CtfUserType &type = options_.user_types[user_types_[data_type_id]
+                                                - 1];
+  return type.fields.empty() ? 1 : type.element_size;
+}
+
+void CtfWriter::SetTime(uint64_t time) {
+  // subtraces are committed when they end, after later messages of
+  // other threads, events of a stream must not go back in time
+  time_ = std::max(time_, time);
+}
+
+void CtfWriter::BeginEvent(unsigned event_id, const MessageView &message) {
+  if (packet_.empty()) {
+    packet_begin_ = time_;
+    packet_end_ = time_;
+  }
+  packet_begin_ = std::min(packet_begin_, time_);
+  packet_end_ = std::max(packet_end_, time_);
+  AppendValue(static_cast<uint16_t>(event_id));
+  AppendValue(time_);
+  AppendValue(static_cast<uint8_t>(path_.size()));
+  if (!path_.empty()) {
+    Append(&path_[0], path_.size());
+  }
+  AppendValue(static_cast<MessageIdType>(message.message_type_id()));
+}
+
+void CtfWriter::EndEvent() {
+  ++event_count_;
+  if (packet_.size() >= options_.packet_size) {
+    FlushPacket();
+  }
+}
+
+void CtfWriter::Append(const void *data, std::size_t size) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  packet_.insert(packet_.end(), bytes, bytes + size);
+}
+
+void CtfWriter::FlushPacket() {
+  uint8_t header[kPacketHeaderSize];
+  uint8_t *position = header;
+  const uint32_t stream_id = 0;
+  const uint64_t context[] = {packet_begin_, packet_end_, 0, 0};
+  std::memcpy(position, &kCtfMagic, sizeof(kCtfMagic));
+  position += sizeof(kCtfMagic);
+  std::memcpy(position, uuid_, sizeof(uuid_));
+  position += sizeof(uuid_);
+  std::memcpy(position, &stream_id, sizeof(stream_id));
+  position += sizeof(stream_id);
+  std::memcpy(position, context, sizeof(context));
+  // content and packet sizes are in bits, packets are not padded
+  uint64_t bit_size = 8*(sizeof(header) + packet_.size());
+  std::memcpy(position + 2*sizeof(uint64_t), &bit_size, sizeof(bit_size));
+  std::memcpy(position + 3*sizeof(uint64_t), &bit_size, sizeof(bit_size));
+  out_->write(reinterpret_cast<const char *>(header), sizeof(header));
+  out_->write(reinterpret_cast<const char *>(packet_.data()), packet_.size());
+  packet_.clear();
+}
+}  // namespace vartrace
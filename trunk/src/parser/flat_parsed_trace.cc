@@ -0,0 +1,76 @@
+/* flat_parsed_trace.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file flat_parsed_trace.cc
+  Construction of flat parsed traces.
+*/
+
+#include <vartrace/flat_parsed_trace.h>
+
+namespace vartrace {
+
+namespace {
+//! Smallest message size, used to preallocate message array.
+const std::size_t kMinMessageSize = sizeof(AlignmentType)*(kHeaderLength + 1);
+}  // unnamed namespace
+
+static_assert(sizeof(FlatMessage) == 16, "flat message must stay compact");
+
+FlatParsedTrace::FlatParsedTrace(const void *byte_stream, std::size_t size)
+    : top_level_count_(0) {
+  ParseView(TraceView(byte_stream, size));
+}
+
+FlatParsedTrace::FlatParsedTrace(const TraceView &view)
+    : top_level_count_(0) {
+  ParseView(view);
+}
+
+void FlatParsedTrace::ParseView(const TraceView &view) {
+  // payload is never longer than the trace, messages usually are shorter
+  messages_.reserve(view.size()/kMinMessageSize);
+  payload_.reserve(RoundSize(view.size()));
+  for (MessageIterator pos = view.begin(); pos != view.end(); ++pos) {
+    AppendMessage(*pos);
+    ++top_level_count_;
+  }
+}
+
+void FlatParsedTrace::AppendMessage(const MessageView &message) {
+  uint32_t index = messages_.size();
+  FlatMessage flat_message;
+  flat_message.timestamp = message.timestamp();
+  flat_message.data_index = payload_.size();
+  flat_message.data_size = message.data_size();
+  flat_message.message_type_id = message.message_type_id();
+  flat_message.data_type_id = message.data_type_id();
+  messages_.push_back(flat_message);
+  if (message.data_type_id() != 0) {
+    payload_.resize(payload_.size() + RoundSize(message.data_size()));
+    std::memcpy(&payload_[flat_message.data_index], message.data(),
+                message.data_size());
+  } else {
+    TraceView children = message.children();
+    for (MessageIterator pos = children.begin(); pos != children.end();
+         ++pos) {
+      AppendMessage(*pos);
+    }
+  }
+  messages_[index].subtree_end = messages_.size();
+}
+}  // namespace vartrace
@@ -0,0 +1,84 @@
+/* latency_table.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file latency_table.cc
+  Collection and summary of span durations.
+*/
+
+#include <vartrace/latency_table.h>
+#include <vartrace/type_codes.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace vartrace {
+
+namespace {
+//! Nearest rank percentile of sorted durations.
+TimestampType Percentile(const std::vector<TimestampType> &sorted,
+                         double fraction) {
+  std::size_t rank = static_cast<std::size_t>(
+      std::ceil(fraction*sorted.size()));
+  return sorted[rank ? rank - 1 : 0];
+}
+}  // unnamed namespace
+
+LatencyTable::LatencyTable() : durations_(0x100) {}
+
+void LatencyTable::Add(const MessageView &message) {
+  if (message.data_type_id() == kTypeIdSpan
+      && message.data_size() == sizeof(TimestampType)) {
+    durations_[message.message_type_id()].push_back(
+        message.value<TimestampType>());
+  } else if (message.has_children()) {
+    Add(message.children());
+  }
+}
+
+void LatencyTable::Add(const TraceView &view) {
+  for (MessageIterator pos = view.begin(); pos != view.end(); ++pos) {
+    Add(*pos);
+  }
+}
+
+std::vector<LatencySummary> LatencyTable::Summarize() const {
+  std::vector<LatencySummary> rows;
+  for (int i = 0; i < 0x100; ++i) {
+    if (durations_[i].empty()) {
+      continue;
+    }
+    std::vector<TimestampType> sorted = durations_[i];
+    std::sort(sorted.begin(), sorted.end());
+    LatencySummary row;
+    row.span_id = i;
+    row.count = sorted.size();
+    row.min = sorted.front();
+    row.max = sorted.back();
+    double sum = 0;
+    for (std::size_t j = 0; j < sorted.size(); ++j) {
+      sum += sorted[j];
+    }
+    row.mean = sum/sorted.size();
+    row.p50 = Percentile(sorted, 0.5);
+    row.p90 = Percentile(sorted, 0.9);
+    row.p99 = Percentile(sorted, 0.99);
+    rows.push_back(row);
+  }
+  return rows;
+}
+}  // namespace vartrace
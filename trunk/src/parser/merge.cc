@@ -0,0 +1,131 @@
+/* merge.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file merge.cc
+  Heap based merge of dumps and writing of the merged dump.
+*/
+
+#include <vartrace/merge.h>
+#include <vartrace/byte_order.h>
+#include <vartrace/type_codes.h>
+
+#include <cmath>
+#include <limits>
+
+namespace vartrace {
+
+namespace {
+//! Write timestamp and description words.
+void WriteHeader(TimestampType timestamp, AlignmentType description,
+                 std::ostream *out) {
+  AlignmentType header[kHeaderLength] = {timestamp, description};
+  out->write(reinterpret_cast<const char *>(header), sizeof(header));
+}
+}  // unnamed namespace
+
+uint64_t ClockCorrection::Apply(uint64_t timestamp) const {
+  double corrected = std::floor(offset + scale*timestamp + 0.5);
+  if (corrected <= 0) {
+    return 0;
+  }
+  if (corrected >= std::numeric_limits<uint64_t>::max()) {
+    return std::numeric_limits<uint64_t>::max();
+  }
+  return static_cast<uint64_t>(corrected);
+}
+
+TraceMerger::TraceMerger() {}
+
+std::size_t TraceMerger::AddSource(const std::vector<TraceView> &parts,
+                                   const ClockCorrection &clock) {
+  sources_.push_back(Source());
+  Source &source = sources_.back();
+  source.parts = parts;
+  source.part = 0;
+  if (!parts.empty()) {
+    source.position = parts[0].begin();
+  }
+  source.clock = clock;
+  Advance(sources_.size() - 1);
+  return sources_.size() - 1;
+}
+
+std::size_t TraceMerger::AddSource(const TraceView &view,
+                                   const ClockCorrection &clock) {
+  return AddSource(std::vector<TraceView>(1, view), clock);
+}
+
+bool TraceMerger::Next(MergedMessage *message) {
+  if (heap_.empty()) {
+    return false;
+  }
+  message->timestamp = heap_.top().first;
+  message->source = heap_.top().second;
+  heap_.pop();
+  Source &source = sources_[message->source];
+  message->message = *source.position;
+  ++source.position;
+  Advance(message->source);
+  return true;
+}
+
+void TraceMerger::Advance(std::size_t index) {
+  Source &source = sources_[index];
+  while (source.part < source.parts.size()) {
+    MessageIterator end = source.parts[source.part].end();
+    for (; source.position != end; ++source.position) {
+      MessageView message = *source.position;
+      if (message.data_type_id() != kTypeIdByteOrderMark) {
+        uint64_t timestamp = source.unwrapper.Unwrap(message.timestamp());
+        heap_.push(HeapEntry(source.clock.Apply(timestamp), index));
+        return;
+      }
+    }
+    if (++source.part < source.parts.size()) {
+      source.position = source.parts[source.part].begin();
+    }
+  }
+}
+
+bool WriteMerged(TraceMerger *merger, bool tag_sources, std::ostream *out) {
+  AlignmentType mark[kHeaderLength + 1];
+  WriteByteOrderMark(mark, kByteOrderMarkSize);
+  out->write(reinterpret_cast<const char *>(mark), kByteOrderMarkSize);
+  MergedMessage merged;
+  while (merger->Next(&merged)) {
+    TimestampType timestamp = static_cast<TimestampType>(merged.timestamp);
+    // the nested copy has no timestamp word
+    const char *nested = static_cast<const char *>(merged.message.message())
+        + sizeof(TimestampType);
+    std::size_t nested_size = merged.message.message_size()
+        - sizeof(TimestampType);
+    if (tag_sources
+        && nested_size <= std::numeric_limits<LengthType>::max()
+        && merged.source <= std::numeric_limits<MessageIdType>::max()) {
+      WriteHeader(timestamp, nested_size
+                  | (merged.source << kMessageIdShift), out);
+      out->write(nested, nested_size);
+    } else {
+      out->write(reinterpret_cast<const char *>(&timestamp),
+                 sizeof(timestamp));
+      out->write(nested, nested_size);
+    }
+  }
+  return out->good();
+}
+}  // namespace vartrace
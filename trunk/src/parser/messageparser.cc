@@ -26,90 +26,95 @@
 
 #include <vartrace/tracetypes.h>
 #include <vartrace/messageparser.h>
+#include <vartrace/message_view.h>
+
+#include <boost/make_shared.hpp>
 
 #include <cstring>
 
 namespace vartrace {
 
-Message::Pointer Message::Parse(void *byte_stream, bool is_nested) {
-  Pointer message(new Message(byte_stream, is_nested));
+Message::Pointer Message::Parse(void *byte_stream, bool is_nested,
+                                ParseMode mode) {
+  Pointer message(new Message(byte_stream, is_nested, mode));
   return message;
 }
 
 Message::Message()
     : is_nested_(false), has_children_(false), timestamp_(0), data_type_id_(0),
-      message_type_id_(0), data_size_(0), message_length_(0) {
+      message_type_id_(0), data_size_(0), message_length_(0), unparsed_(NULL) {
+}
+
+Message::Message(void *byte_stream, bool is_nested, ParseMode mode)
+    : is_nested_(is_nested), unparsed_(NULL) {
+  ParseStream(byte_stream, is_nested, mode);
 }
 
-Message::Message(void *byte_stream, bool is_nested)
-    : is_nested_(is_nested) {
-  ParseStream(byte_stream, is_nested);
+Message::Message(const MessageView &view, ParseMode mode) {
+  ParseView(view, mode);
 }
 
-//! Copy data from byte array into a type variable and return remaining data.
-template<typename T>
-static uint8_t * ReadSimpleType(uint8_t *data, T *variable) {
-  *variable = 0;
-  std::memcpy(variable, data, sizeof(T));
-  return (data + sizeof(T));
+void Message::ParseStream(void *byte_stream, bool is_nested, ParseMode mode) {
+  ParseView(MessageView(byte_stream, is_nested), mode);
+}
+
+void Message::ParseView(const MessageView &view, ParseMode mode) {
+  is_nested_ = view.is_nested();
+  timestamp_ = view.timestamp();
+  data_size_ = view.data_size();
+  message_type_id_ = view.message_type_id();
+  data_type_id_ = view.data_type_id();
+  // bad or incomplete subtraces have zero size and can not be parsed
+  has_children_ = view.has_children();
+  message_length_ = RoundSize(view.message_size());
+  unparsed_ = view.data();
+  if (mode == kEagerParse) {
+    Expand(kEagerParse);
+  }
 }
 
-void Message::ParseStream(void *byte_stream, bool is_nested) {
-  uint8_t *start_position = static_cast<uint8_t *>(byte_stream);
-  uint8_t *unparsed_position = start_position;
-  // parse timestamp if it is present
-  is_nested_ = is_nested;
-  if (!is_nested) {
-    unparsed_position = ReadSimpleType(unparsed_position, &timestamp_);
-  } else {
-    timestamp_ = 0;
-  };
-  // get data size
-  unparsed_position = ReadSimpleType(unparsed_position, &data_size_);
-  // get message id
-  unparsed_position = ReadSimpleType(unparsed_position, &message_type_id_);
-  // get data type id
-  unparsed_position = ReadSimpleType(unparsed_position, &data_type_id_);
+void Message::Expand(ParseMode mode) const {
   if (data_type_id_ != 0) { // simple message
-    has_children_ = false;
-    // get required storage length
-    int data_length = RoundSize(data_size_);
-    data_.reset(new AlignmentType[data_length]);
-    std::memcpy(data_.get(), unparsed_position, data_size_);
-    unparsed_position += data_length*sizeof(AlignmentType);
-  } else { // subtrace message
-    if (data_size_ > 0) {
-      has_children_ = true;
-    } else {
-      // bad or incomplete traces can not be parsed
-      has_children_ = false;
-    }
-    // parse all submessages and add them to children
-    int parsed_size = 0;
-    while (parsed_size < data_size_) {
-      Message::Pointer msg(new Message(unparsed_position, true));
+    data_.reset(new AlignmentType[RoundSize(data_size_)]);
+    std::memcpy(data_.get(), unparsed_, data_size_);
+  } else if (has_children_) { // subtrace message, parse all submessages
+    TraceView children(unparsed_, data_size_, true);
+    for (MessageIterator pos = children.begin(); pos != children.end();
+         ++pos) {
+      Message::Pointer msg = boost::make_shared<Message>();
+      msg->ParseView(*pos, mode);
       children_.push_back(msg);
-      parsed_size += msg->message_size();
-      unparsed_position += msg->message_size();
     }
   }
-  // calculate message length
-  message_length_ = RoundSize(unparsed_position - start_position);
+  unparsed_ = NULL;
 }
 
-ParsedVartrace::ParsedVartrace(void *byte_stream, std::size_t size) {
-  ParseStream(byte_stream, size);
+ParsedVartrace::ParsedVartrace(void *byte_stream, std::size_t size,
+                               ParseMode mode) {
+  ParseStream(byte_stream, size, mode);
 }
 
-void ParsedVartrace::ParseStream(void *byte_stream, std::size_t size) {
+ParsedVartrace::ParsedVartrace(void *byte_stream, std::size_t size,
+                               std::vector<SkippedRange> *skipped_ranges,
+                               ParseMode mode) {
+  std::vector<MessageView> views = ValidatingParse(
+      TraceView(byte_stream, size), skipped_ranges);
+  messages_.reserve(views.size());
+  for (std::size_t i = 0; i < views.size(); ++i) {
+    messages_.push_back(boost::make_shared<Message>(views[i], mode));
+  }
+}
+
+void ParsedVartrace::ParseStream(void *byte_stream, std::size_t size,
+                                 ParseMode mode) {
   uint8_t *unparsed_position = static_cast<uint8_t *>(byte_stream);
   std::size_t parsed_size = 0;
   while (parsed_size < size) {
-    Message::Pointer msg(new Message(unparsed_position, false));
+    Message::Pointer msg =
+        boost::make_shared<Message>(unparsed_position, false, mode);
     messages_.push_back(msg);
     parsed_size += msg->message_size();
     unparsed_position += msg->message_size();
   }
 }
 }  // namespace vartrace
-
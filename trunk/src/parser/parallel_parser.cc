@@ -0,0 +1,214 @@
+/* parallel_parser.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file parallel_parser.cc
+  Implementation of multithreaded dump decoding.
+*/
+
+#include <vartrace/parallel_parser.h>
+#include <vartrace/validating_parser.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace vartrace {
+
+namespace {
+//! Size of a top level header in bytes.
+const std::size_t kHeaderBytes = kHeaderLength*sizeof(AlignmentType);
+//! Number of headers that must be plausible to guess a boundary.
+const unsigned kChainLength = 8;
+//! Chunks per thread, more chunks balance load better.
+const unsigned kChunksPerThread = 4;
+//! Message size used to preallocate results.
+const std::size_t kTypicalMessageSize = 0x10;
+//! Smallest chunk worth a separate task.
+const std::size_t kMinChunkSize = 0x10000;
+
+//! Part of a dump walked by one task.
+struct Chunk {
+  const uint8_t *begin; //!< First byte of the chunk.
+  const uint8_t *limit; //!< First byte of the next chunk.
+  const uint8_t *walk_end; //!< End of the last message started in chunk.
+  std::vector<MessageView> messages; //!< Messages found from the guess.
+  std::vector<MessageView> prefix; //!< Messages found while stitching.
+  std::size_t first_message; //!< First message confirmed by stitching.
+  std::size_t output_offset; //!< Position of the first message in result.
+};
+
+//! Check that data size agrees with data type.
+bool IsPlausible(const MessageView &message) {
+  if (message.data_type_id() == 0) {
+    return message.data_size() % sizeof(AlignmentType) == 0;
+  }
+  return message.data_size() % ElementSize(message.data_type_id()) == 0;
+}
+
+//! True if several plausible messages can be decoded from position.
+bool IsPlausibleChain(const uint8_t *position, const uint8_t *end) {
+  for (unsigned i = 0; i < kChainLength; ++i) {
+    if (position == end) {
+      return i != 0;
+    }
+    if (static_cast<std::size_t>(end - position) < kHeaderBytes) {
+      return false;
+    }
+    MessageView message(position, false);
+    if (!IsPlausible(message)
+        || static_cast<std::size_t>(end - position)
+        < static_cast<std::size_t>(message.message_size())) {
+      return false;
+    }
+    position += message.message_size();
+  }
+  return true;
+}
+
+//! Position itself or end if the rest of the dump can not hold a header.
+const uint8_t *SkipPartialHeader(const uint8_t *position,
+                                 const uint8_t *end) {
+  return static_cast<std::size_t>(end - position) < kHeaderBytes
+      ? end : position;
+}
+
+//! Position after the message, same as MessageIterator increment.
+const uint8_t *NextPosition(const MessageView &message, const uint8_t *end) {
+  const uint8_t *position = static_cast<const uint8_t *>(message.message());
+  return SkipPartialHeader(
+      position + std::min<std::size_t>(message.message_size(),
+                                       end - position), end);
+}
+
+//! Guess first boundary of a chunk and walk messages starting in it.
+void WalkChunk(const uint8_t *dump_begin, const uint8_t *end, Chunk *chunk) {
+  const uint8_t *position = chunk->begin;
+  if (position != dump_begin) {
+    while (position < chunk->limit && !IsPlausibleChain(position, end)) {
+      position += sizeof(AlignmentType);
+    }
+  }
+  position = SkipPartialHeader(position, end);
+  // typical messages are a few words long
+  chunk->messages.reserve((chunk->limit - position)/kTypicalMessageSize);
+  while (position < chunk->limit) {
+    chunk->messages.push_back(MessageView(position, false));
+    position = NextPosition(chunk->messages.back(), end);
+  }
+  chunk->walk_end = position;
+  chunk->first_message = 0;
+}
+
+//! Walk chunk from its real start until a guessed boundary is met.
+const uint8_t *StitchChunk(const uint8_t *start, const uint8_t *end,
+                           Chunk *chunk) {
+  const uint8_t *position = SkipPartialHeader(start, end);
+  chunk->first_message = chunk->messages.size();
+  while (position < chunk->limit) {
+    std::vector<MessageView>::const_iterator found = std::lower_bound(
+        chunk->messages.begin(), chunk->messages.end(), position,
+        [](const MessageView &message, const uint8_t *position) {
+          return static_cast<const uint8_t *>(message.message()) < position;
+        });
+    if (found != chunk->messages.end() && found->message() == position) {
+      chunk->first_message = found - chunk->messages.begin();
+      return chunk->walk_end;
+    }
+    chunk->prefix.push_back(MessageView(position, false));
+    position = NextPosition(chunk->prefix.back(), end);
+  }
+  return position;
+}
+}  // unnamed namespace
+
+std::vector<MessageView> ParallelParse(const TraceView &view,
+                                       unsigned thread_count) {
+  const uint8_t *begin = static_cast<const uint8_t *>(view.data());
+  const uint8_t *end = view.end().position();
+  thread_count = std::max(1u, thread_count);
+  std::size_t chunk_count = std::min<std::size_t>(
+      thread_count*kChunksPerThread, view.size()/kMinChunkSize);
+  chunk_count = std::max<std::size_t>(chunk_count, 1);
+  std::size_t chunk_size = view.size()/chunk_count
+      /sizeof(AlignmentType)*sizeof(AlignmentType);
+  std::vector<Chunk> chunks(chunk_count);
+  for (std::size_t i = 0; i < chunk_count; ++i) {
+    chunks[i].begin = begin + i*chunk_size;
+    chunks[i].limit = (i + 1 == chunk_count) ? end : begin + (i + 1)*chunk_size;
+  }
+  ParallelFor(chunk_count, thread_count, [&chunks, begin, end](unsigned i) {
+      WalkChunk(begin, end, &chunks[i]);
+    });
+  // previous chunk tells where the next one starts
+  std::size_t message_count = chunks[0].messages.size();
+  const uint8_t *start = chunks[0].walk_end;
+  for (std::size_t i = 1; i < chunk_count; ++i) {
+    start = StitchChunk(start, end, &chunks[i]);
+    chunks[i].output_offset = message_count;
+    message_count += chunks[i].prefix.size() + chunks[i].messages.size()
+        - chunks[i].first_message;
+  }
+  chunks[0].output_offset = 0;
+  std::vector<MessageView> messages(message_count);
+  ParallelFor(chunk_count, thread_count, [&chunks, &messages](unsigned i) {
+      std::vector<MessageView>::iterator output =
+          messages.begin() + chunks[i].output_offset;
+      output = std::copy(chunks[i].prefix.begin(), chunks[i].prefix.end(),
+                         output);
+      std::copy(chunks[i].messages.begin() + chunks[i].first_message,
+                chunks[i].messages.end(), output);
+    });
+  return messages;
+}
+
+void ParallelFor(unsigned task_count, unsigned thread_count,
+                 const std::function<void (unsigned)> &task) {
+  std::atomic<unsigned> next_task(0);
+  auto worker = [&next_task, task_count, &task]() {
+    for (unsigned i = next_task++; i < task_count; i = next_task++) {
+      task(i);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned i = 1; i < std::min(thread_count, task_count); ++i) {
+    threads.push_back(std::thread(worker));
+  }
+  worker();
+  for (std::size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+}
+
+void ParallelForEach(const TraceView &view, unsigned thread_count,
+                     const PartFunction &function) {
+  std::vector<MessageView> messages = ParallelParse(view, thread_count);
+  std::size_t part_count = std::min<std::size_t>(
+      std::max(1u, thread_count)*kChunksPerThread, messages.size());
+  const uint8_t *end = view.end().position();
+  ParallelFor(part_count, thread_count,
+           [&messages, &function, part_count, end](unsigned i) {
+      std::size_t first = i*messages.size()/part_count;
+      std::size_t last = (i + 1)*messages.size()/part_count;
+      const uint8_t *part_begin =
+          static_cast<const uint8_t *>(messages[first].message());
+      const uint8_t *part_end = (last == messages.size()) ? end
+          : static_cast<const uint8_t *>(messages[last].message());
+      function(i, TraceView(part_begin, part_end - part_begin));
+    });
+}
+}  // namespace vartrace
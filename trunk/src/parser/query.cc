@@ -0,0 +1,228 @@
+/* query.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file query.cc
+  Evaluation of query filters.
+*/
+
+#include <vartrace/query.h>
+#include <vartrace/parallel_parser.h>
+#include <vartrace/type_codes.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace vartrace {
+
+namespace {
+//! Parts per thread, several to balance uneven parts.
+const unsigned kPartsPerThread = 4;
+
+//! Compare value with the query value.
+inline bool Compare(double value, const QueryFilter &filter) {
+  switch (filter.value_operator) {
+    case kAnyValue:
+      return true;
+    case kLess:
+      return value < filter.value;
+    case kLessEqual:
+      return value <= filter.value;
+    case kEqual:
+      return value == filter.value;
+    case kNotEqual:
+      return value != filter.value;
+    case kGreaterEqual:
+      return value >= filter.value;
+    case kGreater:
+      return value > filter.value;
+  }
+  return false;
+}
+
+//! True if any element of an array of given type passes the comparison.
+template <typename T>
+bool AnyValue(const MessageView &message, const QueryFilter &filter) {
+  const uint8_t *data = static_cast<const uint8_t *>(message.data());
+  std::size_t count = message.data_size()/sizeof(T);
+  for (std::size_t i = 0; i < count; ++i) {
+    T value;
+    std::memcpy(&value, data + i*sizeof(T), sizeof(value));
+    if (Compare(static_cast<double>(value), filter)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+//! Call function for matches of a message and its children.
+template <typename Function>
+void Collect(const MessageView &message, TimestampType timestamp,
+             const QueryFilter &filter, std::vector<MessageIdType> *path,
+             const Function &function) {
+  if (path->size() < filter.path.size()) {
+    // only subtraces on the query path are visited
+    if (message.data_type_id() != 0
+        || message.message_type_id() != filter.path[path->size()]) {
+      return;
+    }
+  } else if (MatchesHeader(message, filter) && MatchesValue(message, filter)) {
+    function(timestamp, *path, message);
+  }
+  if (message.has_children()) {
+    path->push_back(message.message_type_id());
+    TraceView children = message.children();
+    for (MessageIterator pos = children.begin(); pos != children.end();
+         ++pos) {
+      Collect(*pos, timestamp, filter, path, function);
+    }
+    path->pop_back();
+  }
+}
+
+//! Call function for matches of a top level message.
+template <typename Function>
+inline void CollectTopLevel(const MessageView &message,
+                            const QueryFilter &filter,
+                            std::vector<MessageIdType> *path,
+                            const Function &function) {
+  TimestampType timestamp = message.timestamp();
+  if (timestamp >= filter.first_timestamp
+      && timestamp <= filter.last_timestamp) {
+    Collect(message, timestamp, filter, path, function);
+  }
+}
+
+//! Function that appends matches to a vector.
+class AppendMatch {
+ public:
+  //! Matches will be appended to given vector.
+  explicit AppendMatch(std::vector<QueryMatch> *matches)
+      : matches_(matches) {}
+  //! Append a match.
+  void operator()(TimestampType timestamp,
+                  const std::vector<MessageIdType> &path,
+                  const MessageView &message) const {
+    QueryMatch match = {timestamp, path, message};
+    matches_->push_back(match);
+  }
+
+ private:
+  std::vector<QueryMatch> *matches_; //!< Destination of matches.
+};
+
+//! Join results of parts in part order.
+std::vector<QueryMatch> Concatenate(
+    const std::vector<std::vector<QueryMatch> > &parts) {
+  std::size_t size = 0;
+  for (std::size_t i = 0; i < parts.size(); ++i) {
+    size += parts[i].size();
+  }
+  std::vector<QueryMatch> matches;
+  matches.reserve(size);
+  for (std::size_t i = 0; i < parts.size(); ++i) {
+    matches.insert(matches.end(), parts[i].begin(), parts[i].end());
+  }
+  return matches;
+}
+}  // unnamed namespace
+
+bool MatchesValue(const MessageView &message, const QueryFilter &filter) {
+  if (filter.value_operator == kAnyValue) {
+    return true;
+  }
+  switch (message.data_type_id()) {
+    case kTypeIdInt8:
+      return AnyValue<int8_t>(message, filter);
+    case kTypeIdUint8:
+      return AnyValue<uint8_t>(message, filter);
+    case kTypeIdInt16:
+      return AnyValue<int16_t>(message, filter);
+    case kTypeIdUint16:
+      return AnyValue<uint16_t>(message, filter);
+    case kTypeIdInt32:
+      return AnyValue<int32_t>(message, filter);
+    case kTypeIdUint32:
+      return AnyValue<uint32_t>(message, filter);
+    case kTypeIdInt64:
+      return AnyValue<int64_t>(message, filter);
+    case kTypeIdUint64:
+      return AnyValue<uint64_t>(message, filter);
+    case kTypeIdFloat:
+      return AnyValue<float>(message, filter);
+    case kTypeIdDouble:
+      return AnyValue<double>(message, filter);
+    default:
+      return false;
+  }
+}
+
+void ForEachMatch(const MessageView *messages, std::size_t count,
+                  const QueryFilter &filter, const MatchFunction &function) {
+  std::vector<MessageIdType> path;
+  for (std::size_t i = 0; i < count; ++i) {
+    CollectTopLevel(messages[i], filter, &path, function);
+  }
+}
+
+std::vector<QueryMatch> RunQuery(const std::vector<MessageView> &messages,
+                                 const QueryFilter &filter,
+                                 unsigned thread_count) {
+  std::size_t part_count = std::min<std::size_t>(
+      std::max(1u, thread_count)*kPartsPerThread, messages.size());
+  std::vector<std::vector<QueryMatch> > parts(part_count);
+  ParallelFor(part_count, thread_count,
+              [&messages, &filter, &parts, part_count](unsigned i) {
+      std::vector<MessageIdType> path;
+      std::size_t last = (i + 1)*messages.size()/part_count;
+      for (std::size_t j = i*messages.size()/part_count; j < last; ++j) {
+        CollectTopLevel(messages[j], filter, &path, AppendMatch(&parts[i]));
+      }
+    });
+  return Concatenate(parts);
+}
+
+std::vector<QueryMatch> RunQuery(const TraceView &view,
+                                 const QueryFilter &filter,
+                                 unsigned thread_count) {
+  return RunQuery(ParallelParse(view, thread_count), filter, thread_count);
+}
+
+std::vector<QueryMatch> RunQuery(const TraceFile &file,
+                                 const QueryFilter &filter,
+                                 unsigned thread_count) {
+  std::pair<std::size_t, std::size_t> range =
+      file.FindChunks(filter.first_timestamp, filter.last_timestamp);
+  std::vector<std::size_t> chunks;
+  for (std::size_t i = range.first; i < range.second; ++i) {
+    // top level messages of the chunk are subtraces on the path
+    if (filter.path.empty() || file.chunk(i).has_message_id(filter.path[0])) {
+      chunks.push_back(i);
+    }
+  }
+  std::vector<std::vector<QueryMatch> > parts(chunks.size());
+  ParallelFor(chunks.size(), thread_count,
+              [&file, &filter, &chunks, &parts](unsigned i) {
+      std::vector<MessageIdType> path;
+      TraceView view = file.chunk_view(chunks[i]);
+      for (MessageIterator pos = view.begin(); pos != view.end(); ++pos) {
+        CollectTopLevel(*pos, filter, &path, AppendMatch(&parts[i]));
+      }
+    });
+  return Concatenate(parts);
+}
+}  // namespace vartrace
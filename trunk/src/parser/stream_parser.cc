@@ -0,0 +1,101 @@
+/* stream_parser.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file stream_parser.cc
+  Implementation of chunked trace parsing.
+*/
+
+#include <vartrace/stream_parser.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace vartrace {
+
+namespace {
+//! Size of a top level header in bytes.
+const std::size_t kHeaderBytes = kHeaderLength*sizeof(AlignmentType);
+}  // unnamed namespace
+
+void VisitMessages(const TraceView &view, TraceVisitor *visitor) {
+  for (MessageIterator pos = view.begin(); pos != view.end(); ++pos) {
+    MessageView message = *pos;
+    if (message.data_type_id() != 0) {
+      visitor->OnMessage(message);
+      continue;
+    }
+    visitor->OnSubtraceBegin(message);
+    VisitMessages(message.children(), visitor);
+    visitor->OnSubtraceEnd(message);
+  }
+}
+
+StreamParser::StreamParser(TraceVisitor *visitor)
+    : visitor_(visitor), pending_size_(0) {
+}
+
+void StreamParser::Feed(const void *chunk, std::size_t size) {
+  const uint8_t *position = static_cast<const uint8_t *>(chunk);
+  if (pending_size_) {
+    std::size_t used_size = CompletePending(position, size);
+    position += used_size;
+    size -= used_size;
+    if (pending_size_) {
+      return;
+    }
+  }
+  // report complete messages in place
+  while (size >= kHeaderBytes) {
+    std::size_t message_size = MessageSize(position);
+    if (size < message_size) {
+      break;
+    }
+    VisitMessages(TraceView(position, message_size), visitor_);
+    position += message_size;
+    size -= message_size;
+  }
+  std::memcpy(pending_, position, size);
+  pending_size_ = size;
+}
+
+std::size_t StreamParser::CompletePending(const uint8_t *chunk,
+                                          std::size_t size) {
+  uint8_t *pending = reinterpret_cast<uint8_t *>(pending_);
+  std::size_t used_size = 0;
+  // message size is unknown until the header is complete
+  if (pending_size_ < kHeaderBytes) {
+    used_size = std::min(size, kHeaderBytes - pending_size_);
+    std::memcpy(pending + pending_size_, chunk, used_size);
+    pending_size_ += used_size;
+    if (pending_size_ < kHeaderBytes) {
+      return used_size;
+    }
+  }
+  std::size_t message_size = MessageSize(pending_);
+  std::size_t copy_size = std::min(size - used_size,
+                                   message_size - pending_size_);
+  std::memcpy(pending + pending_size_, chunk + used_size, copy_size);
+  pending_size_ += copy_size;
+  used_size += copy_size;
+  if (pending_size_ == message_size) {
+    VisitMessages(TraceView(pending_, message_size), visitor_);
+    pending_size_ = 0;
+  }
+  return used_size;
+}
+}  // namespace vartrace
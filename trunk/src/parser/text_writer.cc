@@ -0,0 +1,470 @@
+/* text_writer.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file text_writer.cc
+  Number formatting of the text writer.
+*/
+
+#include <vartrace/text_writer.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace vartrace {
+
+namespace {
+//! Smallest buffer that holds any formatted number.
+const std::size_t kMinTextBufferSize = 64;
+//! Hexadecimal digits for JSON escapes.
+const char kHexDigits[] = "0123456789abcdef";
+//! Number of powers of ten that fit into 64 bits.
+const int kPowerOfTenCount = 20;
+//! Powers of ten that fit into 64 bits.
+const uint64_t kPowersOfTen[kPowerOfTenCount] = {
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+  10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+  100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+  100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+  100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+//! Decimal digits of numbers from 0 to 99.
+const char kDigitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233"
+    "34353637383940414243444546474849505152535455565758596061626364656667"
+    "6869707172737475767778798081828384858687888990919293949596979899";
+
+//! Write digits of value backwards ending at end, return first digit.
+/*! Two digits are produced per division.
+ */
+inline char *FormatDigits(uint64_t value, char *end) {
+  while (value >= 100) {
+    const char *pair = kDigitPairs + 2*(value % 100);
+    value /= 100;
+    *--end = pair[1];
+    *--end = pair[0];
+  }
+  if (value >= 10) {
+    *--end = kDigitPairs[2*value + 1];
+    *--end = kDigitPairs[2*value];
+  } else {
+    *--end = '0' + value;
+  }
+  return end;
+}
+
+//! Normalized power of ten: significand*2^exponent = 10^decimal.
+struct CachedPower {
+  uint64_t significand; //!< Significand with the highest bit set.
+  int exponent; //!< Binary exponent.
+  int decimal; //!< Decimal exponent.
+};
+
+//! Powers of ten from 10^-348 to 10^340 in steps of 8.
+const CachedPower kCachedPowers[] = {
+  {0xfa8fd5a0081c0288ULL, -1220, -348},
+  {0xbaaee17fa23ebf76ULL, -1193, -340},
+  {0x8b16fb203055ac76ULL, -1166, -332},
+  {0xcf42894a5dce35eaULL, -1140, -324},
+  {0x9a6bb0aa55653b2dULL, -1113, -316},
+  {0xe61acf033d1a45dfULL, -1087, -308},
+  {0xab70fe17c79ac6caULL, -1060, -300},
+  {0xff77b1fcbebcdc4fULL, -1034, -292},
+  {0xbe5691ef416bd60cULL, -1007, -284},
+  {0x8dd01fad907ffc3cULL, -980, -276},
+  {0xd3515c2831559a83ULL, -954, -268},
+  {0x9d71ac8fada6c9b5ULL, -927, -260},
+  {0xea9c227723ee8bcbULL, -901, -252},
+  {0xaecc49914078536dULL, -874, -244},
+  {0x823c12795db6ce57ULL, -847, -236},
+  {0xc21094364dfb5637ULL, -821, -228},
+  {0x9096ea6f3848984fULL, -794, -220},
+  {0xd77485cb25823ac7ULL, -768, -212},
+  {0xa086cfcd97bf97f4ULL, -741, -204},
+  {0xef340a98172aace5ULL, -715, -196},
+  {0xb23867fb2a35b28eULL, -688, -188},
+  {0x84c8d4dfd2c63f3bULL, -661, -180},
+  {0xc5dd44271ad3cdbaULL, -635, -172},
+  {0x936b9fcebb25c996ULL, -608, -164},
+  {0xdbac6c247d62a584ULL, -582, -156},
+  {0xa3ab66580d5fdaf6ULL, -555, -148},
+  {0xf3e2f893dec3f126ULL, -529, -140},
+  {0xb5b5ada8aaff80b8ULL, -502, -132},
+  {0x87625f056c7c4a8bULL, -475, -124},
+  {0xc9bcff6034c13053ULL, -449, -116},
+  {0x964e858c91ba2655ULL, -422, -108},
+  {0xdff9772470297ebdULL, -396, -100},
+  {0xa6dfbd9fb8e5b88fULL, -369, -92},
+  {0xf8a95fcf88747d94ULL, -343, -84},
+  {0xb94470938fa89bcfULL, -316, -76},
+  {0x8a08f0f8bf0f156bULL, -289, -68},
+  {0xcdb02555653131b6ULL, -263, -60},
+  {0x993fe2c6d07b7facULL, -236, -52},
+  {0xe45c10c42a2b3b06ULL, -210, -44},
+  {0xaa242499697392d3ULL, -183, -36},
+  {0xfd87b5f28300ca0eULL, -157, -28},
+  {0xbce5086492111aebULL, -130, -20},
+  {0x8cbccc096f5088ccULL, -103, -12},
+  {0xd1b71758e219652cULL, -77, -4},
+  {0x9c40000000000000ULL, -50, 4},
+  {0xe8d4a51000000000ULL, -24, 12},
+  {0xad78ebc5ac620000ULL, 3, 20},
+  {0x813f3978f8940984ULL, 30, 28},
+  {0xc097ce7bc90715b3ULL, 56, 36},
+  {0x8f7e32ce7bea5c70ULL, 83, 44},
+  {0xd5d238a4abe98068ULL, 109, 52},
+  {0x9f4f2726179a2245ULL, 136, 60},
+  {0xed63a231d4c4fb27ULL, 162, 68},
+  {0xb0de65388cc8ada8ULL, 189, 76},
+  {0x83c7088e1aab65dbULL, 216, 84},
+  {0xc45d1df942711d9aULL, 242, 92},
+  {0x924d692ca61be758ULL, 269, 100},
+  {0xda01ee641a708deaULL, 295, 108},
+  {0xa26da3999aef774aULL, 322, 116},
+  {0xf209787bb47d6b85ULL, 348, 124},
+  {0xb454e4a179dd1877ULL, 375, 132},
+  {0x865b86925b9bc5c2ULL, 402, 140},
+  {0xc83553c5c8965d3dULL, 428, 148},
+  {0x952ab45cfa97a0b3ULL, 455, 156},
+  {0xde469fbd99a05fe3ULL, 481, 164},
+  {0xa59bc234db398c25ULL, 508, 172},
+  {0xf6c69a72a3989f5cULL, 534, 180},
+  {0xb7dcbf5354e9beceULL, 561, 188},
+  {0x88fcf317f22241e2ULL, 588, 196},
+  {0xcc20ce9bd35c78a5ULL, 614, 204},
+  {0x98165af37b2153dfULL, 641, 212},
+  {0xe2a0b5dc971f303aULL, 667, 220},
+  {0xa8d9d1535ce3b396ULL, 694, 228},
+  {0xfb9b7cd9a4a7443cULL, 720, 236},
+  {0xbb764c4ca7a44410ULL, 747, 244},
+  {0x8bab8eefb6409c1aULL, 774, 252},
+  {0xd01fef10a657842cULL, 800, 260},
+  {0x9b10a4e5e9913129ULL, 827, 268},
+  {0xe7109bfba19c0c9dULL, 853, 276},
+  {0xac2820d9623bf429ULL, 880, 284},
+  {0x80444b5e7aa7cf85ULL, 907, 292},
+  {0xbf21e44003acdd2dULL, 933, 300},
+  {0x8e679c2f5e44ff8fULL, 960, 308},
+  {0xd433179d9c8cb841ULL, 986, 316},
+  {0x9e19db92b4e31ba9ULL, 1013, 324},
+  {0xeb96bf6ebadf77d9ULL, 1039, 332},
+  {0xaf87023b9bf0ee6bULL, 1066, 340},
+};
+
+//! Floating point number with 64 bit significand, value is f*2^e.
+struct DiyFp {
+  DiyFp() : f(0), e(0) {}
+  DiyFp(uint64_t f, int e) : f(f), e(e) {}
+
+  //! Difference of numbers with the same exponent.
+  DiyFp operator-(const DiyFp &other) const {
+    return DiyFp(f - other.f, e);
+  }
+  //! Product rounded to 64 bits.
+  DiyFp operator*(const DiyFp &other) const {
+    const uint64_t kMask = 0xffffffff;
+    uint64_t a = f >> 32, b = f & kMask;
+    uint64_t c = other.f >> 32, d = other.f & kMask;
+    uint64_t ac = a*c, bc = b*c, ad = a*d, bd = b*d;
+    uint64_t middle = (bd >> 32) + (ad & kMask) + (bc & kMask)
+        + (static_cast<uint64_t>(1) << 31);
+    return DiyFp(ac + (ad >> 32) + (bc >> 32) + (middle >> 32),
+                 e + other.e + 64);
+  }
+  //! Same number with the highest significand bit set.
+  DiyFp Normalize() const {
+#ifdef __GNUC__
+    int shift = __builtin_clzll(f);
+    return DiyFp(f << shift, e - shift);
+#else
+    DiyFp result = *this;
+    while (!(result.f & (static_cast<uint64_t>(1) << 63))) {
+      result.f <<= 1;
+      --result.e;
+    }
+    return result;
+#endif
+  }
+
+  uint64_t f; //!< Significand.
+  int e; //!< Binary exponent.
+};
+
+//! Unpacked finite positive value and the halfway points to neighbours.
+/*! SignificandBits and ExponentBits describe the IEEE format, bits
+  hold the value without sign.
+ */
+template <int SignificandBits, int ExponentBits>
+void Unpack(uint64_t bits, DiyFp *value, DiyFp *lower, DiyFp *upper) {
+  const uint64_t kHiddenBit = static_cast<uint64_t>(1) << SignificandBits;
+  const int kBias = (1 << (ExponentBits - 1)) - 1 + SignificandBits;
+  int biased_exponent = static_cast<int>(bits >> SignificandBits);
+  uint64_t significand = bits & (kHiddenBit - 1);
+  if (biased_exponent) {
+    *value = DiyFp(significand + kHiddenBit, biased_exponent - kBias);
+  } else {
+    *value = DiyFp(significand, 1 - kBias);
+  }
+  *upper = DiyFp((value->f << 1) + 1, value->e - 1).Normalize();
+  // the gap below a power of two is half as large
+  if (value->f == kHiddenBit) {
+    *lower = DiyFp((value->f << 2) - 1, value->e - 2);
+  } else {
+    *lower = DiyFp((value->f << 1) - 1, value->e - 1);
+  }
+  lower->f <<= lower->e - upper->e;
+  lower->e = upper->e;
+  *value = value->Normalize();
+}
+
+//! Cached power that brings a number with exponent e into range.
+inline const CachedPower &FindCachedPower(int e) {
+  double k = (-61 - e)*0.30102999566398114 + 347;
+  int rounded = static_cast<int>(k);
+  if (k > rounded) {
+    ++rounded;
+  }
+  return kCachedPowers[(rounded >> 3) + 1];
+}
+
+//! Move the last digit closer to the exact value while it stays inside.
+inline void RoundDigits(char *digits, int size, uint64_t delta,
+                        uint64_t rest, uint64_t ten_kappa, uint64_t distance) {
+  while (rest < distance && delta - rest >= ten_kappa
+         && (rest + ten_kappa < distance
+             || distance - rest > rest + ten_kappa - distance)) {
+    --digits[size - 1];
+    rest += ten_kappa;
+  }
+}
+
+//! Take the leading digit of a number with given count of digits.
+/*! Divisors are constants, so no division instruction is used.
+ */
+inline uint32_t NextDigit(int digit_count, uint32_t *number) {
+  uint32_t digit;
+  switch (digit_count) {
+    case 10: digit = *number/1000000000; *number %= 1000000000; break;
+    case 9: digit = *number/100000000; *number %= 100000000; break;
+    case 8: digit = *number/10000000; *number %= 10000000; break;
+    case 7: digit = *number/1000000; *number %= 1000000; break;
+    case 6: digit = *number/100000; *number %= 100000; break;
+    case 5: digit = *number/10000; *number %= 10000; break;
+    case 4: digit = *number/1000; *number %= 1000; break;
+    case 3: digit = *number/100; *number %= 100; break;
+    case 2: digit = *number/10; *number %= 10; break;
+    default: digit = *number; *number = 0;
+  }
+  return digit;
+}
+
+//! Generate shortest digits between the boundaries, Grisu2 algorithm.
+/*! Returns number of digits, the value is digits*10^decimal_exponent.
+ */
+int GenerateDigits(const DiyFp &value, const DiyFp &upper, uint64_t delta,
+                   char *digits, int *decimal_exponent) {
+  const DiyFp one(static_cast<uint64_t>(1) << -upper.e, upper.e);
+  uint64_t distance = (upper - value).f;
+  uint32_t integral = static_cast<uint32_t>(upper.f >> -one.e);
+  uint64_t fraction = upper.f & (one.f - 1);
+  int kappa = 1;
+  while (kappa < 10 && integral >= kPowersOfTen[kappa]) {
+    ++kappa;
+  }
+  int size = 0;
+  while (kappa > 0) {
+    uint32_t digit = NextDigit(kappa, &integral);
+    if (digit || size) {
+      digits[size++] = '0' + digit;
+    }
+    --kappa;
+    uint64_t rest = (static_cast<uint64_t>(integral) << -one.e) + fraction;
+    if (rest <= delta) {
+      *decimal_exponent += kappa;
+      RoundDigits(digits, size, delta, rest, kPowersOfTen[kappa] << -one.e,
+                  distance);
+      return size;
+    }
+  }
+  for (;;) {
+    fraction *= 10;
+    delta *= 10;
+    char digit = static_cast<char>(fraction >> -one.e);
+    if (digit || size) {
+      digits[size++] = '0' + digit;
+    }
+    fraction &= one.f - 1;
+    --kappa;
+    if (fraction < delta) {
+      *decimal_exponent += kappa;
+      RoundDigits(digits, size, delta, fraction, one.f,
+                  -kappa < kPowerOfTenCount
+                  ? distance*kPowersOfTen[-kappa] : 0);
+      return size;
+    }
+  }
+}
+
+//! Place decimal point or exponent, return size of the text.
+/*! Digits are at the start of text, the value is
+  digits*10^decimal_exponent.
+ */
+std::size_t PlaceDecimalPoint(char *text, int size, int decimal_exponent) {
+  // value is between 10^(point - 1) and 10^point
+  int point = size + decimal_exponent;
+  if (size <= point && point <= 21) {
+    std::fill(text + size, text + point, '0');
+    return point;
+  }
+  if (0 < point && point <= 21) {
+    std::memmove(text + point + 1, text + point, size - point);
+    text[point] = '.';
+    return size + 1;
+  }
+  if (-6 < point && point <= 0) {
+    int offset = 2 - point;
+    std::memmove(text + offset, text, size);
+    text[0] = '0';
+    text[1] = '.';
+    std::fill(text + 2, text + offset, '0');
+    return size + offset;
+  }
+  std::size_t mantissa_size = 1;
+  if (size > 1) {
+    std::memmove(text + 2, text + 1, size - 1);
+    text[1] = '.';
+    mantissa_size = size + 1;
+  }
+  char *position = text + mantissa_size;
+  *position++ = 'e';
+  int exponent = point - 1;
+  *position++ = exponent < 0 ? '-' : '+';
+  exponent = std::abs(exponent);
+  if (exponent >= 100) {
+    *position++ = '0' + exponent/100;
+  }
+  if (exponent >= 10) {
+    *position++ = '0' + exponent/10 % 10;
+  }
+  *position++ = '0' + exponent % 10;
+  return position - text;
+}
+
+//! Format shortest text that reads back as the value, return its size.
+template <int SignificandBits, int ExponentBits>
+std::size_t FormatFloatingPoint(uint64_t bits, char *text) {
+  const int kSignShift = SignificandBits + ExponentBits;
+  const uint64_t kExponentMask = ((static_cast<uint64_t>(1) << ExponentBits)
+                                  - 1) << SignificandBits;
+  char *position = text;
+  if (bits >> kSignShift) {
+    *position++ = '-';
+    bits &= (static_cast<uint64_t>(1) << kSignShift) - 1;
+  }
+  if ((bits & kExponentMask) == kExponentMask) {
+    const char *name = (bits & ~kExponentMask) ? "nan" : "inf";
+    if ((bits & ~kExponentMask) && position != text) {
+      --position;
+    }
+    return std::copy(name, name + 3, position) - text;
+  }
+  if (!bits) {
+    *position++ = '0';
+    return position - text;
+  }
+  DiyFp value, lower, upper;
+  Unpack<SignificandBits, ExponentBits>(bits, &value, &lower, &upper);
+  const CachedPower &power = FindCachedPower(upper.e);
+  DiyFp scale(power.significand, power.exponent);
+  DiyFp scaled = value*scale;
+  DiyFp scaled_upper = upper*scale;
+  DiyFp scaled_lower = lower*scale;
+  // stay strictly inside the rounding interval despite product errors
+  ++scaled_lower.f;
+  --scaled_upper.f;
+  int decimal_exponent = -power.decimal;
+  int size = GenerateDigits(scaled, scaled_upper,
+                            scaled_upper.f - scaled_lower.f, position,
+                            &decimal_exponent);
+  return position - text + PlaceDecimalPoint(position, size,
+                                             decimal_exponent);
+}
+}  // unnamed namespace
+
+TextWriter::TextWriter(std::ostream *out, std::size_t buffer_size)
+    : out_(out), buffer_(std::max(buffer_size, kMinTextBufferSize)),
+      size_(0) {
+}
+
+TextWriter::~TextWriter() {
+  Flush();
+}
+
+void TextWriter::WriteUnsigned(uint64_t value) {
+  char number[24];
+  char *end = number + sizeof(number);
+  char *begin = FormatDigits(value, end);
+  Write(begin, end - begin);
+}
+
+void TextWriter::WriteSigned(int64_t value) {
+  if (value < 0) {
+    Write('-');
+    // negate as unsigned so that the smallest value does not overflow
+    WriteUnsigned(-static_cast<uint64_t>(value));
+  } else {
+    WriteUnsigned(value);
+  }
+}
+
+void TextWriter::WriteDouble(double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  size_ += FormatFloatingPoint<52, 11>(bits, Reserve(kMinTextBufferSize));
+}
+
+void TextWriter::WriteFloat(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  size_ += FormatFloatingPoint<23, 8>(bits, Reserve(kMinTextBufferSize));
+}
+
+void TextWriter::WriteJsonString(const char *text, std::size_t size) {
+  Write('"');
+  for (std::size_t i = 0; i < size; ++i) {
+    unsigned char c = text[i];
+    if (c == '"' || c == '\\') {
+      Write('\\');
+      Write(c);
+    } else if (c < 0x20) {
+      char escape[] = {'\\', 'u', '0', '0', kHexDigits[c >> 4],
+                       kHexDigits[c & 0xf]};
+      Write(escape, sizeof(escape));
+    } else {
+      Write(c);
+    }
+  }
+  Write('"');
+}
+
+bool TextWriter::Flush() {
+  out_->write(buffer_.data(), size_);
+  size_ = 0;
+  return out_->good();
+}
+}  // namespace vartrace
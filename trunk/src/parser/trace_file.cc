@@ -0,0 +1,247 @@
+/* trace_file.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file trace_file.cc
+  Writing and memory mapped reading of indexed trace files.
+*/
+
+#include <vartrace/trace_file.h>
+#include <vartrace/byte_order.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace vartrace {
+
+namespace {
+//! First bytes of a trace file.
+const char kFileMagic[] = {'V', 'T', 'F', 'I', 'L', 'E', '0', '2'};
+//! Last bytes of a trace file.
+const char kIndexMagic[] = {'V', 'T', 'I', 'N', 'D', 'E', 'X', '2'};
+//! Size of the file header.
+const std::size_t kFileHeaderSize = sizeof(kFileMagic) + 2*sizeof(uint32_t);
+//! Size of the footer that follows the index.
+const std::size_t kFooterSize = 2*sizeof(uint64_t) + sizeof(kIndexMagic);
+//! Alignment of the index.
+const std::size_t kIndexAlignment = sizeof(uint64_t);
+
+static_assert(sizeof(ChunkIndexEntry) == 64,
+              "index entry layout is part of the file format");
+
+//! Index entry of an empty chunk.
+ChunkIndexEntry EmptyEntry(uint64_t offset) {
+  ChunkIndexEntry entry;
+  std::memset(&entry, 0, sizeof(entry));
+  entry.offset = offset;
+  entry.first_timestamp = std::numeric_limits<uint64_t>::max();
+  return entry;
+}
+
+//! Write bytes of a value.
+template <typename T> void WriteRaw(const T &value, std::ofstream *out) {
+  out->write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+}  // unnamed namespace
+
+TraceFileWriter::TraceFileWriter(std::size_t chunk_size)
+    : chunk_size_(chunk_size), file_size_(0) {
+}
+
+TraceFileWriter::~TraceFileWriter() {
+  if (file_.is_open()) {
+    Close();
+  }
+}
+
+bool TraceFileWriter::Open(const std::string &path) {
+  file_.open(path.c_str(), std::ios::binary | std::ios::trunc);
+  file_.write(kFileMagic, sizeof(kFileMagic));
+  WriteRaw(kByteOrderMark, &file_);
+  WriteRaw(static_cast<uint32_t>(0), &file_);
+  file_size_ = kFileHeaderSize;
+  chunk_.clear();
+  index_.clear();
+  entry_ = EmptyEntry(file_size_);
+  unwrapper_ = TimestampUnwrapper();
+  return file_.good();
+}
+
+bool TraceFileWriter::Append(const MessageView &message) {
+  const uint8_t *begin = static_cast<const uint8_t *>(message.message());
+  chunk_.insert(chunk_.end(), begin, begin + message.message_size());
+  ++entry_.message_count;
+  uint64_t timestamp = unwrapper_.Unwrap(message.timestamp());
+  entry_.first_timestamp = std::min(entry_.first_timestamp, timestamp);
+  entry_.last_timestamp = std::max(entry_.last_timestamp, timestamp);
+  int id = message.message_type_id();
+  entry_.message_ids[id >> 6] |= static_cast<uint64_t>(1) << (id & 63);
+  if (chunk_.size() >= chunk_size_) {
+    FlushChunk();
+  }
+  return file_.good();
+}
+
+bool TraceFileWriter::Append(const TraceView &view) {
+  for (MessageIterator pos = view.begin(); pos != view.end(); ++pos) {
+    Append(*pos);
+  }
+  return file_.good();
+}
+
+bool TraceFileWriter::Close() {
+  FlushChunk();
+  const char zeros[kIndexAlignment] = {0};
+  uint64_t index_offset = CEIL_DIV(file_size_, kIndexAlignment)
+      *kIndexAlignment;
+  file_.write(zeros, index_offset - file_size_);
+  file_.write(reinterpret_cast<const char *>(index_.data()),
+              index_.size()*sizeof(ChunkIndexEntry));
+  WriteRaw(index_offset, &file_);
+  WriteRaw(static_cast<uint64_t>(index_.size()), &file_);
+  file_.write(kIndexMagic, sizeof(kIndexMagic));
+  bool is_good = file_.good();
+  file_.close();
+  return is_good;
+}
+
+void TraceFileWriter::FlushChunk() {
+  if (chunk_.empty()) {
+    return;
+  }
+  file_.write(reinterpret_cast<const char *>(chunk_.data()), chunk_.size());
+  entry_.size = chunk_.size();
+  index_.push_back(entry_);
+  file_size_ += chunk_.size();
+  chunk_.clear();
+  entry_ = EmptyEntry(file_size_);
+}
+
+TraceFile::TraceFile()
+    : data_(NULL), size_(0), index_(NULL), chunk_count_(0) {
+}
+
+TraceFile::~TraceFile() {
+  Close();
+}
+
+bool TraceFile::Open(const std::string &path) {
+  Close();
+  int descriptor = open(path.c_str(), O_RDONLY);
+  if (descriptor < 0) {
+    return false;
+  }
+  struct stat status;
+  if (fstat(descriptor, &status) != 0
+      || static_cast<std::size_t>(status.st_size)
+      < kFileHeaderSize + kFooterSize) {
+    close(descriptor);
+    return false;
+  }
+  size_ = status.st_size;
+  void *data = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, descriptor, 0);
+  close(descriptor);
+  if (data == MAP_FAILED) {
+    size_ = 0;
+    return false;
+  }
+  data_ = static_cast<const uint8_t *>(data);
+  uint32_t byte_order_mark;
+  std::memcpy(&byte_order_mark, data_ + sizeof(kFileMagic),
+              sizeof(byte_order_mark));
+  const uint8_t *footer = data_ + size_ - kFooterSize;
+  uint64_t index_offset, chunk_count;
+  std::memcpy(&index_offset, footer, sizeof(index_offset));
+  std::memcpy(&chunk_count, footer + sizeof(index_offset),
+              sizeof(chunk_count));
+  if (std::memcmp(data_, kFileMagic, sizeof(kFileMagic)) != 0
+      || byte_order_mark != kByteOrderMark
+      || std::memcmp(footer + 2*sizeof(uint64_t), kIndexMagic,
+                     sizeof(kIndexMagic)) != 0
+      || index_offset % kIndexAlignment != 0
+      || index_offset > size_ - kFooterSize
+      || chunk_count != (size_ - kFooterSize - index_offset)
+      /sizeof(ChunkIndexEntry)) {
+    Close();
+    return false;
+  }
+  index_ = reinterpret_cast<const ChunkIndexEntry *>(data_ + index_offset);
+  chunk_count_ = chunk_count;
+  for (std::size_t i = 0; i < chunk_count_; ++i) {
+    if (index_[i].offset < kFileHeaderSize
+        || index_[i].offset + index_[i].size > index_offset) {
+      Close();
+      return false;
+    }
+  }
+  return true;
+}
+
+void TraceFile::Close() {
+  if (data_) {
+    munmap(const_cast<uint8_t *>(data_), size_);
+  }
+  data_ = NULL;
+  size_ = 0;
+  index_ = NULL;
+  chunk_count_ = 0;
+}
+
+std::pair<std::size_t, std::size_t> TraceFile::FindChunks(
+    uint64_t first, uint64_t last) const {
+  const ChunkIndexEntry *begin = std::lower_bound(
+      index_, index_ + chunk_count_, first,
+      [](const ChunkIndexEntry &entry, uint64_t timestamp) {
+        return entry.last_timestamp < timestamp;
+      });
+  const ChunkIndexEntry *end = std::upper_bound(
+      begin, index_ + chunk_count_, last,
+      [](uint64_t timestamp, const ChunkIndexEntry &entry) {
+        return timestamp < entry.first_timestamp;
+      });
+  return std::make_pair(begin - index_, end - index_);
+}
+
+std::vector<MessageView> TraceFile::Query(uint64_t first,
+                                          uint64_t last,
+                                          int message_type_id) const {
+  std::vector<MessageView> messages;
+  std::pair<std::size_t, std::size_t> chunks = FindChunks(first, last);
+  for (std::size_t i = chunks.first; i < chunks.second; ++i) {
+    if (message_type_id >= 0 && !index_[i].has_message_id(message_type_id)) {
+      continue;
+    }
+    TraceView view = chunk_view(i);
+    for (MessageIterator pos = view.begin(); pos != view.end(); ++pos) {
+      MessageView message = *pos;
+      uint64_t timestamp = UnwrapTimestamp(i, message);
+      if (timestamp >= first && timestamp <= last
+          && (message_type_id < 0
+              || message.message_type_id() == message_type_id)) {
+        messages.push_back(message);
+      }
+    }
+  }
+  return messages;
+}
+}  // namespace vartrace
@@ -0,0 +1,165 @@
+/* trace_stats.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file trace_stats.cc
+  Histograms, path statistics and folded stacks.
+*/
+
+#include <vartrace/trace_stats.h>
+#include <vartrace/type_codes.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace vartrace {
+
+Histogram::Histogram(int sub_bucket_bits)
+    : sub_bucket_bits_(sub_bucket_bits),
+      sub_bucket_count_(static_cast<uint64_t>(1) << sub_bucket_bits),
+      count_(0), min_(0), max_(0), sum_(0) {
+}
+
+uint64_t Histogram::Percentile(double fraction) const {
+  uint64_t rank = static_cast<uint64_t>(std::ceil(fraction*count_));
+  rank = std::max<uint64_t>(rank, 1);
+  uint64_t seen = 0;
+  for (std::size_t i = 0; i < counts_.size(); ++i) {
+    seen += counts_[i];
+    if (seen >= rank) {
+      return std::min(BucketMax(i), max_);
+    }
+  }
+  return max_;
+}
+
+bool Histogram::Add(const Histogram &other) {
+  if (other.sub_bucket_bits_ != sub_bucket_bits_) {
+    return false;
+  }
+  if (!other.count_) {
+    return true;
+  }
+  if (other.counts_.size() > counts_.size()) {
+    counts_.resize(other.counts_.size());
+  }
+  for (std::size_t i = 0; i < other.counts_.size(); ++i) {
+    counts_[i] += other.counts_[i];
+  }
+  min_ = count_ ? std::min(min_, other.min_) : other.min_;
+  max_ = std::max(max_, other.max_);
+  count_ += other.count_;
+  sum_ += other.sum_;
+  return true;
+}
+
+uint64_t Histogram::BucketMax(std::size_t index) const {
+  if (index < sub_bucket_count_) {
+    return index;
+  }
+  uint64_t half_count = sub_bucket_count_ >> 1;
+  int shift = index/half_count - 1;
+  uint64_t sub_bucket = index - shift*half_count;
+  return ((sub_bucket + 1) << shift) - 1;
+}
+
+TraceStats::TraceStats() : time_(0), first_time_(0), message_count_(0) {}
+
+void TraceStats::OnMessage(const MessageView &message) {
+  Count(message, false);
+}
+
+void TraceStats::OnSubtraceBegin(const MessageView &subtrace) {
+  Count(subtrace, true);
+  key_.push_back(subtrace.message_type_id());
+}
+
+void TraceStats::OnSubtraceEnd(const MessageView &subtrace) {
+  key_.resize(key_.size() - 1);
+}
+
+bool TraceStats::WriteFolded(FoldedWeight weight, std::ostream *out) const {
+  for (std::size_t i = 0; i < paths_.size(); ++i) {
+    const PathStats &row = paths_[i];
+    uint64_t value = 0;
+    if (!row.is_subtrace) {
+      switch (weight) {
+        case kFoldedTime:
+          value = row.durations.sum();
+          break;
+        case kFoldedCount:
+          value = row.count;
+          break;
+        case kFoldedBytes:
+          value = row.size;
+          break;
+      }
+    }
+    if (!value) {
+      continue;
+    }
+    for (std::size_t j = 0; j < row.path.size(); ++j) {
+      *out << (j ? ";" : "") << static_cast<unsigned>(row.path[j]);
+    }
+    *out << ' ' << value << '\n';
+  }
+  return out->good();
+}
+
+void TraceStats::Count(const MessageView &message, bool is_subtrace) {
+  if (!message.is_nested()) {
+    time_ = unwrapper_.Unwrap(message.timestamp());
+    if (!message_count_) {
+      first_time_ = time_;
+    }
+    if (message.data_type_id() == kTypeIdByteOrderMark) {
+      return;
+    }
+  }
+  ++message_count_;
+  key_.push_back(message.message_type_id());
+  key_.push_back(is_subtrace);
+  std::unordered_map<std::string, std::size_t>::iterator found =
+      indices_.find(key_);
+  if (found == indices_.end()) {
+    found = indices_.insert(std::make_pair(key_, paths_.size())).first;
+    paths_.push_back(PathStats());
+    PathStats &row = paths_.back();
+    row.path.assign(key_.begin(), key_.end() - 1);
+    row.is_subtrace = is_subtrace;
+    row.first_time = time_;
+  }
+  key_.resize(key_.size() - 2);
+  PathStats &row = paths_[found->second];
+  if (row.count) {
+    // span records carry start times and may be out of order
+    row.intervals.Record(time_ > row.last_time ? time_ - row.last_time : 0);
+  }
+  ++row.count;
+  row.last_time = time_;
+  if (is_subtrace) {
+    // children have rows of their own
+    row.size += message.header_size();
+  } else {
+    row.size += message.message_size();
+    if (message.data_type_id() == kTypeIdSpan
+        && message.data_size() == sizeof(TimestampType)) {
+      row.durations.Record(message.value<TimestampType>());
+    }
+  }
+}
+}  // namespace vartrace
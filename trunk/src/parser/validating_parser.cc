@@ -0,0 +1,265 @@
+/* validating_parser.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file validating_parser.cc
+  Implementation of header validation and resynchronization.
+*/
+
+#include <vartrace/validating_parser.h>
+#include <vartrace/type_codes.h>
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace vartrace {
+
+namespace {
+//! Size of a word in bytes.
+const std::size_t kWordSize = sizeof(AlignmentType);
+//! Size of a top level header in bytes.
+const std::size_t kHeaderBytes = kHeaderLength*kWordSize;
+//! Size of a nested header in bytes.
+const std::size_t kNestedHeaderBytes = kNestedHeaderLength*kWordSize;
+//! Mask of the size field of a description word.
+const AlignmentType kSizeMask = static_cast<LengthType>(~0);
+//! Mask of the id fields of a description word.
+const AlignmentType kIdMask = static_cast<MessageIdType>(~0);
+
+//! True if type id is listed in type_codes.h.
+bool IsKnownType(int data_type_id) {
+  switch (data_type_id) {
+    case kTypeIdInt8:
+    case kTypeIdUint8:
+    case kTypeIdInt16:
+    case kTypeIdUint16:
+    case kTypeIdInt32:
+    case kTypeIdUint32:
+    case kTypeIdInt64:
+    case kTypeIdUint64:
+    case kTypeIdFloat:
+    case kTypeIdDouble:
+    case kTypeIdChar:
+    case kTypeIdByteOrderMark:
+    case kTypeIdSpan:
+    case kTypeIdCounters:
+      return true;
+    default:
+      return false;
+  }
+}
+
+//! Check fields of a header that has left bytes available.
+bool IsValidHeader(const MessageView &message, std::size_t left,
+                   const ValidationOptions &options) {
+  if (left < static_cast<std::size_t>(message.message_size())
+      || message.message_type_id() > options.max_message_type_id) {
+    return false;
+  }
+  int data_type_id = message.data_type_id();
+  if (data_type_id == 0) {
+    return message.data_size() % kWordSize == 0;
+  }
+  if (options.known_types_only && !IsKnownType(data_type_id)) {
+    return false;
+  }
+  return message.data_size() % ElementSize(data_type_id) == 0;
+}
+
+//! True if children are valid and fill the subtrace exactly.
+bool IsValidChildren(const MessageView &message,
+                     const ValidationOptions &options) {
+  const uint8_t *position = static_cast<const uint8_t *>(message.data());
+  const uint8_t *end = position + message.data_size();
+  while (position != end) {
+    if (!IsValidMessage(position, end, true, options)) {
+      return false;
+    }
+    position += MessageView(position, true).message_size();
+  }
+  return true;
+}
+
+//! Cheap test of a description word, passes every valid header.
+/*! Zero word is rejected too, it is more likely to come from cleared
+  memory than from an empty subtrace with id 0.
+ */
+bool IsCandidate(AlignmentType description, std::size_t left,
+                 const ValidationOptions &options) {
+  AlignmentType size = description & kSizeMask;
+  int message_type_id = (description >> kMessageIdShift) & kIdMask;
+  int data_type_id = (description >> kDataIdShift) & kIdMask;
+  return description != 0 && size <= left - kHeaderBytes
+      && message_type_id <= options.max_message_type_id
+      && (data_type_id != 0 || size % kWordSize == 0);
+}
+
+//! First position that may start a top level message, end if none.
+const uint8_t *FindCandidate(const uint8_t *position, const uint8_t *end,
+                             const ValidationOptions &options) {
+#ifdef __SSE2__
+  const __m128i size_mask = _mm_set1_epi32(kSizeMask);
+  const __m128i id_mask = _mm_set1_epi32(kIdMask);
+  const __m128i low_bits = _mm_set1_epi32(kWordSize - 1);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i max_id = _mm_set1_epi32(options.max_message_type_id);
+  // description words of four consecutive candidates
+  while (static_cast<std::size_t>(end - position)
+         >= kHeaderBytes + 3*kWordSize) {
+    // limit of the first candidate, so no valid header is missed
+    std::size_t left = std::min<std::size_t>(end - position - kHeaderBytes,
+                                             kSizeMask);
+    __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i *>(
+        position + kHeaderBytes - kWordSize));
+    __m128i sizes = _mm_and_si128(words, size_mask);
+    __m128i bad = _mm_or_si128(_mm_cmpgt_epi32(sizes, _mm_set1_epi32(left)),
+                               _mm_cmpeq_epi32(words, zero));
+    __m128i ids = _mm_and_si128(_mm_srli_epi32(words, kMessageIdShift),
+                                id_mask);
+    bad = _mm_or_si128(bad, _mm_cmpgt_epi32(ids, max_id));
+    __m128i is_subtrace = _mm_cmpeq_epi32(
+        _mm_and_si128(_mm_srli_epi32(words, kDataIdShift), id_mask), zero);
+    __m128i is_aligned = _mm_cmpeq_epi32(_mm_and_si128(sizes, low_bits),
+                                         zero);
+    bad = _mm_or_si128(bad, _mm_andnot_si128(is_aligned, is_subtrace));
+    int good = ~_mm_movemask_ps(_mm_castsi128_ps(bad)) & 0xf;
+    if (good) {
+      for (int i = 0; ; ++i, position += kWordSize) {
+        if (good & (1 << i)) {
+          return position;
+        }
+      }
+    }
+    position += 4*kWordSize;
+  }
+#endif
+  while (static_cast<std::size_t>(end - position) >= kHeaderBytes) {
+    AlignmentType description;
+    std::memcpy(&description, position + kHeaderBytes - kWordSize,
+                sizeof(description));
+    if (IsCandidate(description, end - position, options)) {
+      return position;
+    }
+    position += kWordSize;
+  }
+  return end;
+}
+
+//! True if a number of valid messages can be decoded from position.
+bool IsValidChain(const uint8_t *position, const uint8_t *end,
+                  TimestampType previous_timestamp,
+                  const ValidationOptions &options) {
+  for (unsigned i = 0; i < options.chain_length; ++i) {
+    if (position == end) {
+      return i != 0;
+    }
+    if (!IsValidMessage(position, end, false, options)) {
+      return false;
+    }
+    MessageView message(position, false);
+    if (options.ordered_timestamps
+        && message.timestamp() < previous_timestamp) {
+      return false;
+    }
+    previous_timestamp = message.timestamp();
+    position += message.message_size();
+  }
+  return true;
+}
+
+//! First position after which messages are valid again, end if none.
+const uint8_t *Resync(const uint8_t *position, const uint8_t *end,
+                      TimestampType previous_timestamp,
+                      const ValidationOptions &options) {
+  for (position = FindCandidate(position, end, options); position != end;
+       position = FindCandidate(position + kWordSize, end, options)) {
+    if (IsValidChain(position, end, previous_timestamp, options)) {
+      return position;
+    }
+  }
+  return end;
+}
+}  // unnamed namespace
+
+std::size_t ElementSize(int data_type_id) {
+  switch (data_type_id) {
+    case kTypeIdInt16:
+    case kTypeIdUint16:
+      return 2;
+    case kTypeIdInt32:
+    case kTypeIdUint32:
+    case kTypeIdFloat:
+    case kTypeIdSpan:
+    case kTypeIdByteOrderMark:
+      return 4;
+    case kTypeIdInt64:
+    case kTypeIdUint64:
+    case kTypeIdDouble:
+    case kTypeIdCounters:
+      return 8;
+    default:
+      return 1;
+  }
+}
+
+bool IsValidMessage(const void *position, const void *end, bool is_nested,
+                    const ValidationOptions &options) {
+  std::size_t left = static_cast<const uint8_t *>(end)
+      - static_cast<const uint8_t *>(position);
+  if (left < (is_nested ? kNestedHeaderBytes : kHeaderBytes)) {
+    return false;
+  }
+  MessageView message(position, is_nested);
+  return IsValidHeader(message, left, options)
+      && (message.data_type_id() != 0 || IsValidChildren(message, options));
+}
+
+std::vector<MessageView> ValidatingParse(
+    const TraceView &view, std::vector<SkippedRange> *skipped_ranges,
+    const ValidationOptions &options) {
+  const uint8_t *begin = static_cast<const uint8_t *>(view.data());
+  const uint8_t *end = view.end().position();
+  std::vector<MessageView> messages;
+  TimestampType previous_timestamp = 0;
+  const uint8_t *position = begin;
+  while (position != end) {
+    if (IsValidMessage(position, end, false, options)) {
+      MessageView message(position, false);
+      if (!options.ordered_timestamps
+          || message.timestamp() >= previous_timestamp) {
+        previous_timestamp = message.timestamp();
+        messages.push_back(message);
+        position += message.message_size();
+        continue;
+      }
+    }
+    const uint8_t *next = Resync(std::min(position + kWordSize, end), end,
+                                 previous_timestamp, options);
+    if (skipped_ranges) {
+      SkippedRange range = {static_cast<std::size_t>(position - begin),
+                            static_cast<std::size_t>(next - position)};
+      skipped_ranges->push_back(range);
+    }
+    position = next;
+  }
+  return messages;
+}
+}  // namespace vartrace
@@ -0,0 +1,90 @@
+/* dump_file.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file dump_file.cc
+  Implementation of dump file loading.
+*/
+
+#include "dump_file.h"
+
+#include <vartrace/byte_order.h>
+#include <vartrace/validating_parser.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <iostream>
+
+using std::cerr;
+using std::endl;
+
+namespace vartrace {
+
+DumpFile::~DumpFile() {
+  if (data_) {
+    munmap(data_, size_);
+  }
+}
+
+bool DumpFile::Read(const std::string &path) {
+  path_ = path;
+  int descriptor = open(path.c_str(), O_RDONLY);
+  struct stat status;
+  if (descriptor < 0 || fstat(descriptor, &status) != 0) {
+    cerr << "ERROR: " << path << " cannot be opened" << endl;
+    if (descriptor >= 0) {
+      close(descriptor);
+    }
+    return false;
+  }
+  if (data_) {
+    munmap(data_, size_);
+  }
+  data_ = NULL;
+  size_ = status.st_size;
+  if (size_ > 0) {
+    // pages are copied only if the dump is converted
+    data_ = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                 descriptor, 0);
+  }
+  close(descriptor);
+  if (data_ == MAP_FAILED) {
+    data_ = NULL;
+    size_ = 0;
+    cerr << "ERROR: " << path << " cannot be read" << endl;
+    return false;
+  }
+  if (ToNativeByteOrder(data_, size_) == kSwappedByteOrder) {
+    cerr << path << ": converted from foreign byte order" << endl;
+  }
+  return true;
+}
+
+std::vector<MessageView> DumpFile::Parse() const {
+  std::vector<SkippedRange> skipped_ranges;
+  std::vector<MessageView> messages = ValidatingParse(view(),
+                                                      &skipped_ranges);
+  for (std::size_t i = 0; i < skipped_ranges.size(); ++i) {
+    cerr << path_ << ": skipped " << skipped_ranges[i].size
+         << " damaged bytes at offset " << skipped_ranges[i].offset << endl;
+  }
+  return messages;
+}
+}  // namespace vartrace
@@ -0,0 +1,66 @@
+/* dump_file.h
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file dump_file.h
+  Loading of dump files shared by command line utilities.
+*/
+
+#ifndef TRUNK_SRC_TOOLS_DUMP_FILE_H_
+#define TRUNK_SRC_TOOLS_DUMP_FILE_H_
+
+#include <vartrace/message_view.h>
+
+#include <string>
+#include <vector>
+
+namespace vartrace {
+
+//! Memory mapped dump converted to native byte order.
+/*! The mapping is private, a dump in foreign byte order is converted
+  in place without changing the file.
+ */
+class DumpFile {
+ public:
+  //! Empty dump.
+  DumpFile() : data_(NULL), size_(0) {}
+  //! Unmap the file.
+  ~DumpFile();
+
+  //! Map file, return false and print error if it can not be read.
+  bool Read(const std::string &path);
+  //! Decode valid top level messages, print skipped ranges to stderr.
+  std::vector<MessageView> Parse() const;
+
+  //! Range of all bytes of the dump.
+  TraceView view() const {return TraceView(data_, size_);}
+  //! Size of the dump in bytes.
+  std::size_t size() const {return size_;}
+
+ private:
+  //! Dumps can not be copied.
+  DumpFile(const DumpFile &);
+  //! Dumps can not be copied.
+  DumpFile &operator=(const DumpFile &);
+
+  void *data_; //!< Mapped file.
+  std::size_t size_; //!< Size of the dump in bytes.
+  std::string path_; //!< File name used in messages.
+};
+}  // namespace vartrace
+
+#endif  // TRUNK_SRC_TOOLS_DUMP_FILE_H_
@@ -0,0 +1,230 @@
+/* message_format.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file message_format.cc
+  Implementation of message printing.
+*/
+
+#include "message_format.h"
+
+#include <vartrace/columnar.h>
+#include <vartrace/type_codes.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+namespace vartrace {
+
+namespace {
+//! Print a number with the fastest formatting for its type.
+inline void WriteValue(int64_t value, TextWriter *writer) {
+  writer->WriteSigned(value);
+}
+inline void WriteValue(uint64_t value, TextWriter *writer) {
+  writer->WriteUnsigned(value);
+}
+inline void WriteValue(float value, TextWriter *writer) {
+  writer->WriteFloat(value);
+}
+inline void WriteValue(double value, TextWriter *writer) {
+  writer->WriteDouble(value);
+}
+
+//! Print array elements of given type.
+/*! Printed is the type used for formatting. Text values are preceded
+  by spaces, JSON values are separated by commas and non finite values
+  are printed as null.
+ */
+template <typename T, typename Printed>
+void WriteValues(const MessageView &message, bool is_json,
+                 TextWriter *writer) {
+  const uint8_t *data = static_cast<const uint8_t *>(message.data());
+  std::size_t count = message.data_size()/sizeof(T);
+  for (std::size_t i = 0; i < count; ++i) {
+    T value;
+    std::memcpy(&value, data + i*sizeof(T), sizeof(value));
+    if (!is_json) {
+      writer->Write(' ');
+    } else if (i) {
+      writer->Write(',');
+    }
+    if (is_json && !std::isfinite(static_cast<double>(value))) {
+      writer->Write("null");
+    } else {
+      WriteValue(static_cast<Printed>(value), writer);
+    }
+  }
+}
+
+//! Names of data types indexed by type id, computed once.
+class TypeNames {
+ public:
+  //! Names of standard types, numbers for other types.
+  TypeNames() : names_(0x100) {
+    for (int i = 0; i < 0x100; ++i) {
+      names_[i] = i == 0 ? "subtrace" : DataTypeName(i);
+      is_numeric_[i] = i != kTypeIdChar && !names_[i].empty();
+      if (names_[i].empty()) {
+        std::ostringstream number;
+        number << i;
+        names_[i] = number.str();
+      }
+    }
+  }
+
+  //! Name of the type or its number.
+  const std::string &name(int data_type_id) const {
+    return names_[data_type_id];
+  }
+  //! True if the data type is a standard numeric type.
+  bool is_numeric(int data_type_id) const {
+    return is_numeric_[data_type_id];
+  }
+
+ private:
+  std::vector<std::string> names_; //!< Name of every type id.
+  bool is_numeric_[0x100]; //!< Numeric flag of every type id.
+};
+
+//! Names shared by all printing functions.
+const TypeNames &GetTypeNames() {
+  static const TypeNames names;
+  return names;
+}
+
+//! Print values of a standard numeric type.
+void WriteArray(const MessageView &message, bool is_json,
+                TextWriter *writer) {
+  switch (message.data_type_id()) {
+    case kTypeIdInt8:
+      WriteValues<int8_t, int64_t>(message, is_json, writer);
+      break;
+    case kTypeIdUint8:
+      WriteValues<uint8_t, uint64_t>(message, is_json, writer);
+      break;
+    case kTypeIdInt16:
+      WriteValues<int16_t, int64_t>(message, is_json, writer);
+      break;
+    case kTypeIdUint16:
+      WriteValues<uint16_t, uint64_t>(message, is_json, writer);
+      break;
+    case kTypeIdInt32:
+      WriteValues<int32_t, int64_t>(message, is_json, writer);
+      break;
+    case kTypeIdUint32:
+    case kTypeIdSpan:
+      WriteValues<uint32_t, uint64_t>(message, is_json, writer);
+      break;
+    case kTypeIdInt64:
+      WriteValues<int64_t, int64_t>(message, is_json, writer);
+      break;
+    case kTypeIdUint64:
+    case kTypeIdCounters:
+      WriteValues<uint64_t, uint64_t>(message, is_json, writer);
+      break;
+    case kTypeIdFloat:
+      WriteValues<float, float>(message, is_json, writer);
+      break;
+    case kTypeIdDouble:
+      WriteValues<double, double>(message, is_json, writer);
+      break;
+  }
+}
+
+//! Length of a string without the terminating zeros.
+std::size_t StringSize(const MessageView &message) {
+  const char *text = static_cast<const char *>(message.data());
+  const void *zero = std::memchr(text, 0, message.data_size());
+  return zero ? static_cast<const char *>(zero) - text : message.data_size();
+}
+
+}  // unnamed namespace
+
+int ParseDataType(const std::string &text) {
+  for (int i = 1; i < 0x100; ++i) {
+    if (DataTypeName(i) == text) {
+      return i;
+    }
+  }
+  char *end;
+  long type = std::strtol(text.c_str(), &end, 0);
+  return (*end || end == text.c_str() || type < 0 || type > 0xff) ? -1 : type;
+}
+
+void PrintText(TimestampType timestamp,
+               const std::vector<MessageIdType> &path,
+               const MessageView &message, TextWriter *writer) {
+  writer->WriteUnsigned(timestamp);
+  writer->Write(' ');
+  for (std::size_t i = 0; i < path.size(); ++i) {
+    writer->WriteUnsigned(path[i]);
+    writer->Write('/');
+  }
+  writer->WriteUnsigned(message.message_type_id());
+  writer->Write(' ');
+  const TypeNames &names = GetTypeNames();
+  writer->Write(names.name(message.data_type_id()));
+  if (message.data_type_id() == kTypeIdChar) {
+    writer->Write(' ');
+    writer->Write(static_cast<const char *>(message.data()),
+                  StringSize(message));
+  } else if (names.is_numeric(message.data_type_id())) {
+    WriteArray(message, false, writer);
+  } else {
+    writer->Write(' ');
+    writer->WriteUnsigned(message.data_size());
+    writer->Write(" bytes");
+  }
+  writer->Write('\n');
+}
+
+void PrintJson(TimestampType timestamp,
+               const std::vector<MessageIdType> &path,
+               const MessageView &message, TextWriter *writer) {
+  writer->Write("{\"timestamp\":");
+  writer->WriteUnsigned(timestamp);
+  writer->Write(",\"path\":[");
+  for (std::size_t i = 0; i < path.size(); ++i) {
+    if (i) {
+      writer->Write(',');
+    }
+    writer->WriteUnsigned(path[i]);
+  }
+  writer->Write("],\"id\":");
+  writer->WriteUnsigned(message.message_type_id());
+  writer->Write(",\"type\":\"");
+  const TypeNames &names = GetTypeNames();
+  writer->Write(names.name(message.data_type_id()));
+  writer->Write('"');
+  if (message.data_type_id() == kTypeIdChar) {
+    writer->Write(",\"value\":");
+    writer->WriteJsonString(static_cast<const char *>(message.data()),
+                            StringSize(message));
+  } else if (names.is_numeric(message.data_type_id())) {
+    writer->Write(",\"values\":[");
+    WriteArray(message, true, writer);
+    writer->Write(']');
+  } else {
+    writer->Write(",\"size\":");
+    writer->WriteUnsigned(message.data_size());
+  }
+  writer->Write("}\n");
+}
+}  // namespace vartrace
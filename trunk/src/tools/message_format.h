@@ -0,0 +1,65 @@
+/* message_format.h
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file message_format.h
+  Text and JSON lines printing of messages shared by utilities.
+
+  A text line holds the top level timestamp, the path of the message
+  as slash separated ids, the data type name and the values:
+
+  \code
+  1005 7/3/42 double 2.5
+  \endcode
+
+  A JSON line holds the same fields:
+
+  \code
+  {"timestamp":1005,"path":[7,3],"id":42,"type":"double","values":[2.5]}
+  \endcode
+
+  Strings are printed as a value, other types are printed as their
+  size in bytes.
+*/
+
+#ifndef TRUNK_SRC_TOOLS_MESSAGE_FORMAT_H_
+#define TRUNK_SRC_TOOLS_MESSAGE_FORMAT_H_
+
+#include <vartrace/message_view.h>
+#include <vartrace/text_writer.h>
+#include <vartrace/tracetypes.h>
+
+#include <string>
+#include <vector>
+
+namespace vartrace {
+
+//! Convert data type name or number to type id, -1 if it is unknown.
+int ParseDataType(const std::string &text);
+
+//! Print message as a line of text.
+void PrintText(TimestampType timestamp,
+               const std::vector<MessageIdType> &path,
+               const MessageView &message, TextWriter *writer);
+
+//! Print message as a JSON line.
+void PrintJson(TimestampType timestamp,
+               const std::vector<MessageIdType> &path,
+               const MessageView &message, TextWriter *writer);
+}  // namespace vartrace
+
+#endif  // TRUNK_SRC_TOOLS_MESSAGE_FORMAT_H_
@@ -0,0 +1,152 @@
+/* vartrace_chrome_trace.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file vartrace_chrome_trace.cc
+  Utility that converts a dump into Chrome trace event JSON, see
+  chrome_trace.h.
+*/
+
+#include <boost/program_options.hpp>
+
+#include <vartrace/chrome_trace.h>
+
+#include "dump_file.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+namespace po = boost::program_options;
+
+//! Define and parse command line arguments, process help option.
+po::variables_map parse_commandline(int argc, char *argv[]) {
+  po::options_description desc(
+      "Convert a vartrace dump into Chrome trace event JSON\n"
+      "Usage: vartrace-chrome-trace [options] dump");
+  desc.add_options()
+      ("help,h", "produce help message")
+      ("dump", po::value<std::string>(), "dump file")
+      ("output,o", po::value<std::string>()->default_value("-"),
+       "JSON file, - writes to standard output")
+      ("ticks-per-us", po::value<double>()->default_value(1),
+       "timestamp ticks per microsecond")
+      ("span", po::value<std::vector<std::string> >(),
+       "ids of messages that begin and end a span as begin:end, "
+       "may be repeated")
+      ("object", "write object with traceEvents instead of array")
+      ("name", po::value<std::string>(), "process name")
+      ("pid", po::value<int>()->default_value(1), "process id of events")
+      ("tid", po::value<int>()->default_value(1), "thread id of events");
+  po::positional_options_description positional;
+  positional.add("dump", 1);
+  po::variables_map args;
+  po::store(po::command_line_parser(argc, argv).options(desc)
+            .positional(positional).run(), args);
+  po::notify(args);
+  if (args.count("help") || !args.count("dump")) {
+    cout << desc << endl;
+  }
+  return args;
+}
+
+//! Convert pair of ids like "10:11" into a span.
+bool parse_span(const std::string &text,
+                std::pair<vartrace::MessageIdType,
+                vartrace::MessageIdType> *span) {
+  std::size_t colon = text.find(':');
+  if (colon == std::string::npos) {
+    return false;
+  }
+  char *end;
+  unsigned long begin_id = std::strtoul(text.c_str(), &end, 0);
+  if (end != text.c_str() + colon || begin_id > 0xff) {
+    return false;
+  }
+  unsigned long end_id = std::strtoul(text.c_str() + colon + 1, &end, 0);
+  if (*end || end == text.c_str() + colon + 1 || end_id > 0xff) {
+    return false;
+  }
+  span->first = begin_id;
+  span->second = end_id;
+  return true;
+}
+
+//! Read dump and write its messages as trace events.
+int main(int argc, char *argv[]) {
+  po::variables_map args = parse_commandline(argc, argv);
+  if (args.count("help") || !args.count("dump")) {
+    return args.count("help") ? 0 : 1;
+  }
+  vartrace::ChromeTraceOptions options;
+  options.ticks_per_microsecond = args["ticks-per-us"].as<double>();
+  if (!(options.ticks_per_microsecond > 0)) {
+    cerr << "ERROR: tick rate must be positive" << endl;
+    return 1;
+  }
+  if (args.count("object")) {
+    options.format = vartrace::kChromeObjectFormat;
+  }
+  options.process_id = args["pid"].as<int>();
+  options.thread_id = args["tid"].as<int>();
+  if (args.count("name")) {
+    options.process_name = args["name"].as<std::string>();
+  }
+  if (args.count("span")) {
+    const std::vector<std::string> &spans =
+        args["span"].as<std::vector<std::string> >();
+    options.spans.resize(spans.size());
+    for (std::size_t i = 0; i < spans.size(); ++i) {
+      if (!parse_span(spans[i], &options.spans[i])) {
+        cerr << "ERROR: bad span " << spans[i] << endl;
+        return 1;
+      }
+    }
+  }
+  vartrace::DumpFile dump;
+  if (!dump.Read(args["dump"].as<std::string>())) {
+    return 1;
+  }
+  std::vector<vartrace::MessageView> messages = dump.Parse();
+  std::string output = args["output"].as<std::string>();
+  std::ofstream file;
+  if (output != "-") {
+    file.open(output.c_str(), std::ios::binary | std::ios::trunc);
+    if (!file) {
+      cerr << "ERROR: " << output << " cannot be created" << endl;
+      return 1;
+    }
+  }
+  std::ios::sync_with_stdio(false);
+  vartrace::ChromeTraceWriter writer(options, output == "-" ? &cout : &file);
+  for (std::size_t i = 0; i < messages.size(); ++i) {
+    vartrace::VisitMessages(vartrace::TraceView(messages[i].message(),
+                                                messages[i].message_size()),
+                            &writer);
+  }
+  if (!writer.Finish()) {
+    cerr << "ERROR: " << output << " cannot be written" << endl;
+    return 1;
+  }
+  return 0;
+}
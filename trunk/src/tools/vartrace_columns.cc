@@ -0,0 +1,113 @@
+/* vartrace_columns.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file vartrace_columns.cc
+  Utility that exports values of a dump as columns, see columnar.h.
+*/
+
+#include <boost/program_options.hpp>
+
+#include <vartrace/columnar.h>
+
+#include "dump_file.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+namespace po = boost::program_options;
+
+//! Define and parse command line arguments, process help option.
+po::variables_map parse_commandline(int argc, char *argv[]) {
+  po::options_description desc(
+      "Export values of a vartrace dump as columns\n"
+      "Usage: vartrace-columns [options] dump");
+  desc.add_options()
+      ("help,h", "produce help message")
+      ("dump", po::value<std::string>(), "dump file")
+      ("output,o", po::value<std::string>(), "binary column file")
+      ("csv,c", po::value<std::string>(), "CSV file, - for stdout")
+      ("list,l", "print column names and sizes");
+  po::positional_options_description positional;
+  positional.add("dump", 1);
+  po::variables_map args;
+  po::store(po::command_line_parser(argc, argv).options(desc)
+            .positional(positional).run(), args);
+  po::notify(args);
+  if (args.count("help") || !args.count("dump")) {
+    cout << desc << endl;
+  }
+  return args;
+}
+
+//! Write columns to a file with given writer.
+bool write_file(const std::string &path,
+                const std::vector<vartrace::Column> &columns,
+                bool (*writer)(const std::vector<vartrace::Column> &,
+                               std::ostream *)) {
+  if (path == "-") {
+    return writer(columns, &cout);
+  }
+  std::ofstream file(path.c_str(), std::ios::trunc | std::ios::binary);
+  if (!file || !writer(columns, &file)) {
+    cerr << "ERROR: " << path << " cannot be written" << endl;
+    return false;
+  }
+  return true;
+}
+
+//! Read dump, extract columns and write them.
+int main(int argc, char *argv[]) {
+  po::variables_map args = parse_commandline(argc, argv);
+  if (args.count("help") || !args.count("dump")) {
+    return args.count("help") ? 0 : 1;
+  }
+  vartrace::DumpFile dump;
+  if (!dump.Read(args["dump"].as<std::string>())) {
+    return 1;
+  }
+  std::vector<vartrace::MessageView> messages = dump.Parse();
+  vartrace::ColumnBuilder builder;
+  for (std::size_t i = 0; i < messages.size(); ++i) {
+    builder.Add(messages[i]);
+  }
+  const std::vector<vartrace::Column> &columns = builder.columns();
+  if (args.count("list")) {
+    for (std::size_t i = 0; i < columns.size(); ++i) {
+      cout << columns[i].name << " " << columns[i].size() << endl;
+    }
+    if (builder.skipped_count()) {
+      cout << builder.skipped_count() << " messages of other types" << endl;
+    }
+  }
+  if (args.count("output")
+      && !write_file(args["output"].as<std::string>(), columns,
+                     vartrace::WriteColumnFile)) {
+    return 1;
+  }
+  if (args.count("csv")
+      && !write_file(args["csv"].as<std::string>(), columns,
+                     vartrace::WriteColumnsCsv)) {
+    return 1;
+  }
+  return 0;
+}
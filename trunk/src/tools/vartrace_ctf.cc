@@ -0,0 +1,170 @@
+/* vartrace_ctf.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file vartrace_ctf.cc
+  Utility that converts dumps into a CTF trace directory, see ctf.h.
+*/
+
+#include <boost/program_options.hpp>
+
+#include <vartrace/ctf.h>
+
+#include "dump_file.h"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+namespace po = boost::program_options;
+
+//! Define and parse command line arguments, process help option.
+po::variables_map parse_commandline(int argc, char *argv[]) {
+  po::options_description desc(
+      "Convert vartrace dumps into a Common Trace Format directory\n"
+      "Usage: vartrace-ctf [options] -o directory dump...");
+  desc.add_options()
+      ("help,h", "produce help message")
+      ("dumps", po::value<std::vector<std::string> >(),
+       "dump files in time order")
+      ("output,o", po::value<std::string>(), "trace directory")
+      ("frequency", po::value<uint64_t>()->default_value(1000000000),
+       "timestamp ticks per second")
+      ("offset-s", po::value<int64_t>()->default_value(0),
+       "seconds from epoch to timestamp 0")
+      ("offset", po::value<uint64_t>()->default_value(0),
+       "ticks added to the offset in seconds")
+      ("packet-size", po::value<std::size_t>()->default_value(
+          vartrace::kDefaultCtfPacketSize), "packet size in bytes")
+      ("user-type", po::value<std::vector<std::string> >(),
+       "user type as id:name or id:name:size:fields, e.g. "
+       "\"0x20:point:16:float64_t x; float64_t y;\", may be repeated");
+  po::positional_options_description positional;
+  positional.add("dumps", -1);
+  po::variables_map args;
+  po::store(po::command_line_parser(argc, argv).options(desc)
+            .positional(positional).run(), args);
+  po::notify(args);
+  if (args.count("help") || !args.count("dumps") || !args.count("output")) {
+    cout << desc << endl;
+  }
+  return args;
+}
+
+//! Convert description like "0x20:point:16:float64_t x; float64_t y;".
+bool parse_user_type(const std::string &text, vartrace::CtfUserType *type) {
+  std::size_t name_begin = text.find(':');
+  if (name_begin == std::string::npos) {
+    return false;
+  }
+  char *end;
+  type->data_type_id = std::strtol(text.c_str(), &end, 0);
+  if (end != text.c_str() + name_begin || type->data_type_id <= 0
+      || type->data_type_id > 0xff) {
+    return false;
+  }
+  std::size_t name_end = text.find(':', ++name_begin);
+  type->name = text.substr(name_begin, name_end - name_begin);
+  if (type->name.empty()) {
+    return false;
+  }
+  if (name_end == std::string::npos) {
+    return true;
+  }
+  std::size_t size_end = text.find(':', ++name_end);
+  if (size_end == std::string::npos) {
+    return false;
+  }
+  type->element_size = std::strtoul(text.c_str() + name_end, &end, 0);
+  type->fields = text.substr(size_end + 1);
+  return end == text.c_str() + size_end && type->element_size > 0
+      && !type->fields.empty();
+}
+
+//! Write events of all dumps into the stream and the metadata file.
+int main(int argc, char *argv[]) {
+  po::variables_map args = parse_commandline(argc, argv);
+  if (args.count("help") || !args.count("dumps") || !args.count("output")) {
+    return args.count("help") ? 0 : 1;
+  }
+  vartrace::CtfOptions options;
+  options.clock_frequency = args["frequency"].as<uint64_t>();
+  options.clock_offset_seconds = args["offset-s"].as<int64_t>();
+  options.clock_offset = args["offset"].as<uint64_t>();
+  options.packet_size = args["packet-size"].as<std::size_t>();
+  if (args.count("user-type")) {
+    const std::vector<std::string> &types =
+        args["user-type"].as<std::vector<std::string> >();
+    options.user_types.resize(types.size());
+    for (std::size_t i = 0; i < types.size(); ++i) {
+      if (!parse_user_type(types[i], &options.user_types[i])) {
+        cerr << "ERROR: bad user type " << types[i] << endl;
+        return 1;
+      }
+    }
+  }
+  std::string output = args["output"].as<std::string>();
+  if (mkdir(output.c_str(), 0777) != 0 && errno != EEXIST) {
+    cerr << "ERROR: " << output << " cannot be created" << endl;
+    return 1;
+  }
+  std::string stream_path = output + "/stream_0";
+  std::ofstream stream(stream_path.c_str(),
+                       std::ios::binary | std::ios::trunc);
+  if (!stream) {
+    cerr << "ERROR: " << stream_path << " cannot be created" << endl;
+    return 1;
+  }
+  vartrace::CtfWriter writer(options, &stream);
+  const std::vector<std::string> &dumps =
+      args["dumps"].as<std::vector<std::string> >();
+  for (std::size_t i = 0; i < dumps.size(); ++i) {
+    vartrace::DumpFile dump;
+    if (!dump.Read(dumps[i])) {
+      return 1;
+    }
+    std::vector<vartrace::MessageView> messages = dump.Parse();
+    for (std::size_t j = 0; j < messages.size(); ++j) {
+      vartrace::VisitMessages(
+          vartrace::TraceView(messages[j].message(),
+                              messages[j].message_size()), &writer);
+    }
+  }
+  if (!writer.Finish()) {
+    cerr << "ERROR: " << stream_path << " cannot be written" << endl;
+    return 1;
+  }
+  std::string metadata_path = output + "/metadata";
+  std::ofstream metadata(metadata_path.c_str(), std::ios::trunc);
+  metadata << writer.Metadata();
+  metadata.close();
+  if (!metadata) {
+    cerr << "ERROR: " << metadata_path << " cannot be written" << endl;
+    return 1;
+  }
+  return 0;
+}
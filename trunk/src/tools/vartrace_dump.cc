@@ -0,0 +1,194 @@
+/* vartrace_dump.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file vartrace_dump.cc
+  Utility that prints messages of a dump as text or JSON lines.
+*/
+
+#include <boost/program_options.hpp>
+
+#include <vartrace/parallel_parser.h>
+#include <vartrace/query.h>
+#include <vartrace/text_writer.h>
+
+#include "dump_file.h"
+#include "message_format.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+namespace po = boost::program_options;
+
+//! Top level messages formatted by a thread at once.
+const std::size_t kPartSize = 0x4000;
+//! Parts per thread in a batch, several to balance uneven parts.
+const unsigned kPartsPerThread = 4;
+
+//! Define and parse command line arguments, process help option.
+po::variables_map parse_commandline(int argc, char *argv[]) {
+  po::options_description desc(
+      "Print messages of a vartrace dump\n"
+      "Usage: vartrace-dump [options] dump");
+  desc.add_options()
+      ("help,h", "produce help message")
+      ("dump", po::value<std::string>(), "dump file")
+      ("id,i", po::value<int>(), "print only messages with this id")
+      ("type,t", po::value<std::string>(),
+       "print only this data type, name or id, 0 prints subtraces")
+      ("time", po::value<std::string>(),
+       "top level timestamp range first:last, either may be omitted")
+      ("json", "print JSON lines")
+      ("threads,j", po::value<unsigned>()->default_value(
+          std::max(1u, std::thread::hardware_concurrency())),
+       "number of threads that format text");
+  po::positional_options_description positional;
+  positional.add("dump", 1);
+  po::variables_map args;
+  po::store(po::command_line_parser(argc, argv).options(desc)
+            .positional(positional).run(), args);
+  po::notify(args);
+  if (args.count("help") || !args.count("dump")) {
+    cout << desc << endl;
+  }
+  return args;
+}
+
+//! Convert range like "100:200", ":200" or "100:" into filter limits.
+bool parse_range(const std::string &text, vartrace::QueryFilter *filter) {
+  std::size_t colon = text.find(':');
+  if (colon == std::string::npos) {
+    return false;
+  }
+  std::string first = text.substr(0, colon);
+  std::string last = text.substr(colon + 1);
+  char *end;
+  if (!first.empty()) {
+    filter->first_timestamp = std::strtoul(first.c_str(), &end, 0);
+    if (*end) {
+      return false;
+    }
+  }
+  if (!last.empty()) {
+    filter->last_timestamp = std::strtoul(last.c_str(), &end, 0);
+    if (*end) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//! Function that prints a message.
+typedef void (*PrintFunction)(vartrace::TimestampType timestamp,
+                              const std::vector<vartrace::MessageIdType> &path,
+                              const vartrace::MessageView &message,
+                              vartrace::TextWriter *writer);
+
+//! Print selected messages of a range.
+void print_range(const vartrace::MessageView *messages, std::size_t count,
+                 const vartrace::QueryFilter &filter, PrintFunction print,
+                 vartrace::TextWriter *writer) {
+  vartrace::ForEachMatch(
+      messages, count, filter,
+      [print, writer](vartrace::TimestampType timestamp,
+                      const std::vector<vartrace::MessageIdType> &path,
+                      const vartrace::MessageView &message) {
+        print(timestamp, path, message, writer);
+      });
+}
+
+//! Print messages using several threads, text is written in dump order.
+/*! Messages are formatted in batches of parts, every part into its own
+  string, so memory use does not grow with the size of the dump.
+ */
+void print_parallel(const std::vector<vartrace::MessageView> &messages,
+                    const vartrace::QueryFilter &filter, PrintFunction print,
+                    unsigned thread_count, vartrace::TextWriter *writer) {
+  std::size_t part_count = thread_count*kPartsPerThread;
+  std::vector<std::string> texts(part_count);
+  for (std::size_t first = 0; first < messages.size();
+       first += part_count*kPartSize) {
+    vartrace::ParallelFor(part_count, thread_count,
+                          [&messages, &filter, print, &texts, first](
+                              unsigned i) {
+        std::size_t begin = std::min(first + i*kPartSize, messages.size());
+        std::size_t end = std::min(begin + kPartSize, messages.size());
+        std::ostringstream text;
+        {
+          vartrace::TextWriter part_writer(&text);
+          print_range(messages.data() + begin, end - begin, filter, print,
+                      &part_writer);
+        }
+        texts[i] = text.str();
+      });
+    for (std::size_t i = 0; i < part_count; ++i) {
+      writer->Write(texts[i]);
+    }
+  }
+}
+
+//! Read dump and print messages that pass the filters.
+int main(int argc, char *argv[]) {
+  po::variables_map args = parse_commandline(argc, argv);
+  if (args.count("help") || !args.count("dump")) {
+    return args.count("help") ? 0 : 1;
+  }
+  vartrace::QueryFilter filter;
+  if (args.count("id")) {
+    filter.message_type_id = args["id"].as<int>();
+  }
+  if (args.count("type")) {
+    filter.data_type_id = vartrace::ParseDataType(
+        args["type"].as<std::string>());
+    if (filter.data_type_id < 0) {
+      cerr << "ERROR: unknown data type " << args["type"].as<std::string>()
+           << endl;
+      return 1;
+    }
+  }
+  if (args.count("time")
+      && !parse_range(args["time"].as<std::string>(), &filter)) {
+    cerr << "ERROR: bad time range " << args["time"].as<std::string>()
+         << endl;
+    return 1;
+  }
+  vartrace::DumpFile dump;
+  if (!dump.Read(args["dump"].as<std::string>())) {
+    return 1;
+  }
+  std::vector<vartrace::MessageView> messages = dump.Parse();
+  PrintFunction print = args.count("json") ? vartrace::PrintJson
+      : vartrace::PrintText;
+  unsigned thread_count = args["threads"].as<unsigned>();
+  std::ios::sync_with_stdio(false);
+  vartrace::TextWriter writer(&cout);
+  if (thread_count > 1) {
+    print_parallel(messages, filter, print, thread_count, &writer);
+  } else {
+    print_range(messages.data(), messages.size(), filter, print, &writer);
+  }
+  return writer.Flush() ? 0 : 1;
+}
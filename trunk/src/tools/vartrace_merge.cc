@@ -0,0 +1,119 @@
+/* vartrace_merge.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file vartrace_merge.cc
+  Utility that merges dumps and trace files by timestamp, see merge.h.
+*/
+
+#include <boost/program_options.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <vartrace/merge.h>
+#include <vartrace/trace_file.h>
+
+#include "dump_file.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+namespace po = boost::program_options;
+
+//! Define and parse command line arguments, process help option.
+po::variables_map parse_commandline(int argc, char *argv[]) {
+  po::options_description desc(
+      "Merge vartrace dumps or trace files into one dump by timestamp\n"
+      "Usage: vartrace-merge [options] -o file input...");
+  desc.add_options()
+      ("help,h", "produce help message")
+      ("inputs", po::value<std::vector<std::string> >(),
+       "dumps or trace files")
+      ("output,o", po::value<std::string>(), "merged dump")
+      ("offset", po::value<std::vector<double> >(),
+       "clock offset in ticks, once per input in input order")
+      ("drift", po::value<std::vector<double> >(),
+       "clock drift in ppm, once per input in input order")
+      ("no-tag", "do not wrap messages into subtraces with input index");
+  po::positional_options_description positional;
+  positional.add("inputs", -1);
+  po::variables_map args;
+  po::store(po::command_line_parser(argc, argv).options(desc)
+            .positional(positional).run(), args);
+  po::notify(args);
+  if (args.count("help") || !args.count("inputs") || !args.count("output")) {
+    cout << desc << endl;
+  }
+  return args;
+}
+
+//! Values of a repeated option, missing values are zero.
+std::vector<double> per_input(const po::variables_map &args,
+                              const std::string &name, std::size_t count) {
+  std::vector<double> values;
+  if (args.count(name)) {
+    values = args[name].as<std::vector<double> >();
+  }
+  values.resize(count, 0);
+  return values;
+}
+
+//! Add inputs to the merger and write the merged dump.
+int main(int argc, char *argv[]) {
+  po::variables_map args = parse_commandline(argc, argv);
+  if (args.count("help") || !args.count("inputs") || !args.count("output")) {
+    return args.count("help") ? 0 : 1;
+  }
+  const std::vector<std::string> &inputs =
+      args["inputs"].as<std::vector<std::string> >();
+  std::vector<double> offsets = per_input(args, "offset", inputs.size());
+  std::vector<double> drifts = per_input(args, "drift", inputs.size());
+  std::vector<boost::shared_ptr<vartrace::TraceFile> > files;
+  std::vector<boost::shared_ptr<vartrace::DumpFile> > dumps;
+  vartrace::TraceMerger merger;
+  for (std::size_t i = 0; i < inputs.size(); ++i) {
+    vartrace::ClockCorrection clock(offsets[i], drifts[i]);
+    boost::shared_ptr<vartrace::TraceFile> file(new vartrace::TraceFile);
+    if (file->Open(inputs[i])) {
+      std::vector<vartrace::TraceView> chunks;
+      for (std::size_t j = 0; j < file->chunk_count(); ++j) {
+        chunks.push_back(file->chunk_view(j));
+      }
+      merger.AddSource(chunks, clock);
+      files.push_back(file);
+      continue;
+    }
+    boost::shared_ptr<vartrace::DumpFile> dump(new vartrace::DumpFile);
+    if (!dump->Read(inputs[i])) {
+      return 1;
+    }
+    merger.AddSource(dump->view(), clock);
+    dumps.push_back(dump);
+  }
+  std::string output = args["output"].as<std::string>();
+  std::ofstream out(output.c_str(), std::ios::trunc | std::ios::binary);
+  if (!out || !vartrace::WriteMerged(&merger, !args.count("no-tag"), &out)) {
+    cerr << "ERROR: " << output << " cannot be written" << endl;
+    return 1;
+  }
+  return 0;
+}
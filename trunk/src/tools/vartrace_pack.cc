@@ -0,0 +1,92 @@
+/* vartrace_pack.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file vartrace_pack.cc
+  Utility that packs dumps into an indexed trace file, see trace_file.h.
+*/
+
+#include <boost/program_options.hpp>
+
+#include <vartrace/trace_file.h>
+
+#include "dump_file.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+namespace po = boost::program_options;
+
+//! Define and parse command line arguments, process help option.
+po::variables_map parse_commandline(int argc, char *argv[]) {
+  po::options_description desc(
+      "Pack vartrace dumps into an indexed trace file\n"
+      "Usage: vartrace-pack [options] -o file dump...");
+  desc.add_options()
+      ("help,h", "produce help message")
+      ("dumps", po::value<std::vector<std::string> >(),
+       "dump files in time order")
+      ("output,o", po::value<std::string>(), "trace file")
+      ("chunk-size", po::value<std::size_t>()->default_value(
+          vartrace::kDefaultChunkSize), "chunk size in bytes");
+  po::positional_options_description positional;
+  positional.add("dumps", -1);
+  po::variables_map args;
+  po::store(po::command_line_parser(argc, argv).options(desc)
+            .positional(positional).run(), args);
+  po::notify(args);
+  if (args.count("help") || !args.count("dumps") || !args.count("output")) {
+    cout << desc << endl;
+  }
+  return args;
+}
+
+//! Append messages of all dumps to the trace file.
+int main(int argc, char *argv[]) {
+  po::variables_map args = parse_commandline(argc, argv);
+  if (args.count("help") || !args.count("dumps") || !args.count("output")) {
+    return args.count("help") ? 0 : 1;
+  }
+  vartrace::TraceFileWriter writer(args["chunk-size"].as<std::size_t>());
+  std::string output = args["output"].as<std::string>();
+  if (!writer.Open(output)) {
+    cerr << "ERROR: " << output << " cannot be created" << endl;
+    return 1;
+  }
+  const std::vector<std::string> &dumps =
+      args["dumps"].as<std::vector<std::string> >();
+  for (std::size_t i = 0; i < dumps.size(); ++i) {
+    vartrace::DumpFile dump;
+    if (!dump.Read(dumps[i])) {
+      return 1;
+    }
+    std::vector<vartrace::MessageView> messages = dump.Parse();
+    for (std::size_t j = 0; j < messages.size(); ++j) {
+      writer.Append(messages[j]);
+    }
+  }
+  if (!writer.Close()) {
+    cerr << "ERROR: " << output << " cannot be written" << endl;
+    return 1;
+  }
+  return 0;
+}
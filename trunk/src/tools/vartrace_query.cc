@@ -0,0 +1,191 @@
+/* vartrace_query.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file vartrace_query.cc
+  Utility that prints messages selected by a query, see query.h.
+*/
+
+#include <boost/program_options.hpp>
+
+#include <vartrace/query.h>
+#include <vartrace/text_writer.h>
+#include <vartrace/trace_file.h>
+
+#include "dump_file.h"
+#include "message_format.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+namespace po = boost::program_options;
+
+//! Define and parse command line arguments, process help option.
+po::variables_map parse_commandline(int argc, char *argv[]) {
+  po::options_description desc(
+      "Print messages of a dump or trace file that match a query\n"
+      "Usage: vartrace-query [options] file");
+  desc.add_options()
+      ("help,h", "produce help message")
+      ("file", po::value<std::string>(), "dump or trace file")
+      ("id,i", po::value<int>(), "message id")
+      ("type,t", po::value<std::string>(),
+       "data type name or id, 0 selects subtraces")
+      ("from", po::value<unsigned>(), "first timestamp")
+      ("to", po::value<unsigned>(), "last timestamp")
+      ("path,p", po::value<std::string>(),
+       "ids of enclosing subtraces, e.g. 7/3")
+      ("where,w", po::value<std::string>(),
+       "value condition, e.g. \"> 2.5\"")
+      ("threads,j", po::value<unsigned>()->default_value(
+          std::max(1u, std::thread::hardware_concurrency())),
+       "number of threads")
+      ("count,c", "print only the number of matches")
+      ("json", "print JSON lines");
+  po::positional_options_description positional;
+  positional.add("file", 1);
+  po::variables_map args;
+  po::store(po::command_line_parser(argc, argv).options(desc)
+            .positional(positional).run(), args);
+  po::notify(args);
+  if (args.count("help") || !args.count("file")) {
+    cout << desc << endl;
+  }
+  return args;
+}
+
+//! Convert slash separated ids into path, return false on errors.
+bool parse_path(const std::string &text,
+                std::vector<vartrace::MessageIdType> *path) {
+  std::istringstream in(text);
+  std::string id;
+  while (std::getline(in, id, '/')) {
+    char *end;
+    long value = std::strtol(id.c_str(), &end, 0);
+    if (*end || end == id.c_str() || value < 0 || value > 0xff) {
+      return false;
+    }
+    path->push_back(value);
+  }
+  return !path->empty();
+}
+
+//! Convert condition like "> 2.5" into operator and value.
+bool parse_condition(const std::string &text, vartrace::QueryFilter *filter) {
+  // longer operators first so that "<=" is not read as "<"
+  static const struct {
+    const char *name;
+    vartrace::CompareOperator value_operator;
+  } kOperators[] = {
+    {"<=", vartrace::kLessEqual}, {">=", vartrace::kGreaterEqual},
+    {"==", vartrace::kEqual}, {"!=", vartrace::kNotEqual},
+    {"<", vartrace::kLess}, {">", vartrace::kGreater},
+    {"=", vartrace::kEqual}
+  };
+  std::size_t start = text.find_first_not_of(' ');
+  if (start == std::string::npos) {
+    return false;
+  }
+  for (std::size_t i = 0; i < sizeof(kOperators)/sizeof(kOperators[0]);
+       ++i) {
+    std::size_t length = std::strlen(kOperators[i].name);
+    if (text.compare(start, length, kOperators[i].name) == 0) {
+      const char *value = text.c_str() + start + length;
+      char *end;
+      filter->value = std::strtod(value, &end);
+      filter->value_operator = kOperators[i].value_operator;
+      return end != value && text.find_first_not_of(' ', end - text.c_str())
+          == std::string::npos;
+    }
+  }
+  return false;
+}
+
+//! Build filter, run query over the file and print matches.
+int main(int argc, char *argv[]) {
+  po::variables_map args = parse_commandline(argc, argv);
+  if (args.count("help") || !args.count("file")) {
+    return args.count("help") ? 0 : 1;
+  }
+  vartrace::QueryFilter filter;
+  if (args.count("id")) {
+    filter.message_type_id = args["id"].as<int>();
+  }
+  if (args.count("type")) {
+    filter.data_type_id = vartrace::ParseDataType(
+        args["type"].as<std::string>());
+    if (filter.data_type_id < 0) {
+      cerr << "ERROR: unknown data type " << args["type"].as<std::string>()
+           << endl;
+      return 1;
+    }
+  }
+  if (args.count("from")) {
+    filter.first_timestamp = args["from"].as<unsigned>();
+  }
+  if (args.count("to")) {
+    filter.last_timestamp = args["to"].as<unsigned>();
+  }
+  if (args.count("path")
+      && !parse_path(args["path"].as<std::string>(), &filter.path)) {
+    cerr << "ERROR: bad path " << args["path"].as<std::string>() << endl;
+    return 1;
+  }
+  if (args.count("where")
+      && !parse_condition(args["where"].as<std::string>(), &filter)) {
+    cerr << "ERROR: bad condition " << args["where"].as<std::string>()
+         << endl;
+    return 1;
+  }
+  unsigned thread_count = args["threads"].as<unsigned>();
+  std::string path = args["file"].as<std::string>();
+  std::vector<vartrace::QueryMatch> matches;
+  vartrace::TraceFile file;
+  vartrace::DumpFile dump;
+  if (file.Open(path)) {
+    matches = vartrace::RunQuery(file, filter, thread_count);
+  } else if (dump.Read(path)) {
+    matches = vartrace::RunQuery(dump.Parse(), filter, thread_count);
+  } else {
+    return 1;
+  }
+  if (args.count("count")) {
+    cout << matches.size() << endl;
+    return 0;
+  }
+  std::ios::sync_with_stdio(false);
+  vartrace::TextWriter writer(&cout);
+  for (std::size_t i = 0; i < matches.size(); ++i) {
+    if (args.count("json")) {
+      vartrace::PrintJson(matches[i].timestamp, matches[i].path,
+                          matches[i].message, &writer);
+    } else {
+      vartrace::PrintText(matches[i].timestamp, matches[i].path,
+                          matches[i].message, &writer);
+    }
+  }
+  return writer.Flush() ? 0 : 1;
+}
@@ -0,0 +1,219 @@
+/* vartrace_stats.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file vartrace_stats.cc
+  Utility that prints count, rate, duration and interval statistics of
+  every message path of a dump and writes folded stacks, see
+  trace_stats.h.
+*/
+
+#include <boost/program_options.hpp>
+
+#include <vartrace/trace_stats.h>
+
+#include "dump_file.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+namespace po = boost::program_options;
+
+//! Percentiles printed for durations and intervals.
+const double kFractions[] = {0.5, 0.9, 0.99, 0.999};
+//! Names of percentile columns.
+const char *kFractionNames[] = {"p50", "p90", "p99", "p99.9"};
+
+//! Define and parse command line arguments, process help option.
+po::variables_map parse_commandline(int argc, char *argv[]) {
+  po::options_description desc(
+      "Print statistics of every message path of a vartrace dump\n"
+      "Usage: vartrace-stats [options] dump\n"
+      "Durations of span records and intervals are in timestamp ticks");
+  desc.add_options()
+      ("help,h", "produce help message")
+      ("dump", po::value<std::string>(), "dump file")
+      ("ticks-per-us", po::value<double>()->default_value(1),
+       "timestamp ticks per microsecond, used for rates")
+      ("csv", "print comma separated values")
+      ("folded", po::value<std::string>(),
+       "write folded stacks for flamegraph.pl into this file")
+      ("weight", po::value<std::string>()->default_value("time"),
+       "weight of folded stacks: time of spans, count or bytes");
+  po::positional_options_description positional;
+  positional.add("dump", 1);
+  po::variables_map args;
+  po::store(po::command_line_parser(argc, argv).options(desc)
+            .positional(positional).run(), args);
+  po::notify(args);
+  if (args.count("help") || !args.count("dump")) {
+    cout << desc << endl;
+  }
+  return args;
+}
+
+//! Path with a slash after subtrace ids, e.g. "3/42" or "3/".
+std::string path_name(const vartrace::PathStats &row) {
+  std::ostringstream name;
+  for (std::size_t i = 0; i < row.path.size(); ++i) {
+    name << (i ? "/" : "") << static_cast<unsigned>(row.path[i]);
+  }
+  if (row.is_subtrace) {
+    name << '/';
+  }
+  return name.str();
+}
+
+//! Names of the table columns.
+std::vector<std::string> column_names() {
+  std::vector<std::string> names;
+  names.push_back("path");
+  names.push_back("count");
+  names.push_back("rate/s");
+  const char *prefixes[] = {"dur_", "gap_"};
+  for (int i = 0; i < 2; ++i) {
+    names.push_back(std::string(prefixes[i]) + "min");
+    for (std::size_t j = 0; j < sizeof(kFractions)/sizeof(kFractions[0]);
+         ++j) {
+      names.push_back(std::string(prefixes[i]) + kFractionNames[j]);
+    }
+    names.push_back(std::string(prefixes[i]) + "max");
+  }
+  return names;
+}
+
+//! Append minimum, percentiles and maximum, "-" if there are no values.
+void append_histogram(const vartrace::Histogram &histogram,
+                      std::vector<std::string> *cells) {
+  std::size_t count = sizeof(kFractions)/sizeof(kFractions[0]) + 2;
+  if (!histogram.count()) {
+    cells->insert(cells->end(), count, "-");
+    return;
+  }
+  std::ostringstream cell;
+  cell << histogram.min();
+  cells->push_back(cell.str());
+  for (std::size_t i = 0; i < count - 2; ++i) {
+    cell.str("");
+    cell << histogram.Percentile(kFractions[i]);
+    cells->push_back(cell.str());
+  }
+  cell.str("");
+  cell << histogram.max();
+  cells->push_back(cell.str());
+}
+
+//! Cells of a table row.
+std::vector<std::string> row_cells(const vartrace::PathStats &row,
+                                   uint64_t duration, double ticks_per_us) {
+  std::vector<std::string> cells;
+  cells.push_back(path_name(row));
+  std::ostringstream cell;
+  cell << row.count;
+  cells.push_back(cell.str());
+  cell.str("");
+  if (duration) {
+    cell << std::fixed << std::setprecision(1)
+         << row.count*ticks_per_us*1e6/duration;
+  } else {
+    cell << '-';
+  }
+  cells.push_back(cell.str());
+  append_histogram(row.durations, &cells);
+  append_histogram(row.intervals, &cells);
+  return cells;
+}
+
+//! Print rows as aligned text or as CSV.
+void print_table(const std::vector<std::vector<std::string> > &rows,
+                 bool is_csv) {
+  std::vector<std::size_t> widths(rows[0].size());
+  for (std::size_t i = 0; i < rows.size(); ++i) {
+    for (std::size_t j = 0; j < rows[i].size(); ++j) {
+      widths[j] = std::max(widths[j], rows[i][j].size());
+    }
+  }
+  for (std::size_t i = 0; i < rows.size(); ++i) {
+    for (std::size_t j = 0; j < rows[i].size(); ++j) {
+      if (is_csv) {
+        cout << (j ? "," : "") << rows[i][j];
+      } else if (j == 0) {
+        cout << std::left << std::setw(widths[j]) << rows[i][j];
+      } else {
+        cout << "  " << std::right << std::setw(widths[j]) << rows[i][j];
+      }
+    }
+    cout << '\n';
+  }
+}
+
+//! Collect statistics in one pass, print table and folded stacks.
+int main(int argc, char *argv[]) {
+  po::variables_map args = parse_commandline(argc, argv);
+  if (args.count("help") || !args.count("dump")) {
+    return args.count("help") ? 0 : 1;
+  }
+  double ticks_per_us = args["ticks-per-us"].as<double>();
+  if (!(ticks_per_us > 0)) {
+    cerr << "ERROR: tick rate must be positive" << endl;
+    return 1;
+  }
+  std::string weight_name = args["weight"].as<std::string>();
+  vartrace::FoldedWeight weight = vartrace::kFoldedTime;
+  if (weight_name == "count") {
+    weight = vartrace::kFoldedCount;
+  } else if (weight_name == "bytes") {
+    weight = vartrace::kFoldedBytes;
+  } else if (weight_name != "time") {
+    cerr << "ERROR: unknown weight " << weight_name << endl;
+    return 1;
+  }
+  vartrace::DumpFile dump;
+  if (!dump.Read(args["dump"].as<std::string>())) {
+    return 1;
+  }
+  std::vector<vartrace::MessageView> messages = dump.Parse();
+  vartrace::TraceStats stats;
+  for (std::size_t i = 0; i < messages.size(); ++i) {
+    vartrace::VisitMessages(vartrace::TraceView(messages[i].message(),
+                                                messages[i].message_size()),
+                            &stats);
+  }
+  uint64_t duration = stats.last_time() - stats.first_time();
+  std::vector<std::vector<std::string> > rows(1, column_names());
+  for (std::size_t i = 0; i < stats.paths().size(); ++i) {
+    rows.push_back(row_cells(stats.paths()[i], duration, ticks_per_us));
+  }
+  print_table(rows, args.count("csv"));
+  if (args.count("folded")) {
+    std::string folded = args["folded"].as<std::string>();
+    std::ofstream out(folded.c_str(), std::ios::trunc);
+    if (!stats.WriteFolded(weight, &out)) {
+      cerr << "ERROR: " << folded << " cannot be written" << endl;
+      return 1;
+    }
+  }
+  return cout.good() ? 0 : 1;
+}
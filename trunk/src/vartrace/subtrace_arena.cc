@@ -0,0 +1,95 @@
+/* subtrace_arena.cc
+
+   Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \file subtrace_arena.cc
+  Implementation of subtrace scratch space.
+*/
+
+#include <vartrace/subtrace_arena.h>
+
+namespace vartrace {
+namespace {
+//! Arena of the current thread.
+thread_local SubtraceArena thread_arena;
+}  // unnamed namespace
+
+SubtraceArena *ThreadSubtraceArena() {
+  return &thread_arena;
+}
+
+void SubtraceArena::Push(const void *owner, MessageIdType subtrace_id,
+                         TimestampType timestamp) {
+  if (depth_ == internal::kMaxSubtraceDepth || excess_depth_) {
+    MarkOverflow();
+    ++excess_depth_;
+    return;
+  }
+  Frame &frame = frames_[depth_];
+  frame.owner = owner;
+  frame.header_index = cursor_;
+  frame.is_overflowed = false;
+  if (is_owned_by(owner)) {
+    frame.outermost = frames_[depth_ - 1].outermost;
+  } else {
+    frame.outermost = depth_;
+    frame.timestamp = timestamp;
+  }
+  ++depth_;
+  if (internal::kSubtraceArenaLength - cursor_ < kNestedHeaderLength) {
+    // keep the frame to match the closing call but drop the transaction
+    MarkOverflow();
+    return;
+  }
+  // size is filled when the subtrace is closed
+  data_[cursor_] = (subtrace_id << kMessageIdShift);
+  cursor_ += kNestedHeaderLength;
+}
+
+bool SubtraceArena::Pop(bool keep_data, Frame *closed_frame) {
+  if (excess_depth_) {
+    --excess_depth_;
+    return false;
+  }
+  if (!depth_) {
+    return false;
+  }
+  --depth_;
+  Frame &frame = frames_[depth_];
+  if (keep_data) {
+    uint_fast32_t written_size =
+        (cursor_ - frame.header_index - kNestedHeaderLength)
+        *sizeof(AlignmentType);
+    if (frame.header_index + kNestedHeaderLength > cursor_
+        || written_size > kMaxDataSize) {
+      frames_[frame.outermost].is_overflowed = true;
+    } else {
+      data_[frame.header_index] |= written_size;
+    }
+  } else {
+    cursor_ = frame.header_index;
+  }
+  *closed_frame = frames_[frame.outermost];
+  return frame.outermost == depth_;
+}
+
+void SubtraceArena::MarkOverflow() {
+  if (depth_) {
+    frames_[frames_[depth_ - 1].outermost].is_overflowed = true;
+  }
+}
+}  // namespace vartrace
@@ -21,13 +21,15 @@
 
 #include <vartrace/utility.h>
 
+#include <atomic>
+
 namespace vartrace {
 namespace {
-TimestampType incremental_timestamp = 0;
+std::atomic<TimestampType> incremental_timestamp(0);
 }  // unnamed namespace
 
 TimestampType IncrementalTimestamp() {
-  return incremental_timestamp++;
+  return incremental_timestamp.fetch_add(1, std::memory_order_relaxed);
 }
 
 TimestampType ZeroTimestamp() {
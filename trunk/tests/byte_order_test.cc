@@ -0,0 +1,178 @@
+//! \file byte_order_test.cc
+
+// Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//!  \brief Byte order conversion tests.
+
+#include <gtest/gtest.h>
+
+#include <vartrace/vartrace.h>
+#include <vartrace/byte_order.h>
+#include <vartrace/messageparser.h>
+#include <vartrace/validating_parser.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using vartrace::VarTrace;
+using vartrace::kInfoLevel;
+
+namespace {
+//! Append value with bytes in reverse order.
+template <typename T>
+void AppendSwapped(std::vector<uint8_t> *bytes, T value) {
+  uint8_t raw[sizeof(value)];
+  std::memcpy(raw, &value, sizeof(value));
+  std::reverse(raw, raw + sizeof(value));
+  bytes->insert(bytes->end(), raw, raw + sizeof(value));
+}
+
+//! Append header in reverse byte order.
+void AppendHeader(std::vector<uint8_t> *bytes, bool is_nested,
+                  uint32_t timestamp, uint16_t size, uint8_t message_id,
+                  uint8_t data_id) {
+  if (!is_nested) {
+    AppendSwapped(bytes, timestamp);
+  }
+  AppendSwapped(bytes, size + (static_cast<uint32_t>(message_id) << 16)
+                + (static_cast<uint32_t>(data_id) << 24));
+}
+
+//! Append zeros up to the word boundary.
+void AppendPadding(std::vector<uint8_t> *bytes) {
+  bytes->resize(vartrace::RoundSize(bytes->size())*sizeof(uint32_t));
+}
+}  // unnamed namespace
+
+//! Dump written with the other byte order is converted.
+TEST(ByteOrderTest, SwappedTest) {
+  std::vector<uint8_t> dump;
+  AppendHeader(&dump, false, 0, 4, 0, vartrace::kTypeIdByteOrderMark);
+  AppendSwapped(&dump, vartrace::kByteOrderMark);
+  AppendHeader(&dump, false, 10, 10*sizeof(int32_t), 1,
+               vartrace::kTypeIdInt32);
+  for (int32_t i = 0; i < 10; ++i) {
+    AppendSwapped(&dump, 0x01020304*i);
+  }
+  AppendHeader(&dump, false, 11, 11*sizeof(int16_t), 2,
+               vartrace::kTypeIdInt16);
+  for (int16_t i = 0; i < 11; ++i) {
+    AppendSwapped(&dump, static_cast<int16_t>(0x0102*i));
+  }
+  AppendPadding(&dump);
+  AppendHeader(&dump, false, 12, 5*sizeof(double), 3,
+               vartrace::kTypeIdDouble);
+  for (int i = 0; i < 5; ++i) {
+    AppendSwapped(&dump, 1.25*i);
+  }
+  // nested headers, uint64 and padded chars
+  AppendHeader(&dump, false, 13, 3*sizeof(uint32_t) + sizeof(uint64_t), 4, 0);
+  AppendHeader(&dump, true, 0, sizeof(uint64_t), 5, vartrace::kTypeIdUint64);
+  AppendSwapped(&dump, static_cast<uint64_t>(0x0102030405060708ull));
+  AppendHeader(&dump, true, 0, 3, 6, vartrace::kTypeIdChar);
+  dump.push_back('a');
+  dump.push_back('b');
+  dump.push_back('c');
+  AppendPadding(&dump);
+
+  ASSERT_EQ(vartrace::kSwappedByteOrder,
+            vartrace::DetectByteOrder(&dump[0], dump.size()));
+  ASSERT_EQ(vartrace::kSwappedByteOrder,
+            vartrace::ToNativeByteOrder(&dump[0], dump.size()));
+  ASSERT_EQ(vartrace::kNativeByteOrder,
+            vartrace::DetectByteOrder(&dump[0], dump.size()));
+  std::vector<vartrace::SkippedRange> skipped;
+  vartrace::ParsedVartrace parsed(&dump[0], dump.size(), &skipped);
+  ASSERT_TRUE(skipped.empty());
+  ASSERT_EQ(5, parsed.messages().size());
+  ASSERT_EQ(vartrace::kByteOrderMark, parsed[0]->value<uint32_t>());
+  ASSERT_EQ(10, parsed[1]->timestamp());
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_EQ(0x01020304*i, parsed[1]->pointer<int32_t>()[i]);
+  }
+  for (int i = 0; i < 11; ++i) {
+    ASSERT_EQ(0x0102*i, parsed[2]->pointer<int16_t>()[i]);
+  }
+  for (int i = 0; i < 5; ++i) {
+    ASSERT_EQ(1.25*i, parsed[3]->pointer<double>()[i]);
+  }
+  ASSERT_EQ(4, parsed[4]->message_type_id());
+  ASSERT_EQ(2, parsed[4]->children().size());
+  ASSERT_EQ(0x0102030405060708ull,
+            parsed[4]->children()[0]->value<uint64_t>());
+  ASSERT_EQ(0, std::memcmp("abc", parsed[4]->children()[1]->pointer<char>(),
+                           3));
+}
+
+//! Single small values start their word and are converted too.
+TEST(ByteOrderTest, SwappedScalarTest) {
+  VarTrace<> trace(0x1000);
+  int16_t value = -0x1234;
+  trace.Log(kInfoLevel, 1, value);
+  std::vector<uint32_t> buffer(0x10);
+  trace.DumpInto(&buffer[0], buffer.size()*sizeof(uint32_t));
+  int16_t stored;
+  std::memcpy(&stored, &buffer[vartrace::kHeaderLength], sizeof(stored));
+  ASSERT_EQ(value, stored);
+  // the same layout written by a machine with the other byte order
+  std::vector<uint8_t> dump;
+  AppendHeader(&dump, false, 0, 4, 0, vartrace::kTypeIdByteOrderMark);
+  AppendSwapped(&dump, vartrace::kByteOrderMark);
+  AppendHeader(&dump, false, 1, sizeof(int16_t), 1, vartrace::kTypeIdInt16);
+  AppendSwapped(&dump, value);
+  AppendPadding(&dump);
+  AppendHeader(&dump, false, 2, sizeof(uint8_t), 2, vartrace::kTypeIdUint8);
+  dump.push_back(0xab);
+  AppendPadding(&dump);
+  AppendHeader(&dump, false, 3, 2*sizeof(uint32_t), 3, 0);
+  AppendHeader(&dump, true, 0, sizeof(uint16_t), 4,
+               vartrace::kTypeIdUint16);
+  AppendSwapped(&dump, static_cast<uint16_t>(0xcdef));
+  AppendPadding(&dump);
+  ASSERT_EQ(vartrace::kSwappedByteOrder,
+            vartrace::ToNativeByteOrder(&dump[0], dump.size()));
+  vartrace::ParsedVartrace parsed(&dump[0], dump.size());
+  ASSERT_EQ(4, parsed.messages().size());
+  ASSERT_EQ(value, parsed[1]->value<int16_t>());
+  ASSERT_EQ(0xab, parsed[2]->value<uint8_t>());
+  ASSERT_EQ(0xcdef, parsed[3]->children()[0]->value<uint16_t>());
+}
+
+//! Native dump with a mark is not changed.
+TEST(ByteOrderTest, NativeTest) {
+  VarTrace<> trace(0x1000);
+  trace.Log(kInfoLevel, 1, 0x12345678);
+  trace.Log(kInfoLevel, 2, 2.5);
+  std::vector<uint8_t> dump(0x1000);
+  unsigned size = vartrace::WriteByteOrderMark(&dump[0], dump.size());
+  ASSERT_EQ(vartrace::kByteOrderMarkSize, size);
+  size += trace.DumpInto(&dump[size], dump.size() - size);
+  dump.resize(size);
+  std::vector<uint8_t> copy = dump;
+  ASSERT_EQ(vartrace::kNativeByteOrder,
+            vartrace::ToNativeByteOrder(&dump[0], dump.size()));
+  ASSERT_EQ(copy, dump);
+  vartrace::ValidationOptions options;
+  options.known_types_only = true;
+  ASSERT_EQ(3, vartrace::ValidatingParse(
+      vartrace::TraceView(&dump[0], size), NULL, options).size());
+  // no mark
+  std::size_t mark_size = vartrace::kByteOrderMarkSize;
+  ASSERT_EQ(vartrace::kUnknownByteOrder,
+            vartrace::DetectByteOrder(&dump[mark_size], size - mark_size));
+  ASSERT_EQ(0, vartrace::WriteByteOrderMark(&dump[0], 4));
+}
@@ -0,0 +1,126 @@
+//! \file chrome_trace_test.cc
+
+// Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//!  \brief Chrome trace export tests.
+
+#include <gtest/gtest.h>
+
+#include <vartrace/vartrace.h>
+#include <vartrace/chrome_trace.h>
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using vartrace::AlignmentType;
+using vartrace::ChromeTraceOptions;
+using vartrace::ChromeTraceWriter;
+using vartrace::kMessageIdShift;
+using vartrace::kDataIdShift;
+
+namespace {
+//! Append top level message with given timestamp and 32 bit data.
+void Append(unsigned timestamp, int message_id, int data_type_id,
+            const void *data, int size, std::vector<AlignmentType> *dump) {
+  dump->push_back(timestamp);
+  dump->push_back(size + (message_id << kMessageIdShift)
+                  + (static_cast<AlignmentType>(data_type_id) << kDataIdShift));
+  std::size_t position = dump->size();
+  dump->resize(position + (size + 3)/4);
+  std::memcpy(&(*dump)[position], data, size);
+}
+
+//! Convert dump into JSON.
+std::string Export(const std::vector<AlignmentType> &dump,
+                   const ChromeTraceOptions &options,
+                   std::size_t *event_count) {
+  std::ostringstream out;
+  ChromeTraceWriter writer(options, &out);
+  vartrace::VisitMessages(vartrace::TraceView(
+      &dump[0], dump.size()*sizeof(AlignmentType)), &writer);
+  EXPECT_TRUE(writer.Finish());
+  *event_count = writer.event_count();
+  return out.str();
+}
+
+//! Number of occurrences of text in JSON.
+std::size_t Count(const std::string &json, const std::string &text) {
+  std::size_t count = 0;
+  for (std::size_t position = json.find(text); position != std::string::npos;
+       position = json.find(text, position + 1)) {
+    ++count;
+  }
+  return count;
+}
+}  // unnamed namespace
+
+//! Logged values, strings and subtraces become events.
+TEST(ChromeTraceTest, EventsTest) {
+  vartrace::VarTrace<> trace(0x1000);
+  for (int i = 0; i < 5; ++i) {
+    trace.Log(vartrace::kInfoLevel, 7, 0.5*i);
+    trace.Log(vartrace::kInfoLevel, 8, "text");
+    vartrace::SubtraceGuard<vartrace::VarTrace<> > guard(&trace, 3);
+    trace.Log(vartrace::kInfoLevel, 9, i);
+  }
+  std::vector<AlignmentType> dump(0x400);
+  dump.resize(trace.DumpInto(&dump[0], dump.size()*sizeof(AlignmentType))
+              /sizeof(AlignmentType));
+  ChromeTraceOptions options;
+  options.format = vartrace::kChromeObjectFormat;
+  options.process_name = "test \"process\"";
+  std::size_t event_count;
+  std::string json = Export(dump, options, &event_count);
+  ASSERT_EQ("{\"traceEvents\":[\n", json.substr(0, 17));
+  ASSERT_EQ("\n]}\n", json.substr(json.size() - 4));
+  ASSERT_EQ(1 + 5*4, event_count);
+  ASSERT_EQ(1, Count(json, "\"process_name\""));
+  ASSERT_EQ(1, Count(json, "test \\\"process\\\""));
+  ASSERT_EQ(10, Count(json, "\"ph\":\"C\","));
+  ASSERT_EQ(5, Count(json, "\"name\":\"7\",\"args\":{\"value\":"));
+  ASSERT_EQ(5, Count(json, "\"name\":\"3/9\""));
+  ASSERT_EQ(5, Count(json, "\"ph\":\"i\","));
+  ASSERT_EQ(5, Count(json, "\"name\":\"text\""));
+  ASSERT_EQ(5, Count(json, "\"ph\":\"X\","));
+  ASSERT_EQ(5, Count(json, "\"name\":\"subtrace 3\""));
+  ASSERT_EQ(2, Count(json, "\"args\":{\"value\":2}"));
+  ASSERT_EQ(1, Count(json, "\"args\":{\"value\":1.5}"));
+}
+
+//! Span ids become begin and end events, times are unwrapped.
+TEST(ChromeTraceTest, SpanTest) {
+  std::vector<AlignmentType> dump;
+  const char name[] = "work";
+  int value = 4;
+  Append(0xfffffff0u, 10, vartrace::kTypeIdChar, name, sizeof(name), &dump);
+  Append(0x10, 11, vartrace::kTypeIdInt32, &value, sizeof(value), &dump);
+  Append(0x20, 5, vartrace::kTypeIdInt32, &value, 2, &dump);
+  ChromeTraceOptions options;
+  options.ticks_per_microsecond = 16;
+  options.spans.push_back(std::make_pair(10, 11));
+  std::size_t event_count;
+  std::string json = Export(dump, options, &event_count);
+  ASSERT_EQ("[\n", json.substr(0, 2));
+  ASSERT_EQ("\n]\n", json.substr(json.size() - 3));
+  // truncated value is skipped
+  ASSERT_EQ(2, event_count);
+  ASSERT_EQ(1, Count(json, "{\"ph\":\"B\",\"ts\":268435455,"));
+  ASSERT_EQ(1, Count(json, "\"name\":\"work\"}"));
+  ASSERT_EQ(1, Count(json, "{\"ph\":\"E\",\"ts\":268435457,"));
+  ASSERT_EQ(1, Count(json, "\"args\":{\"value\":4}}"));
+}
@@ -0,0 +1,136 @@
+//! \file columnar_test.cc
+
+// Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//!  \brief Columnar export tests.
+
+#include <gtest/gtest.h>
+
+#include "dump_fixture.h"
+
+#include <vartrace/vartrace.h>
+#include <vartrace/byte_order.h>
+#include <vartrace/columnar.h>
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using vartrace::VarTrace;
+using vartrace::SubtraceGuard;
+using vartrace::kInfoLevel;
+using vartrace::Column;
+
+//! Columnar export test suite, dumps a trace with subtraces.
+class ColumnarTestSuite : public DumpTestSuite {
+ protected:
+  //! Fill trace, dump it and extract columns.
+  virtual void SetUp() {
+    VarTrace<> trace(0x1000);
+    int16_t shorts[] = {1, -2, 3};
+    for (int i = 0; i < 10; ++i) {
+      trace.Log(kInfoLevel, 17, 0.5*i);
+      trace.Log(kInfoLevel, 17, i);
+      trace.Log(kInfoLevel, 1, "text");
+      SubtraceGuard<VarTrace<> > guard(&trace, 4);
+      trace.Log(kInfoLevel, 17, 1.5*i);
+      trace.Log(kInfoLevel, 2, shorts, i % 4);
+    }
+    Dump(&trace, 0x1000);
+    builder.Add(view());
+  }
+
+  vartrace::ColumnBuilder builder; //!< Columns of the dump.
+};
+
+//! Values are grouped by path and type.
+TEST_F(ColumnarTestSuite, ExtractTest) {
+  const std::vector<Column> &columns = builder.columns();
+  ASSERT_EQ(4, columns.size());
+  ASSERT_EQ("17:double", columns[0].name);
+  ASSERT_EQ("17:int32", columns[1].name);
+  ASSERT_EQ("4/17:double", columns[2].name);
+  ASSERT_EQ("4/2:int16", columns[3].name);
+  ASSERT_EQ(10, builder.skipped_count());
+  ASSERT_EQ(2, columns[2].path.size());
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_EQ(0.5*i, columns[0].values<double>()[i]);
+    ASSERT_EQ(i, columns[1].values<int32_t>()[i]);
+    ASSERT_EQ(1.5*i, columns[2].values<double>()[i]);
+    // message and its subtrace are logged one after another
+    ASSERT_LT(columns[0].timestamps[i], columns[2].timestamps[i]);
+  }
+  // arrays of 0, 1, 2, 3, 0, ... elements
+  ASSERT_EQ(0 + 1 + 2 + 3 + 0 + 1 + 2 + 3 + 0 + 1, columns[3].size());
+  ASSERT_EQ(1, columns[3].values<int16_t>()[0]);
+  ASSERT_EQ(-2, columns[3].values<int16_t>()[2]);
+  ASSERT_EQ(columns[3].timestamps[1], columns[3].timestamps[2]);
+}
+
+//! CSV contains one row per value.
+TEST_F(ColumnarTestSuite, CsvTest) {
+  std::ostringstream out;
+  ASSERT_TRUE(vartrace::WriteColumnsCsv(builder.columns(), &out));
+  std::istringstream in(out.str());
+  std::string line;
+  std::getline(in, line);
+  ASSERT_EQ("column,timestamp,value", line);
+  std::getline(in, line);
+  std::ostringstream expected;
+  expected << "17:double," << builder.columns()[0].timestamps[0] << ",0";
+  ASSERT_EQ(expected.str(), line);
+  std::size_t row_count = 0;
+  while (std::getline(in, line)) {
+    ++row_count;
+  }
+  ASSERT_EQ(10 + 10 + 10 + 13 - 1, row_count);
+}
+
+//! Binary file header points to aligned arrays.
+TEST_F(ColumnarTestSuite, ColumnFileTest) {
+  std::ostringstream out;
+  ASSERT_TRUE(vartrace::WriteColumnFile(builder.columns(), &out));
+  std::string file = out.str();
+  ASSERT_EQ("VTCOLS01", file.substr(0, 8));
+  const char *position = file.data() + 8;
+  uint32_t words[2];
+  std::memcpy(words, position, sizeof(words));
+  position += sizeof(words);
+  ASSERT_EQ(vartrace::kByteOrderMark, words[0]);
+  ASSERT_EQ(4, words[1]);
+  for (int i = 0; i < 4; ++i) {
+    const Column &column = builder.columns()[i];
+    uint32_t name_size;
+    std::memcpy(&name_size, position, sizeof(name_size));
+    position += sizeof(name_size);
+    ASSERT_EQ(column.name, std::string(position, name_size));
+    position += name_size;
+    ASSERT_EQ(column.data_type_id, static_cast<uint8_t>(position[1]));
+    ASSERT_EQ(column.element_size, static_cast<uint8_t>(position[2]));
+    position += 4;
+    uint64_t fields[3];
+    std::memcpy(fields, position, sizeof(fields));
+    position += sizeof(fields);
+    ASSERT_EQ(column.size(), fields[0]);
+    ASSERT_EQ(0, fields[1] % 8);
+    ASSERT_EQ(0, fields[2] % 8);
+    ASSERT_EQ(0, std::memcmp(file.data() + fields[1], &column.timestamps[0],
+                             column.size()*sizeof(uint32_t)));
+    ASSERT_EQ(0, std::memcmp(file.data() + fields[2], &column.data[0],
+                             column.size()*column.element_size));
+  }
+}
@@ -0,0 +1,127 @@
+//! \file counters_test.cc
+
+// Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//!  \brief Trace self instrumentation tests.
+
+#include <gtest/gtest.h>
+
+#include <vartrace/vartrace.h>
+#include <vartrace/message_view.h>
+#include <vartrace/validating_parser.h>
+
+#include <cstring>
+#include <vector>
+
+using vartrace::VarTrace;
+using vartrace::SingleThreaded;
+using vartrace::User5LogLevel;
+using vartrace::RelaxedCounting;
+using vartrace::SubtraceGuard;
+using vartrace::MessageView;
+using vartrace::TraceCounters;
+using vartrace::kInfoLevel;
+
+namespace {
+//! Trace with counters compiled in.
+typedef VarTrace<User5LogLevel, SingleThreaded, RelaxedCounting> CountedTrace;
+}  // unnamed namespace
+
+//! Records, bytes and laps are counted.
+TEST(TraceCountersTest, RecordTest) {
+  CountedTrace trace(0x400);
+  ASSERT_EQ(0x100, trace.block_count()*trace.block_size()/sizeof(uint32_t));
+  TraceCounters counters = trace.Stats();
+  ASSERT_EQ(1, counters.is_counting);
+  ASSERT_EQ(0, counters.record_count);
+  // three words per message, lap after 86 messages
+  for (int i = 0; i < 100; ++i) {
+    trace.Log(kInfoLevel, 1, i);
+  }
+  counters = trace.Stats();
+  ASSERT_EQ(100, counters.record_count);
+  ASSERT_EQ(100*3*sizeof(uint32_t), counters.byte_count);
+  ASSERT_EQ(1, counters.lap_count);
+  ASSERT_EQ(0, counters.max_subtrace_depth);
+  {
+    SubtraceGuard<CountedTrace> outer(&trace, 2);
+    SubtraceGuard<CountedTrace> inner(&trace, 3);
+    trace.Log(kInfoLevel, 1, 0.5);
+  }
+  counters = trace.Stats();
+  ASSERT_EQ(101, counters.record_count);
+  ASSERT_EQ(2, counters.max_subtrace_depth);
+}
+
+//! Dump counts data skipped at the slot boundary.
+TEST(TraceCountersTest, DumpTest) {
+  CountedTrace trace(0x400, 4);
+  std::vector<uint32_t> buffer(0x100);
+  trace.Log(kInfoLevel, 1, 1);
+  trace.DumpInto(&buffer[0], buffer.size()*sizeof(uint32_t));
+  // nothing is lost before the first lap
+  ASSERT_EQ(1, trace.Stats().dump_count);
+  ASSERT_EQ(0, trace.Stats().dump_skipped_bytes);
+  for (int i = 0; i < 100; ++i) {
+    trace.Log(kInfoLevel, 1, i);
+  }
+  unsigned size = trace.DumpInto(&buffer[0], buffer.size()*sizeof(uint32_t));
+  TraceCounters counters = trace.Stats();
+  ASSERT_EQ(2, counters.dump_count);
+  ASSERT_LT(0, counters.dump_skipped_bytes);
+  ASSERT_EQ(0x100*sizeof(uint32_t), size + counters.dump_skipped_bytes);
+}
+
+//! Counters are stored as a record of reserved type.
+TEST(TraceCountersTest, LogTest) {
+  CountedTrace trace(0x1000);
+  trace.Log(kInfoLevel, 1, 1);
+  trace.Log(kInfoLevel, 1, 2);
+  trace.LogCounters(kInfoLevel, 9);
+  std::vector<uint32_t> buffer(0x100);
+  buffer.resize(trace.DumpInto(&buffer[0], buffer.size()*sizeof(uint32_t))
+                /sizeof(uint32_t));
+  vartrace::TraceView view(&buffer[0], buffer.size()*sizeof(uint32_t));
+  std::vector<MessageView> messages(view.begin(), view.end());
+  ASSERT_EQ(3, messages.size());
+  ASSERT_EQ(9, messages[2].message_type_id());
+  ASSERT_EQ(vartrace::kTypeIdCounters, messages[2].data_type_id());
+  ASSERT_EQ(sizeof(TraceCounters), messages[2].data_size());
+  TraceCounters counters;
+  std::memcpy(&counters, messages[2].data(), sizeof(counters));
+  ASSERT_EQ(1, counters.is_counting);
+  ASSERT_EQ(2, counters.record_count);
+  ASSERT_EQ(3, trace.Stats().record_count);
+  // counters are a known type for the validating parser
+  vartrace::ValidationOptions options;
+  options.known_types_only = true;
+  std::vector<vartrace::SkippedRange> skipped;
+  ASSERT_EQ(3, vartrace::ValidatingParse(view, &skipped, options).size());
+  ASSERT_TRUE(skipped.empty());
+}
+
+//! Default trace reports only drop counters.
+TEST(TraceCountersTest, DisabledTest) {
+  VarTrace<> trace(0x400);
+  for (int i = 0; i < 100; ++i) {
+    trace.Log(kInfoLevel, 1, i);
+  }
+  TraceCounters counters = trace.Stats();
+  ASSERT_EQ(0, counters.is_counting);
+  ASSERT_EQ(0, counters.record_count);
+  ASSERT_EQ(0, counters.lap_count);
+  ASSERT_EQ(0, counters.dropped_message_count);
+}
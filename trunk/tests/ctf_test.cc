@@ -0,0 +1,247 @@
+//! \file ctf_test.cc
+
+// Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//!  \brief CTF conversion tests.
+
+#include <gtest/gtest.h>
+
+#include <vartrace/vartrace.h>
+#include <vartrace/ctf.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using vartrace::CtfOptions;
+using vartrace::CtfWriter;
+
+namespace {
+//! Point logged as a user type.
+struct Point {
+  double x; //!< First coordinate.
+  double y; //!< Second coordinate.
+};
+}  // unnamed namespace
+
+VARTRACE_SET_TYPEID(Point, 0x20);
+
+namespace {
+//! Copy value from stream at position and advance position.
+template <typename T> T Read(const std::string &stream,
+                             std::size_t *position) {
+  T value;
+  std::memcpy(&value, stream.data() + *position, sizeof(value));
+  *position += sizeof(value);
+  return value;
+}
+
+//! Times of int32 and subtrace events of a stream in order.
+std::vector<uint64_t> EventTimes(const std::string &stream) {
+  std::vector<uint64_t> times;
+  std::size_t packet = 0;
+  while (packet < stream.size()) {
+    // magic, uuid, stream id, begin and end times, content size
+    std::size_t position = packet + 4 + 16 + 4 + 2*8;
+    uint64_t content_size = Read<uint64_t>(stream, &position);
+    position += sizeof(uint64_t);
+    while (position < packet + content_size/8) {
+      uint16_t id = Read<uint16_t>(stream, &position);
+      times.push_back(Read<uint64_t>(stream, &position));
+      position += Read<uint8_t>(stream, &position) + 1;
+      if (id == vartrace::kTypeIdInt32) {
+        position += 4*Read<uint16_t>(stream, &position);
+      } else if (id == vartrace::kTypeIdIllegal) {
+        position += sizeof(uint16_t);
+      }
+    }
+    packet = position;
+  }
+  return times;
+}
+}  // unnamed namespace
+
+//! CTF conversion test suite, converts a trace with subtraces.
+class CtfTestSuite : public ::testing::Test {
+ protected:
+  //! Fill trace and convert its dump with small packets.
+  virtual void SetUp() {
+    vartrace::VarTrace<> trace(0x1000);
+    Point point = {1.5, -2};
+    for (int i = 0; i < 20; ++i) {
+      trace.Log(vartrace::kInfoLevel, 7, i);
+      vartrace::SubtraceGuard<vartrace::VarTrace<> > guard(&trace, 3);
+      trace.Log(vartrace::kInfoLevel, 8, "text");
+      trace.Log(vartrace::kInfoLevel, 9, point);
+    }
+    std::vector<uint32_t> dump(0x400);
+    dump.resize(trace.DumpInto(&dump[0], dump.size()*sizeof(uint32_t))
+                /sizeof(uint32_t));
+    CtfOptions options;
+    options.packet_size = 0x80;
+    options.user_types.push_back(vartrace::CtfUserType(
+        0x20, "point", sizeof(Point), "float64_t x; float64_t y;"));
+    std::ostringstream out;
+    CtfWriter writer(options, &out);
+    vartrace::VisitMessages(vartrace::TraceView(
+        &dump[0], dump.size()*sizeof(uint32_t)), &writer);
+    ASSERT_TRUE(writer.Finish());
+    event_count = writer.event_count();
+    std::memcpy(uuid, writer.uuid(), sizeof(uuid));
+    metadata = writer.Metadata();
+    stream = out.str();
+  }
+
+  std::size_t event_count; //!< Number of written events.
+  uint8_t uuid[16]; //!< Trace uuid.
+  std::string metadata; //!< TSDL text.
+  std::string stream; //!< Packets.
+};
+
+//! Metadata declares the clock and events of standard and user types.
+TEST_F(CtfTestSuite, MetadataTest) {
+  ASSERT_EQ(0, metadata.find("/* CTF 1.8 */"));
+  ASSERT_NE(std::string::npos, metadata.find("freq = 1000000000;"));
+  ASSERT_NE(std::string::npos, metadata.find(
+      "name = \"int32\";\n\tid = 5;"));
+  ASSERT_NE(std::string::npos, metadata.find(
+      "name = \"subtrace_begin\";\n\tid = 0;"));
+  ASSERT_NE(std::string::npos, metadata.find(
+      "name = \"point\";\n\tid = 32;"));
+  ASSERT_NE(std::string::npos, metadata.find(
+      "struct {float64_t x; float64_t y;} values[length];"));
+  char text[3];
+  std::snprintf(text, sizeof(text), "%02x", uuid[0]);
+  ASSERT_EQ(text, metadata.substr(metadata.find("uuid = \"") + 8, 2));
+}
+
+//! Packets hold all events in order.
+TEST_F(CtfTestSuite, StreamTest) {
+  ASSERT_EQ(20*5, event_count);
+  std::size_t packet = 0;
+  std::size_t packet_count = 0;
+  std::vector<unsigned> ids;
+  uint64_t last_time = 0;
+  while (packet < stream.size()) {
+    std::size_t position = packet;
+    ASSERT_EQ(0xc1fc1fc1, Read<uint32_t>(stream, &position));
+    ASSERT_EQ(0, std::memcmp(stream.data() + position, uuid, sizeof(uuid)));
+    position += sizeof(uuid);
+    ASSERT_EQ(0, Read<uint32_t>(stream, &position));
+    uint64_t begin = Read<uint64_t>(stream, &position);
+    uint64_t end = Read<uint64_t>(stream, &position);
+    uint64_t content_size = Read<uint64_t>(stream, &position);
+    ASSERT_EQ(content_size, Read<uint64_t>(stream, &position));
+    ASSERT_EQ(0, content_size % 8);
+    ASSERT_GE(stream.size(), packet + content_size/8);
+    while (position < packet + content_size/8) {
+      ids.push_back(Read<uint16_t>(stream, &position));
+      uint64_t time = Read<uint64_t>(stream, &position);
+      ASSERT_LE(begin, time);
+      ASSERT_GE(end, time);
+      ASSERT_LE(last_time, time);
+      last_time = time;
+      uint8_t depth = Read<uint8_t>(stream, &position);
+      position += depth;
+      uint8_t message_id = Read<uint8_t>(stream, &position);
+      switch (ids.back()) {
+        case vartrace::kTypeIdInt32:
+          ASSERT_EQ(7, message_id);
+          ASSERT_EQ(1, Read<uint16_t>(stream, &position));
+          ASSERT_EQ(ids.size()/5, Read<int32_t>(stream, &position));
+          break;
+        case vartrace::kTypeIdIllegal:
+          ASSERT_EQ(3, message_id);
+          ASSERT_EQ(0, depth);
+          position += sizeof(uint16_t);
+          break;
+        case vartrace::kTypeIdChar:
+          ASSERT_EQ(1, depth);
+          ASSERT_EQ(5, Read<uint16_t>(stream, &position));
+          ASSERT_EQ(0, std::memcmp(stream.data() + position, "text", 5));
+          position += 5;
+          break;
+        case 0x20:
+          ASSERT_EQ(1, Read<uint16_t>(stream, &position));
+          ASSERT_EQ(1.5, Read<double>(stream, &position));
+          ASSERT_EQ(-2, Read<double>(stream, &position));
+          break;
+        case vartrace::kCtfSubtraceEndId:
+          ASSERT_EQ(3, message_id);
+          break;
+        default:
+          FAIL() << "unexpected event " << ids.back();
+      }
+    }
+    ASSERT_EQ(packet + content_size/8, position);
+    packet = position;
+    ++packet_count;
+  }
+  ASSERT_LT(5, packet_count);
+  ASSERT_EQ(event_count, ids.size());
+  const unsigned expected[] = {vartrace::kTypeIdInt32, vartrace::kTypeIdIllegal,
+                               vartrace::kTypeIdChar, 0x20,
+                               vartrace::kCtfSubtraceEndId};
+  for (std::size_t i = 0; i < ids.size(); ++i) {
+    ASSERT_EQ(expected[i % 5], ids[i]);
+  }
+}
+
+//! Subtraces committed after messages of other threads keep time order.
+TEST(CtfTest, InterleavedThreadsTest) {
+  typedef vartrace::VarTrace<vartrace::User5LogLevel,
+                             vartrace::MultiThreaded> Trace;
+  const int kSubtraceCount = 10;
+  Trace trace(0x1000);
+  std::atomic<int> begun(0);
+  std::atomic<int> logged(0);
+  // each subtrace begins before and ends after a top level message
+  std::thread subtrace_thread([&]() {
+      for (int i = 0; i < kSubtraceCount; ++i) {
+        vartrace::SubtraceGuard<Trace> guard(&trace, 3);
+        trace.Log(vartrace::kInfoLevel, 4, i);
+        ++begun;
+        while (logged.load() != i + 1) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  for (int i = 0; i < kSubtraceCount; ++i) {
+    while (begun.load() != i + 1) {
+      std::this_thread::yield();
+    }
+    trace.Log(vartrace::kInfoLevel, 5, i);
+    ++logged;
+  }
+  subtrace_thread.join();
+  std::vector<uint32_t> dump(0x400);
+  dump.resize(trace.DumpInto(&dump[0], dump.size()*sizeof(uint32_t))
+              /sizeof(uint32_t));
+  std::ostringstream out;
+  CtfWriter writer(CtfOptions(), &out);
+  vartrace::VisitMessages(vartrace::TraceView(
+      &dump[0], dump.size()*sizeof(uint32_t)), &writer);
+  ASSERT_TRUE(writer.Finish());
+  std::vector<uint64_t> times = EventTimes(out.str());
+  ASSERT_EQ(4*kSubtraceCount, times.size());
+  for (std::size_t i = 1; i < times.size(); ++i) {
+    ASSERT_LE(times[i - 1], times[i]);
+  }
+}
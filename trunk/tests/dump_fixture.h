@@ -0,0 +1,52 @@
+//! \file dump_fixture.h
+
+// Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//!  \brief Common base of test suites that parse a dumped trace.
+
+// Suites fill a trace in SetUp(), call Dump() and check the buffer
+// through view() or size().
+
+#ifndef TRUNK_TESTS_DUMP_FIXTURE_H_
+#define TRUNK_TESTS_DUMP_FIXTURE_H_
+
+#include <gtest/gtest.h>
+
+#include <vartrace/message_view.h>
+
+#include <stdint.h>
+#include <cstddef>
+#include <vector>
+
+//! Test suite that keeps a dump of a trace.
+class DumpTestSuite : public ::testing::Test {
+ protected:
+  //! Dump trace into the buffer, at most given number of bytes.
+  template <class Trace> void Dump(Trace *trace, std::size_t max_size) {
+    buffer.resize(max_size/sizeof(uint32_t));
+    buffer.resize(trace->DumpInto(&buffer[0], max_size)/sizeof(uint32_t));
+  }
+  //! Size of the dump in bytes.
+  std::size_t size() const {return buffer.size()*sizeof(uint32_t);}
+  //! View of the whole dump.
+  vartrace::TraceView view() const {
+    return vartrace::TraceView(&buffer[0], size());
+  }
+
+  std::vector<uint32_t> buffer; //!< Dumped trace.
+};
+
+#endif  // TRUNK_TESTS_DUMP_FIXTURE_H_
@@ -0,0 +1,122 @@
+//! \file flat_parsed_trace_test.cc
+
+// Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//!  \brief Flat parsed trace tests.
+
+#include <gtest/gtest.h>
+
+#include "dump_fixture.h"
+
+#include <vartrace/vartrace.h>
+#include <vartrace/messageparser.h>
+#include <vartrace/flat_parsed_trace.h>
+
+#include <cstring>
+#include <vector>
+
+using vartrace::VarTrace;
+using vartrace::SubtraceGuard;
+using vartrace::kInfoLevel;
+using vartrace::Message;
+using vartrace::FlatParsedTrace;
+
+//! Compare messages on one level, return index after the last one.
+uint32_t ExpectSameLevel(const std::vector<Message::Pointer> &messages,
+                         const FlatParsedTrace &flat, uint32_t index,
+                         uint32_t end) {
+  for (std::size_t i = 0; i < messages.size(); ++i) {
+    const Message &message = *messages[i];
+    EXPECT_GT(end, index);
+    EXPECT_EQ(message.timestamp(), flat[index].timestamp);
+    EXPECT_EQ(message.message_type_id(), flat[index].message_type_id);
+    EXPECT_EQ(message.data_type_id(), flat[index].data_type_id);
+    EXPECT_EQ(message.data_size(), flat[index].data_size);
+    EXPECT_EQ(message.has_children(), flat.has_children(index));
+    if (message.data_type_id() != 0) {
+      EXPECT_EQ(0, std::memcmp(message.pointer<char>(), flat.data(index),
+                               message.data_size()));
+    } else {
+      EXPECT_EQ(flat.next_sibling(index),
+                ExpectSameLevel(message.children(), flat,
+                                flat.first_child(index),
+                                flat.next_sibling(index)));
+    }
+    index = flat.next_sibling(index);
+  }
+  return index;
+}
+
+//! Flat parsed trace test suite, dumps a trace with subtraces.
+class FlatParsedTraceTestSuite : public DumpTestSuite {
+ protected:
+  //! Fill trace and dump it.
+  virtual void SetUp() {
+    VarTrace<> trace(0x1000);
+    char chars[] = "abcdefgh";
+    for (int i = 0; i < 20; ++i) {
+      trace.Log(kInfoLevel, 1, i);
+      SubtraceGuard<VarTrace<> > guard(&trace, 2);
+      trace.Log(kInfoLevel, 3, chars, i % 8);
+      trace.BeginSubtrace(4);
+      trace.Log(kInfoLevel, 5, 2.5*i);
+      trace.EndSubtrace();
+      trace.BeginSubtrace(6);
+      trace.EndSubtrace();
+    }
+    Dump(&trace, 0x1000);
+  }
+};
+
+//! Flat trace holds the same messages as ParsedVartrace.
+TEST_F(FlatParsedTraceTestSuite, CompareWithParsedTest) {
+  vartrace::ParsedVartrace parsed(&buffer[0], size());
+  FlatParsedTrace flat(&buffer[0], size());
+  ASSERT_EQ(parsed.messages().size(), flat.top_level_count());
+  // each iteration has 6 messages
+  ASSERT_EQ(6*flat.top_level_count()/2, flat.size());
+  ASSERT_EQ(flat.size(), ExpectSameLevel(parsed.messages(), flat, 0,
+                                         flat.size()));
+}
+
+//! Values are read from the payload arena.
+TEST_F(FlatParsedTraceTestSuite, ValueTest) {
+  FlatParsedTrace flat(view());
+  buffer.assign(buffer.size(), 0);
+  // first message of the last iteration
+  uint32_t index = flat.size() - 6;
+  ASSERT_EQ(19, flat.value<int>(index));
+  index = flat.next_sibling(index);
+  ASSERT_EQ(2, flat[index].message_type_id);
+  ASSERT_EQ(flat.size(), flat.next_sibling(index));
+  index = flat.first_child(index);
+  ASSERT_EQ(3, flat[index].data_size);
+  ASSERT_EQ(0, std::memcmp("abc", flat.pointer<char>(index), 3));
+  index = flat.next_sibling(index);
+  ASSERT_TRUE(flat.has_children(index));
+  ASSERT_EQ(47.5, flat.value<double>(flat.first_child(index)));
+  index = flat.next_sibling(index);
+  ASSERT_EQ(6, flat[index].message_type_id);
+  ASSERT_FALSE(flat.has_children(index));
+  ASSERT_EQ(flat.size(), flat.next_sibling(index));
+}
+
+//! Empty trace.
+TEST_F(FlatParsedTraceTestSuite, EmptyTest) {
+  FlatParsedTrace flat(&buffer[0], 0);
+  ASSERT_EQ(0, flat.size());
+  ASSERT_EQ(0, flat.top_level_count());
+}
@@ -199,7 +199,7 @@ bool create_path(const fs::path &path) {
 //! Create trace, use generator to fill it and dump into file at given path.
 bool generate(const std::string &file_path, SampleGenerator sample_generator) {
   cout << "Generating " << file_path << " ...\n";
-  vt::VarTrace<> trace =  vt::VarTrace<>(kTraceSize);
+  vt::VarTrace<> trace(kTraceSize);
   sample_generator(&trace);
   size_t dumped_size = trace.DumpInto(dump_buffer, kDumpBufferSize);
   assert(dumped_size <= kDumpBufferSize);
@@ -0,0 +1,104 @@
+//! \file lazy_parser_test.cc
+
+// Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//!  \brief Lazy parsing tests.
+
+#include <gtest/gtest.h>
+
+#include "dump_fixture.h"
+
+#include <vartrace/vartrace.h>
+#include <vartrace/messageparser.h>
+
+#include <cstring>
+#include <vector>
+
+using vartrace::VarTrace;
+using vartrace::SubtraceGuard;
+using vartrace::kInfoLevel;
+using vartrace::Message;
+using vartrace::ParsedVartrace;
+
+//! Compare headers, data and children of two messages.
+void ExpectSameMessage(const Message &expected, const Message &message) {
+  ASSERT_EQ(expected.is_nested(), message.is_nested());
+  ASSERT_EQ(expected.timestamp(), message.timestamp());
+  ASSERT_EQ(expected.message_type_id(), message.message_type_id());
+  ASSERT_EQ(expected.data_type_id(), message.data_type_id());
+  ASSERT_EQ(expected.data_size(), message.data_size());
+  ASSERT_EQ(expected.message_size(), message.message_size());
+  ASSERT_EQ(expected.has_children(), message.has_children());
+  if (expected.data_type_id() != 0) {
+    ASSERT_EQ(0, std::memcmp(expected.pointer<char>(),
+                             message.pointer<char>(), expected.data_size()));
+  }
+  ASSERT_EQ(expected.children().size(), message.children().size());
+  for (std::size_t i = 0; i < expected.children().size(); ++i) {
+    ExpectSameMessage(*expected.children()[i], *message.children()[i]);
+  }
+}
+
+//! Lazy parser test suite, dumps a trace with subtraces.
+class LazyParserTestSuite : public DumpTestSuite {
+ protected:
+  //! Fill trace and dump it.
+  virtual void SetUp() {
+    VarTrace<> trace(0x1000);
+    char chars[] = "abcdefg";
+    trace.Log(kInfoLevel, 1, 0x12345678);
+    {
+      SubtraceGuard<VarTrace<> > guard(&trace, 2);
+      trace.Log(kInfoLevel, 3, chars);
+      trace.BeginSubtrace(4);
+      trace.Log(kInfoLevel, 5, 2.5);
+      trace.EndSubtrace();
+      trace.BeginSubtrace(6);
+      trace.EndSubtrace();
+    }
+    trace.Log(kInfoLevel, 7, 9.5);
+    Dump(&trace, 0x1000);
+  }
+};
+
+//! Lazy and eager parsing give the same messages.
+TEST_F(LazyParserTestSuite, CompareWithEagerTest) {
+  ParsedVartrace eager(&buffer[0], size());
+  ParsedVartrace lazy(&buffer[0], size(), vartrace::kLazyParse);
+  ASSERT_EQ(3, lazy.messages().size());
+  ASSERT_EQ(eager.messages().size(), lazy.messages().size());
+  for (std::size_t i = 0; i < eager.messages().size(); ++i) {
+    ExpectSameMessage(*eager[i], *lazy[i]);
+  }
+}
+
+//! Headers are available at once, data is copied on first access.
+TEST_F(LazyParserTestSuite, FirstAccessTest) {
+  ParsedVartrace lazy(&buffer[0], size(), vartrace::kLazyParse);
+  ASSERT_EQ(0x12345678, lazy[0]->value<int>());
+  ASSERT_EQ(2, lazy[1]->message_type_id());
+  ASSERT_TRUE(lazy[1]->has_children());
+  // expand only the first level of the subtrace
+  const std::vector<Message::Pointer> &children = lazy[1]->children();
+  ASSERT_EQ(3, children.size());
+  buffer.assign(buffer.size(), 0);
+  // expanded messages own their data, the rest reads the cleared buffer
+  ASSERT_EQ(0x12345678, lazy[0]->value<int>());
+  ASSERT_EQ(3, children.size());
+  ASSERT_EQ(4, children[1]->message_type_id());
+  ASSERT_EQ(0, children[0]->pointer<char>()[0]);
+  ASSERT_EQ(0.0, lazy[2]->value<double>());
+}
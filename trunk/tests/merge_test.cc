@@ -0,0 +1,207 @@
+//! \file merge_test.cc
+
+// Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+//!  \brief Trace merge tests.
+
+#include <gtest/gtest.h>
+
+#include <vartrace/vartrace.h>
+#include <vartrace/byte_order.h>
+#include <vartrace/merge.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+using vartrace::VarTrace;
+using vartrace::kInfoLevel;
+using vartrace::MessageView;
+using vartrace::TraceView;
+using vartrace::MessageIterator;
+using vartrace::MergedMessage;
+using vartrace::TraceMerger;
+
+namespace {
+//! Clock of the first wrapping trace.
+vartrace::TimestampType FirstWrappingClock() {
+  static vartrace::TimestampType time = 0xfffffff0;
+  return time += 2;
+}
+
+//! Clock of the second wrapping trace, ticks between the first one.
+vartrace::TimestampType SecondWrappingClock() {
+  static vartrace::TimestampType time = 0xfffffff1;
+  return time += 2;
+}
+}  // unnamed namespace
+
+//! Merge test suite, logs into two traces in turn.
+class MergeTestSuite : public ::testing::Test {
+ protected:
+  //! Fill traces and dump them.
+  virtual void SetUp() {
+    VarTrace<> first(0x1000);
+    VarTrace<> second(0x1000);
+    for (int i = 0; i < 20; ++i) {
+      first.Log(kInfoLevel, 1, i);
+      second.Log(kInfoLevel, 2, i);
+      second.Log(kInfoLevel, 2, 0.5*i);
+    }
+    Dump(&first, &buffers[0]);
+    Dump(&second, &buffers[1]);
+  }
+
+  //! Dump trace into buffer.
+  void Dump(VarTrace<> *trace, std::vector<uint32_t> *buffer) {
+    buffer->resize(0x400);
+    buffer->resize(trace->DumpInto(&(*buffer)[0],
+                                   buffer->size()*sizeof(uint32_t))
+                   /sizeof(uint32_t));
+  }
+
+  //! View of a dump.
+  TraceView view(int index) const {
+    return TraceView(&buffers[index][0],
+                     buffers[index].size()*sizeof(uint32_t));
+  }
+
+  std::vector<uint32_t> buffers[2]; //!< Dumped traces.
+};
+
+//! Messages come out in timestamp order, sources keep their order.
+TEST_F(MergeTestSuite, OrderTest) {
+  TraceMerger merger;
+  ASSERT_EQ(0, merger.AddSource(view(0)));
+  ASSERT_EQ(1, merger.AddSource(view(1)));
+  MergedMessage message;
+  std::vector<std::size_t> sources;
+  uint64_t previous = 0;
+  while (merger.Next(&message)) {
+    ASSERT_LE(previous, message.timestamp);
+    ASSERT_EQ(message.message.timestamp(), message.timestamp);
+    ASSERT_EQ(message.source + 1, message.message.message_type_id());
+    previous = message.timestamp;
+    sources.push_back(message.source);
+  }
+  ASSERT_EQ(60, sources.size());
+  for (int i = 0; i < 20; ++i) {
+    ASSERT_EQ(0, sources[3*i]);
+    ASSERT_EQ(1, sources[3*i + 1]);
+    ASSERT_EQ(1, sources[3*i + 2]);
+  }
+  ASSERT_FALSE(merger.Next(&message));
+}
+
+//! Corrected clocks decide the order, parts are read in turn.
+TEST_F(MergeTestSuite, ClockTest) {
+  ASSERT_EQ(90, vartrace::ClockCorrection(-10, 0).Apply(100));
+  ASSERT_EQ(101, vartrace::ClockCorrection(0, 10000).Apply(100));
+  ASSERT_EQ(0, vartrace::ClockCorrection(-200, 0).Apply(100));
+  std::vector<TraceView> parts;
+  parts.push_back(TraceView(&buffers[0][0], 6*sizeof(uint32_t)));
+  parts.push_back(TraceView(&buffers[0][6],
+                            (buffers[0].size() - 6)*sizeof(uint32_t)));
+  TraceMerger merger;
+  // second trace is shifted after the end of the first one
+  merger.AddSource(view(1), vartrace::ClockCorrection(1000, 0));
+  merger.AddSource(parts);
+  MergedMessage message;
+  for (int i = 0; i < 20; ++i) {
+    ASSERT_TRUE(merger.Next(&message));
+    ASSERT_EQ(1, message.source);
+    ASSERT_EQ(i, message.message.value<int>());
+  }
+  ASSERT_TRUE(merger.Next(&message));
+  ASSERT_EQ(0, message.source);
+  ASSERT_EQ(message.message.timestamp() + 1000, message.timestamp);
+}
+
+//! Written dump starts with a mark and wraps messages into subtraces.
+TEST_F(MergeTestSuite, WriteTest) {
+  TraceMerger merger;
+  merger.AddSource(view(0));
+  merger.AddSource(view(1));
+  std::ostringstream out;
+  ASSERT_TRUE(vartrace::WriteMerged(&merger, true, &out));
+  std::string dump = out.str();
+  TraceView merged(dump.data(), dump.size());
+  ASSERT_EQ(vartrace::kNativeByteOrder,
+            vartrace::DetectByteOrder(dump.data(), dump.size()));
+  MessageIterator pos = merged.begin();
+  ++pos;
+  for (int i = 0; i < 3; ++i, ++pos) {
+    MessageView subtrace = *pos;
+    ASSERT_EQ(0, subtrace.data_type_id());
+    ASSERT_EQ(i == 0 ? 0 : 1, subtrace.message_type_id());
+    MessageIterator child = subtrace.children().begin();
+    ASSERT_EQ(i == 0 ? 1 : 2, (*child).message_type_id());
+    ASSERT_EQ(i == 2 ? vartrace::kTypeIdDouble : vartrace::kTypeIdInt32,
+              (*child).data_type_id());
+    ASSERT_TRUE(++child == subtrace.children().end());
+  }
+  TraceMerger untagged;
+  untagged.AddSource(view(1));
+  std::ostringstream plain;
+  ASSERT_TRUE(vartrace::WriteMerged(&untagged, false, &plain));
+  ASSERT_EQ(std::string(reinterpret_cast<const char *>(&buffers[1][0]),
+                        buffers[1].size()*sizeof(uint32_t)),
+            plain.str().substr(vartrace::kByteOrderMarkSize));
+}
+
+//! Sources are ordered by unwrapped time after their clocks wrap.
+TEST_F(MergeTestSuite, WrapTest) {
+  VarTrace<> first(0x1000);
+  VarTrace<> second(0x1000);
+  first.SetTimestampFunction(FirstWrappingClock);
+  second.SetTimestampFunction(SecondWrappingClock);
+  for (int i = 0; i < 20; ++i) {
+    first.Log(kInfoLevel, 1, i);
+    second.Log(kInfoLevel, 2, i);
+  }
+  Dump(&first, &buffers[0]);
+  Dump(&second, &buffers[1]);
+  TraceMerger merger;
+  merger.AddSource(view(0));
+  merger.AddSource(view(1), vartrace::ClockCorrection(-2, 0));
+  MergedMessage message;
+  uint64_t previous = 0;
+  for (int i = 0; i < 40; ++i) {
+    ASSERT_TRUE(merger.Next(&message));
+    ASSERT_LE(previous, message.timestamp);
+    ASSERT_EQ(i/2, message.message.value<int>());
+    previous = message.timestamp;
+  }
+  ASSERT_LT(0xffffffffu, previous);
+  ASSERT_FALSE(merger.Next(&message));
+  TraceMerger written;
+  written.AddSource(view(0));
+  written.AddSource(view(1), vartrace::ClockCorrection(-2, 0));
+  std::ostringstream out;
+  ASSERT_TRUE(vartrace::WriteMerged(&written, false, &out));
+  std::string dump = out.str();
+  TraceView merged(dump.data(), dump.size());
+  TraceMerger expected;
+  expected.AddSource(view(0));
+  expected.AddSource(view(1), vartrace::ClockCorrection(-2, 0));
+  MessageIterator pos = merged.begin();
+  for (++pos; expected.Next(&message); ++pos) {
+    ASSERT_EQ(static_cast<vartrace::TimestampType>(message.timestamp),
+              (*pos).timestamp());
+  }
+  ASSERT_TRUE(pos == merged.end());
+}
@@ -0,0 +1,155 @@
+//! \file message_view_test.cc
+
+// Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//!  \brief Zero-copy message view tests.
+
+#include <gtest/gtest.h>
+
+#include "dump_fixture.h"
+
+#include <vartrace/vartrace.h>
+#include <vartrace/messageparser.h>
+#include <vartrace/message_view.h>
+
+#include <vector>
+
+using vartrace::VarTrace;
+using vartrace::SubtraceGuard;
+using vartrace::kInfoLevel;
+using vartrace::Message;
+using vartrace::MessageView;
+using vartrace::MessageIterator;
+using vartrace::TraceView;
+
+//! Compare view with parsed message recursively.
+void ExpectSameMessage(const Message &message, const MessageView &view) {
+  ASSERT_EQ(message.is_nested(), view.is_nested());
+  ASSERT_EQ(message.has_children(), view.has_children());
+  ASSERT_EQ(message.timestamp(), view.timestamp());
+  ASSERT_EQ(message.message_type_id(), view.message_type_id());
+  ASSERT_EQ(message.data_type_id(), view.data_type_id());
+  ASSERT_EQ(message.data_size(), view.data_size());
+  ASSERT_EQ(message.message_size(), view.message_size());
+  if (!view.has_children()) {
+    ASSERT_EQ(0, memcmp(message.pointer<char>(), view.data(),
+                        view.data_size()));
+    return;
+  }
+  TraceView children = view.children();
+  MessageIterator pos = children.begin();
+  for (std::size_t i = 0; i < message.children().size(); ++i, ++pos) {
+    ASSERT_TRUE(pos != children.end());
+    ExpectSameMessage(*message.children()[i], *pos);
+  }
+  ASSERT_TRUE(pos == children.end());
+}
+
+//! Message view test suite, dumps a trace with different messages.
+class MessageViewTestSuite : public DumpTestSuite {
+ protected:
+  //! Fill trace and dump it.
+  virtual void SetUp() {
+    VarTrace<> trace(0x1000);
+    double doubles[] = {1.5, 2.5, 3.5};
+    char chars[] = "abcdefg";
+    trace.Log(kInfoLevel, 1, 0x12345678);
+    trace.Log(kInfoLevel, 2, doubles, 3);
+    {
+      SubtraceGuard<VarTrace<> > guard(&trace, 3);
+      trace.Log(kInfoLevel, 4, static_cast<int8_t>(-5));
+      trace.BeginSubtrace(5);
+      trace.Log(kInfoLevel, 6, chars);
+      trace.EndSubtrace();
+      trace.BeginSubtrace(7);
+      trace.EndSubtrace();
+    }
+    trace.Log(kInfoLevel, 8, 9.5);
+    Dump(&trace, 0x1000);
+  }
+};
+
+//! Fields of the views match messages parsed with copying.
+TEST_F(MessageViewTestSuite, CompareWithParsedTest) {
+  vartrace::ParsedVartrace parsed(&buffer[0], size());
+  MessageIterator pos = view().begin();
+  for (std::size_t i = 0; i < parsed.messages().size(); ++i, ++pos) {
+    ASSERT_TRUE(pos != view().end());
+    ExpectSameMessage(*parsed[i], *pos);
+  }
+  ASSERT_TRUE(pos == view().end());
+}
+
+//! Values are read directly from the dump buffer.
+TEST_F(MessageViewTestSuite, ValueTest) {
+  std::vector<MessageView> messages(view().begin(), view().end());
+  ASSERT_EQ(4, messages.size());
+  ASSERT_EQ(0x12345678, messages[0].value<int>());
+  ASSERT_EQ(&buffer[vartrace::kHeaderLength], messages[0].data());
+  ASSERT_EQ(2.5, messages[1].pointer<double>()[1]);
+  ASSERT_EQ(3*sizeof(double), messages[1].data_size());
+  ASSERT_EQ(9.5, messages[3].value<double>());
+  // value of a shorter type is zero padded
+  ASSERT_EQ(0x5678, messages[0].value<int16_t>());
+  ASSERT_EQ(0x12345678, messages[0].value<int64_t>());
+  // subtrace content
+  ASSERT_TRUE(messages[2].has_children());
+  MessageIterator child = messages[2].children().begin();
+  ASSERT_EQ(-5, (*child).value<int8_t>());
+  ASSERT_TRUE((*child).is_nested());
+  ++child;
+  ASSERT_EQ(5, (*child).message_type_id());
+  ASSERT_STREQ("abcdefg",
+               (*(*child).children().begin()).pointer<char>());
+  ++child;
+  ASSERT_EQ(7, (*child).message_type_id());
+  ASSERT_FALSE((*child).has_children());
+  ASSERT_TRUE((*child).children().empty());
+  ++child;
+  ASSERT_TRUE(child == messages[2].children().end());
+}
+
+//! Iteration stops at the end of a truncated buffer.
+TEST_F(MessageViewTestSuite, TruncatedTest) {
+  TraceView view(&buffer[0], size() - 1);
+  int count = 0;
+  for (MessageIterator pos = view.begin(); pos != view.end(); ++pos) {
+    ++count;
+  }
+  ASSERT_EQ(4, count);
+  ASSERT_TRUE(TraceView().empty());
+  ASSERT_TRUE(TraceView().begin() == TraceView().end());
+}
+
+//! Tail shorter than a header is not decoded as a message.
+TEST_F(MessageViewTestSuite, PartialHeaderTest) {
+  std::size_t whole_size = size();
+  // one word of a following top level header
+  buffer.push_back(0xffffffff);
+  int count = 0;
+  for (MessageIterator pos = view().begin(); pos != view().end(); ++pos) {
+    ASSERT_LT(pos.position(), reinterpret_cast<const uint8_t *>(&buffer[0])
+              + whole_size);
+    ++count;
+  }
+  ASSERT_EQ(4, count);
+  // range with less than a header has no messages
+  TraceView tail(&buffer[0], vartrace::kHeaderSize - 1);
+  ASSERT_TRUE(tail.begin() == tail.end());
+  ASSERT_TRUE(tail.empty());
+  TraceView nested_tail(&buffer[0], vartrace::kNestedHeaderSize - 1, true);
+  ASSERT_TRUE(nested_tail.empty());
+}
@@ -0,0 +1,231 @@
+//! \file overflow_test.cc
+
+// Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//!  \brief Tests of trace overflow policies.
+
+#include <gtest/gtest.h>
+
+#include <vartrace/vartrace.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using vartrace::VarTrace;
+using vartrace::SubtraceGuard;
+using vartrace::kInfoLevel;
+
+namespace {
+//! Trace size in bytes, 64 AlignmentType words.
+const unsigned kTraceSize = 0x100;
+//! Number of blocks in test traces.
+const unsigned kBlockCount = 4;
+//! Length of a logged int message in AlignmentType units.
+const unsigned kIntMessageLength = vartrace::kHeaderLength + 1;
+//! Number of int messages that fit into a test trace.
+const unsigned kIntMessageCount = kTraceSize/sizeof(vartrace::AlignmentType)
+    /kIntMessageLength;
+}  // unnamed namespace
+
+//! Overflow policy test suite, empty.
+class OverflowTestSuite : public ::testing::Test {
+};
+
+//! Policy can be changed only before logging.
+TEST_F(OverflowTestSuite, SetPolicyTest) {
+  VarTrace<> trace(kTraceSize, kBlockCount);
+  uint32_t buffer[0x10];
+  ASSERT_EQ(vartrace::kOverwrite, trace.overflow_policy());
+  ASSERT_EQ(0, trace.DrainInto(buffer, sizeof(buffer)));
+  ASSERT_TRUE(trace.SetOverflowPolicy(vartrace::kDropNew));
+  ASSERT_EQ(vartrace::kDropNew, trace.overflow_policy());
+  trace.Log(kInfoLevel, 1, 1);
+  ASSERT_FALSE(trace.SetOverflowPolicy(vartrace::kOverwrite));
+  ASSERT_EQ(vartrace::kDropNew, trace.overflow_policy());
+}
+
+//! Full trace keeps the first messages and counts the rejected ones.
+TEST_F(OverflowTestSuite, DropNewTest) {
+  VarTrace<> trace(kTraceSize, kBlockCount);
+  uint32_t buffer[0x100];
+  trace.SetOverflowPolicy(vartrace::kDropNew);
+  const unsigned kLoggedCount = kIntMessageCount + 10;
+  for (unsigned i = 0; i < kLoggedCount; ++i) {
+    trace.Log(kInfoLevel, 1, i);
+  }
+  ASSERT_EQ(kLoggedCount - kIntMessageCount, trace.dropped_message_count());
+  unsigned dumped_size = trace.DumpInto(buffer, sizeof(buffer));
+  ASSERT_EQ(kIntMessageCount*kIntMessageLength*sizeof(uint32_t),
+            dumped_size);
+  for (unsigned i = 0; i < kIntMessageCount; ++i) {
+    ASSERT_EQ(i, buffer[i*kIntMessageLength + vartrace::kHeaderLength]);
+  }
+  // dump does not free space
+  trace.Log(kInfoLevel, 1, 0);
+  ASSERT_EQ(kLoggedCount - kIntMessageCount + 1,
+            trace.dropped_message_count());
+}
+
+//! Draining frees space and returns whole messages in order.
+TEST_F(OverflowTestSuite, DrainTest) {
+  VarTrace<> trace(kTraceSize, kBlockCount);
+  uint32_t buffer[0x100];
+  trace.SetOverflowPolicy(vartrace::kDropNew);
+  unsigned logged_value = 0;
+  unsigned drained_value = 0;
+  // messages do not fill the trace completely so rounds wrap around
+  for (unsigned round = 0; round < 10; ++round) {
+    for (unsigned i = 0; i < kIntMessageCount; ++i) {
+      trace.Log(kInfoLevel, 1, logged_value++);
+    }
+    trace.Log(kInfoLevel, 1, 0);
+    ASSERT_EQ(round + 1, trace.dropped_message_count());
+    // buffer that is not a multiple of message size gets one message
+    ASSERT_EQ(kIntMessageLength*sizeof(uint32_t),
+              trace.DrainInto(buffer, (kIntMessageLength + 1)
+                              *sizeof(uint32_t)));
+    ASSERT_EQ(drained_value++, buffer[vartrace::kHeaderLength]);
+    unsigned drained_size = trace.DrainInto(buffer, sizeof(buffer));
+    ASSERT_EQ((kIntMessageCount - 1)*kIntMessageLength*sizeof(uint32_t),
+              drained_size);
+    for (unsigned i = 0; i < kIntMessageCount - 1; ++i) {
+      ASSERT_EQ(drained_value++,
+                buffer[i*kIntMessageLength + vartrace::kHeaderLength]);
+    }
+    ASSERT_EQ(0, trace.DrainInto(buffer, sizeof(buffer)));
+    ASSERT_EQ(0, trace.DumpInto(buffer, sizeof(buffer)));
+  }
+}
+
+//! Writer waits for drainer and nothing is lost.
+TEST_F(OverflowTestSuite, BlockTest) {
+  VarTrace<vartrace::User5LogLevel, vartrace::MultiThreaded> trace(
+      kTraceSize, kBlockCount);
+  trace.SetOverflowPolicy(vartrace::kBlock);
+  const unsigned kLoggedCount = 10000;
+  std::vector<unsigned> values;
+  std::thread drainer([&trace, &values, kLoggedCount]() {
+      uint32_t buffer[0x10];
+      while (values.size() != kLoggedCount) {
+        unsigned size = trace.DrainInto(buffer, sizeof(buffer));
+        if (!size) {
+          std::this_thread::yield();
+        }
+        for (unsigned i = 0; i < size/sizeof(uint32_t);
+             i += kIntMessageLength) {
+          values.push_back(buffer[i + vartrace::kHeaderLength]);
+        }
+      }
+    });
+  for (unsigned i = 0; i < kLoggedCount; ++i) {
+    trace.Log(kInfoLevel, 1, i);
+  }
+  drainer.join();
+  ASSERT_EQ(0, trace.dropped_message_count());
+  for (unsigned i = 0; i < kLoggedCount; ++i) {
+    ASSERT_EQ(i, values[i]);
+  }
+}
+
+//! Waiting forever needs a locking policy.
+TEST_F(OverflowTestSuite, BlockPolicyTest) {
+  VarTrace<> single(kTraceSize, kBlockCount);
+  ASSERT_FALSE(single.SetOverflowPolicy(vartrace::kBlock));
+  ASSERT_TRUE(single.SetOverflowPolicy(vartrace::kBlock, 1000));
+  VarTrace<vartrace::User5LogLevel, vartrace::RealTime> realtime(
+      kTraceSize, kBlockCount);
+  ASSERT_FALSE(realtime.SetOverflowPolicy(vartrace::kBlock));
+  VarTrace<vartrace::User5LogLevel, vartrace::MultiThreaded> locked(
+      kTraceSize, kBlockCount);
+  ASSERT_TRUE(locked.SetOverflowPolicy(vartrace::kBlock));
+}
+
+//! Lock is released while a writer waits, it resumes after a drain.
+TEST_F(OverflowTestSuite, BlockedWriterTest) {
+  VarTrace<vartrace::User5LogLevel, vartrace::MultiThreaded> trace(
+      kTraceSize, kBlockCount);
+  ASSERT_TRUE(trace.SetOverflowPolicy(vartrace::kBlock));
+  for (unsigned i = 0; i < kIntMessageCount; ++i) {
+    trace.Log(kInfoLevel, 1, i);
+  }
+  std::thread writer([&trace]() {
+      trace.Log(kInfoLevel, 1, kIntMessageCount);
+    });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  // dump takes the lock that the waiting writer must not hold
+  uint32_t buffer[0x100];
+  ASSERT_EQ(kIntMessageCount*kIntMessageLength*sizeof(uint32_t),
+            trace.DumpInto(buffer, sizeof(buffer)));
+  ASSERT_EQ(kIntMessageLength*sizeof(uint32_t),
+            trace.DrainInto(buffer, kIntMessageLength*sizeof(uint32_t)));
+  writer.join();
+  ASSERT_EQ(0, trace.dropped_message_count());
+  unsigned size = trace.DrainInto(buffer, sizeof(buffer));
+  ASSERT_EQ(kIntMessageCount*kIntMessageLength*sizeof(uint32_t), size);
+  ASSERT_EQ(kIntMessageCount, buffer[size/sizeof(uint32_t) - 1]);
+}
+
+//! Blocked writer gives up after timeout.
+TEST_F(OverflowTestSuite, BlockTimeoutTest) {
+  VarTrace<> trace(kTraceSize, kBlockCount);
+  trace.SetOverflowPolicy(vartrace::kBlock, 1000);
+  for (unsigned i = 0; i < kIntMessageCount + 2; ++i) {
+    trace.Log(kInfoLevel, 1, i);
+  }
+  ASSERT_EQ(2, trace.dropped_message_count());
+}
+
+//! Subtraces and arrays are rejected as whole messages.
+TEST_F(OverflowTestSuite, SubtraceTest) {
+  VarTrace<> trace(kTraceSize, kBlockCount);
+  uint32_t buffer[0x100];
+  char chars[] = "0123456789";
+  trace.SetOverflowPolicy(vartrace::kDropNew);
+  for (int i = 0; i < 10; ++i) {
+    SubtraceGuard<VarTrace<> > guard(&trace, 1);
+    trace.Log(kInfoLevel, 2, i);
+    trace.Log(kInfoLevel, 3, chars);
+  }
+  // subtrace is 2 + 2 + 4 words long, 8 of them fill the trace
+  ASSERT_EQ(2, trace.dropped_message_count());
+  ASSERT_EQ(0, trace.dropped_subtrace_count());
+  ASSERT_EQ(8*8*sizeof(uint32_t), trace.DumpInto(buffer, sizeof(buffer)));
+  trace.Log(kInfoLevel, 4, chars, 1);
+  ASSERT_EQ(3, trace.dropped_message_count());
+}
+
+//! Data larger than the header size field is rejected, not wrapped.
+TEST_F(OverflowTestSuite, OversizeTest) {
+  VarTrace<> trace(0x40000, kBlockCount);
+  std::vector<uint8_t> data(vartrace::kMaxDataSize + 1, 0x5a);
+  std::vector<uint32_t> buffer(0x10000);
+  trace.Log(kInfoLevel, 1, &data[0], data.size());
+  ASSERT_EQ(1, trace.dropped_message_count());
+  ASSERT_EQ(0, trace.DumpInto(&buffer[0], buffer.size()*sizeof(uint32_t)));
+  // the largest size still fits
+  trace.Log(kInfoLevel, 1, &data[0], vartrace::kMaxDataSize);
+  ASSERT_EQ(1, trace.dropped_message_count());
+  ASSERT_EQ(sizeof(uint32_t)*(vartrace::kHeaderLength
+                              + vartrace::RoundSize(vartrace::kMaxDataSize)),
+            trace.DumpInto(&buffer[0], buffer.size()*sizeof(uint32_t)));
+  ASSERT_EQ(vartrace::kMaxDataSize, buffer[1] & vartrace::kMaxDataSize);
+  {
+    SubtraceGuard<VarTrace<> > guard(&trace, 2);
+    trace.Log(kInfoLevel, 3, &data[0], data.size());
+  }
+  ASSERT_EQ(1, trace.dropped_subtrace_count());
+}
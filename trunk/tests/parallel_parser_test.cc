@@ -0,0 +1,150 @@
+//! \file parallel_parser_test.cc
+
+// Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//!  \brief Parallel parser tests.
+
+#include <gtest/gtest.h>
+
+#include "dump_fixture.h"
+
+#include <vartrace/vartrace.h>
+#include <vartrace/parallel_parser.h>
+
+#include <atomic>
+#include <vector>
+
+using vartrace::VarTrace;
+using vartrace::SubtraceGuard;
+using vartrace::kInfoLevel;
+using vartrace::MessageView;
+using vartrace::TraceView;
+
+namespace {
+//! Size of test dumps, several minimal chunks.
+const unsigned kDumpSize = 0x100000;
+
+//! Start positions of messages found by a sequential walk.
+std::vector<const void *> SequentialPositions(const TraceView &view) {
+  std::vector<const void *> positions;
+  for (vartrace::MessageIterator pos = view.begin(); pos != view.end();
+       ++pos) {
+    positions.push_back((*pos).message());
+  }
+  return positions;
+}
+}  // unnamed namespace
+
+//! Parallel parser test suite, dumps a large trace.
+class ParallelParserTestSuite : public DumpTestSuite {
+ protected:
+  //! Fill trace with messages that contain header-like payloads.
+  virtual void SetUp() {
+    VarTrace<> trace(kDumpSize);
+    // words that look like headers of int messages
+    uint32_t fake_headers[100];
+    for (int i = 0; i < 100; ++i) {
+      fake_headers[i] = (i % 2) ? 0x05010004 : i;
+    }
+    for (int i = 0; i < 5000; ++i) {
+      trace.Log(kInfoLevel, 1, i);
+      trace.Log(kInfoLevel, 2, fake_headers, i % 100);
+      SubtraceGuard<VarTrace<> > guard(&trace, 3);
+      trace.Log(kInfoLevel, 4, fake_headers, (3*i) % 100);
+      trace.Log(kInfoLevel, 5, 0.5*i);
+    }
+    Dump(&trace, kDumpSize);
+  }
+};
+
+//! Result does not depend on number of threads.
+TEST_F(ParallelParserTestSuite, SameAsSequentialTest) {
+  std::vector<const void *> expected = SequentialPositions(view());
+  ASSERT_LT(5000, expected.size());
+  const unsigned kThreadCounts[] = {0, 1, 2, 3, 8};
+  for (unsigned thread_count : kThreadCounts) {
+    std::vector<MessageView> messages =
+        vartrace::ParallelParse(view(), thread_count);
+    ASSERT_EQ(expected.size(), messages.size());
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+      ASSERT_EQ(expected[i], messages[i].message());
+    }
+  }
+}
+
+//! Dump that does not start at a boundary is parsed like sequentially.
+TEST_F(ParallelParserTestSuite, MisalignedStartTest) {
+  TraceView view(&buffer[1], (buffer.size() - 1)*sizeof(uint32_t));
+  std::vector<const void *> expected = SequentialPositions(view);
+  std::vector<MessageView> messages = vartrace::ParallelParse(view, 4);
+  ASSERT_EQ(expected.size(), messages.size());
+  for (std::size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_EQ(expected[i], messages[i].message());
+  }
+}
+
+//! Parts cover all messages in order.
+TEST_F(ParallelParserTestSuite, ForEachTest) {
+  std::size_t expected_count = SequentialPositions(view()).size();
+  std::vector<std::size_t> part_counts(100);
+  std::vector<const void *> part_begins(100);
+  std::atomic<unsigned> part_count(0);
+  vartrace::ParallelForEach(
+      view(), 4, [&](unsigned part_index, const TraceView &part) {
+        part_counts[part_index] = SequentialPositions(part).size();
+        part_begins[part_index] = part.begin().position();
+        ++part_count;
+      });
+  ASSERT_LT(1, part_count);
+  std::size_t total_count = 0;
+  for (unsigned i = 0; i < part_count; ++i) {
+    total_count += part_counts[i];
+    if (i) {
+      ASSERT_LT(part_begins[i - 1], part_begins[i]);
+    }
+  }
+  ASSERT_EQ(expected_count, total_count);
+}
+
+//! Empty and small dumps.
+TEST_F(ParallelParserTestSuite, SmallTest) {
+  ASSERT_TRUE(vartrace::ParallelParse(TraceView(), 4).empty());
+  TraceView view(&buffer[0], 0x100);
+  ASSERT_EQ(SequentialPositions(view).size(),
+            vartrace::ParallelParse(view, 4).size());
+}
+
+//! Header cut by the end of the dump is not decoded.
+TEST_F(ParallelParserTestSuite, CutHeaderTest) {
+  std::vector<const void *> positions = SequentialPositions(view());
+  const uint8_t *begin = reinterpret_cast<const uint8_t *>(&buffer[0]);
+  // one word of the header of the last message is left
+  std::size_t size = static_cast<const uint8_t *>(positions.back()) - begin
+      + sizeof(uint32_t);
+  TraceView cut(begin, size);
+  positions.pop_back();
+  ASSERT_EQ(positions, SequentialPositions(cut));
+  for (unsigned thread_count = 1; thread_count < 8; thread_count *= 2) {
+    std::vector<MessageView> messages = vartrace::ParallelParse(cut,
+                                                                thread_count);
+    ASSERT_EQ(positions.size(), messages.size());
+    for (std::size_t i = 0; i < positions.size(); ++i) {
+      ASSERT_EQ(positions[i], messages[i].message());
+    }
+  }
+  ASSERT_TRUE(vartrace::ParallelParse(TraceView(begin, sizeof(uint32_t)),
+                                      4).empty());
+}
@@ -0,0 +1,183 @@
+//! \file perf_counters.h
+
+// Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//!  \brief Hardware performance counters for benchmarks.
+
+// Counters are opened with perf_event_open for the calling thread and
+// user space only. Events that can not be opened, for example in a
+// container that forbids the system call or on hardware without the
+// event, are skipped and reported as unavailable, the benchmarks run
+// without them. Counts are scaled when the kernel multiplexes events.
+
+#ifndef TRUNK_TESTS_PERF_COUNTERS_H_
+#define TRUNK_TESTS_PERF_COUNTERS_H_
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <stdint.h>
+#include <cstring>
+
+//! Events counted around benchmark cases.
+enum PerfEvent {
+  kPerfCycles,
+  kPerfInstructions,
+  kPerfL1dMisses,
+  kPerfLlcMisses,
+  kPerfDtlbMisses,
+  kPerfBranchMisses,
+  kPerfEventCount
+};
+
+//! Names of events in benchmark output.
+const char *const kPerfEventNames[kPerfEventCount] = {
+  "cycles", "instructions", "l1d_misses", "llc_misses", "dtlb_misses",
+  "branch_misses"
+};
+
+//! Set of counters that accumulate between Start() and Stop() calls.
+class PerfCounters {
+ public:
+  //! Open every event that is available, if is_enabled is true.
+  explicit PerfCounters(bool is_enabled = true) {
+    for (int i = 0; i < kPerfEventCount; ++i) {
+      descriptors_[i] = is_enabled ? Open(static_cast<PerfEvent>(i)) : -1;
+    }
+    Reset();
+  }
+  //! Close counters.
+  ~PerfCounters() {
+#ifdef __linux__
+    for (int i = 0; i < kPerfEventCount; ++i) {
+      if (descriptors_[i] >= 0) {
+        close(descriptors_[i]);
+      }
+    }
+#endif
+  }
+
+  //! True if at least one event is counted.
+  bool is_available() const {
+    for (int i = 0; i < kPerfEventCount; ++i) {
+      if (is_open(i)) {
+        return true;
+      }
+    }
+    return false;
+  }
+  //! True if the event is counted.
+  bool is_open(int event) const { return descriptors_[event] >= 0; }
+  //! Accumulated count of an event.
+  double value(int event) const { return values_[event]; }
+
+  //! Zero accumulated counts.
+  void Reset() {
+    std::memset(values_, 0, sizeof(values_));
+  }
+  //! Start counting.
+  void Start() {
+#ifdef __linux__
+    for (int i = 0; i < kPerfEventCount; ++i) {
+      if (is_open(i)) {
+        ioctl(descriptors_[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(descriptors_[i], PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+#endif
+  }
+  //! Stop counting and add counts since Start().
+  void Stop() {
+#ifdef __linux__
+    for (int i = 0; i < kPerfEventCount; ++i) {
+      if (is_open(i)) {
+        ioctl(descriptors_[i], PERF_EVENT_IOC_DISABLE, 0);
+      }
+    }
+    for (int i = 0; i < kPerfEventCount; ++i) {
+      // value, time enabled and time running
+      uint64_t counts[3];
+      if (!is_open(i)
+          || read(descriptors_[i], counts, sizeof(counts))
+          != sizeof(counts)) {
+        continue;
+      }
+      values_[i] += counts[2] ? static_cast<double>(counts[0])*counts[1]
+          /counts[2] : 0;
+    }
+#endif
+  }
+
+ private:
+  //! Counters can not be copied.
+  PerfCounters(const PerfCounters &);
+  //! Counters can not be copied.
+  PerfCounters &operator=(const PerfCounters &);
+
+  //! Open a disabled user space counter, return -1 on failure.
+  static int Open(PerfEvent event) {
+#ifdef __linux__
+    struct perf_event_attr attributes;
+    std::memset(&attributes, 0, sizeof(attributes));
+    attributes.size = sizeof(attributes);
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+        | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attributes.type = PERF_TYPE_HARDWARE;
+    switch (event) {
+      case kPerfCycles:
+        attributes.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+      case kPerfInstructions:
+        attributes.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+      case kPerfLlcMisses:
+        attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+        break;
+      case kPerfBranchMisses:
+        attributes.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+      case kPerfL1dMisses:
+      case kPerfDtlbMisses:
+        attributes.type = PERF_TYPE_HW_CACHE;
+        attributes.config = (event == kPerfL1dMisses
+                             ? PERF_COUNT_HW_CACHE_L1D
+                             : PERF_COUNT_HW_CACHE_DTLB)
+            | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+            | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+      default:
+        return -1;
+    }
+    long descriptor = syscall(__NR_perf_event_open, &attributes, 0, -1, -1,
+                              0);
+    return descriptor < 0 ? -1 : static_cast<int>(descriptor);
+#else
+    return -1;
+#endif
+  }
+
+  int descriptors_[kPerfEventCount]; //!< Open counters or -1.
+  double values_[kPerfEventCount]; //!< Accumulated scaled counts.
+};
+
+#endif  // TRUNK_TESTS_PERF_COUNTERS_H_
@@ -15,23 +15,40 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
-//! \brief Program for profiling using operf.
+//! \brief Program for profiling int logging.
+
+// Hardware counters per Log call are printed when perf_event_open is
+// available, the loop can also be profiled with operf or perf record.
 
 #include <stdint.h>
 
+#include <iostream>
+
 #include <vartrace/vartrace.h>
+#include <perf_counters.h>
 
 using vartrace::VarTrace;
 using vartrace::kInfoLevel;
 
 int main() {
+  const std::size_t count = 100000000;
   uint32_t value = 123;
-  VarTrace<> trace = VarTrace<>(0x10000, 4);
-  for (std::size_t i = 0; i < 100000000; ++i) {
+  VarTrace<> trace(0x10000, 4);
+  PerfCounters counters;
+  counters.Start();
+  for (std::size_t i = 0; i < count; ++i) {
     trace.Log(kInfoLevel, 1, value);
   }
+  counters.Stop();
 
+  if (!counters.is_available()) {
+    std::cout << "hardware counters are not available" << std::endl;
+  }
+  for (int i = 0; i < kPerfEventCount; ++i) {
+    if (counters.is_open(i)) {
+      std::cout << kPerfEventNames[i] << " per Log: "
+                << counters.value(i)/count << std::endl;
+    }
+  }
   return 0;
 }
-
-
@@ -0,0 +1,128 @@
+/* profile_parser.cc
+ *
+ * Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file profile_parser.cc
+  Compare parsing throughput of a large dump with memory bandwidth.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+
+#include <vartrace/vartrace.h>
+#include <vartrace/messageparser.h>
+#include <vartrace/message_view.h>
+#include <vartrace/parallel_parser.h>
+#include <vartrace/flat_parsed_trace.h>
+#include <vartrace/validating_parser.h>
+
+using std::cout;
+using std::endl;
+
+using vartrace::VarTrace;
+using vartrace::SubtraceGuard;
+using vartrace::kInfoLevel;
+
+namespace {
+//! Size of the profiled dump.
+const unsigned kDumpSize = 0x4000000;
+//! Number of repetitions of every measurement.
+const int kRepetitionCount = 5;
+
+//! Print throughput of an operation repeated on the whole dump.
+template <class F>
+void MeasureThroughput(const char *name, std::size_t size, F operation) {
+  auto begin = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < kRepetitionCount; ++i) {
+    operation();
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  double seconds = std::chrono::duration<double>(end - begin).count();
+  cout << std::setw(20) << name << " " << std::fixed << std::setprecision(0)
+       << size*kRepetitionCount/seconds/1e6 << " MB/s" << endl;
+}
+
+//! Sum ids and first data words of all messages in a range.
+uint32_t SumView(const vartrace::TraceView &view) {
+  uint32_t sum = 0;
+  for (vartrace::MessageIterator pos = view.begin(); pos != view.end();
+       ++pos) {
+    vartrace::MessageView message = *pos;
+    sum += message.message_type_id();
+    if (message.has_children()) {
+      sum += SumView(message.children());
+    } else {
+      sum += message.value<uint32_t>();
+    }
+  }
+  return sum;
+}
+}  // unnamed namespace
+
+//! Fill a large trace, dump it and measure parsing speed.
+int main(int argc, char *argv[]) {
+  VarTrace<> trace(kDumpSize);
+  char chars[16] = "0123456789abcde";
+  for (uint32_t i = 0; i < kDumpSize/0x20; ++i) {
+    trace.Log(kInfoLevel, 1, i);
+    trace.Log(kInfoLevel, 2, 0.5*i);
+    trace.Log(kInfoLevel, 3, chars);
+    SubtraceGuard<VarTrace<> > guard(&trace, 4);
+    trace.Log(kInfoLevel, 5, i);
+    trace.Log(kInfoLevel, 6, i);
+  }
+  std::vector<uint32_t> dump(kDumpSize/sizeof(uint32_t));
+  std::size_t size = trace.DumpInto(&dump[0], kDumpSize);
+  std::vector<uint32_t> copy(dump.size());
+
+  cout << "Dump of " << size << " bytes:" << endl;
+  MeasureThroughput("memcpy", size, [&]() {
+      std::memcpy(&copy[0], &dump[0], size);
+    });
+  volatile uint32_t sum = 0;
+  MeasureThroughput("TraceView", size, [&]() {
+      sum = SumView(vartrace::TraceView(&dump[0], size));
+    });
+  MeasureThroughput("ValidatingParse", size, [&]() {
+      sum = vartrace::ValidatingParse(vartrace::TraceView(&dump[0], size),
+                                      NULL).size();
+    });
+  unsigned thread_count = std::max(1u, std::thread::hardware_concurrency());
+  cout << "Using " << thread_count << " threads for parallel parsing" << endl;
+  MeasureThroughput("ParallelParse", size, [&]() {
+      sum = vartrace::ParallelParse(vartrace::TraceView(&dump[0], size),
+                                    thread_count).size();
+    });
+  MeasureThroughput("FlatParsedTrace", size, [&]() {
+      vartrace::FlatParsedTrace parsed(&dump[0], size);
+      sum = parsed.size();
+    });
+  MeasureThroughput("ParsedVartrace", size, [&]() {
+      vartrace::ParsedVartrace parsed(&dump[0], size);
+      sum = parsed.messages().size();
+    });
+  MeasureThroughput("lazy ParsedVartrace", size, [&]() {
+      vartrace::ParsedVartrace parsed(&dump[0], size, vartrace::kLazyParse);
+      sum = parsed.messages().size();
+    });
+  return 0;
+}
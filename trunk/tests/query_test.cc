@@ -0,0 +1,148 @@
+//! \file query_test.cc
+
+// Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+//!  \brief Query engine tests.
+
+#include <gtest/gtest.h>
+
+#include "dump_fixture.h"
+
+#include <vartrace/vartrace.h>
+#include <vartrace/query.h>
+#include <vartrace/trace_file.h>
+#include <vartrace/type_codes.h>
+
+#include <cstdio>
+#include <vector>
+
+using vartrace::VarTrace;
+using vartrace::SubtraceGuard;
+using vartrace::kInfoLevel;
+using vartrace::TraceView;
+using vartrace::QueryFilter;
+using vartrace::QueryMatch;
+
+namespace {
+//! File created by the tests.
+const char kTestFile[] = "query_test.vtf";
+
+//! Values of matches that hold doubles.
+std::vector<double> Values(const std::vector<QueryMatch> &matches) {
+  std::vector<double> values;
+  for (std::size_t i = 0; i < matches.size(); ++i) {
+    values.push_back(matches[i].message.value<double>());
+  }
+  return values;
+}
+}  // unnamed namespace
+
+//! Query test suite, dumps a trace with nested subtraces.
+class QueryTestSuite : public DumpTestSuite {
+ protected:
+  //! Fill trace and dump it.
+  virtual void SetUp() {
+    VarTrace<> trace(0x4000);
+    for (int i = 0; i < 100; ++i) {
+      trace.Log(kInfoLevel, 42, 1.0*i);
+      SubtraceGuard<VarTrace<> > guard(&trace, 7);
+      trace.Log(kInfoLevel, 42, 0.5*i);
+      trace.Log(kInfoLevel, 43, i);
+      SubtraceGuard<VarTrace<> > nested_guard(&trace, 3);
+      trace.Log(kInfoLevel, 42, 0.25*i);
+    }
+    Dump(&trace, 0x8000);
+  }
+
+  //! Remove trace file.
+  virtual void TearDown() {
+    std::remove(kTestFile);
+  }
+};
+
+//! Id, type and value conditions select messages at any depth.
+TEST_F(QueryTestSuite, FilterTest) {
+  QueryFilter filter;
+  filter.message_type_id = 42;
+  std::vector<QueryMatch> matches = vartrace::RunQuery(view(), filter, 3);
+  ASSERT_EQ(300, matches.size());
+  filter.value_operator = vartrace::kGreaterEqual;
+  filter.value = 49.5;
+  matches = vartrace::RunQuery(view(), filter, 3);
+  ASSERT_EQ(50 + 1, matches.size());
+  ASSERT_EQ(50, matches.front().message.value<double>());
+  ASSERT_TRUE(matches.front().path.empty());
+  ASSERT_EQ(49.5, matches.back().message.value<double>());
+  ASSERT_EQ(std::vector<vartrace::MessageIdType>(1, 7), matches.back().path);
+  filter.message_type_id = -1;
+  filter.data_type_id = vartrace::kTypeIdInt32;
+  filter.value_operator = vartrace::kEqual;
+  filter.value = 10;
+  matches = vartrace::RunQuery(view(), filter, 1);
+  ASSERT_EQ(1, matches.size());
+  ASSERT_EQ(43, matches[0].message.message_type_id());
+  filter.value_operator = vartrace::kAnyValue;
+  filter.data_type_id = 0;
+  matches = vartrace::RunQuery(view(), filter, 2);
+  ASSERT_EQ(200, matches.size());
+}
+
+//! Path and time range restrict the result, order is kept.
+TEST_F(QueryTestSuite, PathTest) {
+  QueryFilter filter;
+  filter.message_type_id = 42;
+  filter.path.push_back(7);
+  std::vector<QueryMatch> matches = vartrace::RunQuery(view(), filter, 4);
+  ASSERT_EQ(200, matches.size());
+  filter.path.push_back(3);
+  matches = vartrace::RunQuery(view(), filter, 4);
+  ASSERT_EQ(100, matches.size());
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_EQ(0.25*i, matches[i].message.value<double>());
+    ASSERT_EQ(2, matches[i].path.size());
+  }
+  filter.first_timestamp = matches[10].timestamp;
+  filter.last_timestamp = matches[19].timestamp;
+  std::vector<double> values = Values(matches);
+  ASSERT_EQ(std::vector<double>(values.begin() + 10, values.begin() + 20),
+            Values(vartrace::RunQuery(view(), filter, 4)));
+  filter.path[0] = 8;
+  ASSERT_TRUE(vartrace::RunQuery(view(), filter, 4).empty());
+}
+
+//! Trace file queries return the same matches as dump queries.
+TEST_F(QueryTestSuite, TraceFileTest) {
+  vartrace::TraceFileWriter writer(0x100);
+  ASSERT_TRUE(writer.Open(kTestFile));
+  ASSERT_TRUE(writer.Append(view()));
+  ASSERT_TRUE(writer.Close());
+  vartrace::TraceFile file;
+  ASSERT_TRUE(file.Open(kTestFile));
+  QueryFilter filter;
+  filter.message_type_id = 42;
+  filter.value_operator = vartrace::kLess;
+  filter.value = 10;
+  ASSERT_EQ(Values(vartrace::RunQuery(view(), filter, 2)),
+            Values(vartrace::RunQuery(file, filter, 2)));
+  filter.path.push_back(7);
+  std::vector<QueryMatch> matches = vartrace::RunQuery(file, filter, 2);
+  ASSERT_EQ(Values(vartrace::RunQuery(view(), filter, 2)), Values(matches));
+  filter.first_timestamp = matches[5].timestamp;
+  filter.last_timestamp = matches[5].timestamp;
+  ASSERT_EQ(Values(vartrace::RunQuery(view(), filter, 2)),
+            Values(vartrace::RunQuery(file, filter, 2)));
+}
@@ -0,0 +1,202 @@
+//! \file realtime_test.cc
+
+// Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//!  \brief Check that real-time traces do not allocate memory.
+/*! The test replaces malloc family functions for the whole program,
+  so it is built as a separate executable.
+ */
+
+#include <gtest/gtest.h>
+
+#include <vartrace/vartrace.h>
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+extern "C" {
+//! Glibc allocation functions used by the replacements.
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *pointer, std::size_t size);
+void *__libc_memalign(std::size_t alignment, std::size_t size);
+}
+
+namespace {
+//! Allocations are counted only when this flag is set.
+std::atomic<bool> is_counting(false);
+//! Number of allocations done while counting.
+std::atomic<unsigned> allocation_count(0);
+
+//! Count allocation if counting is enabled.
+inline void CountAllocation() {
+  if (is_counting.load(std::memory_order_relaxed)) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+}  // unnamed namespace
+
+extern "C" {
+//! Counting malloc.
+void *malloc(std::size_t size) {
+  CountAllocation();
+  return __libc_malloc(size);
+}
+//! Counting calloc.
+void *calloc(std::size_t count, std::size_t size) {
+  CountAllocation();
+  return __libc_calloc(count, size);
+}
+//! Counting realloc.
+void *realloc(void *pointer, std::size_t size) {
+  CountAllocation();
+  return __libc_realloc(pointer, size);
+}
+//! Counting memalign.
+void *memalign(std::size_t alignment, std::size_t size) {
+  CountAllocation();
+  return __libc_memalign(alignment, size);
+}
+}  // extern "C"
+
+using vartrace::VarTrace;
+using vartrace::SubtraceGuard;
+using vartrace::kInfoLevel;
+
+//! Real-time trace type used in tests.
+typedef VarTrace<vartrace::User5LogLevel, vartrace::RealTime> RealTimeTrace;
+
+//! Counts allocations between construction and destruction.
+class AllocationCounter {
+ public:
+  //! Reset and enable counting.
+  AllocationCounter() {
+    allocation_count = 0;
+    is_counting = true;
+  }
+  //! Disable counting.
+  ~AllocationCounter() {
+    is_counting = false;
+  }
+  //! Number of allocations so far.
+  unsigned count() const { return allocation_count; }
+};
+
+namespace test {
+//! Self logging class stored by real-time trace.
+struct RealTimeSelfLog {
+  int ivar; //!< Logged integer.
+  double dvar; //!< Logged double.
+  //! Store members.
+  template <class LoggerPointer>
+  void LogItself(LoggerPointer trace) const {
+    trace->Log(kInfoLevel, 101, ivar);
+    trace->Log(kInfoLevel, 102, dvar);
+  }
+};
+}  // namespace test
+
+//! Register RealTimeSelfLog as self logging.
+VARTRACE_SET_SELFLOGGING(test::RealTimeSelfLog);
+
+//! Real-time test suite.
+class RealTimeTestSuite : public ::testing::Test {
+};
+
+//! Make sure that replaced malloc is actually called.
+TEST_F(RealTimeTestSuite, HarnessTest) {
+  AllocationCounter counter;
+  // volatile store keeps the pair from being elided by the optimizer
+  int *volatile value = new int(1);
+  delete value;
+  ASSERT_LT(0, counter.count());
+}
+
+//! Logging of all supported types does not allocate.
+TEST_F(RealTimeTestSuite, LogTest) {
+  RealTimeTrace trace(0x1000);
+  test::RealTimeSelfLog obj = {1, 2.0};
+  char anarray[] = {1, 2, 3, 4, 5, 6, 7};
+  double doubles[100] = {0};
+  AllocationCounter counter;
+  // wrap around the trace a few times
+  for (int i = 0; i < 1000; ++i) {
+    trace.Log(kInfoLevel, 1, i);
+    trace.Log(kInfoLevel, 2, 1.5*i);
+    trace.Log(kInfoLevel, 3, anarray);
+    trace.Log(kInfoLevel, 4, doubles, 100);
+    trace.Log(kInfoLevel, 5, obj);
+    trace.Log(kInfoLevel, 6, &obj, 1);
+  }
+  ASSERT_EQ(0, counter.count());
+}
+
+//! Subtraces do not allocate even when they overflow.
+TEST_F(RealTimeTestSuite, SubtraceTest) {
+  RealTimeTrace trace(0x1000);
+  int value = 1;
+  AllocationCounter counter;
+  for (int i = 0; i < 100; ++i) {
+    SubtraceGuard<RealTimeTrace> guard(&trace, 1);
+    guard.writer()->Log(kInfoLevel, 2, value);
+    trace.BeginSubtrace(3);
+    trace.Log(kInfoLevel, 4, value);
+    trace.AbortSubtrace();
+  }
+  // go deeper than the fixed subtrace stack
+  const unsigned kDepth = 2*vartrace::internal::kMaxSubtraceDepth;
+  for (unsigned i = 0; i < kDepth; ++i) {
+    trace.BeginSubtrace(i);
+    trace.Log(kInfoLevel, 5, value);
+  }
+  for (unsigned i = 0; i < kDepth; ++i) {
+    trace.EndSubtrace();
+  }
+  ASSERT_EQ(0, counter.count());
+  ASSERT_FALSE(trace.is_subtrace());
+  ASSERT_EQ(1, trace.dropped_subtrace_count());
+}
+
+//! Dumping does not allocate.
+TEST_F(RealTimeTestSuite, DumpTest) {
+  RealTimeTrace trace(0x1000);
+  vartrace::AlignmentType buffer[0x400];
+  for (int i = 0; i < 1000; ++i) {
+    trace.Log(kInfoLevel, 1, i);
+  }
+  AllocationCounter counter;
+  unsigned dumped_size = trace.DumpInto(buffer, sizeof(buffer));
+  ASSERT_EQ(0, counter.count());
+  ASSERT_LT(0, dumped_size);
+}
+
+//! Logging from a thread that did not create the trace.
+TEST_F(RealTimeTestSuite, ThreadTest) {
+  RealTimeTrace trace(0x1000);
+  unsigned thread_allocations = 1;
+  std::thread writer([&trace, &thread_allocations]() {
+      vartrace::ThreadSubtraceArena()->Prefault();
+      test::RealTimeSelfLog obj = {1, 2.0};
+      AllocationCounter counter;
+      for (int i = 0; i < 1000; ++i) {
+        trace.Log(kInfoLevel, 1, obj);
+      }
+      thread_allocations = counter.count();
+    });
+  writer.join();
+  ASSERT_EQ(0, thread_allocations);
+}
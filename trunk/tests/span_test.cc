@@ -0,0 +1,177 @@
+//! \file span_test.cc
+
+// Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//!  \brief Scoped span and latency table tests.
+
+#include <gtest/gtest.h>
+
+#include <vartrace/vartrace.h>
+#include <vartrace/latency_table.h>
+#include <vartrace/validating_parser.h>
+
+#include <vector>
+
+using vartrace::VarTrace;
+using vartrace::ScopedSpan;
+using vartrace::SubtraceGuard;
+using vartrace::MessageView;
+using vartrace::TimestampType;
+using vartrace::kInfoLevel;
+
+namespace {
+//! Time returned by the test clock.
+TimestampType clock_time = 0;
+//! Number of clock reads.
+unsigned clock_read_count = 0;
+
+//! Clock controlled by the tests.
+TimestampType TestClock() {
+  ++clock_read_count;
+  return clock_time;
+}
+
+//! Dump trace into buffer, return top level messages.
+template <class T>
+std::vector<MessageView> Dump(T *trace, std::vector<uint32_t> *buffer) {
+  buffer->resize(0x400);
+  buffer->resize(trace->DumpInto(&(*buffer)[0],
+                                 buffer->size()*sizeof(uint32_t))
+                 /sizeof(uint32_t));
+  vartrace::TraceView view(buffer->empty() ? NULL : &(*buffer)[0],
+                           buffer->size()*sizeof(uint32_t));
+  return std::vector<MessageView>(view.begin(), view.end());
+}
+}  // unnamed namespace
+
+//! Span is one record with start time and duration.
+TEST(ScopedSpanTest, RecordTest) {
+  VarTrace<> trace(0x1000);
+  trace.SetTimestampFunction(TestClock);
+  clock_time = 10;
+  clock_read_count = 0;
+  {
+    ScopedSpan<VarTrace<> > span(&trace, kInfoLevel, 42);
+    ASSERT_EQ(10, span.start());
+    clock_time = 25;
+    trace.Log(kInfoLevel, 1, 7);
+  }
+  // two for the span, one for the message inside
+  ASSERT_EQ(3, clock_read_count);
+  std::vector<uint32_t> buffer;
+  std::vector<MessageView> messages = Dump(&trace, &buffer);
+  ASSERT_EQ(2, messages.size());
+  ASSERT_EQ(1, messages[0].message_type_id());
+  ASSERT_EQ(42, messages[1].message_type_id());
+  ASSERT_EQ(vartrace::kTypeIdSpan, messages[1].data_type_id());
+  ASSERT_EQ(10, messages[1].timestamp());
+  ASSERT_EQ(15, messages[1].value<TimestampType>());
+}
+
+//! Spans below log level and cancelled spans store nothing.
+TEST(ScopedSpanTest, HiddenTest) {
+  VarTrace<vartrace::InfoLogLevel> trace(0x1000);
+  trace.SetTimestampFunction(TestClock);
+  clock_read_count = 0;
+  {
+    ScopedSpan<VarTrace<vartrace::InfoLogLevel> > span(
+        &trace, vartrace::kDebugLevel, 1);
+  }
+  ASSERT_EQ(0, clock_read_count);
+  {
+    ScopedSpan<VarTrace<vartrace::InfoLogLevel> > span(&trace, kInfoLevel, 2);
+    span.Cancel();
+  }
+  ASSERT_EQ(1, clock_read_count);
+  std::vector<uint32_t> buffer;
+  ASSERT_TRUE(Dump(&trace, &buffer).empty());
+}
+
+//! Spans inside subtraces keep only the duration.
+TEST(ScopedSpanTest, NestedTest) {
+  VarTrace<> trace(0x1000);
+  trace.SetTimestampFunction(TestClock);
+  clock_time = 100;
+  {
+    SubtraceGuard<VarTrace<> > guard(&trace, 3);
+    ScopedSpan<VarTrace<> > span(&trace, kInfoLevel, 4);
+    clock_time = 130;
+  }
+  std::vector<uint32_t> buffer;
+  std::vector<MessageView> messages = Dump(&trace, &buffer);
+  ASSERT_EQ(1, messages.size());
+  ASSERT_EQ(100, messages[0].timestamp());
+  std::vector<MessageView> children(messages[0].children().begin(),
+                                    messages[0].children().end());
+  ASSERT_EQ(1, children.size());
+  ASSERT_EQ(vartrace::kTypeIdSpan, children[0].data_type_id());
+  ASSERT_EQ(30, children[0].value<TimestampType>());
+}
+
+//! Span records are a known type for the validating parser.
+TEST(ScopedSpanTest, ValidatingParseTest) {
+  VarTrace<> trace(0x1000);
+  trace.Log(kInfoLevel, 1, 7);
+  {
+    ScopedSpan<VarTrace<> > span(&trace, kInfoLevel, 42);
+  }
+  std::vector<uint32_t> buffer;
+  std::vector<MessageView> messages = Dump(&trace, &buffer);
+  vartrace::ValidationOptions options;
+  options.known_types_only = true;
+  std::vector<vartrace::SkippedRange> skipped;
+  ASSERT_EQ(messages.size(), vartrace::ValidatingParse(vartrace::TraceView(
+      &buffer[0], buffer.size()*sizeof(uint32_t)), &skipped, options).size());
+  ASSERT_TRUE(skipped.empty());
+}
+
+//! Durations are grouped by id and summarized.
+TEST(LatencyTableTest, SummaryTest) {
+  VarTrace<> trace(0x4000);
+  trace.SetTimestampFunction(TestClock);
+  for (TimestampType i = 1; i <= 100; ++i) {
+    clock_time = 1000*i;
+    ScopedSpan<VarTrace<> > span(&trace, kInfoLevel, i % 2 ? 5 : 6);
+    clock_time += i;
+  }
+  {
+    SubtraceGuard<VarTrace<> > guard(&trace, 3);
+    ScopedSpan<VarTrace<> > span(&trace, kInfoLevel, 7);
+    clock_time += 9;
+  }
+  trace.Log(kInfoLevel, 5, 1);
+  std::vector<uint32_t> buffer;
+  Dump(&trace, &buffer);
+  vartrace::LatencyTable table;
+  table.Add(vartrace::TraceView(&buffer[0], buffer.size()*sizeof(uint32_t)));
+  ASSERT_EQ(50, table.durations(5).size());
+  ASSERT_EQ(3, table.durations(5)[1]);
+  std::vector<vartrace::LatencySummary> rows = table.Summarize();
+  ASSERT_EQ(3, rows.size());
+  // odd durations for id 5, even for id 6
+  ASSERT_EQ(5, rows[0].span_id);
+  ASSERT_EQ(50, rows[0].count);
+  ASSERT_EQ(1, rows[0].min);
+  ASSERT_EQ(99, rows[0].max);
+  ASSERT_DOUBLE_EQ(50, rows[0].mean);
+  ASSERT_EQ(49, rows[0].p50);
+  ASSERT_EQ(89, rows[0].p90);
+  ASSERT_EQ(99, rows[0].p99);
+  ASSERT_EQ(6, rows[1].span_id);
+  ASSERT_EQ(100, rows[1].max);
+  ASSERT_EQ(7, rows[2].span_id);
+  ASSERT_EQ(9, rows[2].p50);
+}
@@ -0,0 +1,114 @@
+//! \file stream_parser_test.cc
+
+// Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//!  \brief Streaming parser tests.
+
+#include <gtest/gtest.h>
+
+#include <vartrace/vartrace.h>
+#include <vartrace/stream_parser.h>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using vartrace::VarTrace;
+using vartrace::SubtraceGuard;
+using vartrace::kInfoLevel;
+using vartrace::MessageView;
+using vartrace::StreamParser;
+
+//! Visitor that prints events into a string.
+class RecordingVisitor : public vartrace::TraceVisitor {
+ public:
+  //! Record message id and first data byte.
+  virtual void OnMessage(const MessageView &message) {
+    events << "m" << message.message_type_id() << ":"
+           << static_cast<int>(message.value<uint8_t>()) << " ";
+  }
+  //! Record subtrace id and size.
+  virtual void OnSubtraceBegin(const MessageView &subtrace) {
+    events << "b" << subtrace.message_type_id() << ":"
+           << subtrace.data_size() << " ";
+  }
+  //! Record subtrace id.
+  virtual void OnSubtraceEnd(const MessageView &subtrace) {
+    events << "e" << subtrace.message_type_id() << " ";
+  }
+
+  std::ostringstream events; //!< All recorded events.
+};
+
+//! Streaming parser test suite, dumps a trace with different messages.
+class StreamParserTestSuite : public ::testing::Test {
+ protected:
+  //! Fill trace and dump it.
+  virtual void SetUp() {
+    VarTrace<> trace(0x1000);
+    char chars[] = "abcdefghijklmnopq";
+    for (int i = 0; i < 10; ++i) {
+      trace.Log(kInfoLevel, 1, i);
+      trace.Log(kInfoLevel, 2, chars, i);
+      SubtraceGuard<VarTrace<> > guard(&trace, 3);
+      trace.Log(kInfoLevel, 4, 1.5*i);
+      SubtraceGuard<VarTrace<> > inner_guard(&trace, 5);
+      trace.Log(kInfoLevel, 6, static_cast<int8_t>(i));
+    }
+    buffer.resize(0x400);
+    buffer.resize(trace.DumpInto(&buffer[0], buffer.size()));
+  }
+
+  std::vector<uint8_t> buffer; //!< Dumped trace.
+};
+
+//! Any split of the dump produces the same events as the whole buffer.
+TEST_F(StreamParserTestSuite, ChunkSizeTest) {
+  RecordingVisitor whole;
+  vartrace::VisitMessages(vartrace::TraceView(&buffer[0], buffer.size()),
+                          &whole);
+  ASSERT_EQ(0, whole.events.str().find("m1:0 m2:0 b3:24 m4:0 b5:8 m6:0 "
+                                       "e5 e3 m1:1 m2:97 "));
+  const std::size_t kChunkSizes[] = {1, 3, 7, 8, 12, 100, 0x400};
+  for (std::size_t chunk_size : kChunkSizes) {
+    RecordingVisitor visitor;
+    StreamParser parser(&visitor);
+    for (std::size_t i = 0; i < buffer.size(); i += chunk_size) {
+      parser.Feed(&buffer[i], std::min(chunk_size, buffer.size() - i));
+    }
+    ASSERT_TRUE(parser.is_complete());
+    ASSERT_EQ(whole.events.str(), visitor.events.str());
+  }
+}
+
+//! Incomplete message is kept until the rest arrives.
+TEST_F(StreamParserTestSuite, PendingTest) {
+  RecordingVisitor visitor;
+  StreamParser parser(&visitor);
+  // first message is 12 bytes long
+  parser.Feed(&buffer[0], 14);
+  ASSERT_EQ("m1:0 ", visitor.events.str());
+  ASSERT_EQ(2, parser.pending_size());
+  ASSERT_FALSE(parser.is_complete());
+  // second message is empty string, 8 bytes
+  parser.Feed(&buffer[14], 6);
+  ASSERT_EQ("m1:0 m2:0 ", visitor.events.str());
+  ASSERT_TRUE(parser.is_complete());
+  parser.Feed(&buffer[20], 4);
+  parser.Reset();
+  ASSERT_TRUE(parser.is_complete());
+}
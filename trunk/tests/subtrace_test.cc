@@ -25,8 +25,14 @@
 #include <vartrace/vartrace.h>
 #include <vartrace/messageparser.h>
 
+#include <algorithm>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
 using vartrace::VarTrace;
 using vartrace::SubtraceGuard;
+using vartrace::SubtraceWriter;
 using vartrace::kInfoLevel;
 
 //! Subtrace test suite, empty.
@@ -149,7 +155,7 @@ TEST_F(SubtraceTestSuite, DeepSubtraceTest) {
   for (std::size_t i = 1; i < kMaxDepth; ++i) {
     trace->BeginSubtrace(2*i + 1);
   }
-  // dump trace with all subtraces open, cannot parse it
+  // dump trace with all subtraces open, they are not in the trace yet
   size_t dumped_size = trace->DumpInto(buffer.get(), buffer_size);
   ASSERT_EQ(0, dumped_size);
   // finish subtraces
@@ -247,3 +253,243 @@ TEST_F(SubtraceTestSuite, DeepSubtraceDoubleTest) {
               2*(kMaxDepth - i)*12, msg->data_size());
   }
 }
+
+//! Check that a trace can be dumped while a subtrace is open.
+TEST_F(SubtraceTestSuite, DumpOpenSubtraceTest) {
+  int trace_size = 0x100;
+  int buffer_length = trace_size/sizeof(vartrace::AlignmentType);
+  int buffer_size = buffer_length*sizeof(vartrace::AlignmentType);
+  boost::shared_ptr<VarTrace<> > trace(new VarTrace<>(trace_size));
+  boost::shared_array<vartrace::AlignmentType> buffer(
+      new vartrace::AlignmentType[buffer_length]);
+  int m1 = 0x1234;
+  int m2 = 0x5678;
+  trace->Log(kInfoLevel, 1, m1);
+  trace->BeginSubtrace(2);
+  trace->Log(kInfoLevel, 3, m2);
+  // only the finished message is dumped
+  size_t dumped_size = trace->DumpInto(buffer.get(), buffer_size);
+  ASSERT_EQ(vartrace::kHeaderSize + sizeof(m1), dumped_size);
+  vartrace::ParsedVartrace vt(buffer.get(), dumped_size);
+  ASSERT_EQ(1, vt.messages().size());
+  ASSERT_EQ(m1, vt[0]->value<int>());
+  // subtrace appears after it is closed
+  trace->EndSubtrace();
+  dumped_size = trace->DumpInto(buffer.get(), buffer_size);
+  vartrace::ParsedVartrace closed_vt(buffer.get(), dumped_size);
+  ASSERT_EQ(2, closed_vt.messages().size());
+  ASSERT_EQ(2, closed_vt[1]->message_type_id());
+  ASSERT_EQ(m2, closed_vt[1]->children()[0]->value<int>());
+}
+
+//! Check that aborted subtraces are not stored.
+TEST_F(SubtraceTestSuite, AbortSubtraceTest) {
+  int trace_size = 0x100;
+  int buffer_length = trace_size/sizeof(vartrace::AlignmentType);
+  int buffer_size = buffer_length*sizeof(vartrace::AlignmentType);
+  boost::shared_ptr<VarTrace<> > trace(new VarTrace<>(trace_size));
+  boost::shared_array<vartrace::AlignmentType> buffer(
+      new vartrace::AlignmentType[buffer_length]);
+  int m1 = 0x1234;
+  int m2 = 0x5678;
+  // abort whole subtrace
+  {
+    SubtraceGuard<VarTrace<> > guard(trace.get(), 1);
+    trace->Log(kInfoLevel, 2, m1);
+    guard.Abort();
+    ASSERT_FALSE(trace->is_subtrace());
+  }
+  ASSERT_EQ(0, trace->DumpInto(buffer.get(), buffer_size));
+  // abort only nested subtrace
+  trace->BeginSubtrace(3);
+  trace->Log(kInfoLevel, 4, m1);
+  trace->BeginSubtrace(5);
+  trace->Log(kInfoLevel, 6, m2);
+  trace->AbortSubtrace();
+  ASSERT_TRUE(trace->is_subtrace());
+  trace->EndSubtrace();
+  ASSERT_FALSE(trace->is_subtrace());
+  size_t dumped_size = trace->DumpInto(buffer.get(), buffer_size);
+  vartrace::ParsedVartrace vt(buffer.get(), dumped_size);
+  ASSERT_EQ(1, vt.messages().size());
+  ASSERT_EQ(3, vt[0]->message_type_id());
+  ASSERT_EQ(1, vt[0]->children().size());
+  ASSERT_EQ(m1, vt[0]->children()[0]->value<int>());
+}
+
+//! Subtrace that does not fit into the size field is dropped.
+TEST_F(SubtraceTestSuite, OversizedSubtraceTest) {
+  int trace_size = 0x40000;
+  int buffer_length = trace_size/sizeof(vartrace::AlignmentType);
+  int buffer_size = buffer_length*sizeof(vartrace::AlignmentType);
+  boost::shared_ptr<VarTrace<> > trace(new VarTrace<>(trace_size));
+  boost::shared_array<vartrace::AlignmentType> buffer(
+      new vartrace::AlignmentType[buffer_length]);
+  std::vector<char> chunk(0x1000);
+  trace->BeginSubtrace(1);
+  for (int i = 0; i < 0x20; ++i) {
+    trace->Log(kInfoLevel, 2, chunk);
+  }
+  trace->EndSubtrace();
+  ASSERT_FALSE(trace->is_subtrace());
+  ASSERT_EQ(0, trace->DumpInto(buffer.get(), buffer_size));
+  // arena is usable afterwards
+  trace->BeginSubtrace(1);
+  trace->Log(kInfoLevel, 2, chunk);
+  trace->EndSubtrace();
+  ASSERT_EQ(vartrace::kHeaderSize + vartrace::kNestedHeaderSize + chunk.size(),
+            trace->DumpInto(buffer.get(), buffer_size));
+}
+
+//! Subtraces written from several threads must not interleave.
+TEST_F(SubtraceTestSuite, ConcurrentSubtraceTest) {
+  typedef VarTrace<vartrace::User5LogLevel, vartrace::MultiThreaded>
+      LockedTrace;
+  const int kThreadCount = 4;
+  const int kSubtraceCount = 1000;
+  const int kMessageCount = 8;
+  int trace_size = 0x10000;
+  int buffer_length = trace_size/sizeof(vartrace::AlignmentType);
+  int buffer_size = buffer_length*sizeof(vartrace::AlignmentType);
+  LockedTrace trace(trace_size);
+  trace.SetTimestampFunction(vartrace::ZeroTimestamp);
+  boost::shared_array<vartrace::AlignmentType> buffer(
+      new vartrace::AlignmentType[buffer_length]);
+  std::vector<std::thread> writers;
+  for (int t = 0; t < kThreadCount; ++t) {
+    writers.push_back(std::thread([&trace, t]() {
+          for (int i = 0; i < kSubtraceCount; ++i) {
+            SubtraceGuard<LockedTrace> guard(&trace, t);
+            for (int j = 0; j < kMessageCount; ++j) {
+              trace.Log(kInfoLevel, t, j);
+            }
+          }
+        }));
+  }
+  for (std::size_t t = 0; t < writers.size(); ++t) {
+    writers[t].join();
+  }
+  size_t dumped_size = trace.DumpInto(buffer.get(), buffer_size);
+  vartrace::ParsedVartrace vt(buffer.get(), dumped_size);
+  ASSERT_LT(0, vt.messages().size());
+  for (std::size_t i = 0; i < vt.messages().size(); ++i) {
+    vartrace::Message::Pointer msg = vt[i];
+    ASSERT_EQ(kMessageCount, msg->children().size());
+    for (int j = 0; j < kMessageCount; ++j) {
+      ASSERT_EQ(msg->message_type_id(),
+                msg->children()[j]->message_type_id());
+      ASSERT_EQ(j, msg->children()[j]->value<int>());
+    }
+  }
+}
+
+//! Default clock is read without the lock when subtraces begin.
+TEST_F(SubtraceTestSuite, ConcurrentTimestampTest) {
+  typedef VarTrace<vartrace::User5LogLevel, vartrace::MultiThreaded>
+      LockedTrace;
+  const int kThreadCount = 4;
+  const int kSubtraceCount = 500;
+  LockedTrace trace(0x10000);
+  std::vector<std::thread> writers;
+  for (int t = 0; t < kThreadCount; ++t) {
+    writers.push_back(std::thread([&trace, t]() {
+          for (int i = 0; i < kSubtraceCount; ++i) {
+            SubtraceGuard<LockedTrace> guard(&trace, t);
+            trace.Log(kInfoLevel, t, i);
+          }
+        }));
+  }
+  for (std::size_t t = 0; t < writers.size(); ++t) {
+    writers[t].join();
+  }
+  std::vector<vartrace::AlignmentType> buffer(0x4000);
+  vartrace::ParsedVartrace vt(&buffer[0], trace.DumpInto(
+      &buffer[0], buffer.size()*sizeof(vartrace::AlignmentType)));
+  ASSERT_EQ(kThreadCount*kSubtraceCount, vt.messages().size());
+  // every clock read returns a different value
+  std::vector<unsigned> timestamps;
+  for (std::size_t i = 0; i < vt.messages().size(); ++i) {
+    timestamps.push_back(vt[i]->timestamp());
+  }
+  std::sort(timestamps.begin(), timestamps.end());
+  ASSERT_TRUE(std::adjacent_find(timestamps.begin(), timestamps.end())
+              == timestamps.end());
+}
+
+//! Check logging through writer returned by BeginSubtrace.
+TEST_F(SubtraceTestSuite, WriterTest) {
+  int trace_size = 0x100;
+  int buffer_length = trace_size/sizeof(vartrace::AlignmentType);
+  int buffer_size = buffer_length*sizeof(vartrace::AlignmentType);
+  boost::shared_ptr<VarTrace<> > trace(new VarTrace<>(trace_size));
+  boost::shared_array<vartrace::AlignmentType> buffer(
+      new vartrace::AlignmentType[buffer_length]);
+  int m1 = 0x1234;
+  double m2 = 12e-34;
+  char anarray[] = {1, 2, 3, 4, 5};
+  {
+    SubtraceWriter<VarTrace<> > writer = trace->BeginSubtrace(1);
+    writer.Log(kInfoLevel, 2, m1);
+    writer.Log(kInfoLevel, 3, anarray);
+    SubtraceWriter<VarTrace<> > nested = writer.BeginSubtrace(4);
+    nested.Log(kInfoLevel, 5, m2);
+    nested.Log(vartrace::kHiddenLevel, 6, m2);
+    nested.EndSubtrace();
+    ASSERT_TRUE(trace->is_subtrace());
+    writer.EndSubtrace();
+  }
+  ASSERT_FALSE(trace->is_subtrace());
+  {
+    SubtraceGuard<VarTrace<> > guard(trace.get(), 7);
+    guard.writer()->Log(kInfoLevel, 8, m1);
+  }
+  size_t dumped_size = trace->DumpInto(buffer.get(), buffer_size);
+  vartrace::ParsedVartrace vt(buffer.get(), dumped_size);
+  ASSERT_EQ(2, vt.messages().size());
+  vartrace::Message::Pointer msg = vt[0];
+  ASSERT_EQ(1, msg->message_type_id());
+  ASSERT_EQ(3, msg->children().size());
+  ASSERT_EQ(m1, msg->children()[0]->value<int>());
+  ASSERT_EQ(sizeof(anarray), msg->children()[1]->data_size());
+  ASSERT_EQ(4, msg->children()[2]->message_type_id());
+  ASSERT_EQ(1, msg->children()[2]->children().size());
+  ASSERT_EQ(m2, msg->children()[2]->children()[0]->value<double>());
+  ASSERT_EQ(7, vt[1]->message_type_id());
+  ASSERT_EQ(m1, vt[1]->children()[0]->value<int>());
+}
+
+//! Self logging class that records which logger it was given.
+struct WriterAwareClass {
+  int ivar; //!< Logged member.
+  //! Set to true if the last call received subtrace writer.
+  static bool got_writer;
+  //! Template logging function accepts writer as well as trace.
+  template <class LoggerPointer>
+  void LogItself(LoggerPointer logger) const {
+    got_writer = std::is_same<LoggerPointer,
+                              SubtraceWriter<VarTrace<> > *>::value;
+    logger->Log(kInfoLevel, 101, ivar);
+  }
+};
+bool WriterAwareClass::got_writer = false;
+
+//! Register WriterAwareClass as self logging.
+VARTRACE_SET_SELFLOGGING(WriterAwareClass);
+
+//! Template self logging functions receive writer.
+TEST_F(SubtraceTestSuite, SelfLogWriterTest) {
+  int trace_size = 0x100;
+  int buffer_length = trace_size/sizeof(vartrace::AlignmentType);
+  int buffer_size = buffer_length*sizeof(vartrace::AlignmentType);
+  boost::shared_ptr<VarTrace<> > trace(new VarTrace<>(trace_size));
+  boost::shared_array<vartrace::AlignmentType> buffer(
+      new vartrace::AlignmentType[buffer_length]);
+  WriterAwareClass obj;
+  obj.ivar = 0x1234;
+  trace->Log(kInfoLevel, 1, obj);
+  ASSERT_TRUE(WriterAwareClass::got_writer);
+  size_t dumped_size = trace->DumpInto(buffer.get(), buffer_size);
+  vartrace::ParsedVartrace vt(buffer.get(), dumped_size);
+  ASSERT_EQ(1, vt.messages().size());
+  ASSERT_EQ(obj.ivar, vt[0]->children()[0]->value<int>());
+}
@@ -0,0 +1,126 @@
+//! \file text_writer_test.cc
+
+// Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+//!  \brief Text writer tests.
+
+#include <gtest/gtest.h>
+
+#include <vartrace/text_writer.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <string>
+
+using vartrace::TextWriter;
+
+namespace {
+//! Text of a double.
+std::string DoubleText(double value) {
+  std::ostringstream out;
+  {
+    TextWriter writer(&out);
+    writer.WriteDouble(value);
+  }
+  return out.str();
+}
+
+//! Text of a float.
+std::string FloatText(float value) {
+  std::ostringstream out;
+  {
+    TextWriter writer(&out);
+    writer.WriteFloat(value);
+  }
+  return out.str();
+}
+}  // unnamed namespace
+
+//! Integers are printed with all digits.
+TEST(TextWriterTest, IntegerTest) {
+  std::ostringstream out;
+  {
+    TextWriter writer(&out);
+    writer.WriteUnsigned(0);
+    writer.Write(' ');
+    writer.WriteUnsigned(std::numeric_limits<uint64_t>::max());
+    writer.Write(' ');
+    writer.WriteSigned(std::numeric_limits<int64_t>::min());
+    writer.Write(' ');
+    writer.WriteSigned(-7);
+    writer.Write(' ');
+    writer.WriteSigned(10);
+  }
+  ASSERT_EQ("0 18446744073709551615 -9223372036854775808 -7 10", out.str());
+}
+
+//! Floating point values use the shortest text.
+TEST(TextWriterTest, ShortestTest) {
+  ASSERT_EQ("0", DoubleText(0));
+  ASSERT_EQ("-0", DoubleText(-0.0));
+  ASSERT_EQ("0.1", DoubleText(0.1));
+  ASSERT_EQ("-2.5", DoubleText(-2.5));
+  ASSERT_EQ("123", DoubleText(123));
+  ASSERT_EQ("0.000001", DoubleText(1e-6));
+  ASSERT_EQ("1.5e-7", DoubleText(1.5e-7));
+  ASSERT_EQ("1e+21", DoubleText(1e21));
+  ASSERT_EQ("5e-324", DoubleText(5e-324));
+  ASSERT_EQ("1.7976931348623157e+308",
+            DoubleText(std::numeric_limits<double>::max()));
+  ASSERT_EQ("0.1", FloatText(0.1f));
+  ASSERT_EQ("3.4028235e+38", FloatText(std::numeric_limits<float>::max()));
+  ASSERT_EQ("1e-45", FloatText(std::numeric_limits<float>::denorm_min()));
+  ASSERT_EQ("nan", DoubleText(std::numeric_limits<double>::quiet_NaN()));
+  ASSERT_EQ("-inf", FloatText(-std::numeric_limits<float>::infinity()));
+}
+
+//! Printed values read back as the same values.
+TEST(TextWriterTest, RoundTripTest) {
+  uint64_t state = 1;
+  for (int i = 0; i < 20000; ++i) {
+    // linear congruential generator covers all exponents
+    state = state*6364136223846793005ULL + 1442695040888963407ULL;
+    double value;
+    std::memcpy(&value, &state, sizeof(value));
+    if (!std::isfinite(value)) {
+      continue;
+    }
+    ASSERT_EQ(value, std::strtod(DoubleText(value).c_str(), NULL));
+    uint32_t bits = state >> 32;
+    float single;
+    std::memcpy(&single, &bits, sizeof(single));
+    if (std::isfinite(single)) {
+      ASSERT_EQ(single, std::strtof(FloatText(single).c_str(), NULL));
+    }
+  }
+}
+
+//! Strings are escaped and long writes bypass the buffer.
+TEST(TextWriterTest, StringTest) {
+  std::ostringstream out;
+  std::string text(1000, 'x');
+  {
+    TextWriter writer(&out, 100);
+    writer.WriteJsonString("a\"b\\c\n", 6);
+    writer.Write(text);
+    writer.Write('y');
+  }
+  ASSERT_EQ("\"a\\\"b\\\\c\\u000a\"" + text + "y", out.str());
+}
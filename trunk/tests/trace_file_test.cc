@@ -0,0 +1,205 @@
+//! \file trace_file_test.cc
+
+// Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//!  \brief Indexed trace file tests.
+
+#include <gtest/gtest.h>
+
+#include "dump_fixture.h"
+
+#include <vartrace/vartrace.h>
+#include <vartrace/trace_file.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using vartrace::VarTrace;
+using vartrace::SubtraceGuard;
+using vartrace::kInfoLevel;
+using vartrace::MessageView;
+using vartrace::TraceView;
+using vartrace::TraceFile;
+
+namespace {
+//! File created by the tests.
+const char kTestFile[] = "trace_file_test.vtf";
+
+//! Timestamps of messages that pass the filter.
+std::vector<unsigned> Filter(const TraceView &view, unsigned first,
+                             unsigned last, int message_type_id) {
+  std::vector<unsigned> timestamps;
+  for (vartrace::MessageIterator pos = view.begin(); pos != view.end();
+       ++pos) {
+    if ((*pos).timestamp() >= first && (*pos).timestamp() <= last
+        && (message_type_id < 0
+            || (*pos).message_type_id() == message_type_id)) {
+      timestamps.push_back((*pos).timestamp());
+    }
+  }
+  return timestamps;
+}
+
+//! Clock that wraps after a few hundred messages.
+vartrace::TimestampType WrappingClock() {
+  static vartrace::TimestampType time = 0xffffff00;
+  return time++;
+}
+
+//! Unwrapped timestamps of messages in given range.
+std::vector<uint64_t> Unwrapped(const TraceView &view, uint64_t first,
+                                uint64_t last) {
+  std::vector<uint64_t> timestamps;
+  vartrace::TimestampUnwrapper unwrapper;
+  for (vartrace::MessageIterator pos = view.begin(); pos != view.end();
+       ++pos) {
+    uint64_t timestamp = unwrapper.Unwrap((*pos).timestamp());
+    if (timestamp >= first && timestamp <= last) {
+      timestamps.push_back(timestamp);
+    }
+  }
+  return timestamps;
+}
+
+//! Timestamps of messages.
+std::vector<unsigned> Timestamps(const std::vector<MessageView> &messages) {
+  std::vector<unsigned> timestamps;
+  for (std::size_t i = 0; i < messages.size(); ++i) {
+    timestamps.push_back(messages[i].timestamp());
+  }
+  return timestamps;
+}
+}  // unnamed namespace
+
+//! Trace file test suite, packs a dump into small chunks.
+class TraceFileTestSuite : public DumpTestSuite {
+ protected:
+  //! Fill trace, dump it and write trace file.
+  virtual void SetUp() {
+    VarTrace<> trace(0x4000);
+    for (int i = 0; i < 500; ++i) {
+      trace.Log(kInfoLevel, i % 7, i);
+      if (i % 50 == 0) {
+        SubtraceGuard<VarTrace<> > guard(&trace, 200);
+        trace.Log(kInfoLevel, 1, 0.5*i);
+      }
+    }
+    Dump(&trace, 0x4000);
+    vartrace::TraceFileWriter writer(0x100);
+    ASSERT_TRUE(writer.Open(kTestFile));
+    ASSERT_TRUE(writer.Append(view()));
+    ASSERT_TRUE(writer.Close());
+  }
+
+  //! Remove trace file.
+  virtual void TearDown() {
+    std::remove(kTestFile);
+  }
+};
+
+//! Chunks hold all messages in order.
+TEST_F(TraceFileTestSuite, ChunksTest) {
+  TraceFile file;
+  ASSERT_TRUE(file.Open(kTestFile));
+  ASSERT_LT(10, file.chunk_count());
+  std::vector<unsigned> all = Filter(view(), 0, ~0u, -1);
+  std::vector<unsigned> read;
+  for (std::size_t i = 0; i < file.chunk_count(); ++i) {
+    std::vector<unsigned> chunk = Filter(file.chunk_view(i), 0, ~0u, -1);
+    ASSERT_EQ(file.chunk(i).message_count, chunk.size());
+    ASSERT_EQ(file.chunk(i).first_timestamp, chunk.front());
+    ASSERT_EQ(file.chunk(i).last_timestamp, chunk.back());
+    read.insert(read.end(), chunk.begin(), chunk.end());
+  }
+  ASSERT_EQ(all, read);
+  ASSERT_TRUE(file.chunk(0).has_message_id(200));
+  ASSERT_FALSE(file.chunk(0).has_message_id(100));
+}
+
+//! Queries return the same messages as a full scan.
+TEST_F(TraceFileTestSuite, QueryTest) {
+  TraceFile file;
+  ASSERT_TRUE(file.Open(kTestFile));
+  std::vector<unsigned> all = Filter(view(), 0, ~0u, -1);
+  unsigned first = all[all.size()/3];
+  unsigned last = all[all.size()/2];
+  ASSERT_EQ(Filter(view(), first, last, -1),
+            Timestamps(file.Query(first, last)));
+  ASSERT_EQ(Filter(view(), first, last, 3),
+            Timestamps(file.Query(first, last, 3)));
+  ASSERT_EQ(Filter(view(), 0, ~0u, 200),
+            Timestamps(file.Query(0, ~0u, 200)));
+  std::pair<std::size_t, std::size_t> chunks = file.FindChunks(first, last);
+  ASSERT_LT(0, chunks.first);
+  ASSERT_GT(file.chunk_count(), chunks.second);
+  ASSERT_TRUE(file.Query(all.back() + 1, ~0u).empty());
+}
+
+//! Damaged files are rejected.
+TEST_F(TraceFileTestSuite, DamagedTest) {
+  TraceFile file;
+  ASSERT_FALSE(file.Open("no_such_file.vtf"));
+  std::ofstream out(kTestFile, std::ios::binary | std::ios::app);
+  out << "tail";
+  out.close();
+  ASSERT_FALSE(file.Open(kTestFile));
+  ASSERT_EQ(0, file.chunk_count());
+}
+
+//! Chunks after a wrap of the clock are found by unwrapped time ranges.
+TEST_F(TraceFileTestSuite, WrapTest) {
+  VarTrace<> trace(0x4000);
+  trace.SetTimestampFunction(WrappingClock);
+  for (int i = 0; i < 500; ++i) {
+    trace.Log(kInfoLevel, i % 7, i);
+  }
+  Dump(&trace, 0x4000);
+  vartrace::TraceFileWriter writer(0x100);
+  ASSERT_TRUE(writer.Open(kTestFile));
+  ASSERT_TRUE(writer.Append(view()));
+  ASSERT_TRUE(writer.Close());
+  TraceFile file;
+  ASSERT_TRUE(file.Open(kTestFile));
+  std::vector<uint64_t> all = Unwrapped(view(), 0, ~uint64_t(0));
+  ASSERT_EQ(500, all.size());
+  ASSERT_LT(0xffffffffu, all.back());
+  for (std::size_t i = 1; i < file.chunk_count(); ++i) {
+    ASSERT_LT(file.chunk(i - 1).last_timestamp, file.chunk(i).first_timestamp);
+  }
+  uint64_t first = all[all.size()/3];
+  uint64_t last = all[2*all.size()/3];
+  ASSERT_GT(0x100000000u, first);
+  ASSERT_LE(0x100000000u, last);
+  std::vector<uint64_t> read;
+  std::vector<MessageView> messages = file.Query(first, last);
+  std::pair<std::size_t, std::size_t> chunks = file.FindChunks(first, last);
+  for (std::size_t i = chunks.first; i < chunks.second; ++i) {
+    TraceView chunk = file.chunk_view(i);
+    for (vartrace::MessageIterator pos = chunk.begin(); pos != chunk.end();
+         ++pos) {
+      uint64_t timestamp = file.UnwrapTimestamp(i, *pos);
+      if (timestamp >= first && timestamp <= last) {
+        read.push_back(timestamp);
+      }
+    }
+  }
+  ASSERT_EQ(Unwrapped(view(), first, last), read);
+  ASSERT_EQ(read.size(), messages.size());
+  ASSERT_EQ(Unwrapped(view(), 0x100000000u, ~uint64_t(0)).size(),
+            file.Query(0x100000000u, ~uint64_t(0)).size());
+}
@@ -0,0 +1,153 @@
+//! \file trace_stats_test.cc
+
+// Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//!  \brief Histogram and path statistics tests.
+
+#include <gtest/gtest.h>
+
+#include <vartrace/vartrace.h>
+#include <vartrace/trace_stats.h>
+
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using vartrace::Histogram;
+using vartrace::PathStats;
+using vartrace::TimestampType;
+using vartrace::VarTrace;
+
+namespace {
+//! Time returned by the test clock.
+TimestampType clock_time = 0;
+
+//! Clock controlled by the tests.
+TimestampType TestClock() {
+  return clock_time;
+}
+}  // unnamed namespace
+
+//! Small values are exact, large values keep relative precision.
+TEST(HistogramTest, PrecisionTest) {
+  Histogram histogram;
+  for (uint64_t i = 1; i <= 100; ++i) {
+    histogram.Record(i);
+  }
+  ASSERT_EQ(100, histogram.count());
+  ASSERT_EQ(1, histogram.min());
+  ASSERT_EQ(100, histogram.max());
+  ASSERT_DOUBLE_EQ(50.5, histogram.mean());
+  ASSERT_EQ(50, histogram.Percentile(0.5));
+  ASSERT_EQ(99, histogram.Percentile(0.99));
+  ASSERT_EQ(100, histogram.Percentile(1));
+  std::srand(1);
+  for (int i = 0; i < 1000; ++i) {
+    uint64_t value = static_cast<uint64_t>(std::rand()) << (i % 32);
+    Histogram single;
+    single.Record(value);
+    single.Record(~static_cast<uint64_t>(0));
+    uint64_t reported = single.Percentile(0.5);
+    ASSERT_LE(value, reported);
+    ASSERT_GE(value/128.0, static_cast<double>(reported - value));
+  }
+}
+
+//! Merged histogram is the same as one that recorded all values.
+TEST(HistogramTest, AddTest) {
+  Histogram all, low, high;
+  for (uint64_t i = 1; i <= 1000; ++i) {
+    all.Record(i*i);
+    (i % 3 ? low : high).Record(i*i);
+  }
+  ASSERT_TRUE(low.Add(high));
+  ASSERT_TRUE(low.Add(Histogram()));
+  ASSERT_EQ(all.count(), low.count());
+  ASSERT_EQ(all.min(), low.min());
+  ASSERT_EQ(all.max(), low.max());
+  ASSERT_EQ(all.sum(), low.sum());
+  ASSERT_EQ(all.Percentile(0.5), low.Percentile(0.5));
+  ASSERT_EQ(all.Percentile(0.999), low.Percentile(0.999));
+  Histogram coarse(4);
+  ASSERT_FALSE(coarse.Add(all));
+  ASSERT_EQ(0, coarse.count());
+}
+
+//! Rows are kept per path, spans have durations.
+TEST(TraceStatsTest, PathTest) {
+  VarTrace<> trace(0x4000);
+  trace.SetTimestampFunction(TestClock);
+  for (int i = 0; i < 10; ++i) {
+    clock_time = 100*i;
+    trace.Log(vartrace::kInfoLevel, 1, i);
+    vartrace::SubtraceGuard<VarTrace<> > guard(&trace, 3);
+    {
+      vartrace::ScopedSpan<VarTrace<> > span(&trace, vartrace::kInfoLevel, 4);
+      clock_time += 10 + i;
+    }
+    trace.Log(vartrace::kInfoLevel, 1, "text");
+  }
+  std::vector<uint32_t> buffer(0x1000);
+  buffer.resize(trace.DumpInto(&buffer[0], buffer.size()*sizeof(uint32_t))
+                /sizeof(uint32_t));
+  vartrace::TraceStats stats;
+  vartrace::VisitMessages(vartrace::TraceView(
+      &buffer[0], buffer.size()*sizeof(uint32_t)), &stats);
+  ASSERT_EQ(40, stats.message_count());
+  ASSERT_EQ(0, stats.first_time());
+  ASSERT_EQ(900, stats.last_time());
+  const std::vector<PathStats> &paths = stats.paths();
+  ASSERT_EQ(4, paths.size());
+  ASSERT_EQ(std::vector<uint8_t>(1, 1), paths[0].path);
+  ASSERT_TRUE(paths[1].is_subtrace);
+  ASSERT_EQ(3, paths[1].path[0]);
+  ASSERT_EQ(2, paths[2].path.size());
+  ASSERT_EQ(4, paths[2].path[1]);
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_EQ(10, paths[i].count);
+    ASSERT_EQ(9, paths[i].intervals.count());
+  }
+  ASSERT_EQ(100, paths[0].intervals.min());
+  ASSERT_EQ(100, paths[0].intervals.max());
+  ASSERT_EQ(10, paths[2].durations.count());
+  ASSERT_EQ(10, paths[2].durations.min());
+  ASSERT_EQ(19, paths[2].durations.max());
+  ASSERT_EQ(0, paths[3].durations.count());
+
+  std::ostringstream folded;
+  ASSERT_TRUE(stats.WriteFolded(vartrace::kFoldedTime, &folded));
+  ASSERT_EQ("3;4 145\n", folded.str());
+  folded.str("");
+  ASSERT_TRUE(stats.WriteFolded(vartrace::kFoldedCount, &folded));
+  ASSERT_EQ("1 10\n3;4 10\n3;1 10\n", folded.str());
+}
+
+//! Late record just before a wrap does not shift later times.
+TEST(TimestampUnwrapperTest, LateRecordTest) {
+  vartrace::TimestampUnwrapper unwrapper;
+  const uint64_t kEpoch = static_cast<uint64_t>(1) << 32;
+  ASSERT_EQ(0xfffffff0u, unwrapper.Unwrap(0xfffffff0));
+  ASSERT_EQ(kEpoch + 0x10, unwrapper.Unwrap(0x10));
+  // committed after the wrap but written before it
+  ASSERT_EQ(0xffffffe0u, unwrapper.Unwrap(0xffffffe0));
+  ASSERT_EQ(kEpoch + 0x10, unwrapper.time());
+  ASSERT_EQ(kEpoch + 0x20, unwrapper.Unwrap(0x20));
+  // large forward step in the first epoch is not a late record
+  vartrace::TimestampUnwrapper first;
+  ASSERT_EQ(0x10u, first.Unwrap(0x10));
+  ASSERT_EQ(0xfffffff0u, first.Unwrap(0xfffffff0));
+}
@@ -83,6 +83,36 @@ TEST_F(TypesTest, LogIntegersTest) {
   }
 }
 
+//! Dump of a full trace loses at most one start index slot.
+TEST_F(TypesTest, DumpSizeTest) {
+  int trace_size = 0x1000;
+  int buffer_length = trace_size/sizeof(vartrace::AlignmentType);
+  int buffer_size = buffer_length*sizeof(vartrace::AlignmentType);
+  int message_size = vartrace::kHeaderSize + sizeof(vartrace::AlignmentType);
+  int message_length = 3;
+  boost::shared_array<vartrace::AlignmentType> buffer(
+      new vartrace::AlignmentType[buffer_length]);
+  for (int block_count = 4; block_count <= 64; block_count *= 4) {
+    trace = boost::shared_ptr<VarTrace<> >(
+        new VarTrace<>(trace_size, block_count));
+    for (int i = 0; i < 3*trace_size/message_size; ++i) {
+      trace->Log(kInfoLevel, 1, i);
+      int dumped_size = trace->DumpInto(buffer.get(), buffer_size);
+      if (i >= trace_size/message_size) {
+        ASSERT_LE(trace_size - static_cast<int>(
+            vartrace::internal::kStartIndexSpacing) - message_size,
+                  dumped_size);
+      }
+      // messages are consecutive and end with the last one
+      int dumped_count = dumped_size/message_size;
+      ASSERT_EQ(0, dumped_size%message_size);
+      for (int j = 0; j < dumped_count; ++j) {
+        ASSERT_EQ(i - dumped_count + 1 + j, buffer[j*message_length + 2]);
+      }
+    }
+  }
+}
+
 //! Check correct logging of short POD types..
 TEST_F(TypesTest, LogDifferentTypesTest) {
   int trace_size = 0x1000;
@@ -0,0 +1,172 @@
+//! \file validating_parser_test.cc
+
+// Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//!  \brief Validating parser tests.
+
+#include <gtest/gtest.h>
+
+#include "dump_fixture.h"
+
+#include <vartrace/vartrace.h>
+#include <vartrace/messageparser.h>
+#include <vartrace/validating_parser.h>
+
+#include <vector>
+
+using vartrace::VarTrace;
+using vartrace::SubtraceGuard;
+using vartrace::kInfoLevel;
+using vartrace::MessageView;
+using vartrace::TraceView;
+using vartrace::SkippedRange;
+
+namespace {
+//! Start positions of messages found by a sequential walk.
+std::vector<const void *> SequentialPositions(const TraceView &view) {
+  std::vector<const void *> positions;
+  for (vartrace::MessageIterator pos = view.begin(); pos != view.end();
+       ++pos) {
+    positions.push_back((*pos).message());
+  }
+  return positions;
+}
+
+//! Start positions of parsed messages.
+std::vector<const void *> Positions(const std::vector<MessageView> &messages) {
+  std::vector<const void *> positions;
+  for (std::size_t i = 0; i < messages.size(); ++i) {
+    positions.push_back(messages[i].message());
+  }
+  return positions;
+}
+}  // unnamed namespace
+
+//! Validating parser test suite, dumps a trace with subtraces.
+class ValidatingParserTestSuite : public DumpTestSuite {
+ protected:
+  //! Fill trace and dump it.
+  virtual void SetUp() {
+    VarTrace<> trace(0x4000);
+    char chars[] = "abcdefg";
+    for (int i = 0; i < 200; ++i) {
+      trace.Log(kInfoLevel, 1, i);
+      trace.Log(kInfoLevel, 2, chars, i % 8);
+      SubtraceGuard<VarTrace<> > guard(&trace, 3);
+      trace.Log(kInfoLevel, 4, 0.5*i);
+    }
+    Dump(&trace, 0x4000);
+  }
+};
+
+//! Intact dump is parsed like sequentially.
+TEST_F(ValidatingParserTestSuite, IntactTest) {
+  std::vector<SkippedRange> skipped;
+  std::vector<MessageView> messages = vartrace::ValidatingParse(view(),
+                                                                &skipped);
+  ASSERT_TRUE(skipped.empty());
+  ASSERT_EQ(SequentialPositions(view()), Positions(messages));
+  vartrace::ValidationOptions options;
+  options.known_types_only = true;
+  options.ordered_timestamps = true;
+  ASSERT_EQ(messages.size(),
+            vartrace::ValidatingParse(view(), NULL, options).size());
+}
+
+//! Overwritten words are skipped, following messages are found.
+TEST_F(ValidatingParserTestSuite, CorruptedTest) {
+  std::vector<const void *> expected = SequentialPositions(view());
+  ASSERT_LT(100, expected.size());
+  // damage messages 50 and 51
+  std::size_t first = static_cast<const uint32_t *>(expected[50])
+      - &buffer[0];
+  std::size_t last = static_cast<const uint32_t *>(expected[52])
+      - &buffer[0];
+  for (std::size_t i = first + 1; i < last; ++i) {
+    buffer[i] = 0xffffffff;
+  }
+  std::vector<SkippedRange> skipped;
+  std::vector<const void *> positions = Positions(
+      vartrace::ValidatingParse(view(), &skipped));
+  ASSERT_EQ(1, skipped.size());
+  ASSERT_EQ(first*sizeof(uint32_t), skipped[0].offset);
+  ASSERT_EQ((last - first)*sizeof(uint32_t), skipped[0].size);
+  expected.erase(expected.begin() + 50, expected.begin() + 52);
+  ASSERT_EQ(expected, positions);
+}
+
+//! Torn last record is reported, nothing is read past the end.
+TEST_F(ValidatingParserTestSuite, TruncatedTest) {
+  std::vector<const void *> expected = SequentialPositions(view());
+  std::size_t torn = static_cast<const uint32_t *>(expected.back())
+      - &buffer[0];
+  std::size_t size = (buffer.size() - 1)*sizeof(uint32_t);
+  std::vector<SkippedRange> skipped;
+  std::vector<MessageView> messages = vartrace::ValidatingParse(
+      TraceView(&buffer[0], size), &skipped);
+  ASSERT_EQ(expected.size() - 1, messages.size());
+  ASSERT_EQ(1, skipped.size());
+  ASSERT_EQ(torn*sizeof(uint32_t), skipped[0].offset);
+  ASSERT_EQ(size, skipped[0].offset + skipped[0].size);
+  // less than a header left
+  skipped.clear();
+  ASSERT_TRUE(vartrace::ValidatingParse(TraceView(&buffer[0], 6),
+                                        &skipped).empty());
+  ASSERT_EQ(6, skipped[0].size);
+}
+
+//! Empty subtrace with id 0 has a zero description and is still valid.
+TEST(ValidatingParserTest, EmptySubtraceTest) {
+  VarTrace<> trace(0x100);
+  trace.Log(kInfoLevel, 1, 1);
+  trace.BeginSubtrace(0);
+  trace.EndSubtrace();
+  trace.Log(kInfoLevel, 1, 2);
+  std::vector<uint32_t> buffer(0x40);
+  buffer.resize(trace.DumpInto(&buffer[0], buffer.size()*sizeof(uint32_t))
+                /sizeof(uint32_t));
+  ASSERT_EQ(0, buffer[vartrace::kHeaderLength + 2]);
+  std::vector<SkippedRange> skipped;
+  std::vector<MessageView> messages = vartrace::ValidatingParse(
+      TraceView(&buffer[0], buffer.size()*sizeof(uint32_t)), &skipped);
+  ASSERT_TRUE(skipped.empty());
+  ASSERT_EQ(3, messages.size());
+  ASSERT_EQ(0, messages[1].message_type_id());
+  ASSERT_EQ(0, messages[1].data_type_id());
+  ASSERT_EQ(0, messages[1].data_size());
+}
+
+//! Nested messages of a subtrace that was left open are skipped.
+TEST_F(ValidatingParserTestSuite, OpenSubtraceTest) {
+  std::vector<uint32_t> damaged;
+  // subtrace 7 of zero size followed by nested int message 8
+  damaged.push_back(0);
+  damaged.push_back(0x00070000);
+  damaged.push_back(0x05080004);
+  damaged.push_back(0x12345678);
+  std::size_t skipped_size = 2*sizeof(uint32_t);
+  damaged.insert(damaged.end(), buffer.begin(), buffer.end());
+  std::vector<SkippedRange> skipped;
+  vartrace::ParsedVartrace parsed(&damaged[0],
+                                  damaged.size()*sizeof(uint32_t), &skipped);
+  ASSERT_EQ(1, skipped.size());
+  ASSERT_EQ(2*sizeof(uint32_t), skipped[0].offset);
+  ASSERT_EQ(skipped_size, skipped[0].size);
+  ASSERT_EQ(SequentialPositions(view()).size() + 1, parsed.messages().size());
+  ASSERT_EQ(7, parsed[0]->message_type_id());
+  ASSERT_FALSE(parsed[0]->has_children());
+  ASSERT_EQ(1, parsed[1]->message_type_id());
+}
@@ -0,0 +1,524 @@
+/* vartrace_bench.cc
+ *
+ * Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file vartrace_bench.cc
+  Microbenchmarks of logging, subtraces, dumping and parsing.
+
+  Every case is calibrated until one repetition runs for at least the
+  minimum time, then repeated. Results are printed as JSON with the
+  median time per operation, its median absolute deviation, minimum
+  and maximum, so runs can be compared by scripts. Use --quick for a
+  short smoke run and --filter to select cases by name. Hardware
+  counters of the benchmark thread are added per operation when
+  perf_event_open is available, see perf_counters.h.
+*/
+
+#include <boost/program_options.hpp>
+
+#include <vartrace/vartrace.h>
+#include <vartrace/message_view.h>
+#include <vartrace/flat_parsed_trace.h>
+#include <vartrace/parallel_parser.h>
+#include <vartrace/validating_parser.h>
+#include <perf_counters.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using std::cout;
+using std::endl;
+
+using vartrace::VarTrace;
+using vartrace::SubtraceGuard;
+using vartrace::kInfoLevel;
+
+namespace po = boost::program_options;
+
+namespace {
+//! Case parameter, name and value.
+typedef std::pair<std::string, uint64_t> Param;
+
+//! Timings of one benchmark case.
+struct Result {
+  std::string name; //!< Group and parameters.
+  std::vector<Param> params; //!< Parameters of the case.
+  uint64_t iteration_count; //!< Operations per repetition.
+  uint64_t bytes_per_operation; //!< Payload or dump bytes, may be 0.
+  std::vector<double> samples; //!< Nanoseconds per operation.
+  double events[kPerfEventCount]; //!< Hardware events per operation.
+};
+
+//! Median of values, the vector is reordered.
+double Median(std::vector<double> *values) {
+  std::size_t middle = values->size()/2;
+  std::nth_element(values->begin(), values->begin() + middle, values->end());
+  double median = (*values)[middle];
+  if (values->size() % 2 == 0) {
+    median = (median + *std::max_element(values->begin(),
+                                         values->begin() + middle))/2;
+  }
+  return median;
+}
+
+//! Runs cases and collects their results.
+class Bench {
+ public:
+  //! Bench with given settings.
+  Bench(int repetition_count, double min_time, const std::string &filter,
+        bool is_quick, PerfCounters *counters)
+      : repetition_count_(repetition_count), min_time_(min_time),
+        filter_(filter), is_quick_(is_quick), counters_(counters) {}
+
+  //! True for short smoke runs.
+  bool is_quick() const { return is_quick_; }
+  //! Collected results.
+  const std::vector<Result> &results() const { return results_; }
+  //! Full name of a case.
+  static std::string Name(const std::string &group,
+                          const std::vector<Param> &params) {
+    std::string name = group;
+    for (std::size_t i = 0; i < params.size(); ++i) {
+      name += "/" + params[i].first + ":" + std::to_string(params[i].second);
+    }
+    return name;
+  }
+  //! True if a case passes the filter, checked before costly setup.
+  bool IsSelected(const std::string &group,
+                  const std::vector<Param> &params) const {
+    return Name(group, params).find(filter_) != std::string::npos;
+  }
+  //! Time operation(count) that performs count operations.
+  template <class F>
+  void Run(const std::string &group, const std::vector<Param> &params,
+           uint64_t bytes_per_operation, F operation) {
+    if (!IsSelected(group, params)) {
+      return;
+    }
+    Result result;
+    result.name = Name(group, params);
+    result.params = params;
+    result.bytes_per_operation = bytes_per_operation;
+    // calibration runs double as warm up
+    uint64_t count = 1;
+    double seconds = Time(count, operation);
+    while (seconds < min_time_) {
+      double scale = seconds > 0 ? 1.5*min_time_/seconds : 10;
+      count = std::max<uint64_t>(count + 1,
+                                 count*std::min(scale, 10.0));
+      seconds = Time(count, operation);
+    }
+    result.iteration_count = count;
+    counters_->Reset();
+    for (int i = 0; i < repetition_count_; ++i) {
+      counters_->Start();
+      result.samples.push_back(Time(count, operation)*1e9/count);
+      counters_->Stop();
+    }
+    for (int i = 0; i < kPerfEventCount; ++i) {
+      result.events[i] = counters_->value(i)/count/repetition_count_;
+    }
+    results_.push_back(result);
+  }
+  //! Print results as JSON.
+  void Print(std::ostream *out) const {
+    *out << "{\n  \"repetitions\": " << repetition_count_
+         << ",\n  \"min_time_s\": " << min_time_
+         << ",\n  \"counters\": [";
+    for (int i = 0, j = 0; i < kPerfEventCount; ++i) {
+      if (counters_->is_open(i)) {
+        *out << (j++ ? ", " : "") << "\"" << kPerfEventNames[i] << "\"";
+      }
+    }
+    *out << "],\n  \"results\": [";
+    for (std::size_t i = 0; i < results_.size(); ++i) {
+      const Result &result = results_[i];
+      std::vector<double> samples = result.samples;
+      double median = Median(&samples);
+      std::vector<double> deviations;
+      for (std::size_t j = 0; j < samples.size(); ++j) {
+        deviations.push_back(samples[j] > median ? samples[j] - median
+                             : median - samples[j]);
+      }
+      char line[256];
+      *out << (i ? "," : "") << "\n    {\"name\": \"" << result.name
+           << "\", \"params\": {";
+      for (std::size_t j = 0; j < result.params.size(); ++j) {
+        *out << (j ? ", " : "") << "\"" << result.params[j].first
+             << "\": " << result.params[j].second;
+      }
+      std::snprintf(line, sizeof(line),
+                    "}, \"iterations\": %llu, \"median_ns\": %.4g, "
+                    "\"mad_ns\": %.3g, \"min_ns\": %.4g, \"max_ns\": %.4g",
+                    static_cast<unsigned long long>(result.iteration_count),
+                    median, Median(&deviations),
+                    *std::min_element(samples.begin(), samples.end()),
+                    *std::max_element(samples.begin(), samples.end()));
+      *out << line;
+      if (result.bytes_per_operation) {
+        std::snprintf(line, sizeof(line), ", \"bytes\": %llu, \"mb_s\": %.4g",
+                      static_cast<unsigned long long>(
+                          result.bytes_per_operation),
+                      result.bytes_per_operation*1e3/median);
+        *out << line;
+      }
+      for (int j = 0; j < kPerfEventCount; ++j) {
+        if (counters_->is_open(j)) {
+          std::snprintf(line, sizeof(line), ", \"%s\": %.4g",
+                        kPerfEventNames[j], result.events[j]);
+          *out << line;
+        }
+      }
+      *out << "}";
+    }
+    *out << "\n  ]\n}" << endl;
+  }
+
+ private:
+  //! Seconds taken by count operations.
+  template <class F> static double Time(uint64_t count, F operation) {
+    auto begin = std::chrono::steady_clock::now();
+    operation(count);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - begin).count();
+  }
+
+  int repetition_count_; //!< Timed repetitions of every case.
+  double min_time_; //!< Minimal duration of a repetition in seconds.
+  std::string filter_; //!< Substring of selected case names.
+  bool is_quick_; //!< Fewer sizes and shorter runs.
+  PerfCounters *counters_; //!< Hardware counters of this thread.
+  std::vector<Result> results_; //!< Finished cases.
+};
+
+//! Structure copied with memcpy.
+struct CharArray64 {
+  char cs[64]; //!< Payload.
+};
+
+//! Object with custom log function.
+struct CustomLogged {
+  int ivar; //!< Logged integer.
+  double dvar; //!< Logged double.
+};
+
+//! Self logging object that contains Depth - 1 nested levels.
+template <int Depth> struct Nested {
+  //! Store value and nested object, which opens a subtrace.
+  template <class W> void LogItself(W *writer) const {
+    writer->Log(kInfoLevel, 1, value);
+    writer->Log(kInfoLevel, 2, inner);
+  }
+  int value; //!< Logged integer.
+  Nested<Depth - 1> inner; //!< Next level.
+};
+
+//! Innermost level of nested objects.
+template <> struct Nested<1> {
+  //! Store value.
+  template <class W> void LogItself(W *writer) const {
+    writer->Log(kInfoLevel, 1, value);
+  }
+  int value; //!< Logged integer.
+};
+}  // unnamed namespace
+
+namespace vartrace {
+//! Custom logging function.
+template <class W> void LogObject(const CustomLogged &object, W *writer) {
+  writer->Log(kInfoLevel, 1, object.ivar);
+  writer->Log(kInfoLevel, 2, object.dvar);
+}
+}  // namespace vartrace
+
+VARTRACE_SET_LOG_FUNCTION(CustomLogged);
+VARTRACE_SET_SELFLOGGING(Nested<1>);
+VARTRACE_SET_SELFLOGGING(Nested<2>);
+VARTRACE_SET_SELFLOGGING(Nested<4>);
+VARTRACE_SET_SELFLOGGING(Nested<8>);
+
+namespace {
+//! Ring size of logging cases that do not vary it.
+const unsigned kRingSize = 0x10000;
+//! Ring size of payload cases, holds several largest payloads.
+const unsigned kPayloadRingSize = 0x100000;
+
+//! Time logging of one value of a type.
+template <class T, class Trace = VarTrace<> >
+void LogValue(Bench *bench, const std::string &group, unsigned ring_size) {
+  std::vector<Param> params{Param("ring_bytes", ring_size)};
+  if (!bench->IsSelected(group, params)) {
+    return;
+  }
+  Trace trace(ring_size);
+  T value{};
+  bench->Run(group, params, sizeof(T), [&](uint64_t count) {
+      for (uint64_t i = 0; i < count; ++i) {
+        trace.Log(kInfoLevel, 1, value);
+      }
+    });
+}
+
+//! One case per CopyTraits category and for policy variants.
+void CopyCategories(Bench *bench) {
+  LogValue<int8_t>(bench, "assignment/int8", kRingSize);
+  LogValue<int32_t>(bench, "assignment/int32", kRingSize);
+  LogValue<int64_t>(bench, "assignment/int64", kRingSize);
+  LogValue<double>(bench, "assignment/double", kRingSize);
+  LogValue<CharArray64>(bench, "sizeof/char64", kRingSize);
+  LogValue<CustomLogged>(bench, "custom/int_double", kRingSize);
+  LogValue<Nested<1> >(bench, "self/depth1", kRingSize);
+  LogValue<Nested<2> >(bench, "self/depth2", kRingSize);
+  LogValue<Nested<4> >(bench, "self/depth4", kRingSize);
+  LogValue<Nested<8> >(bench, "self/depth8", kRingSize);
+  LogValue<int32_t, VarTrace<vartrace::User5LogLevel,
+                             vartrace::MultiThreaded> >(
+      bench, "multithreaded/int32", kRingSize);
+  LogValue<int32_t, VarTrace<vartrace::User5LogLevel,
+                             vartrace::SingleThreaded,
+                             vartrace::RelaxedCounting> >(
+      bench, "counted/int32", kRingSize);
+}
+
+//! Arrays from 1 byte to 64 KB.
+void Payloads(Bench *bench) {
+  // the largest payload a header can describe
+  std::vector<unsigned> sizes{1, 4, 16, 64, 256, 0x400, 0x1000, 0x4000,
+        vartrace::kMaxDataSize};
+  if (bench->is_quick()) {
+    sizes = {1, 64, 0x1000};
+  }
+  std::vector<uint8_t> payload(sizes.back(), 0x5a);
+  for (std::size_t i = 0; i < sizes.size(); ++i) {
+    std::vector<Param> params{Param("payload_bytes", sizes[i]),
+          Param("ring_bytes", kPayloadRingSize)};
+    if (!bench->IsSelected("array", params)) {
+      continue;
+    }
+    VarTrace<> trace(kPayloadRingSize);
+    unsigned size = sizes[i];
+    bench->Run("array", params, size, [&](uint64_t count) {
+        for (uint64_t j = 0; j < count; ++j) {
+          trace.Log(kInfoLevel, 1, &payload[0], size);
+        }
+      });
+  }
+}
+
+//! Ring sizes from in cache to out of cache, both wrap all the time.
+void RingSizes(Bench *bench) {
+  std::vector<unsigned> sizes{0x4000, 0x40000, 0x400000, 0x4000000};
+  if (bench->is_quick()) {
+    sizes.resize(2);
+  }
+  for (std::size_t i = 0; i < sizes.size(); ++i) {
+    LogValue<int32_t>(bench, "ring/int32", sizes[i]);
+    LogValue<CharArray64>(bench, "ring/char64", sizes[i]);
+  }
+}
+
+//! Explicit subtraces with four messages each.
+void Subtraces(Bench *bench) {
+  std::vector<Param> params{Param("ring_bytes", kRingSize)};
+  if (!bench->IsSelected("subtrace/4_int32", params)) {
+    return;
+  }
+  VarTrace<> trace(kRingSize);
+  bench->Run("subtrace/4_int32", params, 0, [&](uint64_t count) {
+      for (uint64_t i = 0; i < count; ++i) {
+        SubtraceGuard<VarTrace<> > guard(&trace, 1);
+        for (int j = 0; j < 4; ++j) {
+          trace.Log(kInfoLevel, 2, j);
+        }
+      }
+    });
+}
+
+//! Int logging with overflow policies, optionally with a drainer.
+void Policies(Bench *bench) {
+  const struct {
+    const char *group;
+    vartrace::OverflowPolicy policy;
+    bool is_drained;
+  } cases[] = {
+    {"policy/drop_new_full", vartrace::kDropNew, false},
+    {"policy/drop_new_drained", vartrace::kDropNew, true},
+    {"policy/block_drained", vartrace::kBlock, true}
+  };
+  for (std::size_t i = 0; i < sizeof(cases)/sizeof(cases[0]); ++i) {
+    std::vector<Param> params{Param("ring_bytes", kRingSize)};
+    if (!bench->IsSelected(cases[i].group, params)) {
+      continue;
+    }
+    VarTrace<vartrace::User5LogLevel, vartrace::MultiThreaded>
+        trace(kRingSize);
+    trace.SetOverflowPolicy(cases[i].policy);
+    std::atomic<bool> is_done(false);
+    std::thread drainer;
+    if (cases[i].is_drained) {
+      drainer = std::thread([&trace, &is_done]() {
+          vartrace::AlignmentType buffer[0x100];
+          while (!is_done) {
+            if (!trace.DrainInto(buffer, sizeof(buffer))) {
+              std::this_thread::yield();
+            }
+          }
+        });
+    }
+    bench->Run(cases[i].group, params, sizeof(int32_t), [&](uint64_t count) {
+        for (uint64_t j = 0; j < count; ++j) {
+          trace.Log(kInfoLevel, 1, static_cast<int32_t>(j));
+        }
+      });
+    is_done = true;
+    if (drainer.joinable()) {
+      drainer.join();
+    }
+  }
+}
+
+//! Fill a trace with assorted messages.
+void Fill(VarTrace<> *trace, unsigned size) {
+  char chars[16] = "0123456789abcde";
+  for (uint32_t i = 0; i < size/0x20; ++i) {
+    trace->Log(kInfoLevel, 1, i);
+    trace->Log(kInfoLevel, 2, 0.5*i);
+    trace->Log(kInfoLevel, 3, chars);
+    SubtraceGuard<VarTrace<> > guard(trace, 4);
+    trace->Log(kInfoLevel, 5, i);
+    trace->Log(kInfoLevel, 6, i);
+  }
+}
+
+//! DumpInto() of full traces and parsing of the dump.
+void DumpAndParse(Bench *bench) {
+  std::vector<unsigned> sizes{0x40000, 0x4000000};
+  if (bench->is_quick()) {
+    sizes.resize(1);
+  }
+  unsigned thread_count = std::max(1u, std::thread::hardware_concurrency());
+  const char *groups[] = {"dump", "parse/trace_view", "parse/validating",
+                          "parse/parallel", "parse/flat"};
+  for (std::size_t i = 0; i < sizes.size(); ++i) {
+    std::vector<Param> params{Param("ring_bytes", sizes[i])};
+    bool is_selected = false;
+    for (std::size_t j = 0; j < sizeof(groups)/sizeof(groups[0]); ++j) {
+      is_selected = is_selected || bench->IsSelected(groups[j], params);
+    }
+    if (!is_selected) {
+      continue;
+    }
+    VarTrace<> trace(sizes[i]);
+    Fill(&trace, sizes[i]);
+    std::vector<uint32_t> dump(sizes[i]/sizeof(uint32_t));
+    unsigned size = trace.DumpInto(&dump[0], sizes[i]);
+    bench->Run("dump", params, size, [&](uint64_t count) {
+        for (uint64_t j = 0; j < count; ++j) {
+          trace.DumpInto(&dump[0], sizes[i]);
+        }
+      });
+    vartrace::TraceView view(&dump[0], size);
+    volatile std::size_t sink = 0;
+    bench->Run("parse/trace_view", params, size, [&](uint64_t count) {
+        for (uint64_t j = 0; j < count; ++j) {
+          std::size_t message_count = 0;
+          for (vartrace::MessageIterator pos = view.begin();
+               pos != view.end(); ++pos) {
+            ++message_count;
+          }
+          sink = message_count;
+        }
+      });
+    bench->Run("parse/validating", params, size, [&](uint64_t count) {
+        for (uint64_t j = 0; j < count; ++j) {
+          sink = vartrace::ValidatingParse(view, NULL).size();
+        }
+      });
+    std::vector<Param> parallel_params(params);
+    parallel_params.push_back(Param("threads", thread_count));
+    bench->Run("parse/parallel", parallel_params, size, [&](uint64_t count) {
+        for (uint64_t j = 0; j < count; ++j) {
+          sink = vartrace::ParallelParse(view, thread_count).size();
+        }
+      });
+    bench->Run("parse/flat", params, size, [&](uint64_t count) {
+        for (uint64_t j = 0; j < count; ++j) {
+          vartrace::FlatParsedTrace parsed(view);
+          sink = parsed.size();
+        }
+      });
+  }
+}
+
+//! Define and parse command line arguments, process help option.
+po::variables_map parse_commandline(int argc, char *argv[]) {
+  po::options_description desc(
+      "Vartrace microbenchmarks, results are printed as JSON\n"
+      "Usage: vartrace_bench [options]");
+  desc.add_options()
+      ("help,h", "produce help message")
+      ("quick", "fewer sizes and short repetitions")
+      ("no-counters", "do not open hardware performance counters")
+      ("filter", po::value<std::string>()->default_value(""),
+       "run cases whose name contains the string")
+      ("repetitions", po::value<int>(), "timed repetitions of every case")
+      ("min-time", po::value<double>(),
+       "minimal duration of a repetition in seconds");
+  po::variables_map args;
+  po::store(po::parse_command_line(argc, argv, desc), args);
+  po::notify(args);
+  if (args.count("help")) {
+    std::cerr << desc << endl;
+  }
+  return args;
+}
+}  // unnamed namespace
+
+//! Run all selected cases and print results.
+int main(int argc, char *argv[]) {
+  po::variables_map args = parse_commandline(argc, argv);
+  if (args.count("help")) {
+    return 0;
+  }
+  bool is_quick = args.count("quick") != 0;
+  int repetition_count = args.count("repetitions")
+      ? args["repetitions"].as<int>() : (is_quick ? 3 : 9);
+  double min_time = args.count("min-time")
+      ? args["min-time"].as<double>() : (is_quick ? 1e-3 : 0.05);
+  if (repetition_count < 1 || min_time < 0) {
+    std::cerr << "ERROR: invalid repetitions or min-time" << endl;
+    return 1;
+  }
+  PerfCounters counters(!args.count("no-counters"));
+  Bench bench(repetition_count, min_time, args["filter"].as<std::string>(),
+              is_quick, &counters);
+  CopyCategories(&bench);
+  Payloads(&bench);
+  RingSizes(&bench);
+  Subtraces(&bench);
+  Policies(&bench);
+  DumpAndParse(&bench);
+  bench.Print(&cout);
+  return 0;
+}
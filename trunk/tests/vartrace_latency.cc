@@ -0,0 +1,298 @@
+/* vartrace_latency.cc
+ *
+ * Copyright (C) 2014 Alexey Naydenov <alexey.naydenovREMOVETHIS@linux.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file vartrace_latency.cc
+  Latency distribution of single Log calls.
+
+  Every call is timed separately and recorded in a log-linear
+  histogram, so that rare slow calls, such as the split copy at the
+  end of the circular buffer, cache misses on a new block or page
+  faults during the first lap, show up in the upper percentiles
+  instead of disappearing in an average. On x86 the time stamp
+  counter is read with fences around the measured call, elsewhere
+  steady_clock is used. The smallest time of an empty measurement is
+  subtracted from every sample.
+
+  Scenarios:
+  - cold: first lap of a freshly allocated large ring;
+  - warm: ring that already wrapped and stays in cache if it fits;
+  - contended: several threads logging into a MultiThreaded trace.
+
+  Results are printed as JSON, times are given in timer ticks and in
+  nanoseconds.
+*/
+
+#include <boost/program_options.hpp>
+
+#include <vartrace/vartrace.h>
+#include <vartrace/trace_stats.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::cout;
+using std::endl;
+
+using vartrace::VarTrace;
+using vartrace::Histogram;
+using vartrace::kInfoLevel;
+
+namespace po = boost::program_options;
+
+namespace {
+//! Percentiles printed for every scenario.
+const double kPercentiles[] = {0.5, 0.9, 0.99, 0.999, 0.9999, 0.99999};
+//! Largest ring of the cold scenario, longer runs wrap around.
+const uint64_t kMaxColdRingSize = 1 << 30;
+//! Number of empty measurements used to find timer overhead.
+const int kOverheadSampleCount = 10000;
+
+#if defined(__x86_64__) || defined(__i386__)
+//! Timer name printed with the results.
+const char kTimerName[] = "rdtsc";
+//! Read counter before the measured code, earlier loads must finish.
+inline uint64_t StartTicks() {
+  _mm_lfence();
+  uint64_t ticks = __rdtsc();
+  _mm_lfence();
+  return ticks;
+}
+//! Read counter after the measured code has finished.
+inline uint64_t StopTicks() {
+  unsigned aux;
+  uint64_t ticks = __rdtscp(&aux);
+  _mm_lfence();
+  return ticks;
+}
+#else
+//! Timer name printed with the results.
+const char kTimerName[] = "steady_clock";
+//! Nanoseconds before the measured code.
+inline uint64_t StartTicks() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+//! Nanoseconds after the measured code.
+inline uint64_t StopTicks() {
+  return StartTicks();
+}
+#endif
+
+//! Smallest number of ticks of an empty measurement.
+uint64_t TimerOverhead() {
+  uint64_t overhead = ~static_cast<uint64_t>(0);
+  for (int i = 0; i < kOverheadSampleCount; ++i) {
+    uint64_t start = StartTicks();
+    uint64_t stop = StopTicks();
+    overhead = std::min(overhead, stop - start);
+  }
+  return overhead;
+}
+
+//! Timer ticks per nanosecond measured against steady_clock.
+double TicksPerNs(double seconds) {
+  auto begin = std::chrono::steady_clock::now();
+  uint64_t start = StartTicks();
+  auto end = begin;
+  do {
+    end = std::chrono::steady_clock::now();
+  } while (std::chrono::duration<double>(end - begin).count() < seconds);
+  uint64_t stop = StopTicks();
+  return (stop - start)
+      /std::chrono::duration<double, std::nano>(end - begin).count();
+}
+
+//! Settings shared by all scenarios.
+struct Settings {
+  uint64_t count; //!< Measured calls per thread.
+  unsigned payload; //!< Bytes of logged arrays, 0 logs an int32.
+  uint64_t overhead; //!< Timer overhead subtracted from samples.
+};
+
+//! Log count messages into a trace and record every call.
+template <class Trace>
+void Measure(Trace *trace, const Settings &settings, Histogram *histogram) {
+  std::vector<uint8_t> payload(std::max(settings.payload, 1u), 0x5a);
+  for (uint64_t i = 0; i < settings.count; ++i) {
+    uint64_t start, stop;
+    if (settings.payload) {
+      start = StartTicks();
+      trace->Log(kInfoLevel, 1, &payload[0], settings.payload);
+      stop = StopTicks();
+    } else {
+      int32_t value = i;
+      start = StartTicks();
+      trace->Log(kInfoLevel, 1, value);
+      stop = StopTicks();
+    }
+    uint64_t ticks = stop - start;
+    histogram->Record(ticks > settings.overhead ? ticks - settings.overhead
+                      : 0);
+  }
+}
+
+//! Bytes taken in the trace by one message.
+unsigned MessageSize(unsigned payload) {
+  return sizeof(vartrace::AlignmentType)
+      *(vartrace::kHeaderLength + vartrace::RoundSize(payload ? payload : 4));
+}
+
+//! First lap of a ring that was just allocated and never touched.
+Histogram Cold(const Settings &settings) {
+  std::size_t ring_size = vartrace::CeilPower2(std::min<uint64_t>(
+      kMaxColdRingSize, settings.count*MessageSize(settings.payload)));
+  VarTrace<> trace(ring_size);
+  Histogram histogram;
+  Measure(&trace, settings, &histogram);
+  return histogram;
+}
+
+//! Ring that already wrapped once.
+Histogram Warm(const Settings &settings, std::size_t ring_size) {
+  VarTrace<> trace(ring_size);
+  Settings fill(settings);
+  fill.count = 2*ring_size/MessageSize(settings.payload) + 1;
+  Histogram ignored;
+  Measure(&trace, fill, &ignored);
+  Histogram histogram;
+  Measure(&trace, settings, &histogram);
+  return histogram;
+}
+
+//! Threads that log into one locked trace at the same time.
+Histogram Contended(const Settings &settings, std::size_t ring_size,
+                    unsigned thread_count) {
+  typedef VarTrace<vartrace::User5LogLevel, vartrace::MultiThreaded> Trace;
+  Trace trace(ring_size);
+  std::vector<Histogram> histograms(thread_count);
+  std::vector<std::thread> threads;
+  std::atomic<unsigned> ready_count(0);
+  for (unsigned i = 0; i < thread_count; ++i) {
+    threads.push_back(std::thread([&, i]() {
+          ++ready_count;
+          while (ready_count.load() != thread_count) {
+            std::this_thread::yield();
+          }
+          Measure(&trace, settings, &histograms[i]);
+        }));
+  }
+  Histogram histogram;
+  for (unsigned i = 0; i < thread_count; ++i) {
+    threads[i].join();
+    histogram.Add(histograms[i]);
+  }
+  return histogram;
+}
+
+//! Print one scenario as a JSON object.
+void Print(const char *name, const Histogram &histogram, double ticks_per_ns,
+           bool is_last) {
+  char line[128];
+  cout << "    {\"name\": \"" << name << "\", \"count\": "
+       << histogram.count();
+  std::snprintf(line, sizeof(line), ", \"mean\": %.1f, \"min\": %llu",
+                histogram.mean(),
+                static_cast<unsigned long long>(histogram.min()));
+  cout << line;
+  for (std::size_t i = 0; i < sizeof(kPercentiles)/sizeof(kPercentiles[0]);
+       ++i) {
+    std::snprintf(line, sizeof(line), ", \"p%g\": %llu",
+                  100*kPercentiles[i], static_cast<unsigned long long>(
+                      histogram.Percentile(kPercentiles[i])));
+    cout << line;
+  }
+  std::snprintf(line, sizeof(line),
+                ", \"max\": %llu, \"p99_ns\": %.1f, \"p99.99_ns\": %.1f}",
+                static_cast<unsigned long long>(histogram.max()),
+                histogram.Percentile(0.99)/ticks_per_ns,
+                histogram.Percentile(0.9999)/ticks_per_ns);
+  cout << line << (is_last ? "" : ",") << endl;
+}
+
+//! Define and parse command line arguments, process help option.
+po::variables_map parse_commandline(int argc, char *argv[]) {
+  po::options_description desc(
+      "Per call latency of Log, results are printed as JSON\n"
+      "Usage: vartrace_latency [options]");
+  desc.add_options()
+      ("help,h", "produce help message")
+      ("quick", "few calls for a smoke run")
+      ("count", po::value<uint64_t>(), "measured calls per scenario")
+      ("payload", po::value<unsigned>()->default_value(0),
+       "bytes of logged arrays, 0 logs int32 values")
+      ("ring-size", po::value<std::size_t>()->default_value(0x100000),
+       "ring size of warm and contended scenarios")
+      ("threads", po::value<unsigned>(),
+       "threads of the contended scenario");
+  po::variables_map args;
+  po::store(po::parse_command_line(argc, argv, desc), args);
+  po::notify(args);
+  if (args.count("help")) {
+    std::cerr << desc << endl;
+  }
+  return args;
+}
+}  // unnamed namespace
+
+//! Run scenarios and print percentiles.
+int main(int argc, char *argv[]) {
+  po::variables_map args = parse_commandline(argc, argv);
+  if (args.count("help")) {
+    return 0;
+  }
+  bool is_quick = args.count("quick") != 0;
+  Settings settings;
+  settings.count = args.count("count") ? args["count"].as<uint64_t>()
+      : (is_quick ? 10000 : 1000000);
+  settings.payload = args["payload"].as<unsigned>();
+  std::size_t ring_size = args["ring-size"].as<std::size_t>();
+  unsigned thread_count = args.count("threads")
+      ? args["threads"].as<unsigned>()
+      : std::max(2u, std::thread::hardware_concurrency());
+  if (!settings.count || !thread_count
+      || settings.payload > vartrace::kMaxDataSize
+      || ring_size < 4*MessageSize(settings.payload)) {
+    std::cerr << "ERROR: invalid count, threads, payload or ring size"
+              << endl;
+    return 1;
+  }
+  settings.overhead = TimerOverhead();
+  double ticks_per_ns = TicksPerNs(is_quick ? 0.01 : 0.1);
+
+  cout << "{\n  \"timer\": \"" << kTimerName << "\", \"ticks_per_ns\": "
+       << ticks_per_ns << ", \"overhead_ticks\": " << settings.overhead
+       << ",\n  \"payload_bytes\": " << settings.payload
+       << ", \"ring_bytes\": " << ring_size << ", \"threads\": "
+       << thread_count << ",\n  \"scenarios\": [" << endl;
+  Print("cold", Cold(settings), ticks_per_ns, false);
+  Print("warm", Warm(settings, ring_size), ticks_per_ns, false);
+  Print("contended", Contended(settings, ring_size, thread_count),
+        ticks_per_ns, true);
+  cout << "  ]\n}" << endl;
+  return 0;
+}